@@ -0,0 +1,61 @@
+// bench/bench_frustum.cpp
+// Chunk frustum culling: cull_aabbs (SSE / AVX) vs. the scalar reference over a
+// large grid of 32^3 chunk boxes, for a camera inside the grid and one above it.
+#include "frustum.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace vxl;
+
+namespace {
+
+struct Timer {
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  double ns_per(std::size_t n) const {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / double(n);
+  }
+};
+
+volatile std::size_t g_sink = 0;
+
+template <class Cull>
+double measure(Cull&& cull, const Frustum& F, const AabbBatch& B, int reps) {
+  std::vector<uint8_t> vis;
+  cull(F, B, vis);   // warm up
+  Timer t;
+  for (int r = 0; r < reps; ++r) g_sink = g_sink + cull(F, B, vis);
+  return t.ns_per(B.size() * std::size_t(reps));
+}
+
+void run(const char* name, const AabbBatch& B, const glm::vec3& eye, const glm::vec3& at) {
+  glm::mat4 P = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.05f, 2000.0f);
+  glm::mat4 V = glm::lookAt(eye, at, glm::vec3(0, 1, 0));
+  const Frustum F = Frustum::from_matrix(P * V);
+  std::vector<uint8_t> vis;
+  const std::size_t visible = cull_aabbs(F, B, vis);
+  const int reps = 200;
+  const double simd = measure(cull_aabbs, F, B, reps);
+  const double scalar = measure(cull_aabbs_scalar, F, B, reps);
+  std::printf("%-12s %zu boxes, %zu visible (%.1f%%)\n", name, B.size(), visible, 100.0 * double(visible) / double(B.size()));
+  std::printf("    %-8s %6.2f ns/box\n    %-8s %6.2f ns/box   (x%.1f)\n", cull_isa(), simd, "scalar", scalar, scalar / simd);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  // n x 4 x n chunks of 32^3, centered on the origin
+  const int n = (argc > 1) ? std::atoi(argv[1]) : 128;
+  AabbBatch B;
+  for (int z = -n / 2; z < n / 2; ++z)
+    for (int y = -2; y < 2; ++y)
+      for (int x = -n / 2; x < n / 2; ++x) {
+        glm::vec3 lo = glm::vec3(float(x), float(y), float(z)) * 32.0f - 0.87f;
+        B.push(lo, lo + 32.74f);
+      }
+  run("inside", B, glm::vec3(10, 20, 10), glm::vec3(200, 0, 150));
+  run("overhead", B, glm::vec3(0, 1500, 600), glm::vec3(0, 0, 0));
+  return 0;
+}
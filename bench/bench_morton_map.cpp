@@ -0,0 +1,86 @@
+// bench/bench_morton_map.cpp
+// MortonMap/MortonSet vs. std::unordered_map/unordered_set with IVec3Hasher:
+// insert, hit lookup and miss lookup for random, clustered and sequential keys.
+#include "morton_map.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace vxl;
+
+namespace {
+
+struct Timer {
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  double ns_per(std::size_t n) const {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / double(n);
+  }
+};
+
+volatile std::size_t g_sink = 0;
+
+template <class Insert, class Find>
+void measure(const char* name, const std::vector<IVec3>& keys, const std::vector<IVec3>& probes,
+             const std::vector<IVec3>& misses, Insert&& insert, Find&& find) {
+  Timer ti; for (auto& p : keys) insert(p); double ins = ti.ns_per(keys.size());
+  Timer th; for (auto& p : probes) g_sink = g_sink + find(p); double hit = th.ns_per(probes.size());
+  Timer tm; for (auto& p : misses) g_sink = g_sink + find(p); double miss = tm.ns_per(misses.size());
+  std::printf("    %-14s insert %6.1f ns   hit %6.1f ns   miss %6.1f ns\n", name, ins, hit, miss);
+}
+
+void run(const char* pattern, std::vector<IVec3> keys, std::vector<IVec3> probes) {
+  std::printf("%s (%zu keys)\n", pattern, keys.size());
+  std::vector<IVec3> misses(probes.size());
+  for (std::size_t i = 0; i < probes.size(); ++i) misses[i] = {probes[i].x, probes[i].y + 100000, probes[i].z};
+
+  std::printf("  map<IVec3,int>\n");
+  { std::unordered_map<IVec3, int, IVec3Hasher> m;
+    measure("unordered_map", keys, probes, misses, [&](const IVec3& p){ m[p] = 1; }, [&](const IVec3& p){ return m.count(p); }); }
+  { MortonMap<int> m;
+    measure("MortonMap", keys, probes, misses, [&](const IVec3& p){ m[p] = 1; }, [&](const IVec3& p){ return m.find(p) != nullptr; }); }
+  std::printf("  set<IVec3>\n");
+  { std::unordered_set<IVec3, IVec3Hasher> s;
+    measure("unordered_set", keys, probes, misses, [&](const IVec3& p){ s.insert(p); }, [&](const IVec3& p){ return s.count(p); }); }
+  { MortonSet s;
+    measure("MortonSet", keys, probes, misses, [&](const IVec3& p){ s.insert(p); }, [&](const IVec3& p){ return s.contains(p); }); }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t n = (argc > 1) ? std::size_t(std::atol(argv[1])) : 1000000;
+  std::mt19937 rng(123);
+
+  // random: uniform over a large cube; probes in shuffled order
+  std::vector<IVec3> random(n);
+  std::uniform_int_distribution<int> wide(-500000, 500000);
+  for (auto& p : random) p = {wide(rng), wide(rng), wide(rng)};
+  std::vector<IVec3> randomProbes = random;
+  std::shuffle(randomProbes.begin(), randomProbes.end(), rng);
+  run("random", random, randomProbes);
+
+  // clustered: small blobs around scattered centers, probed blob by blob
+  std::vector<IVec3> clustered;
+  clustered.reserve(n);
+  std::uniform_int_distribution<int> off(-6, 6);
+  while (clustered.size() < n) {
+    IVec3 c{wide(rng), wide(rng), wide(rng)};
+    for (int k = 0; k < 512 && clustered.size() < n; ++k) clustered.push_back({c.x + off(rng), c.y + off(rng), c.z + off(rng)});
+  }
+  run("clustered", clustered, clustered);
+
+  // sequential: x-fastest scan of a block, probed in the same order
+  std::vector<IVec3> sequential;
+  sequential.reserve(n);
+  int edge = 1; while (std::size_t(edge) * edge * edge < n) ++edge;
+  for (int z = 0; z < edge && sequential.size() < n; ++z)
+    for (int y = 0; y < edge && sequential.size() < n; ++y)
+      for (int x = 0; x < edge && sequential.size() < n; ++x) sequential.push_back({x, y, z});
+  run("sequential", sequential, sequential);
+  return 0;
+}
@@ -0,0 +1,137 @@
+// bench/bench_occlusion.cpp
+// Software occlusion culling over a generated city: for each frame of a camera
+// path, frustum-cull the chunk boxes, rasterize the nearest occluders and test
+// the survivors, serially and on a worker pool. Pass a path file to replay a
+// recorded path instead of the built-in street-level fly-through; one frame per
+// line, "eye.x eye.y eye.z target.x target.y target.z", '#' starts a comment.
+#include "frustum.hpp"
+#include "occlusion.hpp"
+#include "universe.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace vxl;
+
+namespace {
+
+struct Frame { glm::vec3 eye, target; };
+
+struct Scene {
+  AabbBatch chunks;
+  std::vector<Box3> occluders;
+  std::size_t voxels = 0;
+};
+
+/// Blocks of buildings of varying height on a ground slab, streets between them.
+Scene make_city(int blocks) {
+  Universe U;
+  std::vector<IVec3> cells;
+  Cube c;
+  const int pitch = 48, size = 32, streets = pitch - size;
+  for (int bz = 0; bz < blocks; ++bz)
+    for (int bx = 0; bx < blocks; ++bx) {
+      const int h = 24 + ((bx * 7 + bz * 13) % 5) * 20;
+      cells.clear();
+      for (int z = 0; z < size; ++z)
+        for (int y = 0; y < h; ++y)
+          for (int x = 0; x < size; ++x) cells.push_back({bx * pitch + streets + x, y, bz * pitch + streets + z});
+      U.place_many(cells, std::span<const Cube>(&c, 1));
+    }
+  Scene S;
+  S.voxels = U.store().size();
+  U.store().for_each_chunk([&](const IVec3& cc, const Chunk& ch) {
+    const glm::vec3 lo = glm::vec3(float(cc.x), float(cc.y), float(cc.z)) * float(CHUNK_SIZE) - 0.87f;
+    S.chunks.push(lo, lo + (float(CHUNK_SIZE - 1) + 1.74f));
+    occluder_boxes(ch, cc, S.occluders);
+  });
+  return S;
+}
+
+std::vector<Frame> street_path(int blocks) {
+  // Along the first street, then diagonally over the roofs
+  std::vector<Frame> path;
+  const float len = float(blocks * 48);
+  for (int i = 0; i < 240; ++i) {
+    const float t = float(i) / 240.0f * len;
+    path.push_back({{8.0f, 6.0f, t}, {8.0f + 10.0f * std::sin(t * 0.02f), 6.0f, t + 40.0f}});
+  }
+  for (int i = 0; i < 120; ++i) {
+    const float t = float(i) / 120.0f * len;
+    path.push_back({{t, 140.0f, t}, {t + 60.0f, 40.0f, t + 60.0f}});
+  }
+  return path;
+}
+
+std::vector<Frame> load_path(const char* file) {
+  std::vector<Frame> path;
+  std::ifstream in(file);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream ss(line);
+    Frame f;
+    if (ss >> f.eye.x >> f.eye.y >> f.eye.z >> f.target.x >> f.target.y >> f.target.z) path.push_back(f);
+  }
+  return path;
+}
+
+struct Totals { double ms = 0; std::size_t inFrustum = 0, occluded = 0; };
+
+Totals replay(const Scene& S, const std::vector<Frame>& path, ThreadPool* pool) {
+  const glm::mat4 P = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.05f, 2000.0f);
+  OcclusionBuffer ob(256, 144);
+  std::vector<uint8_t> vis;
+  std::vector<std::pair<float, Box3>> cand;
+  std::vector<Box3> chosen;
+  Totals T;
+  for (const Frame& f : path) {
+    const glm::mat4 clip = P * glm::lookAt(f.eye, f.target, glm::vec3(0, 1, 0));
+    T.inFrustum += cull_aabbs(Frustum::from_matrix(clip), S.chunks, vis);
+    const auto t0 = std::chrono::steady_clock::now();
+    cand.clear();
+    for (const Box3& o : S.occluders)
+      cand.push_back({glm::length(glm::max(o.lo, glm::min(f.eye, o.hi)) - f.eye), o});
+    const std::size_t n = std::min<std::size_t>(512, cand.size());
+    std::partial_sort(cand.begin(), cand.begin() + std::ptrdiff_t(n), cand.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+    chosen.clear();
+    for (std::size_t i = 0; i < n; ++i) chosen.push_back(cand[i].second);
+    ob.begin(clip);
+    ob.rasterize(chosen, pool);
+    for (std::size_t i = 0; i < S.chunks.size(); ++i) {
+      if (!vis[i]) continue;
+      const Box3 b{{S.chunks.lo(0)[i], S.chunks.lo(1)[i], S.chunks.lo(2)[i]}, {S.chunks.hi(0)[i], S.chunks.hi(1)[i], S.chunks.hi(2)[i]}};
+      T.occluded += ob.occluded(b);
+    }
+    T.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  }
+  return T;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int blocks = 12;
+  const Scene S = make_city(blocks);
+  const std::vector<Frame> path = argc > 1 ? load_path(argv[1]) : street_path(blocks);
+  if (path.empty()) { std::fprintf(stderr, "no frames in %s\n", argv[1]); return 1; }
+  std::printf("city: %zu voxels, %zu chunks, %zu occluder boxes; %zu frames\n",
+              S.voxels, S.chunks.size(), S.occluders.size(), path.size());
+
+  ThreadPool pool;
+  for (ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}) {
+    const Totals T = replay(S, path, p);
+    const double frames = double(path.size());
+    std::printf("  %-10s %6.3f ms/frame   %6.1f chunks in frustum, %5.1f%% of them occluded\n",
+                p ? "pool" : "serial", T.ms / frames, double(T.inFrustum) / frames,
+                T.inFrustum ? 100.0 * double(T.occluded) / double(T.inFrustum) : 0.0);
+  }
+  if (pool.size()) std::printf("  (pool: %u workers + caller)\n", pool.size());
+  return 0;
+}
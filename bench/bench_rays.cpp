@@ -0,0 +1,90 @@
+// bench/bench_rays.cpp
+// Ray casting throughput on a generated terrain: full-screen ray sets from a few
+// cameras, cast as separate picks (cast_ray), as one batch walked ray by ray
+// (cast_rays_scalar), in SIMD packets on the calling thread, and in packets on a
+// worker pool. Reports rays per second.
+// Optional argument: the terrain edge in voxels (default 512).
+#include "ray_query.hpp"
+#include "world_snapshot.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace vxl;
+
+namespace {
+
+/// Rolling hills three voxels thick, with a tower every 64 voxels.
+Universe make_terrain(int edge) {
+  Universe U;
+  std::vector<IVec3> cells;
+  Cube c;
+  for (int z = 0; z < edge; ++z) {
+    cells.clear();
+    for (int x = 0; x < edge; ++x) {
+      const int h = int(12.0f + 10.0f * std::sin(float(x) * 0.031f) * std::cos(float(z) * 0.027f) +
+                        5.0f * std::sin(float(x + z) * 0.11f));
+      const bool tower = x % 64 < 6 && z % 64 < 6;
+      for (int y = h - 2; y <= (tower ? h + 40 : h); ++y) cells.push_back({x, y, z});
+    }
+    U.place_many(cells, std::span<const Cube>(&c, 1));
+  }
+  return U;
+}
+
+struct Timing { double ms = 0; std::size_t hits = 0; };
+
+template <class Fn>
+Timing run(const std::vector<Ray>& rays, Fn&& cast) {
+  std::vector<std::optional<RayHit>> hits(rays.size());
+  const auto t0 = std::chrono::steady_clock::now();
+  cast(hits);
+  Timing T;
+  T.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  for (const auto& h : hits) T.hits += h.has_value();
+  return T;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int edge = argc > 1 ? std::max(64, std::atoi(argv[1])) : 512;
+  Universe U = make_terrain(edge);
+  SnapshotBuilder B;
+  const auto W = B.build(U, Selection());
+  std::printf("terrain: %d x %d, %zu voxels, %zu chunks; packets of %d (%s)\n",
+              edge, edge, U.size(), U.chunk_count(), ray_packet_width(), ray_packet_isa());
+
+  const int width = 1280, height = 720;
+  const glm::mat4 P = glm::perspective(glm::radians(50.0f), float(width) / float(height), 0.05f, 2000.0f);
+  const float e = float(edge);
+  const struct { const char* name; glm::vec3 eye, target; } views[] = {
+    {"ground", {8.0f, 30.0f, 8.0f}, {e, 10.0f, e}},
+    {"oblique", {-0.2f * e, 0.5f * e, -0.2f * e}, {0.5f * e, 0.0f, 0.5f * e}},
+    {"top-down", {0.5f * e, 0.8f * e, 0.5f * e + 1.0f}, {0.5f * e, 0.0f, 0.5f * e}},
+  };
+
+  ThreadPool pool;
+  for (const auto& v : views) {
+    const std::vector<Ray> rays = screen_rays(P * glm::lookAt(v.eye, v.target, glm::vec3(0, 1, 0)), width, height,
+                                              {0, 0, width - 1, height - 1});
+    // Separate picks rebuild their lookups every time: a sample of rays is enough
+    const std::vector<Ray> some(rays.begin(), rays.begin() + std::ptrdiff_t(rays.size() / 16));
+    const Timing single = run(some, [&](auto& hits) {
+      for (std::size_t i = 0; i < some.size(); ++i) hits[i] = cast_ray(*W, some[i]);
+    });
+    const Timing scalar = run(rays, [&](auto& hits) { cast_rays_scalar(*W, rays, hits); });
+    const Timing packed = run(rays, [&](auto& hits) { cast_rays(*W, rays, hits); });
+    const Timing pooled = run(rays, [&](auto& hits) { cast_rays(*W, rays, hits, &pool); });
+    auto mrays = [&](const Timing& T, std::size_t n) { return double(n) / (T.ms * 1000.0); };
+    std::printf("  %-9s %zu rays, %4.1f%% hit   single %6.2f   scalar %6.2f   packets %6.2f   pool %6.2f Mrays/s%s\n",
+                v.name, rays.size(), 100.0 * double(scalar.hits) / double(rays.size()), mrays(single, some.size()),
+                mrays(scalar, rays.size()), mrays(packed, rays.size()), mrays(pooled, rays.size()),
+                scalar.hits == packed.hits && scalar.hits == pooled.hits ? "" : "   (hit counts differ!)");
+  }
+  if (pool.size()) std::printf("  (pool: %u workers + caller)\n", pool.size());
+  return 0;
+}
@@ -0,0 +1,92 @@
+// bench/bench_storage.cpp
+// Chunked Universe storage vs. the previous one-node-per-voxel unordered_map:
+// memory per voxel and place/get/iterate throughput for dense and scattered scenes,
+// plus the Morton-ordered batch API on the same coordinates.
+#include "universe.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace vxl;
+
+namespace {
+
+std::size_t g_mapBytes = 0;
+
+/// Allocator that tallies live bytes so the baseline map's real footprint can be reported.
+template <class T> struct CountingAlloc {
+  using value_type = T;
+  CountingAlloc() = default;
+  template <class U> CountingAlloc(const CountingAlloc<U>&) {}
+  T* allocate(std::size_t n) { g_mapBytes += n * sizeof(T); return std::allocator<T>{}.allocate(n); }
+  void deallocate(T* p, std::size_t n) { g_mapBytes -= n * sizeof(T); std::allocator<T>{}.deallocate(p, n); }
+  template <class U> bool operator==(const CountingAlloc<U>&) const { return true; }
+};
+
+using BaselineMap = std::unordered_map<IVec3, Cube, IVec3Hasher, std::equal_to<IVec3>,
+                                       CountingAlloc<std::pair<const IVec3, Cube>>>;
+
+struct Timer {
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  double ms() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(); }
+};
+
+void report(const char* what, std::size_t n, double placeMs, double getMs, double iterMs, std::size_t bytes) {
+  std::printf("  %-10s place %8.1f ns/op   get %6.1f ns/op   iterate %6.2f ns/voxel   %7.1f bytes/voxel\n",
+              what, placeMs * 1e6 / n, getMs * 1e6 / n, iterMs * 1e6 / n, double(bytes) / n);
+}
+
+void run(const char* scene, const std::vector<IVec3>& pts) {
+  std::printf("%s (%zu voxels)\n", scene, pts.size());
+  std::vector<IVec3> probes = pts;
+  std::shuffle(probes.begin(), probes.end(), std::mt19937(7));
+  volatile std::size_t sink = 0;
+
+  {
+    g_mapBytes = 0;
+    BaselineMap m;
+    Timer tp; for (auto& p : pts) m[p] = Cube{}; double placeMs = tp.ms();
+    Timer tg; for (auto& p : probes) sink = sink + (m.find(p) != m.end()); double getMs = tg.ms();
+    Timer ti; for (auto& [p, c] : m) sink = sink + (c.embedded == nullptr); double iterMs = ti.ms();
+    report("map", pts.size(), placeMs, getMs, iterMs, g_mapBytes + sizeof(m));
+  }
+  {
+    Universe U;
+    Timer tp; for (auto& p : pts) U.place(p.x, p.y, p.z); double placeMs = tp.ms();
+    Timer tg; for (auto& p : probes) sink = sink + U.get(p.x, p.y, p.z).has_value(); double getMs = tg.ms();
+    Timer ti; U.for_each([&](const IVec3&, const Cube& c){ sink = sink + (c.embedded == nullptr); }); double iterMs = ti.ms();
+    report("chunked", pts.size(), placeMs, getMs, iterMs, U.store().memory_bytes());
+  }
+  {
+    Universe U;
+    Cube c;
+    Timer tp; U.place_many(pts, std::span<const Cube>(&c, 1)); double placeMs = tp.ms();
+    Timer tu; U.update_many(probes, [](const IVec3&, Cube& cube){ cube.mat = 1; }); double updMs = tu.ms();
+    Timer te; U.erase_many(probes); double eraseMs = te.ms();
+    std::printf("  %-10s place_many %6.1f ms   update_many %6.1f ms   erase_many %6.1f ms\n",
+                "batch", placeMs, updMs, eraseMs);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  int edge = (argc > 1) ? std::atoi(argv[1]) : 128;
+
+  std::vector<IVec3> block;
+  block.reserve(std::size_t(edge) * edge * edge);
+  for (int z = 0; z < edge; ++z) for (int y = 0; y < edge; ++y) for (int x = 0; x < edge; ++x)
+    block.push_back({x, y, z});
+  run("dense block", block);
+
+  std::vector<IVec3> scatter(block.size());
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> d(-8 * edge, 8 * edge);
+  for (auto& p : scatter) p = {d(rng), d(rng), d(rng)};
+  run("random scatter", scatter);
+  return 0;
+}
@@ -2,18 +2,17 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 
-// Instance attributes
-layout(location = 2) in vec4 iM0;
-layout(location = 3) in vec4 iM1;
-layout(location = 4) in vec4 iM2;
-layout(location = 5) in vec4 iM3;
-layout(location = 6) in vec4 iColorA;
-layout(location = 7) in vec4 iColorB;
-layout(location = 8) in int iKind;
-layout(location = 9) in vec3 iGradDir;
+// Instance attributes (16 bytes): store-local position, material | orientation << 16
+layout(location = 2) in ivec3 iPos;
+layout(location = 3) in uint iPacked;
 
+uniform mat4 uModel;   // store pose: identity, or a group's offset and orientation
 uniform mat4 uView;
 uniform mat4 uProj;
+uniform samplerBuffer uMaterials;   // per palette slot: colorA, colorB, (gradDir, kind)
+uniform samplerBuffer uRotations;   // per orientation index: the 3 matrix columns
+
+const uint HOLE = 0xFFFFu;          // unused instance slot
 
 out VS_OUT {
     vec3 normal;
@@ -25,13 +24,31 @@ out VS_OUT {
 } vs_out;
 
 void main() {
-    mat4 M = mat4(iM0, iM1, iM2, iM3);
+    uint mat = iPacked & 0xFFFFu;
+    uint rot = iPacked >> 16;
+    if (rot == HOLE) {
+        gl_Position = vec4(0.0);   // degenerate: nothing is rasterized
+        vs_out.normal = vec3(0.0, 1.0, 0.0);
+        vs_out.worldPos = vec3(0.0);
+        vs_out.colorA = vs_out.colorB = vec4(0.0);
+        vs_out.kind = 0;
+        vs_out.gradDir = vec3(0.0, 1.0, 0.0);
+        return;
+    }
+    int r = int(rot) * 3;
+    mat3 R = mat3(texelFetch(uRotations, r).xyz,
+                  texelFetch(uRotations, r + 1).xyz,
+                  texelFetch(uRotations, r + 2).xyz);
+    mat4 M = uModel * mat4(vec4(R[0], 0.0), vec4(R[1], 0.0), vec4(R[2], 0.0), vec4(vec3(iPos), 1.0));
     vec4 wp = M * vec4(aPos, 1.0);
     gl_Position = uProj * uView * wp;
     vs_out.worldPos = wp.xyz;
     vs_out.normal = mat3(M) * aNormal;
-    vs_out.colorA = iColorA;
-    vs_out.colorB = iColorB;
-    vs_out.kind = iKind;
-    vs_out.gradDir = normalize(iGradDir);
+
+    int m = int(mat) * 3;
+    vec4 extra = texelFetch(uMaterials, m + 2);
+    vs_out.colorA = texelFetch(uMaterials, m);
+    vs_out.colorB = texelFetch(uMaterials, m + 1);
+    vs_out.kind = int(extra.w);
+    vs_out.gradDir = normalize(extra.xyz);
 }
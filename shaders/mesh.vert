@@ -0,0 +1,47 @@
+#version 330 core
+// Greedy-meshed chunk faces (see mesher.hpp): one vertex per quad corner
+layout(location = 0) in uvec4 aCornerFace;   // chunk-local corner xyz (0..32, in cells), face 0..5
+layout(location = 1) in uint aMat;           // palette id, or RGB565 colour when uCell > 1
+
+uniform mat4 uModel;   // store pose: identity, or a group's offset and orientation
+uniform mat4 uView;
+uniform mat4 uProj;
+uniform vec3 uOrigin;  // store-local position of the chunk's voxel 0
+uniform float uCell;   // voxels per cell edge: 1, or 2^level for a coarse level (see lod.hpp)
+uniform samplerBuffer uMaterials;   // per palette slot: colorA, colorB, (gradDir, kind)
+
+const vec3 NORMALS[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0),
+                                vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+
+out VS_OUT {
+    vec3 normal;
+    vec3 worldPos;
+    vec4 colorA;
+    vec4 colorB;
+    flat int kind;
+    vec3 gradDir;
+} vs_out;
+
+void main() {
+    // Voxel k spans [k - 0.5, k + 0.5], so corner k sits half a unit below it
+    vec3 local = uOrigin + vec3(aCornerFace.xyz) * uCell - 0.5;
+    vec4 wp = uModel * vec4(local, 1.0);
+    gl_Position = uProj * uView * wp;
+    vs_out.worldPos = wp.xyz;
+    vs_out.normal = mat3(uModel) * NORMALS[aCornerFace.w];
+
+    if (uCell > 1.0) {
+        // Mean colour of the cell's cubes
+        vec3 c = vec3(float(aMat >> 11u), float((aMat >> 5u) & 63u), float(aMat & 31u)) / vec3(31.0, 63.0, 31.0);
+        vs_out.colorA = vs_out.colorB = vec4(c, 1.0);
+        vs_out.kind = 0;
+        vs_out.gradDir = vec3(0.0, 1.0, 0.0);
+        return;
+    }
+    int m = int(aMat) * 3;
+    vec4 extra = texelFetch(uMaterials, m + 2);
+    vs_out.colorA = texelFetch(uMaterials, m);
+    vs_out.colorB = texelFetch(uMaterials, m + 1);
+    vs_out.kind = int(extra.w);
+    vs_out.gradDir = normalize(extra.xyz);
+}
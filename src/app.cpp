@@ -1,4 +1,7 @@
 #include "app.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <stdexcept>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
@@ -16,19 +19,34 @@
 
 namespace vxl {
 
-App::App() {
+namespace {
+
+/// Session files: $VOXEL_LAB_SESSION (default ./voxel_lab_session) + .vxs / .wal
+std::string session_base() {
+  const char* env = std::getenv("VOXEL_LAB_SESSION");
+  return (env && *env) ? env : "voxel_lab_session";
+}
+
+/// Program binary cache: $VOXEL_LAB_SHADER_CACHE (default ./voxel_lab_shader_cache)
+std::string shader_cache_dir() {
+  const char* env = std::getenv("VOXEL_LAB_SHADER_CACHE");
+  return (env && *env) ? env : "voxel_lab_shader_cache";
+}
+
+double ms_between(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+  return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+} // namespace
+
+App::App() : Sim_(Pool_, session_base()), Rend_(Pool_) {
+  sync_world();
   init_sdl();
-  Rend_.init_gl();
+  Rend_.init_gl(shader_cache_dir());
   init_imgui();
 
   // Load menus
   Menus_.load_from_file(std::string(DEFAULT_RES_DIR) + "/menus.txt");
-
-  // Built-ins
-  register_builtin_commands(Cmds_);
-
-  // Seed: a few cubes
-  for (int z=0; z<3; ++z) U_.place(z,0,0);
 }
 
 App::~App() { shutdown(); }
@@ -56,7 +74,8 @@ void App::init_sdl() {
 
   int w,h; SDL_GetWindowSize(window_, &w, &h);
   Cam_.set_viewport(w,h);
-  Cam_.set_distance_for_pixel_edge(U_.base_edge_pixels());
+  Cam_.set_distance_for_pixel_edge(W_->baseEdgePixels);
+  edgePixels_ = W_->baseEdgePixels;
   Rend_.resize(w,h);
 }
 
@@ -79,10 +98,43 @@ void App::shutdown() {
 }
 
 void App::print(const std::string& s) { console_.push_back(s); if (console_.size()>512) console_.pop_front(); }
-void App::request_redraw() { /* no-op; draw every frame */ }
 
-void App::recompute_camera_edgepix() {
-  Cam_.set_distance_for_pixel_edge(U_.base_edge_pixels());
+void App::run_command(const std::string& line) {
+  // The frame on screen as the line is entered, for commands that pick through it
+  ScreenView view;
+  view.world = W_;
+  view.viewProj = Cam_.proj() * Cam_.view();
+  SDL_GetWindowSize(window_, &view.width, &view.height);
+  Sim_.post([line, view = std::move(view)](Simulation::Context& c) {
+    // Redraws happen every frame, and the camera follows the snapshot's edge pixels
+    CommandContext ctx{c.U, c.Sel, c.print, []{}, []{}, &c.history, c.log, &view, &c.pool};
+    c.commands.run_line(line, ctx);
+  });
+}
+
+void App::sync_world() {
+  Sim_.drain_messages([this](std::string&& s) { print(s); });
+  for (const std::string& s : Rend_.take_shader_messages()) print(s);
+  if (!Sim_.update() && W_) return;
+  W_ = Sim_.snapshot();
+  for (const EditStamp& e : W_->edits) {
+    if (e.version <= stamped_) continue;   // seen in an earlier snapshot
+    unsettled_.push_back(e);
+    stamped_ = e.version;
+  }
+  if (edgePixels_ && W_->baseEdgePixels != edgePixels_) {
+    Cam_.set_distance_for_pixel_edge(W_->baseEdgePixels);
+    edgePixels_ = W_->baseEdgePixels;
+  }
+}
+
+void App::track_latency() {
+  const auto now = std::chrono::steady_clock::now();
+  while (!unsettled_.empty() && unsettled_.front().version <= Rend_.settled_version()) {
+    latencyMs_ = ms_between(unsettled_.front().at, now);
+    latencyMaxMs_ = std::max(latencyMaxMs_, latencyMs_);
+    unsettled_.pop_front();
+  }
 }
 
 void App::handle_shortcuts() {
@@ -101,11 +153,11 @@ void App::handle_shortcuts() {
   if (In_.key_e) Cam_.move_local(0,0,+k);
 
   // Rotate selection with bracket keys
-  if (In_.key_bracket_l) Sel_.rotate(U_, 'y', -1.0f);
-  if (In_.key_bracket_r) Sel_.rotate(U_, 'y', +1.0f);
+  if (In_.key_bracket_l) Sim_.post([](Simulation::Context& c) { c.Sel.rotate(c.U, 'y', -1.0f); });
+  if (In_.key_bracket_r) Sim_.post([](Simulation::Context& c) { c.Sel.rotate(c.U, 'y', +1.0f); });
 }
 
-std::optional<IVec3> App::pick_under_cursor() const {
+std::pair<glm::vec3, glm::vec3> App::cursor_ray() const {
   // Compute world ray from mouse
   int w,h; SDL_GetWindowSize(window_, &w, &h);
   float x = (2.0f * In_.mx) / float(w) - 1.0f;
@@ -117,7 +169,27 @@ std::optional<IVec3> App::pick_under_cursor() const {
   glm::vec4 pFar  = invVP * glm::vec4(x,y, 1,1); pFar  /= pFar.w;
   glm::vec3 ro = glm::vec3(pNear);
   glm::vec3 rd = glm::normalize(glm::vec3(pFar - pNear));
-  return Selection::pick_cube(U_, ro, rd);
+  return {ro, rd};
+}
+
+void App::track_edit_gesture() {
+  // One undo entry per edit gesture (drag, R + mouse, [ ]): open before its first edit, close on release
+  bool gesture = (In_.lmb && !ImGui::GetIO().WantCaptureMouse && !W_->selection->empty())
+              || In_.key_r || In_.key_bracket_l || In_.key_bracket_r;
+  if (gesture && !gestureOpen_) {
+    Sim_.post([](Simulation::Context& c) {
+      c.history.begin("gesture");
+      if (c.log) c.log->begin();
+    });
+    gestureOpen_ = true;
+  }
+  if (!gesture && gestureOpen_) {
+    Sim_.post([](Simulation::Context& c) {
+      if (c.log) c.log->commit();
+      c.history.commit();
+    });
+    gestureOpen_ = false;
+  }
 }
 
 void App::handle_interaction() {
@@ -131,17 +203,19 @@ void App::handle_interaction() {
   }
   if (In_.wheel != 0) Cam_.zoom(0.1f * In_.wheel);
 
-  // Select
+  // Select: the ray is the cursor's now, the pick runs against the world as edited so far
   if (In_.lmb && !ImGui::GetIO().WantCaptureMouse && (std::abs(In_.dmx)+std::abs(In_.dmy))==0) {
-    if (auto hit = pick_under_cursor()) {
-      if (In_.ctrl) Sel_.toggle(*hit); else { Sel_.clear(); Sel_.add(*hit); }
-    }
+    Sim_.post([ray = cursor_ray(), toggle = In_.ctrl](Simulation::Context& c) {
+      if (auto hit = Selection::pick_cube(c.U, ray.first, ray.second)) {
+        if (toggle) c.Sel.toggle(*hit); else { c.Sel.clear(); c.Sel.add(*hit); }
+      }
+    });
   }
 
   // Drag move (simple: along camera plane)
   static bool dragging = false;
   static glm::vec3 dragStartEye;
-  if (In_.lmb && !ImGui::GetIO().WantCaptureMouse && !Sel_.items().empty()) {
+  if (In_.lmb && !ImGui::GetIO().WantCaptureMouse && !W_->selection->empty()) {
     dragging = true;
     dragStartEye = Cam_.eye();
     // Move selection by mouse delta projected into camera right/up
@@ -152,7 +226,7 @@ void App::handle_interaction() {
     IVec3 d{ (int)std::round(scale * In_.dmx * right.x),
              (int)std::round(scale * -In_.dmy * up.y),
              0 };
-    if (d.x || d.y || d.z) Sel_.move(U_, d);
+    if (d.x || d.y || d.z) Sim_.post([d](Simulation::Context& c) { c.Sel.move(c.U, d, &c.pool); });
   } else {
     dragging = false;
   }
@@ -160,7 +234,7 @@ void App::handle_interaction() {
   // Rotate with R + mouse X
   if (In_.key_r && !ImGui::GetIO().WantCaptureKeyboard) {
     float deg = 0.2f * In_.dmx;
-    Sel_.rotate(U_, 'y', deg);
+    if (deg != 0.0f) Sim_.post([deg](Simulation::Context& c) { c.Sel.rotate(c.U, 'y', deg); });
   }
 }
 
@@ -179,15 +253,12 @@ void App::ui_console() {
   // Input line
   ImGui::PushItemWidth(-1);
   if (ImGui::InputText("##input", &inputLine_, ImGuiInputTextFlags_EnterReturnsTrue)) {
-    // Execute
-    CommandContext ctx{
-      U_, Sel_,
-      [this](const std::string& s){ this->print(s); },
-      [this](){ this->request_redraw(); },
-      [this](){ this->recompute_camera_edgepix(); }
-    };
-    bool ok = Cmds_.run_line(inputLine_, ctx);
-    if (ok) { history_.push_back(inputLine_); historyPos_ = -1; }
+    // Execute (on the simulation thread; its output comes back through sync_world)
+    if (!inputLine_.empty()) {
+      run_command(inputLine_);
+      history_.push_back(inputLine_);
+      historyPos_ = -1;
+    }
     inputLine_.clear();
   }
   // History with Up/Down
@@ -211,22 +282,40 @@ void App::ui_context_menu() {
   }
   if (ImGui::BeginPopup("ctx")) {
     for (auto& it : Menus_.items()) {
-      if (ImGui::MenuItem(it.label.c_str())) {
-        CommandContext ctx{U_, Sel_,
-          [this](const std::string& s){ this->print(s); },
-          [this](){ this->request_redraw(); },
-          [this](){ this->recompute_camera_edgepix(); }
-        };
-        Cmds_.run_line(it.command, ctx);
-      }
+      if (ImGui::MenuItem(it.label.c_str())) run_command(it.command);
     }
     ImGui::Separator();
     if (ImGui::MenuItem(showGrid_ ? "Grid: ON" : "Grid: OFF")) showGrid_ = !showGrid_;
     if (ImGui::MenuItem(showWireframe_ ? "Wireframe: ON" : "Wireframe: OFF")) showWireframe_ = !showWireframe_;
+    if (ImGui::MenuItem(showStats_ ? "Stats: ON" : "Stats: OFF")) showStats_ = !showStats_;
+    if (ImGui::MenuItem(Rend_.meshing() ? "Meshing: ON" : "Meshing: OFF")) Rend_.set_meshing(!Rend_.meshing());
+    if (ImGui::MenuItem(Rend_.lod() ? "LOD: ON" : "LOD: OFF")) Rend_.set_lod(!Rend_.lod());
+    if (ImGui::MenuItem(Rend_.occlusion() ? "Occlusion: ON" : "Occlusion: OFF")) Rend_.set_occlusion(!Rend_.occlusion());
     ImGui::EndPopup();
   }
 }
 
+void App::ui_stats() {
+  if (!showStats_) return;
+  const RenderStats& st = Rend_.stats();
+  ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 250, 10), ImGuiCond_FirstUseEver);
+  ImGui::Begin("Stats", &showStats_, ImGuiWindowFlags_AlwaysAutoResize);
+  ImGui::Text("%.1f fps", ImGui::GetIO().Framerate);
+  ImGui::Text("cubes: %zu, instanced: %zu", W_->cubes, st.instances);
+  if (Rend_.meshing()) ImGui::Text("mesh quads: %zu, coarse chunks: %zu", st.meshQuads, st.lodChunks);
+  if (st.translucent)
+    ImGui::Text("translucent: %zu (%s, %.2f ms)", st.translucent, st.sortReused ? "order kept" : "sorted", st.sortMs);
+  ImGui::Text("chunks drawn: %zu, culled: %zu", st.chunksDrawn, st.chunksCulled);
+  if (Rend_.occlusion())
+    ImGui::Text("occluded: %zu (%zu occluders, %.2f ms)", st.chunksOccluded, st.occluders, st.occlusionMs);
+  ImGui::Text("draw calls: %zu", st.drawCalls);
+  ImGui::Text("chunks updated: %zu, waiting: %zu, building: %zu", st.chunksUpdated, st.chunksWaiting, st.jobsPending);
+  ImGui::Text("uploaded: %.1f KiB", st.bytesUploaded / 1024.0);
+  ImGui::Text("GPU buffers: %.1f MiB", st.bufferBytes / (1024.0 * 1024.0));
+  ImGui::Text("edit to display: %.1f ms (max %.1f), edits queued: %zu", latencyMs_, latencyMaxMs_, Sim_.pending());
+  ImGui::End();
+}
+
 void App::ui_frame() {
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplSDL2_NewFrame();
@@ -242,6 +331,7 @@ void App::ui_frame() {
 
   ui_console();
   ui_context_menu();
+  ui_stats();
 
   ImGui::Render();
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -258,25 +348,28 @@ int App::run() {
         int w=e.window.data1, h=e.window.data2;
         Cam_.set_viewport(w,h);
         Rend_.resize(w,h);
-        Cam_.set_distance_for_pixel_edge(U_.base_edge_pixels());
+        Cam_.set_distance_for_pixel_edge(W_->baseEdgePixels);
       } else {
         handle_event(In_, e);
       }
     }
 
+    track_edit_gesture();
     handle_shortcuts();
     handle_interaction();
 
-    // Render scene
+    // Render the newest complete snapshot; edits still running show up in a later frame
+    sync_world();
     glm::mat4 V = Cam_.view();
     glm::mat4 P = Cam_.proj();
     Rend_.set_wireframe(showWireframe_);
-    Rend_.render(U_, Sel_, V, P, showGrid_);
+    Rend_.render(*W_, V, P, showGrid_);
 
     // Draw UI on top
     ui_frame();
 
     SDL_GL_SwapWindow(window_);
+    track_latency();
   }
   return 0;
 }
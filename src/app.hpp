@@ -1,11 +1,11 @@
 #pragma once
 #include <string>
 #include <deque>
+#include <memory>
+#include <utility>
 #include <SDL.h>
-#include "universe.hpp"
-#include "selection.hpp"
 #include "renderer.hpp"
-#include "commands.hpp"
+#include "simulation.hpp"
 #include "menu.hpp"
 #include "camera.hpp"
 #include "input.hpp"
@@ -28,17 +28,26 @@ private:
   SDL_GLContext glctx_{};
   bool running_ = true;
 
-  // State
-  Universe U_{64};
-  Selection Sel_;
+  // State: the world lives on the simulation thread; frames draw its newest snapshot.
+  // One worker pool serves both, declared first so it outlives them.
+  ThreadPool Pool_;
+  Simulation Sim_;
+  std::shared_ptr<const WorldSnapshot> W_;
   Camera Cam_;
   Renderer Rend_;
   MenuRegistry Menus_;
-  CommandRegistry Cmds_;
   InputState In_;
   bool showGrid_ = true;
   bool showWireframe_ = false;
   bool showHelp_ = true;
+  bool showStats_ = true;
+  bool gestureOpen_ = false;   ///< a mouse/key edit gesture is being recorded as one undo entry
+  int edgePixels_ = 0;         ///< base edge pixels the camera distance was set for
+
+  // Edit to display latency: snapshots with edits, until the renderer has shown them
+  std::deque<EditStamp> unsettled_;
+  uint64_t stamped_ = 0;       ///< newest snapshot version queued in unsettled_
+  double latencyMs_ = 0.0, latencyMaxMs_ = 0.0;
 
   // Prompt
   std::string inputLine_;
@@ -54,15 +63,21 @@ private:
   void ui_frame();
   void ui_console();
   void ui_context_menu();
+  void ui_stats();
   void handle_interaction();
+  void track_edit_gesture();
   void handle_shortcuts();
 
   void print(const std::string& s);
-  void request_redraw();
-  void recompute_camera_edgepix();
+  /// Run a command line on the simulation thread.
+  void run_command(const std::string& line);
+  /// Take the newest snapshot and the messages printed by edits.
+  void sync_world();
+  /// Measure the latency of edits the last frame showed for the first time.
+  void track_latency();
 
-  // Picking helper
-  std::optional<IVec3> pick_under_cursor() const;
+  /// World ray (origin, direction) under the mouse.
+  std::pair<glm::vec3, glm::vec3> cursor_ray() const;
 };
 
 } // namespace vxl
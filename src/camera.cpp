@@ -60,15 +60,15 @@ void Camera::move_local(float forwardAmt, float rightAmt, float upAmt) {
   target_ += fwd * forwardAmt + right * rightAmt + up * upAmt;
 }
 
-void Camera::set_distance_for_pixel_edge(int pixels) {
-  // For a unit cube (size=1), projected edge length in pixels for height H and FOV_y is:
+float projected_pixels(float size, float distance, float fovY, int heightPx) {
   // s_pixels = (H/2) * size / (tan(FOV_y/2) * distance)
-  // Solve for distance.
-  float H = float(height_);
-  float size = 1.0f; // world units (edge)
-  float s = std::max(1, pixels);
-  float d = (H * size) / (2.0f * std::tan(fov_y * 0.5f) * s);
-  set_distance(d);
+  return (float(heightPx) * size) / (2.0f * std::tan(fovY * 0.5f) * std::max(distance, 1e-6f));
+}
+
+void Camera::set_distance_for_pixel_edge(int pixels) {
+  // Projected size falls off as 1/distance: solve projected_pixels(1, d) = pixels for d
+  float s = float(std::max(1, pixels));
+  set_distance(projected_pixels(1.0f, 1.0f, fov_y, height_) / s);
 }
 
 } // namespace vxl
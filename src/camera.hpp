@@ -8,6 +8,10 @@
 
 namespace vxl {
 
+/// On-screen length in pixels of a world length `size` facing the camera at
+/// `distance`, with vertical field of view fovY spread over `heightPx` pixels.
+float projected_pixels(float size, float distance, float fovY, int heightPx);
+
 class Camera {
 public:
   Camera();
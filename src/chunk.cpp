@@ -0,0 +1,379 @@
+#include "chunk.hpp"
+#include "page_cache.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace vxl {
+
+// ----- Chunk -----
+
+const Cube* Chunk::find(int i) const {
+  if (dense()) return occupied(i) ? &dense_[i] : nullptr;
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), uint16_t(i));
+  if (it == keys_.end() || *it != i) return nullptr;
+  return &vals_[it - keys_.begin()];
+}
+
+Cube* Chunk::find(int i) {
+  return const_cast<Cube*>(static_cast<const Chunk*>(this)->find(i));
+}
+
+bool Chunk::set(int i, const Cube& c) {
+  if (dense()) {
+    bool fresh = !occupied(i);
+    dense_[i] = c;
+    if (fresh) { occ_[i >> 6] |= uint64_t(1) << (i & 63); ++count_; }
+    return fresh;
+  }
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), uint16_t(i));
+  auto k = it - keys_.begin();
+  if (it != keys_.end() && *it == i) { vals_[k] = c; return false; }
+  keys_.insert(it, uint16_t(i));
+  vals_.insert(vals_.begin() + k, c);
+  if (++count_ > DENSE_AT) to_dense();
+  return true;
+}
+
+bool Chunk::erase(int i) {
+  if (dense()) {
+    if (!occupied(i)) return false;
+    occ_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    dense_[i] = Cube{};
+    if (--count_ < SPARSE_AT) to_sparse();
+    return true;
+  }
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), uint16_t(i));
+  if (it == keys_.end() || *it != i) return false;
+  vals_.erase(vals_.begin() + (it - keys_.begin()));
+  keys_.erase(it);
+  --count_;
+  return true;
+}
+
+int Chunk::set_sorted(std::span<const uint16_t> idx, std::span<const Cube> cubes) {
+  const bool broadcast = cubes.size() == 1;
+  auto cube = [&](std::size_t k) -> const Cube& { return cubes[broadcast ? 0 : k]; };
+  if (!dense() && count_ + int(idx.size()) > DENSE_AT) to_dense();
+  int fresh = 0;
+  if (dense()) {
+    for (std::size_t k = 0; k < idx.size(); ++k) fresh += set(idx[k], cube(k)) ? 1 : 0;
+    return fresh;
+  }
+  // Merge the run into the sorted arrays in one pass
+  std::vector<uint16_t> keys;
+  std::vector<Cube> vals;
+  keys.reserve(keys_.size() + idx.size());
+  vals.reserve(keys_.size() + idx.size());
+  std::size_t a = 0, k = 0;
+  while (a < keys_.size() || k < idx.size()) {
+    if (k == idx.size() || (a < keys_.size() && keys_[a] < idx[k])) {
+      keys.push_back(keys_[a]); vals.push_back(vals_[a]); ++a;
+      continue;
+    }
+    uint16_t i = idx[k];
+    while (k + 1 < idx.size() && idx[k + 1] == i) ++k;   // last duplicate wins
+    if (a < keys_.size() && keys_[a] == i) ++a; else ++fresh;
+    keys.push_back(i); vals.push_back(cube(k)); ++k;
+  }
+  keys_.swap(keys);
+  vals_.swap(vals);
+  count_ += fresh;
+  return fresh;
+}
+
+int Chunk::erase_sorted(std::span<const uint16_t> idx) {
+  if (dense()) {
+    int n = 0;
+    for (uint16_t i : idx) {
+      if (!occupied(i)) continue;
+      occ_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+      dense_[i] = Cube{};
+      ++n;
+    }
+    count_ -= n;
+    if (count_ < SPARSE_AT) to_sparse();
+    return n;
+  }
+  // Compact the sorted arrays in one pass
+  std::size_t out = 0, k = 0;
+  for (std::size_t a = 0; a < keys_.size(); ++a) {
+    while (k < idx.size() && idx[k] < keys_[a]) ++k;
+    if (k < idx.size() && idx[k] == keys_[a]) continue;
+    keys_[out] = keys_[a]; vals_[out] = vals_[a]; ++out;
+  }
+  int n = int(keys_.size() - out);
+  keys_.resize(out); vals_.resize(out);
+  count_ -= n;
+  return n;
+}
+
+void Chunk::to_dense() {
+  occ_.assign(WORDS, 0);
+  dense_.assign(CHUNK_VOLUME, Cube{});
+  for (std::size_t k = 0; k < keys_.size(); ++k) {
+    int i = keys_[k];
+    occ_[i >> 6] |= uint64_t(1) << (i & 63);
+    dense_[i] = vals_[k];
+  }
+  std::vector<uint16_t>().swap(keys_);
+  std::vector<Cube>().swap(vals_);
+}
+
+void Chunk::to_sparse() {
+  keys_.reserve(count_);
+  vals_.reserve(count_);
+  for_each([&](int i, const Cube& c){ keys_.push_back(uint16_t(i)); vals_.push_back(c); });
+  std::vector<uint64_t>().swap(occ_);
+  std::vector<Cube>().swap(dense_);
+}
+
+std::size_t Chunk::memory_bytes() const {
+  return sizeof(Chunk)
+       + occ_.capacity() * sizeof(uint64_t) + dense_.capacity() * sizeof(Cube)
+       + keys_.capacity() * sizeof(uint16_t) + vals_.capacity() * sizeof(Cube);
+}
+
+// ----- ChunkStore -----
+
+uint64_t ChunkStore::next_serial() {
+  static std::atomic<uint64_t> next{1};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+Chunk* ChunkStore::resident(Slot& s) const {
+  if (!s.chunk) {
+    auto ch = std::make_shared<Chunk>();
+    if (s.id != NO_ID) {
+      if (s.paged) pager_->file().load(s.id, *ch);
+      else source_->load(s.id, *ch);
+      --lazy_;
+      if (pager_) ++pager_->stats().misses;
+    }
+    s.chunk = std::move(ch);
+    // Paged stores keep the stored copy, so a clean chunk can be evicted for free
+    if (!pager_) drop_backing(s);
+  } else if (pager_) {
+    ++pager_->stats().hits;
+  }
+  if (pager_) s.used = pager_->tick();
+  return s.chunk.get();
+}
+
+Chunk* ChunkStore::writable(Slot& s) const {
+  resident(s);
+  if (s.chunk.use_count() > 1) {
+    s.chunk = std::make_shared<Chunk>(*s.chunk);
+  } else {
+    // The last other owner may have let go on another thread: see its reads first
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return s.chunk.get();
+}
+
+void ChunkStore::drop_backing(Slot& s) const {
+  if (s.id == NO_ID) return;
+  if (s.paged) pager_->file().release(s.id);
+  else if (--sourced_ == 0) source_.reset();   // e.g. unmaps a snapshot once fully loaded
+  s.id = NO_ID;
+  s.paged = false;
+}
+
+void ChunkStore::add_lazy(const IVec3& cc, uint32_t id, int count) {
+  Slot& s = chunks_[cc];
+  if (s.chunk) count_ -= s.chunk->size();
+  else if (s.id != NO_ID) { count_ -= s.count; --lazy_; }
+  std::shared_ptr<IChunkSource> keep = source_;   // dropping the old copy must not release the source
+  drop_backing(s);
+  source_ = std::move(keep);
+  s.chunk.reset();
+  s.id = id;
+  s.paged = false;
+  s.count = count;
+  count_ += count;
+  ++lazy_;
+  ++sourced_;
+  dirty_.insert(cc);
+}
+
+void ChunkStore::release_source(const IVec3& cc) const {
+  Slot* s = chunks_.find(cc);
+  if (!s) return;
+  resident(*s);
+  if (!s->paged) drop_backing(*s);
+}
+
+bool ChunkStore::place(const IVec3& p, const Cube& c) {
+  Slot& s = chunks_[chunk_of(p)];
+  bool fresh = writable(s)->set(local_index(p), c);
+  drop_backing(s);
+  dirty_.insert(chunk_of(p));
+  if (fresh) ++count_;
+  return fresh;
+}
+
+bool ChunkStore::erase(const IVec3& p) {
+  IVec3 cc = chunk_of(p);
+  Slot* s = chunks_.find(cc);
+  if (!s) return false;
+  if (!static_cast<const Chunk*>(resident(*s))->find(local_index(p))) return false;
+  Chunk* ch = writable(*s);
+  ch->erase(local_index(p));
+  drop_backing(*s);
+  dirty_.insert(cc);
+  if (ch->empty()) chunks_.erase(cc);
+  --count_;
+  return true;
+}
+
+const Cube* ChunkStore::find(const IVec3& p) const {
+  Slot* s = chunks_.find(chunk_of(p));
+  return s ? static_cast<const Chunk*>(resident(*s))->find(local_index(p)) : nullptr;
+}
+
+Cube* ChunkStore::find(const IVec3& p) {
+  Slot* s = chunks_.find(chunk_of(p));
+  if (!s) return nullptr;
+  if (!static_cast<const Chunk*>(resident(*s))->find(local_index(p))) return nullptr;
+  // The caller may write through it
+  Cube* c = writable(*s)->find(local_index(p));
+  drop_backing(*s);
+  dirty_.insert(chunk_of(p));
+  return c;
+}
+
+std::vector<KeyIndex> ChunkStore::locality_order(std::span<const IVec3> coords) {
+  std::vector<KeyIndex> order;
+  order.reserve(coords.size());
+  for (std::size_t i = 0; i < coords.size(); ++i)
+    if (in_morton_range(coords[i])) order.push_back({locality_key(coords[i]), uint32_t(i)});
+  radix_sort(order);
+  return order;
+}
+
+std::size_t ChunkStore::place_many(std::span<const IVec3> coords, std::span<const Cube> cubes,
+                                   const ChangeFn& observe) {
+  if (cubes.empty()) return 0;
+  constexpr int RUN_SHIFT = 3 * CHUNK_SHIFT;
+  const bool broadcast = cubes.size() == 1;
+  auto order = locality_order(coords);
+  std::vector<uint16_t> idx;
+  std::vector<Cube> run;
+  std::size_t fresh = 0;
+  for (std::size_t i = 0; i < order.size(); ) {
+    const uint64_t key = order[i].key >> RUN_SHIFT;
+    idx.clear(); run.clear();
+    for (; i < order.size() && (order[i].key >> RUN_SHIFT) == key; ++i) {
+      idx.push_back(uint16_t(order[i].key & (CHUNK_VOLUME - 1)));
+      if (!broadcast) run.push_back(cubes[order[i].index]);
+    }
+    const IVec3 cc = chunk_of(coords[order[i - 1].index]);
+    Slot& s = chunks_[cc];
+    Chunk* ch = writable(s);
+    drop_backing(s);
+    dirty_.insert(cc);
+    if (observe) {
+      const std::size_t first = i - idx.size();
+      for (std::size_t k = 0; k < idx.size(); ++k) {
+        if (k + 1 < idx.size() && idx[k + 1] == idx[k]) continue;   // last duplicate wins
+        const uint32_t in = order[first + k].index;
+        observe(coords[in], ch->find(idx[k]), &cubes[broadcast ? 0 : in]);
+      }
+    }
+    fresh += ch->set_sorted(idx, broadcast ? cubes : std::span<const Cube>(run));
+  }
+  count_ += fresh;
+  return fresh;
+}
+
+std::size_t ChunkStore::erase_many(std::span<const IVec3> coords, std::vector<uint8_t>* hit,
+                                   const ChangeFn& observe) {
+  constexpr int RUN_SHIFT = 3 * CHUNK_SHIFT;
+  auto order = locality_order(coords);
+  std::vector<uint16_t> idx;
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < order.size(); ) {
+    const uint64_t key = order[i].key >> RUN_SHIFT;
+    idx.clear();
+    for (; i < order.size() && (order[i].key >> RUN_SHIFT) == key; ++i)
+      idx.push_back(uint16_t(order[i].key & (CHUNK_VOLUME - 1)));
+    IVec3 cc = chunk_of(coords[order[i - 1].index]);
+    Slot* s = chunks_.find(cc);
+    if (!s) continue;
+    const Chunk* peek = resident(*s);
+    if (std::none_of(idx.begin(), idx.end(), [&](uint16_t k) { return peek->find(k) != nullptr; })) continue;
+    Chunk* ch = writable(*s);
+    if (hit || observe) {
+      for (std::size_t k = i - idx.size(); k < i; ++k) {
+        const Cube* c = ch->find(int(order[k].key & (CHUNK_VOLUME - 1)));
+        if (!c) continue;
+        if (hit) (*hit)[order[k].index] = 1;
+        if (observe && (k + 1 == i || order[k + 1].key != order[k].key)) observe(coords[order[k].index], c, nullptr);
+      }
+    }
+    int removed = ch->erase_sorted(idx);
+    if (removed == 0) continue;
+    n += removed;
+    drop_backing(*s);
+    dirty_.insert(cc);
+    if (ch->empty()) chunks_.erase(cc);
+  }
+  count_ -= n;
+  return n;
+}
+
+void ChunkStore::clear() {
+  chunks_.for_each([&](const IVec3& cc, Slot& s){
+    if (pager_ && s.paged) pager_->file().release(s.id);
+    dirty_.insert(cc);
+  });
+  chunks_.clear();
+  source_.reset();
+  lazy_ = 0;
+  sourced_ = 0;
+  count_ = 0;
+}
+
+void ChunkStore::set_pager(ChunkPager* pager) {
+  if (pager == pager_) return;
+  // Records in the old page file and copies only a pager would use are dropped
+  chunks_.for_each([&](const IVec3&, Slot& s){
+    if (s.paged) resident(s);
+    if (s.chunk) drop_backing(s);
+  });
+  pager_ = pager;
+}
+
+bool ChunkStore::evict(const IVec3& cc) const {
+  Slot* s = chunks_.find(cc);
+  if (!s || !s->chunk || !pager_) return false;
+  if (s->id == NO_ID) {
+    s->id = pager_->file().write(*s->chunk);
+    s->paged = true;
+    ++pager_->stats().writebacks;
+  }
+  s->count = s->chunk->size();
+  s->chunk.reset();
+  ++lazy_;
+  ++pager_->stats().evictions;
+  return true;
+}
+
+const Chunk* ChunkStore::chunk(const IVec3& cc) const {
+  Slot* s = chunks_.find(cc);
+  return s ? resident(*s) : nullptr;
+}
+
+std::shared_ptr<const Chunk> ChunkStore::share(const IVec3& cc) const {
+  Slot* s = chunks_.find(cc);
+  if (!s) return nullptr;
+  resident(*s);
+  return s->chunk;
+}
+
+std::size_t ChunkStore::memory_bytes() const {
+  std::size_t bytes = sizeof(ChunkStore) + chunks_.memory_bytes();
+  for_each_resident_chunk([&](const IVec3&, const Chunk& ch){ bytes += ch.memory_bytes(); });
+  return bytes;
+}
+
+} // namespace vxl
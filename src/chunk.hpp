@@ -0,0 +1,305 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+#include "cube.hpp"
+#include "util.hpp"
+#include "morton_map.hpp"
+#include "radix_sort.hpp"
+
+/** @file chunk.hpp
+ *  @brief Chunked voxel storage: fixed-size bricks held in a coordinate->chunk map.
+ */
+
+namespace vxl {
+
+constexpr int CHUNK_SHIFT  = 5;
+constexpr int CHUNK_SIZE   = 1 << CHUNK_SHIFT;                 ///< bricks are 32^3
+constexpr int CHUNK_MASK   = CHUNK_SIZE - 1;
+constexpr int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+/// Chunk coordinate containing voxel p (floor division, also for negatives).
+inline IVec3 chunk_of(const IVec3& p) {
+  return {p.x >> CHUNK_SHIFT, p.y >> CHUNK_SHIFT, p.z >> CHUNK_SHIFT};
+}
+/// Index of voxel p inside its chunk, x fastest: x | y<<5 | z<<10.
+inline int local_index(const IVec3& p) {
+  return (p.x & CHUNK_MASK) | ((p.y & CHUNK_MASK) << CHUNK_SHIFT) | ((p.z & CHUNK_MASK) << (2*CHUNK_SHIFT));
+}
+/// World coordinate of local index i in chunk cc.
+inline IVec3 voxel_at(const IVec3& cc, int i) {
+  return {(cc.x << CHUNK_SHIFT) | (i & CHUNK_MASK),
+          (cc.y << CHUNK_SHIFT) | ((i >> CHUNK_SHIFT) & CHUNK_MASK),
+          (cc.z << CHUNK_SHIFT) | (i >> (2*CHUNK_SHIFT))};
+}
+
+/** @brief One 32^3 brick. Sparse (sorted index/cube arrays) while mostly empty,
+ *         dense (occupancy bitmap + flat cube array) once it fills up.
+ */
+class Chunk {
+public:
+  /// Switch to dense storage above this many voxels, back to sparse below the lower mark.
+  static constexpr int DENSE_AT  = CHUNK_VOLUME / 4;
+  static constexpr int SPARSE_AT = CHUNK_VOLUME / 16;
+
+  bool empty() const noexcept { return count_ == 0; }
+  int size() const noexcept { return count_; }
+  bool dense() const noexcept { return !dense_.empty(); }
+
+  const Cube* find(int i) const;
+  Cube* find(int i);
+  /// Insert or replace. Returns true if the slot was previously empty.
+  bool set(int i, const Cube& c);
+  /// Returns true if a cube was removed.
+  bool erase(int i);
+  /// Batch set for ascending local indices (duplicates allowed, last wins);
+  /// cubes.size() is idx.size() or 1. Sparse bricks merge the whole run in one
+  /// pass. Returns the number of previously empty slots filled.
+  int set_sorted(std::span<const uint16_t> idx, std::span<const Cube> cubes);
+  /// Batch erase for ascending local indices. Returns the number removed.
+  int erase_sorted(std::span<const uint16_t> idx);
+
+  /// Visit occupied slots in ascending local index: fn(int localIndex, const Cube&).
+  template <class Fn> void for_each(Fn&& fn) const {
+    if (dense()) {
+      for (int w = 0; w < WORDS; ++w) {
+        for (uint64_t bits = occ_[w]; bits; bits &= bits - 1) {
+          int i = w * 64 + std::countr_zero(bits);
+          fn(i, dense_[i]);
+        }
+      }
+    } else {
+      for (std::size_t k = 0; k < keys_.size(); ++k) fn(int(keys_[k]), vals_[k]);
+    }
+  }
+
+  /// Approximate heap + object footprint in bytes.
+  std::size_t memory_bytes() const;
+
+private:
+  static constexpr int WORDS = CHUNK_VOLUME / 64;
+
+  int count_ = 0;
+  // dense
+  std::vector<uint64_t> occ_;
+  std::vector<Cube> dense_;
+  // sparse, sorted by key
+  std::vector<uint16_t> keys_;
+  std::vector<Cube> vals_;
+
+  bool occupied(int i) const { return (occ_[i >> 6] >> (i & 63)) & 1u; }
+  void to_dense();
+  void to_sparse();
+};
+
+/** @brief Where a ChunkStore gets chunks that are not resident yet (a mapped
+ *         snapshot, a page file). Ids are chosen by whoever registers the chunks.
+ */
+class IChunkSource {
+public:
+  virtual ~IChunkSource() = default;
+  /// Fill the empty chunk `out` with the content stored under `id`.
+  virtual void load(uint32_t id, Chunk& out) = 0;
+  /// Flag the palette / rotation slots chunks in this source may refer to, so GC
+  /// can run without faulting them in.
+  virtual void mark_used(std::vector<bool>& materials, std::vector<bool>& rotations) const = 0;
+};
+
+class ChunkPager;
+
+/** @brief Voxel volume made of lazily allocated chunks. Voxel coordinates must
+ *         satisfy in_morton_range() (callers check; see Universe::place).
+ *
+ *  Chunks may also be registered as non-resident (add_lazy); any access that
+ *  needs their voxels faults them in from the source first, const access too.
+ *  With a pager attached, resident chunks can be evicted again (see ChunkPager).
+ */
+class ChunkStore {
+public:
+  /// Insert or replace. Returns true if the voxel was previously empty.
+  bool place(const IVec3& p, const Cube& c);
+  bool erase(const IVec3& p);
+  const Cube* find(const IVec3& p) const;
+  Cube* find(const IVec3& p);
+  void clear();
+
+  // Batch forms. Coordinates are visited in Morton order, so each chunk is looked
+  // up once per run of coordinates inside it. Out-of-range coordinates are skipped.
+  // When `hit` is given (sized like coords), hit[i] is set to 1 for every coords[i]
+  // that held a cube; entries for the others are left untouched.
+
+  /// observe(p, before, after) for each voxel a batch changes, just before the
+  /// change; before/after are nullptr for an empty voxel. Duplicates report once.
+  using ChangeFn = std::function<void(const IVec3&, const Cube*, const Cube*)>;
+
+  /// cubes.size() is coords.size(), or 1 to place the same cube everywhere.
+  /// Returns the number of previously empty voxels filled.
+  std::size_t place_many(std::span<const IVec3> coords, std::span<const Cube> cubes,
+                         const ChangeFn& observe = {});
+  /// Returns the number of cubes removed.
+  std::size_t erase_many(std::span<const IVec3> coords, std::vector<uint8_t>* hit = nullptr,
+                         const ChangeFn& observe = {});
+  /// fn(const IVec3& p, Cube& c) in place for each occupied coordinate. Returns the count.
+  template <class Fn>
+  std::size_t update_many(std::span<const IVec3> coords, Fn&& fn, std::vector<uint8_t>* hit = nullptr) {
+    return for_runs(coords, [&](Chunk* ch, const IVec3& p, uint32_t) {
+      Cube* c = ch ? ch->find(local_index(p)) : nullptr;
+      if (c) fn(p, *c);
+      return c != nullptr;
+    }, hit, true);
+  }
+  /// fn(const IVec3& p, const Cube& c) for each occupied coordinate. Returns the count.
+  template <class Fn>
+  std::size_t visit_many(std::span<const IVec3> coords, Fn&& fn, std::vector<uint8_t>* hit = nullptr) const {
+    return const_cast<ChunkStore*>(this)->for_runs(coords, [&](Chunk* ch, const IVec3& p, uint32_t) {
+      const Cube* c = ch ? static_cast<const Chunk*>(ch)->find(local_index(p)) : nullptr;
+      if (c) fn(p, *c);
+      return c != nullptr;
+    }, hit, false);
+  }
+
+  /// Sort key for batch walks: the chunk's Morton code above the voxel's local index.
+  static uint64_t locality_key(const IVec3& p) {
+    constexpr int RUN_SHIFT = 3 * CHUNK_SHIFT;
+    return (morton_encode(p) >> RUN_SHIFT << RUN_SHIFT) | uint64_t(local_index(p));
+  }
+  /// (locality key, input index) of every in-range coordinate, sorted by key:
+  /// chunks in Morton order, voxels ascending by local index inside each chunk.
+  static std::vector<KeyIndex> locality_order(std::span<const IVec3> coords);
+
+  std::size_t size() const noexcept { return count_; }
+  std::size_t chunk_count() const noexcept { return chunks_.size(); }
+  /// Chunks currently in memory (chunk_count() minus those still in the source).
+  std::size_t resident_count() const noexcept { return chunks_.size() - lazy_; }
+  const Chunk* chunk(const IVec3& cc) const;
+  /// Chunk cc (faulted in), shared rather than copied: the store copies it
+  /// before its next change instead, so the handle never sees one. Null if
+  /// there is no such chunk.
+  std::shared_ptr<const Chunk> share(const IVec3& cc) const;
+  /// Whether chunk cc exists, without faulting it in.
+  bool has_chunk(const IVec3& cc) const { return chunks_.contains(cc); }
+
+  // Lazy chunks
+  /// Source for chunks registered with add_lazy. Released once all of them are resident.
+  void set_source(std::shared_ptr<IChunkSource> src) { source_ = std::move(src); }
+  const IChunkSource* source() const noexcept { return source_.get(); }
+  /// Register chunk cc, holding `count` voxels, as stored under `id` in the source.
+  /// Replaces any chunk already at cc.
+  void add_lazy(const IVec3& cc, uint32_t id, int count);
+  /// Fault chunk cc in and stop reading it from the source (paged stores keep
+  /// clean chunks backed by it otherwise), so the source can be released.
+  void release_source(const IVec3& cc) const;
+
+  // Paging
+  /// Attach (or detach, with nullptr) the pager that may evict this store's chunks.
+  /// Detaching faults back in every chunk the pager holds.
+  void set_pager(ChunkPager* pager);
+  /// Drop resident chunk cc from memory, writing it to the pager's page file first
+  /// unless an unchanged copy is already in the source or page file. Returns false
+  /// if it was not resident or no pager is attached. Invalidates references into it.
+  bool evict(const IVec3& cc) const;
+  /// fn(const IVec3& chunkCoord, uint64_t lastUse, std::size_t bytes) per resident chunk;
+  /// lastUse is the pager clock at the chunk's latest access.
+  template <class Fn> void for_each_resident_use(Fn&& fn) const {
+    chunks_.for_each([&](const IVec3& cc, const Slot& s){ if (s.chunk) fn(cc, s.used, s.chunk->memory_bytes()); });
+  }
+
+  /// Visit every chunk coordinate, resident or not: fn(const IVec3& chunkCoord).
+  template <class Fn> void for_each_chunk_coord(Fn&& fn) const {
+    chunks_.for_each([&](const IVec3& cc, const Slot&){ fn(cc); });
+  }
+  /// Visit non-empty chunks in unspecified order: fn(const IVec3& chunkCoord, const Chunk&).
+  template <class Fn> void for_each_chunk(Fn&& fn) const {
+    chunks_.for_each([&](const IVec3& cc, Slot& s){ fn(cc, *resident(s)); });
+  }
+  /// Visit every voxel chunk by chunk: fn(const IVec3& p, const Cube&).
+  template <class Fn> void for_each(Fn&& fn) const {
+    chunks_.for_each([&](const IVec3& cc, Slot& s){
+      resident(s)->for_each([&](int i, const Cube& cube){ fn(voxel_at(cc, i), cube); });
+    });
+  }
+  /// Like for_each_chunk, but skips chunks that are not resident instead of loading them.
+  template <class Fn> void for_each_resident_chunk(Fn&& fn) const {
+    chunks_.for_each([&](const IVec3& cc, const Slot& s){ if (s.chunk) fn(cc, *s.chunk); });
+  }
+
+  // Change tracking
+  /// fn(const IVec3& chunkCoord) for every chunk whose voxels changed, or that was
+  /// added or removed, since the last call; then forgets them. Meant for a single
+  /// consumer keeping per-chunk derived data (the renderer's instance buffers).
+  /// Paging does not count as a change.
+  template <class Fn> void take_dirty(Fn&& fn) const {
+    dirty_.for_each(fn);
+    dirty_.clear();
+  }
+  /// Identity for caches keyed by store: unique among the stores of a process.
+  uint64_t serial() const noexcept { return serial_; }
+
+  /// Approximate footprint of resident chunks plus the chunk map.
+  std::size_t memory_bytes() const;
+
+private:
+  static constexpr uint32_t NO_ID = ~uint32_t(0);
+
+  struct Slot {
+    std::shared_ptr<Chunk> chunk;   ///< null while only in the source / page file; copied on write if shared
+    uint32_t id = NO_ID;            ///< copy in the source / page file (paged stores keep it while clean)
+    bool paged = false;             ///< id is a page file record, not a source id
+    int count = 0;                  ///< voxel count of a non-resident chunk
+    uint64_t used = 0;              ///< pager clock at the last access
+  };
+
+  mutable MortonMap<Slot> chunks_;   ///< keyed by chunk coordinate; faulting in mutates slots
+  mutable std::shared_ptr<IChunkSource> source_;
+  mutable std::size_t lazy_ = 0;      ///< non-resident chunks
+  mutable std::size_t sourced_ = 0;   ///< slots whose id refers to source_
+  std::size_t count_ = 0;
+  ChunkPager* pager_ = nullptr;
+  mutable MortonSet dirty_;           ///< chunks changed since the last take_dirty()
+  uint64_t serial_ = next_serial();
+
+  static uint64_t next_serial();
+
+  /// The slot's chunk, faulted in from the source / page file (or created empty) if needed.
+  Chunk* resident(Slot& s) const;
+  /// resident(s), made the slot's own first if share() handed it out: for writing.
+  Chunk* writable(Slot& s) const;
+  /// Forget the slot's stored copy, after (or before) its chunk changes.
+  void drop_backing(Slot& s) const;
+
+  /// Walk coords in locality order: fn(chunkOrNull, p, inputIndex) -> bool (counted, flagged in hit).
+  /// `write`: fn may modify the cubes it reports.
+  template <class Fn> std::size_t for_runs(std::span<const IVec3> coords, Fn&& fn, std::vector<uint8_t>* hit, bool write) {
+    // A voxel's Morton code shifted right by 15 is the Morton code of its chunk
+    constexpr int RUN_SHIFT = 3 * CHUNK_SHIFT;
+    auto order = locality_order(coords);
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < order.size(); ) {
+      const uint64_t run = order[i].key >> RUN_SHIFT;
+      const IVec3 cc = chunk_of(coords[order[i].index]);
+      Slot* s = chunks_.find(cc);
+      Chunk* ch = s ? resident(*s) : nullptr;
+      if (write && ch) {
+        // Copy a shared chunk only if something in it is about to be written
+        bool any = false;
+        for (std::size_t k = i; !any && k < order.size() && (order[k].key >> RUN_SHIFT) == run; ++k)
+          any = static_cast<const Chunk*>(ch)->find(int(order[k].key & (CHUNK_VOLUME - 1))) != nullptr;
+        if (any) ch = writable(*s);
+      }
+      const std::size_t before = n;
+      for (; i < order.size() && (order[i].key >> RUN_SHIFT) == run; ++i) {
+        if (!fn(ch, coords[order[i].index], order[i].index)) continue;
+        ++n;
+        if (hit) (*hit)[order[i].index] = 1;
+      }
+      if (write && n != before) { drop_backing(*s); dirty_.insert(cc); }
+    }
+    return n;
+  }
+};
+
+} // namespace vxl
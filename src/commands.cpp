@@ -1,9 +1,13 @@
 // src/commands.cpp
 #include "commands.hpp"
+#include "snapshot.hpp"
+#include "region_select.hpp"
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <filesystem>
 #include <glm/gtc/constants.hpp>
 
 namespace vxl {
@@ -21,13 +25,19 @@ bool CommandRegistry::run_line(const std::string& line, CommandContext& ctx) {
   tokens.erase(tokens.begin());
   auto it = map_.find(cmd);
   if (it == map_.end()) { ctx.print("Unknown command: " + cmd); return false; }
+  // Everything one line changes is undone together (partial edits of a failed command too)
+  if (ctx.history) ctx.history->begin(trim(line));
+  if (ctx.log) ctx.log->begin();
+  bool ok = true;
   try {
     it->second.fn(tokens, ctx);
-    return true;
   } catch (std::exception& e) {
     ctx.print(std::string("Error: ") + e.what());
-    return false;
+    ok = false;
   }
+  if (ctx.log) ctx.log->commit();
+  if (ctx.history) ctx.history->commit();
+  return ok;
 }
 
 std::vector<std::string> CommandRegistry::completions(const std::string& prefix) const {
@@ -50,6 +60,31 @@ static bool parse_int3(const std::vector<std::string>& a, int i, int& x,int& y,i
   return true;
 }
 
+/// Arguments rejoined with single spaces (paths may contain spaces).
+static std::string join_args(const std::vector<std::string>& a) {
+  std::string s;
+  for (auto& x : a) { if (!s.empty()) s += ' '; s += x; }
+  return s;
+}
+
+/// Apply `edit` to the material of every selected cube. Each distinct source
+/// material is edited and interned once; cubes then just swap palette indices.
+template <class Edit>
+static void recolor(Universe& U, const Selection& Sel, Edit&& edit) {
+  std::unordered_map<MaterialId, MaterialId> remap;
+  Sel.set().for_each_slice(Selection::EDIT_SLICE, [&](std::span<const IVec3> slice) {
+    U.update_many(slice, [&](const IVec3&, Cube& c){
+      auto it = remap.find(c.mat);
+      if (it == remap.end()) {
+        Material m = U.material(c.mat);
+        edit(m);
+        it = remap.emplace(c.mat, U.materials().intern(m)).first;
+      }
+      c.mat = it->second;
+    });
+  });
+}
+
 // ----- builtins -----
 
 void register_builtin_commands(CommandRegistry& R) {
@@ -57,7 +92,7 @@ void register_builtin_commands(CommandRegistry& R) {
   R.register_cmd("place", "place x y z [color=#RRGGBBAA] [gradient=#..,#..] [dir=x|y|z]",
     [](const auto& t, CommandContext& ctx){
       int x,y,z; if (!parse_int3(t,0,x,y,z)) { ctx.print("Usage: place x y z [color=#..] [gradient=#..,#..] [dir=x|y|z]"); return; }
-      Cube c;
+      Material m;
       for (size_t i=3;i<t.size();++i) {
         auto kv = t[i];
         auto eq = kv.find('=');
@@ -65,21 +100,23 @@ void register_builtin_commands(CommandRegistry& R) {
         auto k = to_lower(kv.substr(0,eq));
         auto v = kv.substr(eq+1);
         if (k == "color") {
-          auto col = parse_rgba_hex(v); if (col) { c.mat.kind = Material::Kind::Solid; c.mat.colorA = *col; }
+          auto col = parse_rgba_hex(v); if (col) { m.kind = Material::Kind::Solid; m.colorA = *col; }
         } else if (k == "gradient") {
           auto pos = v.find(',');
           if (pos!=std::string::npos) {
             auto c1 = parse_rgba_hex(v.substr(0,pos));
             auto c2 = parse_rgba_hex(v.substr(pos+1));
-            if (c1 && c2) { c.mat.kind = Material::Kind::Gradient; c.mat.colorA=*c1; c.mat.colorB=*c2; }
+            if (c1 && c2) { m.kind = Material::Kind::Gradient; m.colorA=*c1; m.colorB=*c2; }
           }
         } else if (k == "dir") {
           auto d = to_lower(v);
-          if (d=="x") c.mat.gradDir={1,0,0};
-          else if (d=="y") c.mat.gradDir={0,1,0};
-          else c.mat.gradDir={0,0,1};
+          if (d=="x") m.gradDir={1,0,0};
+          else if (d=="y") m.gradDir={0,1,0};
+          else m.gradDir={0,0,1};
         }
       }
+      Cube c;
+      c.mat = ctx.U.materials().intern(m);
       ctx.U.place(x,y,z, c);
       ctx.request_redraw();
     }
@@ -89,8 +126,7 @@ void register_builtin_commands(CommandRegistry& R) {
   R.register_cmd("erase", "erase x y z | erase selection",
     [](const auto& t, CommandContext& ctx){
       if (t.size()==1 && to_lower(t[0])=="selection") {
-        auto items = ctx.Sel.items();
-        for (auto& p : items) ctx.U.erase(p.x,p.y,p.z);
+        ctx.Sel.set().for_each_slice(Selection::EDIT_SLICE, [&](std::span<const IVec3> slice) { ctx.U.erase_many(slice); });
         ctx.Sel.clear();
         ctx.request_redraw();
         return;
@@ -102,19 +138,59 @@ void register_builtin_commands(CommandRegistry& R) {
   );
 
   // select
-  R.register_cmd("select", "select x y z | select box x1 y1 z1 x2 y2 z2",
+  R.register_cmd("select", "select x y z | select box x1 y1 z1 x2 y2 z2 | select sphere cx cy cz r | "
+                           "select ellipsoid cx cy cz rx ry rz | select flood x y z [6|26] [solid|same] | "
+                           "select visible x0 y0 x1 y1 [step]",
     [](const auto& t, CommandContext& ctx){
+      if (!t.empty() && to_lower(t[0])=="visible") {
+        // Window pixels; one ray per step-th pixel through the frame on screen
+        if (t.size()<5) { ctx.print("Usage: select visible x0 y0 x1 y1 [step]"); return; }
+        if (!ctx.view) { ctx.print("select visible needs a view."); return; }
+        PixelRect r{std::stoi(t[1]), std::stoi(t[2]), std::stoi(t[3]), std::stoi(t[4])};
+        int step = t.size()>=6 ? std::stoi(t[5]) : 1;
+        auto seen = visible_in_rect(*ctx.view, r, step, ctx.pool);
+        ctx.Sel.clear();
+        for (const IVec3& p : seen) if (ctx.U.get(p.x,p.y,p.z)) ctx.Sel.add(p);   // still there after earlier edits
+        ctx.print("Selected " + std::to_string(ctx.Sel.size()) + " visible cubes.");
+        ctx.request_redraw();
+        return;
+      }
+      // Regions replace the selection with the cubes in them
+      auto select_region = [&](const VoxelMask& m) {
+        ctx.Sel.clear();
+        ctx.Sel.unite(m);
+        ctx.print("Selected " + std::to_string(ctx.Sel.size()) + " cubes.");
+        ctx.request_redraw();
+      };
       if (!t.empty() && to_lower(t[0])=="box") {
         if (t.size()<7) { ctx.print("Usage: select box x1 y1 z1 x2 y2 z2"); return; }
-        int x1=std::stoi(t[1]),y1=std::stoi(t[2]),z1=std::stoi(t[3]);
-        int x2=std::stoi(t[4]),y2=std::stoi(t[5]),z2=std::stoi(t[6]);
-        ctx.Sel.clear();
-        for (int x=std::min(x1,x2); x<=std::max(x1,x2); ++x)
-        for (int y=std::min(y1,y2); y<=std::max(y1,y2); ++y)
-        for (int z=std::min(z1,z2); z<=std::max(z1,z2); ++z) {
-          if (ctx.U.get(x,y,z)) ctx.Sel.add({x,y,z});
+        IVec3 a{std::stoi(t[1]), std::stoi(t[2]), std::stoi(t[3])}, b{std::stoi(t[4]), std::stoi(t[5]), std::stoi(t[6])};
+        select_region(cubes_in_box(ctx.U, a, b, ctx.pool));
+        return;
+      }
+      if (!t.empty() && (to_lower(t[0])=="sphere" || to_lower(t[0])=="ellipsoid")) {
+        const bool sphere = to_lower(t[0])=="sphere";
+        if (t.size() < (sphere ? 5u : 7u)) { ctx.print("Usage: select sphere cx cy cz r | select ellipsoid cx cy cz rx ry rz"); return; }
+        glm::vec3 c{std::stof(t[1]), std::stof(t[2]), std::stof(t[3])};
+        glm::vec3 r = sphere ? glm::vec3(std::stof(t[4])) : glm::vec3(std::stof(t[4]), std::stof(t[5]), std::stof(t[6]));
+        if (!(r.x > 0.0f && r.y > 0.0f && r.z > 0.0f)) { ctx.print("Radii must be positive."); return; }
+        select_region(cubes_in_ellipsoid(ctx.U, c, r, ctx.pool));
+        return;
+      }
+      if (!t.empty() && to_lower(t[0])=="flood") {
+        int x,y,z; if (!parse_int3(t,1,x,y,z)) { ctx.print("Usage: select flood x y z [6|26] [solid|same]"); return; }
+        Connectivity conn = Connectivity::Faces;
+        FloodMatch match = FloodMatch::AnySolid;
+        for (std::size_t i = 4; i < t.size(); ++i) {
+          auto o = to_lower(t[i]);
+          if (o=="6") conn = Connectivity::Faces;
+          else if (o=="26") conn = Connectivity::All;
+          else if (o=="solid") match = FloodMatch::AnySolid;
+          else if (o=="same") match = FloodMatch::SameMaterial;
+          else { ctx.print("Unknown flood option: " + t[i]); return; }
         }
-        ctx.request_redraw();
+        if (!ctx.U.get(x,y,z)) { ctx.print("No cube at the seed."); return; }
+        select_region(flood_select(ctx.U, {x,y,z}, conn, match, ctx.pool));
         return;
       }
       int x,y,z; if (!parse_int3(t,0,x,y,z)) { ctx.print("Usage: select x y z | select box ..."); return; }
@@ -128,7 +204,52 @@ void register_builtin_commands(CommandRegistry& R) {
     [](const auto& t, CommandContext& ctx){
       if (t.size()<3) { ctx.print("Usage: move dx dy dz"); return; }
       IVec3 d{std::stoi(t[0]), std::stoi(t[1]), std::stoi(t[2])};
-      ctx.Sel.move(ctx.U, d);
+      if (!ctx.Sel.move(ctx.U, d, ctx.pool)) { ctx.print("That would move cubes out of the world."); return; }
+      ctx.request_redraw();
+    }
+  );
+
+  // turn / mirror: positions and orientations together (VoxelTransform)
+  auto parse_axis = [](const std::string& s) {
+    const std::string a = to_lower(s);
+    return a == "x" ? 0 : a == "y" ? 1 : a == "z" ? 2 : -1;
+  };
+  auto half_cubes = [](const std::string& s) { return int(std::lround(2.0 * std::stod(s))); };
+  R.register_cmd("turn", "turn x|y|z [quarters] [about px py pz] (selection, about its centre by default)",
+    [=](const auto& t, CommandContext& ctx){
+      const int axis = t.empty() ? -1 : parse_axis(t[0]);
+      if (axis < 0) { ctx.print("Usage: turn x|y|z [quarters] [about px py pz]"); return; }
+      if (ctx.Sel.empty()) { ctx.print("Nothing selected."); return; }
+      std::size_t i = 1;
+      const int quarters = (t.size() > i && to_lower(t[i]) != "about") ? std::stoi(t[i++]) : 1;
+      IVec3 pivot2;
+      if (t.size() > i) {
+        if (to_lower(t[i]) != "about" || t.size() < i + 4) { ctx.print("Usage: turn x|y|z [quarters] [about px py pz]"); return; }
+        pivot2 = {half_cubes(t[i+1]), half_cubes(t[i+2]), half_cubes(t[i+3])};
+      } else {
+        // Any doubled centroid works for a half turn; quarter turns may need it nudged
+        pivot2 = doubled_centroid(ctx.Sel.set());
+        if (quarters % 2) pivot2 = turnable_pivot(axis, pivot2);
+      }
+      VoxelTransform T;
+      try { T = VoxelTransform::turn(axis, quarters, pivot2); }
+      catch (const std::invalid_argument&) { ctx.print("That pivot would put cubes between cells."); return; }
+      if (!ctx.Sel.transform(ctx.U, T, ctx.pool)) { ctx.print("That would turn cubes out of the world."); return; }
+      ctx.request_redraw();
+    }
+  );
+  R.register_cmd("mirror", "mirror x|y|z [at c] (selection, across its centre by default)",
+    [=](const auto& t, CommandContext& ctx){
+      const int axis = t.empty() ? -1 : parse_axis(t[0]);
+      if (axis < 0 || (t.size() > 1 && (to_lower(t[1]) != "at" || t.size() < 3))) {
+        ctx.print("Usage: mirror x|y|z [at c]"); return;
+      }
+      if (ctx.Sel.empty()) { ctx.print("Nothing selected."); return; }
+      const IVec3 c2 = doubled_centroid(ctx.Sel.set());
+      const int plane2 = t.size() > 1 ? half_cubes(t[2]) : axis == 0 ? c2.x : axis == 1 ? c2.y : c2.z;
+      if (!ctx.Sel.transform(ctx.U, VoxelTransform::mirror(axis, plane2), ctx.pool)) {
+        ctx.print("That would mirror cubes out of the world."); return;
+      }
       ctx.request_redraw();
     }
   );
@@ -148,15 +269,12 @@ void register_builtin_commands(CommandRegistry& R) {
   R.register_cmd("fill", "fill solid #RRGGBBAA | fill gradient c1 c2 [dir=x|y|z]",
     [](const auto& t, CommandContext& ctx){
       if (t.empty()) { ctx.print("Usage: fill solid ... | fill gradient ..."); return; }
-      auto items = ctx.Sel.items();
-      if (items.empty()) { ctx.print("Nothing selected."); return; }
+      if (ctx.Sel.empty()) { ctx.print("Nothing selected."); return; }
 
       if (to_lower(t[0])=="solid") {
         if (t.size()<2) { ctx.print("Usage: fill solid #RRGGBBAA"); return; }
         auto col = parse_rgba_hex(t[1]); if (!col) { ctx.print("Bad color"); return; }
-        for (auto& p: items) {
-          auto c=ctx.U.get(p.x,p.y,p.z); if(c){ c->mat.kind=Material::Kind::Solid; c->mat.colorA=*col; ctx.U.place(p.x,p.y,p.z,*c); }
-        }
+        recolor(ctx.U, ctx.Sel, [&](Material& m){ m.kind=Material::Kind::Solid; m.colorA=*col; });
       } else if (to_lower(t[0])=="gradient") {
         if (t.size()<3) { ctx.print("Usage: fill gradient c1 c2 [dir=x|y|z]"); return; }
         auto c1 = parse_rgba_hex(t[1]), c2 = parse_rgba_hex(t[2]); if(!c1||!c2){ ctx.print("Bad colors"); return; }
@@ -166,14 +284,142 @@ void register_builtin_commands(CommandRegistry& R) {
             auto v=to_lower(kv.substr(eq+1)); if(v=="x") dir={1,0,0}; else if(v=="y") dir={0,1,0}; else dir={0,0,1};
           }
         }
-        for (auto& p: items) {
-          auto c=ctx.U.get(p.x,p.y,p.z);
-          if(c){ c->mat.kind=Material::Kind::Gradient; c->mat.colorA=*c1; c->mat.colorB=*c2; c->mat.gradDir=dir; ctx.U.place(p.x,p.y,p.z,*c); }
-        }
+        recolor(ctx.U, ctx.Sel, [&](Material& m){ m.kind=Material::Kind::Gradient; m.colorA=*c1; m.colorB=*c2; m.gradDir=dir; });
+      }
+      ctx.request_redraw();
+    }
+  );
+
+  // palette
+  R.register_cmd("palette", "palette | palette gc -- material table stats / drop unused entries",
+    [](const auto& t, CommandContext& ctx){
+      if (!t.empty() && to_lower(t[0])=="gc") {
+        auto freed = ctx.U.gc_materials();
+        ctx.print("Freed " + std::to_string(freed) + " unused materials");
       }
+      auto& pal = ctx.U.materials();
+      ctx.print(std::to_string(pal.size()) + " materials in " + std::to_string(pal.slots()) + " slots");
+    }
+  );
+
+  // undo / redo
+  R.register_cmd("undo", "undo [N] -- revert the last N edits",
+    [](const auto& t, CommandContext& ctx){
+      if (!ctx.history) { ctx.print("Undo is not available"); return; }
+      int n = t.empty() ? 1 : std::max(1, std::stoi(t[0]));
+      int done = 0;
+      for (; done < n; ++done) {
+        std::string label = ctx.history->undo_label();
+        if (!ctx.history->undo()) break;
+        ctx.print("Undone: " + label);
+      }
+      if (done == 0) ctx.print("Nothing to undo");
+      ctx.request_redraw();
+    }
+  );
+  R.register_cmd("redo", "redo [N] -- re-apply the last N undone edits",
+    [](const auto& t, CommandContext& ctx){
+      if (!ctx.history) { ctx.print("Redo is not available"); return; }
+      int n = t.empty() ? 1 : std::max(1, std::stoi(t[0]));
+      int done = 0;
+      for (; done < n; ++done) {
+        std::string label = ctx.history->redo_label();
+        if (!ctx.history->redo()) break;
+        ctx.print("Redone: " + label);
+      }
+      if (done == 0) ctx.print("Nothing to redo");
       ctx.request_redraw();
     }
   );
+  R.register_cmd("history", "history | history budget MB | history clear -- undo journal stats / limits",
+    [](const auto& t, CommandContext& ctx){
+      if (!ctx.history) { ctx.print("Undo is not available"); return; }
+      auto& H = *ctx.history;
+      if (!t.empty() && to_lower(t[0])=="clear") H.clear();
+      else if (t.size()>=2 && to_lower(t[0])=="budget") H.set_budget(std::size_t(std::max(0.0, std::stod(t[1])) * (1 << 20)));
+      std::ostringstream os;
+      os << H.undo_depth() << " undo / " << H.redo_depth() << " redo entries, "
+         << std::fixed << std::setprecision(1) << H.bytes() / double(1 << 20) << " of "
+         << H.budget() / double(1 << 20) << " MB";
+      ctx.print(os.str());
+    }
+  );
+
+  // save / load
+  R.register_cmd("save", "save PATH -- write the scene to a binary snapshot",
+    [](const auto& t, CommandContext& ctx){
+      if (t.empty()) { ctx.print("Usage: save PATH"); return; }
+      auto path = join_args(t);
+      Snapshot::save(ctx.U, path);
+      ctx.print("Saved " + std::to_string(ctx.U.size()) + " cubes to " + path);
+    }
+  );
+  R.register_cmd("load", "load PATH -- replace the scene with a snapshot (chunks load on first use)",
+    [](const auto& t, CommandContext& ctx){
+      if (t.empty()) { ctx.print("Usage: load PATH"); return; }
+      auto path = join_args(t);
+      Snapshot::load(ctx.U, path);
+      if (ctx.log) ctx.log->note_load(path);
+      ctx.Sel.clear();
+      if (ctx.history) ctx.history->clear();
+      ctx.print("Loaded " + std::to_string(ctx.U.size()) + " cubes in " + std::to_string(ctx.U.chunk_count()) +
+                " chunks (" + std::to_string(ctx.U.resident_chunk_count()) + " resident) from " + path);
+      ctx.request_redraw();
+    }
+  );
+
+  // log (crash recovery)
+  R.register_cmd("log", "log | log checkpoint -- edit log stats / save the session snapshot and empty the log",
+    [](const auto& t, CommandContext& ctx){
+      if (!ctx.log) { ctx.print("Edit log is off"); return; }
+      auto& L = *ctx.log;
+      if (!t.empty() && to_lower(t[0])=="checkpoint") {
+        L.checkpoint();
+        ctx.print("Checkpoint written to " + L.snapshot_path());
+      }
+      std::ostringstream os;
+      os << L.log_path() << ": " << std::fixed << std::setprecision(1) << L.bytes() / double(1 << 20) << " MB, "
+         << L.commits() << " transactions in " << L.syncs() << " syncs";
+      if (auto err = L.error(); !err.empty()) os << "\nError: " << err;
+      ctx.print(os.str());
+    }
+  );
+
+  // cache (chunk paging)
+  R.register_cmd("cache", "cache | cache budget MB [PATH] | cache off | cache reset -- chunk paging stats / limits",
+    [](const auto& t, CommandContext& ctx){
+      auto& U = ctx.U;
+      auto sub = t.empty() ? std::string() : to_lower(t[0]);
+      if (sub=="budget") {
+        if (t.size()<2) { ctx.print("Usage: cache budget MB [PATH]"); return; }
+        auto bytes = std::size_t(std::max(0.0, std::stod(t[1])) * (1 << 20));
+        auto path = t.size()>=3 ? join_args({t.begin() + 2, t.end()})
+                                : (std::filesystem::temp_directory_path() / "voxel_lab.pages").string();
+        U.enable_paging(bytes, path);
+        U.page_out();
+      } else if (sub=="off") {
+        U.disable_paging();
+      } else if (sub=="reset") {
+        U.reset_page_stats();
+      }
+      std::ostringstream os;
+      os << U.resident_chunk_count() << " of " << U.chunk_count() << " chunks resident";
+      if (auto* pg = U.pager()) {
+        const auto& st = pg->stats();
+        const uint64_t looks = st.hits + st.misses;
+        os << std::fixed << std::setprecision(1)
+           << ", budget " << pg->budget() / double(1 << 20) << " MB"
+           << "\nhits " << st.hits << ", misses " << st.misses
+           << " (" << (looks ? 100.0 * st.hits / looks : 100.0) << "% hit)"
+           << ", evictions " << st.evictions << ", write-backs " << st.writebacks
+           << "\npage file " << pg->file().records() << " chunks, "
+           << pg->file().file_bytes() / double(1 << 20) << " MB at " << pg->file().path();
+      } else {
+        os << " (paging off)";
+      }
+      ctx.print(os.str());
+    }
+  );
 
   // grid (UI hint)
   R.register_cmd("grid", "grid on|off|toggle",
@@ -205,7 +451,7 @@ void register_builtin_commands(CommandRegistry& R) {
   );
 
   // group
-  R.register_cmd("group", "group create NAME | select NAME | move NAME dx dy dz | erase NAME",
+  R.register_cmd("group", "group create NAME | select NAME | move NAME dx dy dz | rotate NAME x|y|z deg90 | bake NAME | erase NAME",
     [](const auto& t, CommandContext& ctx){
       if (t.size()<2) { ctx.print("Usage: group ..."); return; }
       auto sub = to_lower(t[0]); auto name = t[1];
@@ -221,6 +467,18 @@ void register_builtin_commands(CommandRegistry& R) {
         IVec3 d{std::stoi(t[2]), std::stoi(t[3]), std::stoi(t[4])};
         if (!ctx.U.group_move(name, d)) ctx.print("No such group");
         ctx.request_redraw();
+      } else if (sub=="rotate") {
+        if (t.size()<4) { ctx.print("Usage: group rotate NAME x|y|z degrees (multiple of 90)"); return; }
+        char ax = std::tolower(static_cast<unsigned char>(t[2][0]));
+        glm::vec3 axis = (ax=='x') ? glm::vec3(1,0,0) : (ax=='y') ? glm::vec3(0,1,0) : glm::vec3(0,0,1);
+        auto code = snap_orientation(glm::angleAxis(glm::radians(std::stof(t[3])), axis));
+        if (!code) { ctx.print("Group rotations must be multiples of 90 degrees"); return; }
+        if (!ctx.U.group_rotate(name, *code)) ctx.print("No such group");
+        ctx.request_redraw();
+      } else if (sub=="bake") {
+        if (!ctx.U.group_bake(name)) { ctx.print("No such group"); return; }
+        ctx.print("Group baked: " + name);
+        ctx.request_redraw();
       } else if (sub=="erase") {
         ctx.U.group_erase(name);
         ctx.print("Group erased: " + name);
@@ -5,6 +5,9 @@
 #include <vector>
 #include "universe.hpp"
 #include "selection.hpp"
+#include "history.hpp"
+#include "edit_log.hpp"
+#include "ray_query.hpp"
 #include "util.hpp"
 
 /** @file commands.hpp
@@ -19,6 +22,10 @@ struct CommandContext {
   std::function<void(const std::string&)> print;  ///< output to console
   std::function<void()> request_redraw;           ///< call to redraw
   std::function<void()> recompute_camera_edgepix; ///< recompute camera distance from universe base edge pixels
+  History* history = nullptr;                     ///< undo journal; each run_line is one entry
+  EditLog* log = nullptr;                         ///< crash-recovery log; each run_line is one transaction
+  const ScreenView* view = nullptr;               ///< what the user saw when entering the line (select visible)
+  ThreadPool* pool = nullptr;                     ///< workers for bulk queries
 };
 
 using CommandFn = std::function<void(const std::vector<std::string>&, CommandContext&)>;
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "orientation.hpp"
+
+/** @file cube.hpp
+ *  @brief Per-voxel payload: material and local orientation of one cube.
+ */
+
+namespace vxl {
+
+/** @brief Material coloration model for a cube. */
+struct Material {
+  enum class Kind { Solid, Gradient } kind = Kind::Solid;
+  glm::vec4 colorA{0.8f,0.8f,0.8f,1.0f};
+  glm::vec4 colorB{0.2f,0.2f,0.2f,1.0f};
+  glm::vec3 gradDir{0,1,0}; ///< unit direction in local cube space
+};
+
+/// True if what lies behind a cube of this material shows through (colorA.a
+/// below 1). The renderer draws such cubes last, blended and depth-sorted.
+inline bool translucent(const Material& m) noexcept { return m.colorA.w < 1.0f; }
+
+/// Index into the owning Universe's MaterialPalette (see palette.hpp).
+using MaterialId = uint16_t;
+
+/** @brief Optional hook to allow embedding custom renderables per-cube. */
+struct IEmbeddedRenderable {
+  virtual ~IEmbeddedRenderable() = default;
+  /// Called with model matrix that maps cube-local coordinates to world.
+  virtual void draw(const glm::mat4& cubeModel) = 0;
+};
+
+/** @brief One cube at an integer coordinate. */
+struct Cube {
+  MaterialId mat = 0;            ///< palette index; 0 is the default material
+  Orientation rotation{};        ///< local rotation; axis-aligned code or FREE
+  uint32_t freeRot = 0;          ///< Universe side-table slot when rotation is FREE
+  IEmbeddedRenderable* embedded{nullptr}; ///< user-owned object (not managed)
+};
+
+} // namespace vxl
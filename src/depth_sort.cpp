@@ -0,0 +1,83 @@
+#include "depth_sort.hpp"
+#include <algorithm>
+#include <array>
+
+namespace vxl {
+
+namespace {
+
+constexpr int DIGIT = 8;
+constexpr uint32_t RADIX = 1u << DIGIT;
+constexpr std::size_t MIN_SLICE = 16384;   // fewer elements than this per slice are not worth a job
+
+/// How many slices to split n elements into: one per thread that can work on them.
+std::size_t slice_count(std::size_t n, const ThreadPool* pool) {
+  if (!pool) return 1;
+  return std::clamp<std::size_t>(n / MIN_SLICE, 1, std::size_t(pool->size()) + 1);
+}
+
+} // namespace
+
+void radix_sort(std::vector<DepthKey>& a, int bits, std::vector<DepthKey>& scratch, ThreadPool* pool) {
+  const std::size_t n = a.size();
+  if (n < 2) return;
+  const std::size_t slices = slice_count(n, pool);
+  const std::size_t per = (n + slices - 1) / slices;
+  std::vector<std::array<uint32_t, RADIX>> count(slices);
+  scratch.resize(n);
+  for (int shift = 0; shift < bits; shift += DIGIT) {
+    parallel_for(pool, slices, [&](std::size_t s) {
+      auto& c = count[s];
+      c.fill(0);
+      for (std::size_t i = s * per, end = std::min(n, i + per); i < end; ++i) ++c[(a[i].key >> shift) & (RADIX - 1)];
+    });
+    // Start of each (digit, slice) run: digit-major, then slice order, which keeps the sort stable
+    uint32_t sum = 0;
+    bool same = false;
+    for (uint32_t d = 0; d < RADIX && !same; ++d) {
+      uint32_t total = 0;
+      for (const auto& c : count) total += c[d];
+      same = total == n;   // earlier digits were all empty, so nothing is lost by stopping
+      for (auto& c : count) { const uint32_t t = c[d]; c[d] = sum; sum += t; }
+    }
+    if (same) continue;
+    parallel_for(pool, slices, [&](std::size_t s) {
+      auto& c = count[s];
+      for (std::size_t i = s * per, end = std::min(n, i + per); i < end; ++i) scratch[c[(a[i].key >> shift) & (RADIX - 1)]++] = a[i];
+    });
+    a.swap(scratch);
+  }
+}
+
+bool DepthSorter::reusable(uint64_t version, const glm::vec3& eye) const {
+  return valid_ && version == version_ && glm::length(eye - eye_) <= reuseDistance_;
+}
+
+void DepthSorter::sort(std::span<const glm::vec3> points, const glm::vec3& eye, uint64_t version, ThreadPool* pool) {
+  const std::size_t n = points.size();
+  const std::size_t slices = slice_count(n, pool);
+  const std::size_t per = n ? (n + slices - 1) / slices : 0;
+  dist_.resize(n);
+  keys_.resize(n);
+  std::vector<float> far(slices, 0.0f);
+  parallel_for(pool, slices, [&](std::size_t s) {
+    float m = 0.0f;
+    for (std::size_t i = s * per, end = std::min(n, i + per); i < end; ++i) m = std::max(m, dist_[i] = glm::length(points[i] - eye));
+    far[s] = m;
+  });
+  // Farthest gets key 0: an ascending sort puts it first
+  const float top = float((1u << DEPTH_KEY_BITS) - 1);
+  const float scale = n ? top / std::max(*std::max_element(far.begin(), far.end()), 1e-6f) : 0.0f;
+  parallel_for(pool, slices, [&](std::size_t s) {
+    for (std::size_t i = s * per, end = std::min(n, i + per); i < end; ++i)
+      keys_[i] = {uint32_t(std::max(0.0f, top - dist_[i] * scale)), uint32_t(i)};
+  });
+  radix_sort(keys_, DEPTH_KEY_BITS, scratch_, pool);
+  order_.resize(n);
+  for (std::size_t i = 0; i < n; ++i) order_[i] = keys_[i].index;
+  eye_ = eye;
+  version_ = version;
+  valid_ = true;
+}
+
+} // namespace vxl
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "thread_pool.hpp"
+
+/** @file depth_sort.hpp
+ *  @brief Back-to-front order for blending: quantized eye distance, a parallel
+ *         radix sort, and reuse of the order while the eye stays put.
+ */
+
+namespace vxl {
+
+/// Sort record: a quantized depth and the index of what it belongs to.
+struct DepthKey {
+  uint32_t key;
+  uint32_t index;
+};
+
+/// Bits of depth DepthSorter quantizes to (three 8-bit radix passes).
+constexpr int DEPTH_KEY_BITS = 24;
+
+/// Stable LSD radix sort of `a` on the low `bits` bits of its keys, 8 bits per
+/// pass. Slices of the array are counted and scattered on pool's workers (and
+/// the calling thread) if given; a pass is skipped when all keys share its
+/// digit. `scratch` is resized to fit and may be reused between calls.
+void radix_sort(std::vector<DepthKey>& a, int bits, std::vector<DepthKey>& scratch, ThreadPool* pool = nullptr);
+
+/** @brief Orders points farthest from the eye first.
+ *
+ *  Depth is the distance to the eye rather than view z, so turning the camera
+ *  keeps the order and only moving it does not. While the points stay the same
+ *  (same caller-supplied version) and the eye stays within reuse_distance() of
+ *  where it was at the last sort, reusable() says the old order may be drawn
+ *  again: two points can then be out of order only if their distances differ
+ *  by less than twice that (plus the quantization step).
+ */
+class DepthSorter {
+public:
+  /// Whether order() may stand for points of this version seen from `eye`.
+  bool reusable(uint64_t version, const glm::vec3& eye) const;
+  /// Order `points` back to front as seen from `eye`; remember version and eye.
+  void sort(std::span<const glm::vec3> points, const glm::vec3& eye, uint64_t version, ThreadPool* pool = nullptr);
+  /// Indices into the points last sorted, farthest first.
+  const std::vector<uint32_t>& order() const noexcept { return order_; }
+  /// Forget the last order: the next reusable() is false.
+  void invalidate() noexcept { valid_ = false; }
+
+  /// How far the eye may move before the order is recomputed (default 0.1).
+  void set_reuse_distance(float d) { reuseDistance_ = d; }
+  float reuse_distance() const noexcept { return reuseDistance_; }
+
+private:
+  std::vector<float> dist_;
+  std::vector<DepthKey> keys_, scratch_;
+  std::vector<uint32_t> order_;
+  glm::vec3 eye_{0.0f};
+  uint64_t version_ = 0;
+  float reuseDistance_ = 0.1f;
+  bool valid_ = false;
+};
+
+} // namespace vxl
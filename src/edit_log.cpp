@@ -0,0 +1,445 @@
+#include "edit_log.hpp"
+#include "snapshot.hpp"
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace vxl {
+
+namespace {
+
+/// Payload ops. Voxel ops address the store named by the last OP_STORE of the
+/// frame; material / rotation ids refer to the latest definition in the log.
+/// Names and paths are a uint32 byte length followed by the bytes.
+enum Op : uint8_t {
+  OP_MATERIAL = 1,   ///< uint16 id, uint8 kind, float colorA[4], colorB[4], gradDir[3]
+  OP_ROTATION = 2,   ///< uint32 id, float x, y, z, w
+  OP_STORE    = 3,   ///< name
+  OP_PLACE    = 4,   ///< int32 x, y, z, uint16 material, uint8 orientation, uint32 rotation
+  OP_ERASE    = 5,   ///< int32 x, y, z
+  OP_POSE     = 6,   ///< name, int32 offset[3], uint8 orient (creates the group if needed)
+  OP_DROP     = 7,   ///< name
+  OP_LOAD     = 8,   ///< snapshot path; replaces everything before it
+};
+
+constexpr std::size_t HEADER_BYTES = 16;
+constexpr std::size_t FRAME_BYTES = 8;
+
+uint32_t crc32(const char* p, std::size_t n) {
+  static const auto table = []{
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t c = ~0u;
+  for (std::size_t i = 0; i < n; ++i) c = table[(c ^ uint8_t(p[i])) & 0xFF] ^ (c >> 8);
+  return ~c;
+}
+
+template <class T> void put(std::vector<char>& b, const T& v) {
+  const std::size_t at = b.size();
+  b.resize(at + sizeof(T));
+  std::memcpy(b.data() + at, &v, sizeof(T));
+}
+void put_string(std::vector<char>& b, const std::string& s) {
+  put(b, uint32_t(s.size()));
+  b.insert(b.end(), s.begin(), s.end());
+}
+void put_vec(std::vector<char>& b, const float* v, int n) {
+  for (int i = 0; i < n; ++i) put(b, v[i]);
+}
+
+class Reader {
+public:
+  Reader(const char* p, std::size_t n) : p_(p), end_(p + n) {}
+  bool done() const { return p_ == end_; }
+  template <class T> T get() {
+    if (std::size_t(end_ - p_) < sizeof(T)) throw std::runtime_error("edit log: malformed transaction");
+    T v;
+    std::memcpy(&v, p_, sizeof(T));
+    p_ += sizeof(T);
+    return v;
+  }
+  std::string get_string() {
+    const auto n = get<uint32_t>();
+    if (std::size_t(end_ - p_) < n) throw std::runtime_error("edit log: malformed transaction");
+    std::string s(p_, n);
+    p_ += n;
+    return s;
+  }
+  IVec3 get_ivec3() {
+    int32_t x = get<int32_t>(), y = get<int32_t>(), z = get<int32_t>();
+    return {x, y, z};
+  }
+
+private:
+  const char* p_;
+  const char* end_;
+};
+
+/// Applies replayed ops; consecutive places (or erases) in one store become one
+/// batch call, across transactions.
+class Replayer {
+public:
+  explicit Replayer(Universe& U) : U_(U) {}
+
+  void run(const char* payload, std::size_t n, LogReplay& stats) {
+    Reader r(payload, n);
+    while (!r.done()) {
+      switch (r.get<uint8_t>()) {
+        case OP_MATERIAL: {
+          const auto id = r.get<uint16_t>();
+          Material m;
+          m.kind = r.get<uint8_t>() ? Material::Kind::Gradient : Material::Kind::Solid;
+          for (int i = 0; i < 4; ++i) m.colorA[i] = r.get<float>();
+          for (int i = 0; i < 4; ++i) m.colorB[i] = r.get<float>();
+          for (int i = 0; i < 3; ++i) m.gradDir[i] = r.get<float>();
+          if (mats_.size() <= id) mats_.resize(id + 1, -1);
+          mats_[id] = U_.materials().intern(m);
+          break;
+        }
+        case OP_ROTATION: {
+          const auto id = r.get<uint32_t>();
+          float x = r.get<float>(), y = r.get<float>(), z = r.get<float>(), w = r.get<float>();
+          rots_[id] = U_.intern_rotation(glm::quat(w, x, y, z));
+          break;
+        }
+        case OP_STORE: {
+          auto name = r.get_string();
+          if (name != store_) { flush(); store_ = std::move(name); }
+          break;
+        }
+        case OP_PLACE: {
+          const IVec3 p = r.get_ivec3();
+          const auto mat = r.get<uint16_t>();
+          const auto code = r.get<uint8_t>();
+          const auto rot = r.get<uint32_t>();
+          Cube c;
+          if (mat >= mats_.size() || mats_[mat] < 0) throw std::runtime_error("edit log: undefined material");
+          c.mat = MaterialId(mats_[mat]);
+          c.rotation.code = code;
+          if (code == Orientation::FREE) {
+            auto it = rots_.find(rot);
+            if (it == rots_.end()) throw std::runtime_error("edit log: undefined rotation");
+            c.freeRot = it->second;
+          } else if (code >= Orientation::COUNT) {
+            throw std::runtime_error("edit log: bad orientation");
+          }
+          stage(Kind::Place);
+          coords_.push_back(p);
+          cubes_.push_back(c);
+          ++stats.voxels;
+          break;
+        }
+        case OP_ERASE:
+          stage(Kind::Erase);
+          coords_.push_back(r.get_ivec3());
+          ++stats.voxels;
+          break;
+        case OP_POSE: {
+          auto name = r.get_string();
+          GroupPose pose;
+          pose.offset = r.get_ivec3();
+          pose.orient = r.get<uint8_t>();
+          if (pose.orient >= Orientation::COUNT) throw std::runtime_error("edit log: bad group orientation");
+          flush();
+          U_.apply_group(name, &pose);
+          break;
+        }
+        case OP_DROP:
+          flush();
+          U_.apply_group(r.get_string(), nullptr);
+          break;
+        case OP_LOAD:
+          flush();
+          Snapshot::load(U_, r.get_string());
+          mats_.clear();
+          rots_.clear();
+          break;
+        default:
+          throw std::runtime_error("edit log: unknown op");
+      }
+    }
+  }
+
+  void flush() {
+    if (kind_ == Kind::Place) U_.apply_place(store_, coords_, cubes_);
+    else if (kind_ == Kind::Erase) U_.apply_erase(store_, coords_);
+    coords_.clear();
+    cubes_.clear();
+    kind_ = Kind::None;
+  }
+
+private:
+  enum class Kind { None, Place, Erase };
+
+  Universe& U_;
+  std::vector<int32_t> mats_;                          ///< log id -> palette id (-1 = undefined)
+  std::unordered_map<uint32_t, uint32_t> rots_;        ///< log id -> side-table slot
+  std::string store_;
+  Kind kind_ = Kind::None;
+  std::vector<IVec3> coords_;
+  std::vector<Cube> cubes_;
+
+  void stage(Kind k) {
+    if (kind_ != k) flush();
+    kind_ = k;
+  }
+};
+
+/// Replay the complete frames of the log at `path` into U. Returns the byte
+/// length of the valid prefix (0 if the file is too short to hold a header).
+uint64_t replay_file(Universe& U, const std::string& path, LogReplay& stats) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) throw std::runtime_error("Cannot read edit log: " + path);
+  std::vector<char> buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (buf.size() < HEADER_BYTES) return 0;
+  if (std::memcmp(buf.data(), LOG_MAGIC, sizeof LOG_MAGIC) != 0) throw std::runtime_error(path + ": not an edit log");
+  uint32_t version;
+  std::memcpy(&version, buf.data() + 8, sizeof version);
+  if (version != LOG_VERSION) throw std::runtime_error(path + ": unsupported edit log version " + std::to_string(version));
+
+  Replayer R(U);
+  std::size_t at = HEADER_BYTES;
+  while (at < buf.size()) {
+    uint32_t n = 0, crc = 0;
+    if (buf.size() - at >= FRAME_BYTES) {
+      std::memcpy(&n, buf.data() + at, 4);
+      std::memcpy(&crc, buf.data() + at + 4, 4);
+    }
+    if (buf.size() - at < FRAME_BYTES || buf.size() - at - FRAME_BYTES < n ||
+        crc32(buf.data() + at + FRAME_BYTES, n) != crc) {
+      stats.tornTail = true;   // the crash hit mid-write
+      break;
+    }
+    R.run(buf.data() + at + FRAME_BYTES, n, stats);
+    ++stats.transactions;
+    at += FRAME_BYTES + n;
+  }
+  R.flush();
+  return at;
+}
+
+bool sync_file(std::FILE* f) {
+  if (std::fflush(f) != 0) return false;
+#ifdef _WIN32
+  return _commit(_fileno(f)) == 0;
+#else
+  return ::fsync(fileno(f)) == 0;
+#endif
+}
+
+} // namespace
+
+EditLog::EditLog(Universe& U, std::string logPath, std::string snapshotPath)
+  : U_(U), logPath_(std::move(logPath)), snapshotPath_(std::move(snapshotPath)) {
+  std::error_code ec;
+  if (std::filesystem::exists(snapshotPath_, ec)) {
+    Snapshot::load(U_, snapshotPath_);
+    recovered_.snapshot = true;
+  }
+  uint64_t valid = 0;
+  if (std::filesystem::exists(logPath_, ec)) valid = replay_file(U_, logPath_, recovered_);
+  if (valid >= HEADER_BYTES) {
+    if (valid < std::filesystem::file_size(logPath_)) std::filesystem::resize_file(logPath_, valid);
+    file_ = std::fopen(logPath_.c_str(), "ab");
+    bytes_ = valid;
+  } else {
+    rewrite_header();
+  }
+  if (!file_) throw std::runtime_error("Cannot open edit log: " + logPath_);
+  writer_ = std::thread([this]{ writer_loop(); });
+  U_.add_journal(this);
+}
+
+EditLog::~EditLog() {
+  U_.remove_journal(this);
+  queue_open();
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+  if (file_) std::fclose(file_);
+}
+
+void EditLog::writer_loop() {
+  std::unique_lock<std::mutex> lk(mu_);
+  for (;;) {
+    wake_.wait(lk, [&]{ return stop_ || !queued_.empty(); });
+    if (queued_.empty()) return;   // stopping, and everything is written
+    std::vector<char> batch;
+    batch.swap(queued_);
+    const uint64_t seq = queuedSeq_;
+    lk.unlock();
+    // Everything queued while the previous sync ran goes out with one sync
+    bool ok = file_ && std::fwrite(batch.data(), 1, batch.size(), file_) == batch.size() && sync_file(file_);
+    lk.lock();
+    if (!ok) error_ = "write to " + logPath_ + " failed";
+    durableSeq_ = seq;
+    ++syncs_;
+    done_.notify_all();
+  }
+}
+
+void EditLog::queue_open() {
+  if (open_.empty()) return;
+  const uint32_t n = uint32_t(open_.size()), crc = crc32(open_.data(), open_.size());
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    put(queued_, n);
+    put(queued_, crc);
+    queued_.insert(queued_.end(), open_.begin(), open_.end());
+    bytes_ += FRAME_BYTES + n;
+    ++queuedSeq_;
+  }
+  wake_.notify_one();
+  open_.clear();
+  storeSet_ = false;
+}
+
+void EditLog::rewrite_header() {
+  if (file_) std::fclose(file_);
+  file_ = std::fopen(logPath_.c_str(), "wb");
+  if (!file_) { error_ = "cannot reopen " + logPath_; return; }
+  std::vector<char> h;
+  h.insert(h.end(), LOG_MAGIC, LOG_MAGIC + sizeof LOG_MAGIC);
+  put(h, LOG_VERSION);
+  put(h, uint32_t(0));
+  if (std::fwrite(h.data(), 1, h.size(), file_) != h.size() || !sync_file(file_)) error_ = "write to " + logPath_ + " failed";
+  bytes_ = HEADER_BYTES;
+}
+
+void EditLog::forget_definitions() {
+  materialSent_.assign(materialSent_.size(), false);
+  rotationSent_.assign(rotationSent_.size(), false);
+}
+
+void EditLog::begin() {
+  if (depth_++ == 0) queue_open();   // close an implicit transaction
+}
+
+void EditLog::commit() {
+  if (depth_ > 0 && --depth_ > 0) return;
+  queue_open();
+}
+
+void EditLog::publish() {
+  if (depth_ == 0) queue_open();
+}
+
+void EditLog::note_load(const std::string& path) {
+  // The snapshot replaces the palette too: ids must be defined again after it
+  forget_definitions();
+  open_.push_back(char(OP_LOAD));
+  put_string(open_, std::filesystem::absolute(path).string());
+  storeSet_ = false;
+}
+
+void EditLog::flush() {
+  std::unique_lock<std::mutex> lk(mu_);
+  const uint64_t target = queuedSeq_;
+  done_.wait(lk, [&]{ return durableSeq_ >= target; });
+}
+
+void EditLog::checkpoint() {
+  queue_open();   // the snapshot covers it; the rest of an open transaction starts a new frame
+  flush();
+  Snapshot::save(U_, snapshotPath_);
+  std::lock_guard<std::mutex> lk(mu_);
+  // Only this thread queues, so the writer is idle now
+  rewrite_header();
+  forget_definitions();
+}
+
+uint64_t EditLog::bytes() const {
+  std::lock_guard<std::mutex> lk(mu_);
+  return bytes_;
+}
+
+uint64_t EditLog::commits() const {
+  std::lock_guard<std::mutex> lk(mu_);
+  return queuedSeq_;
+}
+
+uint64_t EditLog::syncs() const {
+  std::lock_guard<std::mutex> lk(mu_);
+  return syncs_;
+}
+
+std::string EditLog::error() const {
+  std::lock_guard<std::mutex> lk(mu_);
+  return error_;
+}
+
+void EditLog::select_store(const std::string& name) {
+  if (storeSet_ && name == store_) return;
+  open_.push_back(char(OP_STORE));
+  put_string(open_, name);
+  store_ = name;
+  storeSet_ = true;
+}
+
+void EditLog::define(const Cube& c) {
+  if (c.mat >= materialSent_.size()) { materialSent_.resize(c.mat + 1, false); materials_.resize(c.mat + 1); }
+  const Material& m = U_.material(c.mat);
+  if (!materialSent_[c.mat] || !(materials_[c.mat] == m)) {
+    open_.push_back(char(OP_MATERIAL));
+    put(open_, uint16_t(c.mat));
+    put(open_, uint8_t(m.kind == Material::Kind::Gradient));
+    put_vec(open_, &m.colorA[0], 4);
+    put_vec(open_, &m.colorB[0], 4);
+    put_vec(open_, &m.gradDir[0], 3);
+    materials_[c.mat] = m;
+    materialSent_[c.mat] = true;
+  }
+  if (c.rotation.axis_aligned()) return;
+  if (c.freeRot >= rotationSent_.size()) { rotationSent_.resize(c.freeRot + 1, false); rotations_.resize(c.freeRot + 1); }
+  const glm::quat& q = U_.free_rotations().quat(c.freeRot);
+  if (!rotationSent_[c.freeRot] || rotations_[c.freeRot] != q) {
+    open_.push_back(char(OP_ROTATION));
+    put(open_, c.freeRot);
+    put(open_, q.x); put(open_, q.y); put(open_, q.z); put(open_, q.w);
+    rotations_[c.freeRot] = q;
+    rotationSent_[c.freeRot] = true;
+  }
+}
+
+void EditLog::on_voxel(const std::string& group, const IVec3& p, const Cube*, const Cube* after) {
+  if (after) define(*after);
+  select_store(group);
+  open_.push_back(char(after ? OP_PLACE : OP_ERASE));
+  put(open_, int32_t(p.x)); put(open_, int32_t(p.y)); put(open_, int32_t(p.z));
+  if (!after) return;
+  put(open_, uint16_t(after->mat));
+  put(open_, uint8_t(after->rotation.code));
+  put(open_, uint32_t(after->rotation.axis_aligned() ? 0 : after->freeRot));
+}
+
+void EditLog::on_group(const std::string& name, const GroupPose*, const GroupPose* after) {
+  if (after) {
+    open_.push_back(char(OP_POSE));
+    put_string(open_, name);
+    put(open_, int32_t(after->offset.x)); put(open_, int32_t(after->offset.y)); put(open_, int32_t(after->offset.z));
+    put(open_, uint8_t(after->orient));
+  } else {
+    open_.push_back(char(OP_DROP));
+    put_string(open_, name);
+  }
+}
+
+} // namespace vxl
@@ -0,0 +1,119 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "universe.hpp"
+
+/** @file edit_log.hpp
+ *  @brief Write-ahead log of storage changes, for crash recovery.
+ *
+ *  File: LOG_MAGIC, uint32 version, uint32 reserved, then one frame per
+ *  transaction: uint32 payload bytes, uint32 CRC-32 of the payload, payload.
+ *  A payload is a run of ops (see edit_log.cpp) carrying absolute after-states,
+ *  materials and free rotations by value, so a log replays onto a fresh palette
+ *  and replaying changes a snapshot already holds is harmless.
+ */
+
+namespace vxl {
+
+constexpr char LOG_MAGIC[8] = {'V','X','L','W','A','L','\0','\0'};
+constexpr uint32_t LOG_VERSION = 2;   ///< 2: string lengths are uint32
+
+/// What opening a session brought back.
+struct LogReplay {
+  bool snapshot = false;          ///< the session snapshot was loaded
+  uint64_t transactions = 0;      ///< log frames replayed on top of it
+  uint64_t voxels = 0;            ///< voxel changes among them
+  bool tornTail = false;          ///< an incomplete or corrupt last frame was cut off
+};
+
+/** @brief Append-only journal of a Universe, written by a background thread.
+ *
+ *  Transactions are encoded on the calling thread and queued; the writer thread
+ *  appends whatever has queued since its last pass and syncs once for all of it
+ *  (group commit), so callers never wait for the disk. A crash loses at most
+ *  the transactions queued since the last sync.
+ */
+class EditLog : public IEditJournal {
+public:
+  /// Recover a session: load `snapshotPath` if it exists, replay the complete
+  /// transactions of `logPath` on top (batched through Universe::apply_*), cut
+  /// off a torn tail, then log every later change to U. Throws
+  /// std::runtime_error if the log cannot be opened or replayed.
+  EditLog(Universe& U, std::string logPath, std::string snapshotPath);
+  /// Writes out everything committed, then stops the writer.
+  ~EditLog() override;
+  EditLog(const EditLog&) = delete;
+  EditLog& operator=(const EditLog&) = delete;
+
+  /// Open a transaction; nested pairs fold into the outermost one. Changes made
+  /// while none is open start an implicit one, closed by begin(), commit() or publish().
+  void begin();
+  /// Close the outermost transaction and queue it for the writer.
+  void commit();
+  /// Queue an implicit transaction, if one is open (call once per frame).
+  void publish();
+  /// Record that the scene was replaced by the snapshot at `path` (see Snapshot::load).
+  void note_load(const std::string& path);
+
+  /// Block until everything queued so far is on disk.
+  void flush();
+  /// Save the session snapshot and empty the log.
+  void checkpoint();
+
+  const LogReplay& recovered() const noexcept { return recovered_; }
+  const std::string& log_path() const noexcept { return logPath_; }
+  const std::string& snapshot_path() const noexcept { return snapshotPath_; }
+  /// Log file size, queued transactions included.
+  uint64_t bytes() const;
+  /// Transactions queued / syncs performed since the log was opened.
+  uint64_t commits() const;
+  uint64_t syncs() const;
+  /// Last write error of the writer thread ("" if none).
+  std::string error() const;
+
+  // IEditJournal
+  void on_voxel(const std::string& group, const IVec3& p, const Cube* before, const Cube* after) override;
+  void on_group(const std::string& name, const GroupPose* before, const GroupPose* after) override;
+
+private:
+  Universe& U_;
+  std::string logPath_, snapshotPath_;
+  LogReplay recovered_;
+
+  // Caller side
+  int depth_ = 0;
+  std::vector<char> open_;               ///< ops of the open transaction
+  std::string store_;                    ///< store the last voxel op in open_ addressed
+  bool storeSet_ = false;
+  std::vector<Material> materials_;      ///< as last written, by palette id
+  std::vector<bool> materialSent_;
+  std::vector<glm::quat> rotations_;     ///< as last written, by side-table slot
+  std::vector<bool> rotationSent_;
+
+  // Shared with the writer
+  mutable std::mutex mu_;
+  std::condition_variable wake_, done_;
+  std::vector<char> queued_;
+  uint64_t queuedSeq_ = 0, durableSeq_ = 0, syncs_ = 0;
+  uint64_t bytes_ = 0;
+  bool stop_ = false;
+  std::string error_;
+  std::FILE* file_ = nullptr;
+  std::thread writer_;
+
+  void writer_loop();
+  /// Frame open_ and hand it to the writer.
+  void queue_open();
+  /// Truncate the file to a bare header (writer idle, mu_ held).
+  void rewrite_header();
+  void forget_definitions();
+  void select_store(const std::string& name);
+  void define(const Cube& c);
+};
+
+} // namespace vxl
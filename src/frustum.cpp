@@ -0,0 +1,147 @@
+#include "frustum.hpp"
+#include <array>
+#include <bit>
+#include <cstring>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VXL_CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace vxl {
+
+namespace {
+
+/// Per plane: the coordinate arrays of each box's corner furthest along the
+/// normal (the "positive vertex"), picked once per batch from the normal's signs.
+struct PlaneInput {
+  const float* px;
+  const float* py;
+  const float* pz;
+  float nx, ny, nz, d;
+};
+
+void plane_inputs(const Frustum& F, const AabbBatch& boxes, PlaneInput (&out)[6]) {
+  for (int k = 0; k < 6; ++k) {
+    const glm::vec4& p = F.planes[k];
+    out[k] = {p.x >= 0 ? boxes.hi(0) : boxes.lo(0),
+              p.y >= 0 ? boxes.hi(1) : boxes.lo(1),
+              p.z >= 0 ? boxes.hi(2) : boxes.lo(2),
+              p.x, p.y, p.z, p.w};
+  }
+}
+
+/// Byte k of SPREAD[m] is bit k of m (little-endian: byte 0 is the lowest address).
+constexpr std::array<uint32_t, 16> make_spread() {
+  std::array<uint32_t, 16> t{};
+  for (uint32_t m = 0; m < 16; ++m)
+    for (uint32_t k = 0; k < 4; ++k) t[m] |= ((m >> k) & 1u) << (8 * k);
+  return t;
+}
+[[maybe_unused]] constexpr std::array<uint32_t, 16> SPREAD = make_spread();
+
+} // namespace
+
+Frustum Frustum::from_matrix(const glm::mat4& m) {
+  // Gribb-Hartmann: row 3 of the matrix plus / minus rows 0..2
+  auto row = [&](int r) { return glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]); };
+  const glm::vec4 w = row(3);
+  Frustum F;
+  F.planes[0] = w + row(0);
+  F.planes[1] = w - row(0);
+  F.planes[2] = w + row(1);
+  F.planes[3] = w - row(1);
+  F.planes[4] = w + row(2);
+  F.planes[5] = w - row(2);
+  return F;
+}
+
+void AabbBatch::push(const glm::vec3& lo, const glm::vec3& hi) {
+  if (n_ == lo_[0].size()) {
+    const std::size_t cap = n_ + 8;   // keep whole SIMD batches readable
+    for (int a = 0; a < 3; ++a) { lo_[a].resize(cap, 0.0f); hi_[a].resize(cap, 0.0f); }
+  }
+  for (int a = 0; a < 3; ++a) { lo_[a][n_] = lo[a]; hi_[a][n_] = hi[a]; }
+  ++n_;
+}
+
+std::size_t cull_aabbs_scalar(const Frustum& F, const AabbBatch& boxes, std::vector<uint8_t>& visible) {
+  PlaneInput pl[6];
+  plane_inputs(F, boxes, pl);
+  visible.resize(boxes.size());
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < boxes.size(); ++i) {
+    bool in = true;
+    for (const PlaneInput& p : pl) {
+      if (p.nx * p.px[i] + p.ny * p.py[i] + (p.nz * p.pz[i] + p.d) < 0.0f) { in = false; break; }
+    }
+    visible[i] = in;
+    n += in;
+  }
+  return n;
+}
+
+std::size_t cull_aabbs(const Frustum& F, const AabbBatch& boxes, std::vector<uint8_t>& visible) {
+#if defined(__AVX__) || defined(VXL_CULL_SSE)
+  PlaneInput pl[6];
+  plane_inputs(F, boxes, pl);
+  visible.resize(boxes.size());
+  std::size_t n = 0;
+#if defined(__AVX__)
+  constexpr std::size_t W = 8;
+#else
+  constexpr std::size_t W = 4;
+#endif
+  // Storage is padded to 8 boxes, so the last batch may read past size()
+  for (std::size_t i = 0; i < boxes.size(); i += W) {
+#if defined(__AVX__)
+    __m256 out = _mm256_setzero_ps();
+    for (const PlaneInput& p : pl) {
+      __m256 dist = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.nx), _mm256_loadu_ps(p.px + i)),
+                        _mm256_mul_ps(_mm256_set1_ps(p.ny), _mm256_loadu_ps(p.py + i))),
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.nz), _mm256_loadu_ps(p.pz + i)), _mm256_set1_ps(p.d)));
+      out = _mm256_or_ps(out, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+    const int culled = _mm256_movemask_ps(out);
+#else
+    __m128 out = _mm_setzero_ps();
+    for (const PlaneInput& p : pl) {
+      __m128 dist = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nx), _mm_loadu_ps(p.px + i)),
+                     _mm_mul_ps(_mm_set1_ps(p.ny), _mm_loadu_ps(p.py + i))),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nz), _mm_loadu_ps(p.pz + i)), _mm_set1_ps(p.d)));
+      out = _mm_or_ps(out, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+    }
+    const int culled = _mm_movemask_ps(out);
+#endif
+    const unsigned in = ~unsigned(culled) & ((1u << W) - 1);
+    if (i + W <= boxes.size()) {
+      // Spread the lane bits into one byte per box
+      for (std::size_t k = 0; k < W; k += 4) std::memcpy(&visible[i + k], &SPREAD[(in >> k) & 15], 4);
+      n += std::size_t(std::popcount(in));
+    } else {
+      for (std::size_t k = 0; i + k < boxes.size(); ++k) {
+        visible[i + k] = (in >> k) & 1;
+        n += (in >> k) & 1;
+      }
+    }
+  }
+  return n;
+#else
+  return cull_aabbs_scalar(F, boxes, visible);
+#endif
+}
+
+const char* cull_isa() {
+#if defined(__AVX__)
+  return "AVX";
+#elif defined(VXL_CULL_SSE)
+  return "SSE";
+#else
+  return "scalar";
+#endif
+}
+
+} // namespace vxl
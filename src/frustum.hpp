@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/** @file frustum.hpp
+ *  @brief View-frustum planes and batched AABB culling (SSE / AVX when available).
+ */
+
+namespace vxl {
+
+/** @brief The six clip planes of a view-projection matrix. A point x is inside
+ *         plane (n, d) when dot(n, x) + d >= 0. Planes are not normalized.
+ */
+struct Frustum {
+  glm::vec4 planes[6];   ///< left, right, bottom, top, near, far
+
+  /// Planes of clip = P * V (OpenGL clip space, -w <= z <= w).
+  static Frustum from_matrix(const glm::mat4& clip);
+};
+
+/** @brief Axis-aligned boxes in structure-of-arrays form, so a SIMD lane holds
+ *         one box. Storage is padded to a multiple of 8 boxes.
+ */
+class AabbBatch {
+public:
+  void clear() noexcept { n_ = 0; }
+  std::size_t size() const noexcept { return n_; }
+  void push(const glm::vec3& lo, const glm::vec3& hi);
+
+  const float* lo(int axis) const noexcept { return lo_[axis].data(); }
+  const float* hi(int axis) const noexcept { return hi_[axis].data(); }
+
+private:
+  std::size_t n_ = 0;
+  std::vector<float> lo_[3], hi_[3];
+};
+
+/// visible[i] = 1 if box i intersects or may intersect F, else 0 (resized to
+/// boxes.size()). Conservative: boxes near a frustum corner may pass.
+/// Returns the number of visible boxes. Uses AVX or SSE when compiled for them.
+std::size_t cull_aabbs(const Frustum& F, const AabbBatch& boxes, std::vector<uint8_t>& visible);
+/// Same test one box at a time; the reference for cull_aabbs.
+std::size_t cull_aabbs_scalar(const Frustum& F, const AabbBatch& boxes, std::vector<uint8_t>& visible);
+/// Instruction set cull_aabbs was built with: "AVX", "SSE" or "scalar".
+const char* cull_isa();
+
+} // namespace vxl
@@ -0,0 +1,157 @@
+#include "history.hpp"
+
+namespace vxl {
+
+History::History(Universe& U, std::size_t budgetBytes) : U_(U), budget_(budgetBytes) {
+  U_.add_journal(this);
+}
+
+History::~History() { U_.remove_journal(this); }
+
+std::size_t History::Entry::bytes() const noexcept {
+  std::size_t n = sizeof(Entry) + label.capacity()
+                + steps.capacity() * sizeof(Step) + deltas.capacity() * sizeof(Delta);
+  for (auto& s : steps) n += s.store.capacity();
+  return n;
+}
+
+void History::begin(const std::string& label) {
+  if (depth_++ == 0) {
+    flush();            // close an implicit transaction
+    open_.label = label;
+  }
+}
+
+void History::commit() {
+  if (depth_ > 0 && --depth_ > 0) return;
+  flush();
+}
+
+void History::flush() {
+  if (open_.empty()) { open_ = Entry{}; return; }
+  for (auto& e : redo_) bytes_ -= e.bytes();
+  redo_.clear();
+  open_.deltas.shrink_to_fit();
+  bytes_ += open_.bytes();
+  undo_.push_back(std::move(open_));
+  open_ = Entry{};
+  trim();
+}
+
+bool History::undo() {
+  flush();
+  if (undo_.empty()) return false;
+  Entry e = std::move(undo_.back());
+  undo_.pop_back();
+  bytes_ -= e.bytes();
+  Entry inverse;
+  inverse.label = e.label;
+  replay(e, inverse);
+  bytes_ += inverse.bytes();
+  redo_.push_back(std::move(inverse));
+  trim();
+  return true;
+}
+
+bool History::redo() {
+  flush();
+  if (redo_.empty()) return false;
+  Entry e = std::move(redo_.back());
+  redo_.pop_back();
+  bytes_ -= e.bytes();
+  Entry inverse;
+  inverse.label = e.label;
+  replay(e, inverse);
+  bytes_ += inverse.bytes();
+  undo_.push_back(std::move(inverse));
+  trim();
+  return true;
+}
+
+const std::string& History::undo_label() const {
+  static const std::string none;
+  return undo_.empty() ? none : undo_.back().label;
+}
+
+const std::string& History::redo_label() const {
+  static const std::string none;
+  return redo_.empty() ? none : redo_.back().label;
+}
+
+void History::set_budget(std::size_t bytes) {
+  budget_ = bytes;
+  trim();
+}
+
+void History::clear() {
+  undo_.clear();
+  redo_.clear();
+  open_ = Entry{};
+  bytes_ = 0;
+}
+
+void History::replay(const Entry& e, Entry& inverse) {
+  replay_ = &inverse;
+  try {
+    std::vector<IVec3> coords;
+    std::vector<Cube> cubes;
+    for (auto s = e.steps.rbegin(); s != e.steps.rend(); ++s) {
+      if (s->group) {
+        U_.apply_group(s->store, s->hadPose ? &s->pose : nullptr);
+        continue;
+      }
+      // Newest first; consecutive deltas of the same kind go out as one batch.
+      // Inside a batch the later (older) duplicate wins, as it must.
+      for (uint32_t i = s->end; i > s->begin; ) {
+        const uint32_t had = e.deltas[i - 1].had;
+        coords.clear(); cubes.clear();
+        for (; i > s->begin && e.deltas[i - 1].had == had; --i) {
+          coords.push_back(e.deltas[i - 1].p);
+          if (had) cubes.push_back(e.deltas[i - 1].before);
+        }
+        if (had) U_.apply_place(s->store, coords, cubes);
+        else U_.apply_erase(s->store, coords);
+      }
+    }
+  } catch (...) {
+    replay_ = nullptr;
+    throw;
+  }
+  replay_ = nullptr;
+}
+
+void History::trim() {
+  while (bytes_ > budget_ && !undo_.empty()) { bytes_ -= undo_.front().bytes(); undo_.pop_front(); }
+  while (bytes_ > budget_ && !redo_.empty()) { bytes_ -= redo_.front().bytes(); redo_.pop_front(); }
+}
+
+void History::on_voxel(const std::string& group, const IVec3& p, const Cube* before, const Cube*) {
+  Entry& e = sink();
+  if (e.steps.empty() || e.steps.back().group || e.steps.back().store != group) {
+    Step s;
+    s.store = group;
+    s.begin = s.end = uint32_t(e.deltas.size());
+    e.steps.push_back(std::move(s));
+  }
+  Delta d{p, before ? 1u : 0u, before ? *before : Cube{}};
+  e.deltas.push_back(d);
+  e.steps.back().end = uint32_t(e.deltas.size());
+}
+
+void History::on_group(const std::string& name, const GroupPose* before, const GroupPose*) {
+  Step s;
+  s.group = true;
+  s.store = name;
+  s.hadPose = before != nullptr;
+  if (before) s.pose = *before;
+  sink().steps.push_back(std::move(s));
+}
+
+void History::for_each_held(const std::function<void(const Cube&)>& fn) const {
+  auto visit = [&](const Entry& e){ for (auto& d : e.deltas) if (d.had) fn(d.before); };
+  for (auto& e : undo_) visit(e);
+  for (auto& e : redo_) visit(e);
+  visit(open_);
+}
+
+} // namespace vxl
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "universe.hpp"
+
+/** @file history.hpp
+ *  @brief Undo/redo stacks built from per-transaction voxel delta journals.
+ */
+
+namespace vxl {
+
+/** @brief Undo/redo for a Universe.
+ *
+ *  Attaches itself as an IEditJournal and keeps, for each change a transaction
+ *  makes, only the store-local coordinate and the previous state (the current
+ *  state is the other half). Undo replays those states in reverse through
+ *  Universe::apply_*, and the replay is itself journaled into the matching redo
+ *  entry, so both directions cost time proportional to the voxels changed.
+ *  Undo plus redo memory is capped by a byte budget; oldest entries go first.
+ */
+class History : public IEditJournal {
+public:
+  static constexpr std::size_t DEFAULT_BUDGET = std::size_t(256) << 20;
+
+  explicit History(Universe& U, std::size_t budgetBytes = DEFAULT_BUDGET);
+  ~History() override;
+  History(const History&) = delete;
+  History& operator=(const History&) = delete;
+
+  /// Open a transaction; nested begin/commit pairs fold into the outermost one.
+  /// Changes made while none is open start an implicit one, closed by the next
+  /// begin(), commit(), undo() or redo().
+  void begin(const std::string& label = {});
+  /// Close the outermost transaction. A non-empty one becomes the newest undo
+  /// entry and discards the redo stack.
+  void commit();
+
+  /// Revert / re-apply the newest entry. Return false if there is none.
+  bool undo();
+  bool redo();
+
+  std::size_t undo_depth() const noexcept { return undo_.size(); }
+  std::size_t redo_depth() const noexcept { return redo_.size(); }
+  /// Label of the entry undo() / redo() would apply ("" if none).
+  const std::string& undo_label() const;
+  const std::string& redo_label() const;
+
+  /// Bytes held by both stacks (the open transaction is not counted until committed).
+  std::size_t bytes() const noexcept { return bytes_; }
+  std::size_t budget() const noexcept { return budget_; }
+  /// Change the cap, dropping entries right away if the stacks no longer fit.
+  void set_budget(std::size_t bytes);
+  void clear();
+
+  // IEditJournal
+  void on_voxel(const std::string& group, const IVec3& p, const Cube* before, const Cube* after) override;
+  void on_group(const std::string& name, const GroupPose* before, const GroupPose* after) override;
+  void for_each_held(const std::function<void(const Cube&)>& fn) const override;
+
+private:
+  /// Previous state of one voxel: 32 bytes.
+  struct Delta {
+    IVec3 p;
+    uint32_t had = 0;     ///< 1 if `before` holds a cube, 0 if the voxel was empty
+    Cube before;
+  };
+  /// A run of deltas on one store, or one group change.
+  struct Step {
+    bool group = false;
+    std::string store;             ///< group name, "" = ungrouped cubes
+    uint32_t begin = 0, end = 0;   ///< voxel steps: range in Entry::deltas
+    bool hadPose = false;          ///< group steps: previous pose, if the group existed
+    GroupPose pose;
+  };
+  struct Entry {
+    std::string label;
+    std::vector<Step> steps;
+    std::vector<Delta> deltas;
+    bool empty() const noexcept { return steps.empty(); }
+    std::size_t bytes() const noexcept;
+  };
+
+  Universe& U_;
+  std::deque<Entry> undo_, redo_;   ///< newest at the back
+  Entry open_;
+  int depth_ = 0;
+  Entry* replay_ = nullptr;         ///< sink for changes made by undo()/redo()
+  std::size_t budget_;
+  std::size_t bytes_ = 0;
+
+  Entry& sink() { return replay_ ? *replay_ : open_; }
+  /// Move a non-empty open transaction onto the undo stack.
+  void flush();
+  /// Apply e's previous states in reverse, journaling into `inverse`.
+  void replay(const Entry& e, Entry& inverse);
+  void trim();
+};
+
+} // namespace vxl
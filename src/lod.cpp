@@ -0,0 +1,79 @@
+#include "lod.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace vxl {
+
+namespace {
+
+constexpr float HYSTERESIS = 0.25f;   // in levels
+
+/// Cube count and colour sum of one cell, the running state of a level.
+struct CellSum {
+  uint32_t count = 0;
+  glm::vec3 rgb{0.0f};
+};
+
+void emit(const std::vector<CellSum>& sums, int level, LodLevel& out) {
+  out.level = level;
+  out.edge = CHUNK_SIZE >> level;
+  out.color.assign(sums.size(), 0);
+  out.solid.assign(sums.size(), 0);
+  for (std::size_t i = 0; i < sums.size(); ++i) {
+    if (!sums[i].count) continue;
+    out.solid[i] = 1;
+    out.color[i] = pack_rgb565(sums[i].rgb / float(sums[i].count));
+  }
+}
+
+} // namespace
+
+uint16_t pack_rgb565(const glm::vec3& c) noexcept {
+  auto q = [](float v, float top) { return uint16_t(std::clamp(v, 0.0f, 1.0f) * top + 0.5f); };
+  return uint16_t(q(c.x, 31.0f) << 11 | q(c.y, 63.0f) << 5 | q(c.z, 31.0f));
+}
+
+glm::vec3 unpack_rgb565(uint16_t c) noexcept {
+  return glm::vec3(float(c >> 11), float((c >> 5) & 63), float(c & 31)) / glm::vec3(31.0f, 63.0f, 31.0f);
+}
+
+void build_lod_chain(const Chunk& ch, std::span<const glm::vec3> colours, LodLevel (&out)[LOD_LEVELS - 1]) {
+  // Level 1 straight from the voxels, then each level from the sums of the one below
+  int edge = CHUNK_SIZE / 2;
+  std::vector<CellSum> sums(std::size_t(edge) * edge * edge), next;
+  ch.for_each([&](int i, const Cube& c) {
+    const IVec3 p = voxel_at({0, 0, 0}, i);
+    CellSum& s = sums[std::size_t((p.x >> 1) + edge * ((p.y >> 1) + edge * (p.z >> 1)))];
+    ++s.count;
+    s.rgb += c.mat < colours.size() ? colours[c.mat] : glm::vec3(1.0f);
+  });
+  emit(sums, 1, out[0]);
+  for (int level = 2; level < LOD_LEVELS; ++level) {
+    const int half = edge / 2;
+    next.assign(std::size_t(half) * half * half, CellSum{});
+    for (int z = 0; z < edge; ++z)
+      for (int y = 0; y < edge; ++y)
+        for (int x = 0; x < edge; ++x) {
+          const CellSum& s = sums[std::size_t(x + edge * (y + edge * z))];
+          CellSum& d = next[std::size_t((x >> 1) + half * ((y >> 1) + half * (z >> 1)))];
+          d.count += s.count;
+          d.rgb += s.rgb;
+        }
+    sums.swap(next);
+    edge = half;
+    emit(sums, level, out[level - 1]);
+  }
+}
+
+uint8_t pick_lod_level(float voxelPixels, uint8_t current) noexcept {
+  // Ideal (fractional) level: a cell of 2^f voxels spans one pixel
+  const float f = std::log2(1.0f / std::max(voxelPixels, 1e-6f));
+  const float maxLevel = float(LOD_LEVELS - 1);
+  const int target = int(std::clamp(std::floor(f), 0.0f, maxLevel));
+  const int cur = std::min<int>(current, LOD_LEVELS - 1);
+  if (target > cur && f < float(target) + HYSTERESIS) return uint8_t(std::max(cur, target - 1));
+  if (target < cur && f > float(cur) - HYSTERESIS) return uint8_t(cur);
+  return uint8_t(target);
+}
+
+} // namespace vxl
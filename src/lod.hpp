@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "chunk.hpp"
+
+/** @file lod.hpp
+ *  @brief Voxel mip chain of a chunk, and which level to draw it at.
+ */
+
+namespace vxl {
+
+/// Levels of detail: 0 is the chunk itself, level L has cells of 2^L voxels a side.
+constexpr int LOD_LEVELS = 4;
+
+/** @brief One coarse level of a chunk: edge^3 cells, x fastest. A cell is solid
+ *         if any of its voxels holds a cube (thin walls stay visible from afar);
+ *         its colour is the mean colour of those cubes.
+ */
+struct LodLevel {
+  int level = 0;
+  int edge = 0;                  ///< CHUNK_SIZE >> level
+  std::vector<uint16_t> color;   ///< RGB565 per cell
+  std::vector<uint8_t> solid;    ///< 1 per occupied cell
+};
+
+/// Levels 1..LOD_LEVELS-1 of ch; out[L-1] is level L, each built from the one
+/// below. colours[id] is the colour of material id, ids past its end read as white.
+void build_lod_chain(const Chunk& ch, std::span<const glm::vec3> colours, LodLevel (&out)[LOD_LEVELS - 1]);
+
+uint16_t pack_rgb565(const glm::vec3& c) noexcept;
+glm::vec3 unpack_rgb565(uint16_t c) noexcept;
+
+/// Level to draw a chunk at whose voxels span `voxelPixels` on screen: the
+/// coarsest whose cells stay within a pixel. A chunk drawn at `current` only
+/// switches once the ideal level is past the boundary by a quarter level, so
+/// chunks near a boundary do not flip back and forth as the camera moves.
+uint8_t pick_lod_level(float voxelPixels, uint8_t current) noexcept;
+
+} // namespace vxl
@@ -0,0 +1,64 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vxl {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) { file_ = nullptr; throw std::runtime_error("Cannot open file: " + path); }
+  LARGE_INTEGER sz{};
+  if (!GetFileSizeEx(file_, &sz)) { CloseHandle(file_); throw std::runtime_error("Cannot stat file: " + path); }
+  size_ = std::size_t(sz.QuadPart);
+  if (size_ == 0) return;
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_) data_ = static_cast<const std::byte*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    if (mapping_) CloseHandle(mapping_);
+    CloseHandle(file_);
+    throw std::runtime_error("Cannot map file: " + path);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) throw std::runtime_error("Cannot open file: " + path);
+  struct stat st{};
+  if (::fstat(fd_, &st) != 0) { ::close(fd_); throw std::runtime_error("Cannot stat file: " + path); }
+  size_ = std::size_t(st.st_size);
+  if (size_ == 0) return;
+  void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (p == MAP_FAILED) { ::close(fd_); throw std::runtime_error("Cannot map file: " + path); }
+  ::madvise(p, size_, MADV_RANDOM);   // chunks are read in whatever order they are touched
+  data_ = static_cast<const std::byte*>(p);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) ::munmap(const_cast<std::byte*>(data_), size_);
+  if (fd_ >= 0) ::close(fd_);
+}
+
+#endif
+
+} // namespace vxl
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/** @file mapped_file.hpp
+ *  @brief Read-only memory mapping of a whole file (mmap / MapViewOfFile).
+ */
+
+namespace vxl {
+
+class MappedFile {
+public:
+  /// Map `path` read-only. Throws std::runtime_error if it cannot be opened or mapped.
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const std::byte* data() const noexcept { return data_; }
+  std::size_t size() const noexcept { return size_; }
+
+private:
+  const std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+} // namespace vxl
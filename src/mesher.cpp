@@ -0,0 +1,153 @@
+#include "mesher.hpp"
+#include "world_snapshot.hpp"
+
+namespace vxl {
+
+namespace {
+
+constexpr int N = CHUNK_SIZE;
+
+/// Face f looks along axis f/2, towards + for even f. The slice axes u, v follow
+/// cyclically, so that u x v points along +axis.
+struct FaceAxes {
+  int a, u, v, s;
+  explicit FaceAxes(int f) : a(f / 2), u((f / 2 + 1) % 3), v((f / 2 + 2) % 3), s(f % 2 == 0 ? 1 : -1) {}
+};
+
+/// Chunk local index: x fastest, as Mesher::cell for n_ == CHUNK_SIZE.
+int cell_index(const int (&xyz)[3]) {
+  return xyz[0] | (xyz[1] << CHUNK_SHIFT) | (xyz[2] << (2 * CHUNK_SHIFT));
+}
+
+/// The chunk beyond face f of chunk cc.
+IVec3 neighbour(const IVec3& cc, int f) {
+  const FaceAxes F(f);
+  int ncc[3] = {cc.x, cc.y, cc.z};
+  ncc[F.a] += F.s;
+  return {ncc[0], ncc[1], ncc[2]};
+}
+
+/// Mesher::gather for any store with chunk(cc): copy the chunk and its neighbours'
+/// borders (load_border is Mesher's, passed in as it is private).
+template <class Store, class LoadBorder>
+bool gather_from(const Store& S, const IVec3& cc, MeshInput& in, std::span<const uint8_t> translucent,
+                 LoadBorder load_border) {
+  const Chunk* ch = S.chunk(cc);
+  if (!ch) return false;
+  in.chunk = *ch;
+  for (int f = 0; f < 6; ++f) load_border(S.chunk(neighbour(cc, f)), f, translucent, in.border[f]);
+  return true;
+}
+
+} // namespace
+
+void Mesher::build(const ChunkStore& S, const IVec3& cc, ChunkMesh& out) {
+  if (gather(S, cc, input_)) build(input_, out);
+  else out.clear();
+}
+
+bool Mesher::gather(const ChunkStore& S, const IVec3& cc, MeshInput& in, std::span<const uint8_t> translucent) {
+  return gather_from(S, cc, in, translucent, &Mesher::load_border);
+}
+
+bool Mesher::gather(const StoreSnapshot& S, const IVec3& cc, MeshInput& in, std::span<const uint8_t> translucent) {
+  return gather_from(S, cc, in, translucent, &Mesher::load_border);
+}
+
+void Mesher::build(const MeshInput& in, ChunkMesh& out) {
+  n_ = N;
+  cells_.assign(CHUNK_VOLUME, EMPTY);
+  in.chunk.for_each([&](int i, const Cube& c){ cells_[i] = meshable(c) ? int32_t(c.mat) : LOOSE; });
+  mesh_grid(in.border, out);
+}
+
+void Mesher::build(const LodLevel& lod, ChunkMesh& out) {
+  n_ = lod.edge;
+  cells_.resize(lod.solid.size());
+  for (std::size_t i = 0; i < cells_.size(); ++i) cells_[i] = lod.solid[i] ? int32_t(lod.color[i]) : EMPTY;
+  mesh_grid(nullptr, out);
+}
+
+void Mesher::mesh_grid(const std::vector<uint8_t>* border, ChunkMesh& out) {
+  out.clear();
+  mask_.resize(std::size_t(n_) * n_);
+  for (int f = 0; f < 6; ++f)
+    for (int d = 0; d < n_; ++d) mesh_slice(border, f, d, out);
+}
+
+void Mesher::load_border(const Chunk* nb, int face, std::span<const uint8_t> translucent, std::vector<uint8_t>& border) {
+  const FaceAxes F(face);
+  border.assign(N * N, 0);
+  if (!nb) return;
+  int xyz[3];
+  xyz[F.a] = F.s > 0 ? 0 : N - 1;   // the neighbour's layer touching this chunk
+  for (int v = 0; v < N; ++v) {
+    xyz[F.v] = v;
+    for (int u = 0; u < N; ++u) {
+      xyz[F.u] = u;
+      const Cube* c = nb->find(cell_index(xyz));
+      border[u + N * v] = c && meshable(*c) && !(c->mat < translucent.size() && translucent[c->mat]);
+    }
+  }
+}
+
+void Mesher::mesh_slice(const std::vector<uint8_t>* border, int face, int d, ChunkMesh& out) {
+  const FaceAxes F(face);
+  const int n = n_;
+  const int nd = d + F.s;
+  const bool inside = nd >= 0 && nd < n;
+
+  // Exposed faces of this slice
+  bool any = false;
+  int xyz[3], nxyz[3];
+  xyz[F.a] = d;
+  nxyz[F.a] = nd;
+  for (int v = 0; v < n; ++v) {
+    xyz[F.v] = nxyz[F.v] = v;
+    for (int u = 0; u < n; ++u) {
+      xyz[F.u] = nxyz[F.u] = u;
+      int32_t m = cells_[cell(xyz)];
+      if (m >= 0) {
+        const bool hidden = inside ? cells_[cell(nxyz)] >= 0 : border && border[face][u + n * v] != 0;
+        if (hidden) m = EMPTY;
+      }
+      mask_[u + n * v] = m >= 0 ? m : EMPTY;
+      any |= m >= 0;
+    }
+  }
+  if (!any) return;
+
+  // Greedy: grow each rectangle along u, then along v while whole rows match
+  const uint8_t plane = uint8_t(d + (F.s > 0 ? 1 : 0));
+  for (int v = 0; v < n; ++v) {
+    for (int u = 0; u < n; ) {
+      const int32_t m = mask_[u + n * v];
+      if (m < 0) { ++u; continue; }
+      int w = 1;
+      while (u + w < n && mask_[u + w + n * v] == m) ++w;
+      int h = 1;
+      for (; v + h < n; ++h) {
+        bool row = true;
+        for (int k = 0; k < w && row; ++k) row = mask_[u + k + n * (v + h)] == m;
+        if (!row) break;
+      }
+      for (int j = 0; j < h; ++j)
+        for (int k = 0; k < w; ++k) mask_[u + k + n * (v + j)] = EMPTY;
+
+      auto corner = [&](int cu, int cv) {
+        uint8_t p[3];
+        p[F.a] = plane;
+        p[F.u] = uint8_t(cu);
+        p[F.v] = uint8_t(cv);
+        return MeshVertex{p[0], p[1], p[2], uint8_t(face), uint16_t(m)};
+      };
+      const MeshVertex c0 = corner(u, v), c1 = corner(u + w, v), c2 = corner(u + w, v + h), c3 = corner(u, v + h);
+      if (F.s > 0) out.vertices.insert(out.vertices.end(), {c0, c1, c2, c3});
+      else         out.vertices.insert(out.vertices.end(), {c0, c3, c2, c1});
+      out.faces += std::size_t(w) * std::size_t(h);
+      u += w;
+    }
+  }
+}
+
+} // namespace vxl
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "chunk.hpp"
+#include "lod.hpp"
+
+/** @file mesher.hpp
+ *  @brief CPU greedy mesher: a chunk's exposed cube faces as merged quads.
+ */
+
+namespace vxl {
+
+class StoreSnapshot;
+
+/// One quad corner in chunk-local corner coordinates: 0..32 per axis, corner k
+/// being the low corner of voxel k (of cell k, for a LodLevel mesh). 8 bytes.
+struct MeshVertex {
+  uint8_t x, y, z;
+  uint8_t face;       ///< 0..5: +x, -x, +y, -y, +z, -z
+  uint16_t mat;       ///< MaterialId (RGB565 colour, for a LodLevel mesh)
+  uint16_t pad = 0;
+};
+
+/// Output of Mesher::build.
+struct ChunkMesh {
+  std::vector<MeshVertex> vertices;   ///< 4 per quad, counter-clockwise seen from outside
+  std::size_t faces = 0;              ///< exposed unit faces the quads cover
+
+  std::size_t quads() const noexcept { return vertices.size() / 4; }
+  void clear() { vertices.clear(); faces = 0; }
+};
+
+/** @brief What Mesher::build reads: a copy of the chunk and, per face, 32x32 flags
+ *         telling whether the neighbouring chunk's touching cell holds an
+ *         axis-aligned cube. Taken by the thread that owns the store, so the
+ *         build itself can run on any thread.
+ */
+struct MeshInput {
+  Chunk chunk;
+  std::vector<uint8_t> border[6];
+};
+
+/** @brief Builds chunk meshes with hidden-face removal and greedy merging.
+ *
+ *  Only axis-aligned cubes are meshed: turning a unit cube by one of the 24
+ *  axis-aligned rotations leaves its faces where they were, so faces merge on
+ *  material alone. Cubes with a free rotation are left to the caller (draw them
+ *  as instances) and do not hide their neighbours' faces. Keeps scratch buffers
+ *  between calls; use one Mesher per thread.
+ */
+class Mesher {
+public:
+  /// Mesh chunk cc of S into `out`. A face is dropped when the cell beyond it, in
+  /// this chunk or the neighbouring one, holds an axis-aligned cube; the rest are
+  /// merged, per slice and material, into maximal rectangles. Faults in cc and
+  /// its six neighbours if they are not resident. Same as gather() then build().
+  void build(const ChunkStore& S, const IVec3& cc, ChunkMesh& out);
+  /// Copy what build() needs of chunk cc. Returns false (in untouched) if there is no such chunk.
+  /// Neighbouring cubes whose material is flagged in `translucent` (by MaterialId)
+  /// hide nothing; the chunk itself is copied whole, so a caller drawing those
+  /// cubes elsewhere removes them from in.chunk before build().
+  static bool gather(const ChunkStore& S, const IVec3& cc, MeshInput& in, std::span<const uint8_t> translucent = {});
+  /// The same from a snapshot of a store, so any thread may call it.
+  static bool gather(const StoreSnapshot& S, const IVec3& cc, MeshInput& in, std::span<const uint8_t> translucent = {});
+  void build(const MeshInput& in, ChunkMesh& out);
+  /// Mesh a coarse level of a chunk: solid cells merge on colour. Faces on the
+  /// chunk border are all kept, so neighbours drawn at another level leave no gaps.
+  void build(const LodLevel& lod, ChunkMesh& out);
+
+  /// True if build() draws c; other cubes need instancing.
+  static bool meshable(const Cube& c) noexcept { return c.rotation.axis_aligned(); }
+
+private:
+  static constexpr int32_t EMPTY = -1;
+  static constexpr int32_t LOOSE = -2;   ///< a free-rotated cube: not meshed, hides nothing
+
+  int n_ = CHUNK_SIZE;               ///< grid edge
+  std::vector<int32_t> cells_;       ///< n_^3, x fastest: material id (colour), EMPTY or LOOSE
+  std::vector<int32_t> mask_;        ///< one slice: material of each exposed face, or EMPTY
+  MeshInput input_;                  ///< for build(S, cc, out)
+
+  /// Flags of border[face] from the neighbouring chunk nb (none if null).
+  static void load_border(const Chunk* nb, int face, std::span<const uint8_t> translucent, std::vector<uint8_t>& border);
+  int cell(const int (&xyz)[3]) const noexcept { return xyz[0] + n_ * (xyz[1] + n_ * xyz[2]); }
+  /// Quads of cells_; border[f] (if given) flags the cells beyond face f as solid.
+  void mesh_grid(const std::vector<uint8_t>* border, ChunkMesh& out);
+  void mesh_slice(const std::vector<uint8_t>* border, int face, int d, ChunkMesh& out);
+};
+
+} // namespace vxl
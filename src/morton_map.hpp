@@ -0,0 +1,205 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "util.hpp"
+
+/** @file morton_map.hpp
+ *  @brief 64-bit Morton codes for IVec3 and flat Robin Hood hash containers keyed on them.
+ */
+
+namespace vxl {
+
+/// Each axis keeps 21 bits, so keyed coordinates must lie in [MORTON_MIN, MORTON_MAX].
+constexpr int MORTON_MIN = -(1 << 20);
+constexpr int MORTON_MAX = (1 << 20) - 1;
+
+inline bool in_morton_range(const IVec3& p) noexcept {
+  auto ok = [](int v){ return v >= MORTON_MIN && v <= MORTON_MAX; };
+  return ok(p.x) && ok(p.y) && ok(p.z);
+}
+
+namespace detail {
+inline uint64_t part1by2(uint32_t v) noexcept {
+  uint64_t x = v & 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8)  & 0x100f00f00f00f00full;
+  x = (x | x << 4)  & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2)  & 0x1249249249249249ull;
+  return x;
+}
+inline uint32_t compact1by2(uint64_t x) noexcept {
+  x &= 0x1249249249249249ull;
+  x = (x ^ (x >> 2))  & 0x10c30c30c30c30c3ull;
+  x = (x ^ (x >> 4))  & 0x100f00f00f00f00full;
+  x = (x ^ (x >> 8))  & 0x1f0000ff0000ffull;
+  x = (x ^ (x >> 16)) & 0x1f00000000ffffull;
+  x = (x ^ (x >> 32)) & 0x1fffffull;
+  return uint32_t(x);
+}
+} // namespace detail
+
+/// Interleave x,y,z (biased by 2^20) into a 63-bit code; nearby coordinates get nearby codes.
+inline uint64_t morton_encode(const IVec3& p) noexcept {
+  constexpr uint32_t bias = 1u << 20;
+  return detail::part1by2(uint32_t(p.x) + bias)
+       | detail::part1by2(uint32_t(p.y) + bias) << 1
+       | detail::part1by2(uint32_t(p.z) + bias) << 2;
+}
+
+inline IVec3 morton_decode(uint64_t m) noexcept {
+  constexpr int bias = 1 << 20;
+  return {int(detail::compact1by2(m)) - bias,
+          int(detail::compact1by2(m >> 1)) - bias,
+          int(detail::compact1by2(m >> 2)) - bias};
+}
+
+/** @brief Open-addressing map from IVec3 (as Morton code) to T.
+ *
+ *  One flat slot array, linear probing with Robin Hood displacement and
+ *  backward-shift deletion, so a lookup is a hash plus a short forward scan
+ *  over contiguous memory. Keys must satisfy in_morton_range(). Pointers to
+ *  values are invalidated by any insertion or erase.
+ */
+template <class T>
+class MortonMap {
+public:
+  bool empty() const noexcept { return size_ == 0; }
+  std::size_t size() const noexcept { return size_; }
+  std::size_t capacity() const noexcept { return slots_.size(); }
+
+  void clear() { slots_.clear(); size_ = 0; shift_ = 64; }
+
+  /// Make room for n keys without rehashing.
+  void reserve(std::size_t n) {
+    std::size_t cap = 16;
+    while (cap * MAX_LOAD_NUM < n * MAX_LOAD_DEN) cap *= 2;
+    if (cap > slots_.size()) rehash(cap);
+  }
+
+  T* find(const IVec3& p) { return find_code(morton_encode(p)); }
+  const T* find(const IVec3& p) const { return const_cast<MortonMap*>(this)->find_code(morton_encode(p)); }
+  bool contains(const IVec3& p) const { return find(p) != nullptr; }
+
+  /// Value for p, default-constructing it if absent. Returns {value, inserted}.
+  std::pair<T*, bool> try_emplace(const IVec3& p) {
+    uint64_t k = morton_encode(p);
+    if (T* v = find_code(k)) return {v, false};
+    if ((size_ + 1) * MAX_LOAD_DEN > slots_.size() * MAX_LOAD_NUM) rehash(slots_.empty() ? 16 : slots_.size() * 2);
+    return {insert_new(k, T{}), true};
+  }
+  T& operator[](const IVec3& p) { return *try_emplace(p).first; }
+
+  bool erase(const IVec3& p) {
+    if (size_ == 0) return false;
+    uint64_t k = morton_encode(p);
+    std::size_t mask = slots_.size() - 1, i = home(k);
+    for (std::size_t d = 0;; ++d, i = (i + 1) & mask) {
+      if (slots_[i].key == k) break;
+      if (slots_[i].key == EMPTY || dist(slots_[i].key, i) < d) return false;
+    }
+    // Backward-shift the rest of the cluster into the hole
+    for (std::size_t j = (i + 1) & mask; slots_[j].key != EMPTY && dist(slots_[j].key, j) > 0; j = (j + 1) & mask) {
+      slots_[i] = std::move(slots_[j]);
+      i = j;
+    }
+    slots_[i] = Slot{};
+    --size_;
+    return true;
+  }
+
+  /// Visit entries in slot order: fn(const IVec3& key, T& value). Do not mutate the map inside.
+  template <class Fn> void for_each(Fn&& fn) {
+    for (auto& s : slots_) if (s.key != EMPTY) fn(morton_decode(s.key), s.value);
+  }
+  template <class Fn> void for_each(Fn&& fn) const {
+    for (auto& s : slots_) if (s.key != EMPTY) fn(morton_decode(s.key), s.value);
+  }
+
+  /// Heap bytes held by the slot array.
+  std::size_t memory_bytes() const noexcept { return slots_.capacity() * sizeof(Slot); }
+
+private:
+  static constexpr uint64_t EMPTY = ~uint64_t(0);   // never a valid 63-bit code
+  static constexpr std::size_t MAX_LOAD_NUM = 4, MAX_LOAD_DEN = 5;
+
+  struct Slot {
+    uint64_t key = EMPTY;
+    [[no_unique_address]] T value{};
+  };
+
+  std::vector<Slot> slots_;
+  std::size_t size_ = 0;
+  int shift_ = 64;
+
+  std::size_t home(uint64_t k) const noexcept { return std::size_t((k * 0x9E3779B97F4A7C15ull) >> shift_); }
+  std::size_t dist(uint64_t k, std::size_t i) const noexcept { return (i - home(k)) & (slots_.size() - 1); }
+
+  T* find_code(uint64_t k) {
+    if (size_ == 0) return nullptr;
+    std::size_t mask = slots_.size() - 1, i = home(k);
+    for (std::size_t d = 0;; ++d, i = (i + 1) & mask) {
+      Slot& s = slots_[i];
+      if (s.key == k) return &s.value;
+      if (s.key == EMPTY || dist(s.key, i) < d) return nullptr;
+    }
+  }
+
+  /// Robin Hood insert of a key known to be absent; capacity already ensured.
+  T* insert_new(uint64_t k, T v) {
+    std::size_t mask = slots_.size() - 1, i = home(k), d = 0;
+    T* placed = nullptr;
+    for (;; ++d, i = (i + 1) & mask) {
+      Slot& s = slots_[i];
+      if (s.key == EMPTY) {
+        s.key = k; s.value = std::move(v);
+        ++size_;
+        return placed ? placed : &s.value;
+      }
+      std::size_t sd = dist(s.key, i);
+      if (sd < d) {                      // steal from the richer entry, carry it onward
+        std::swap(k, s.key);
+        std::swap(v, s.value);
+        if (!placed) placed = &s.value;
+        d = sd;
+      }
+    }
+  }
+
+  void rehash(std::size_t cap) {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(cap);
+    shift_ = 64 - std::countr_zero(cap);
+    size_ = 0;
+    for (auto& s : old) if (s.key != EMPTY) insert_new(s.key, std::move(s.value));
+  }
+};
+
+/** @brief Open-addressing set of IVec3, same layout as MortonMap without values. */
+class MortonSet {
+public:
+  bool empty() const noexcept { return map_.empty(); }
+  std::size_t size() const noexcept { return map_.size(); }
+  void clear() { map_.clear(); }
+  void reserve(std::size_t n) { map_.reserve(n); }
+
+  /// Returns true if p was not present.
+  bool insert(const IVec3& p) { return map_.try_emplace(p).second; }
+  bool erase(const IVec3& p) { return map_.erase(p); }
+  bool contains(const IVec3& p) const { return map_.contains(p); }
+
+  /// fn(const IVec3&)
+  template <class Fn> void for_each(Fn&& fn) const { map_.for_each([&](const IVec3& p, const Unit&){ fn(p); }); }
+
+  std::size_t memory_bytes() const noexcept { return map_.memory_bytes(); }
+
+private:
+  struct Unit {};
+  MortonMap<Unit> map_;
+};
+
+} // namespace vxl
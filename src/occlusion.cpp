@@ -0,0 +1,234 @@
+#include "occlusion.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace vxl {
+
+namespace {
+
+constexpr int G = CHUNK_SIZE / OCCLUDER_BRICK;   // sub-bricks per chunk edge
+constexpr int BANDS_PER_THREAD = 2;              // smaller bands even out uneven rows
+
+/// Corner k of a box: bit 0 picks hi.x, bit 1 hi.y, bit 2 hi.z.
+glm::vec3 corner(const Box3& b, int k) {
+  return {(k & 1) ? b.hi.x : b.lo.x, (k & 2) ? b.hi.y : b.lo.y, (k & 4) ? b.hi.z : b.lo.z};
+}
+
+/// Box faces as corner indices, counter-clockwise seen from outside.
+constexpr int FACES[6][4] = {{0, 4, 6, 2}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 2, 3, 1}, {4, 5, 7, 6}};
+
+float edge(const glm::vec3& a, const glm::vec3& b, float px, float py) {
+  return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+} // namespace
+
+void occluder_boxes(const Chunk& ch, const IVec3& cc, std::vector<Box3>& out) {
+  constexpr int B = OCCLUDER_BRICK;
+  constexpr int FULL = B * B * B;
+  if (ch.size() < FULL) return;
+  std::array<uint16_t, G * G * G> count{};
+  ch.for_each([&](int i, const Cube& c) {
+    if (!c.rotation.axis_aligned()) return;   // a tilted cube leaves gaps
+    const IVec3 p = voxel_at({0, 0, 0}, i);
+    ++count[std::size_t(p.x / B + G * (p.y / B + G * (p.z / B)))];
+  });
+  std::array<uint8_t, G * G * G> solid{};
+  for (std::size_t i = 0; i < solid.size(); ++i) solid[i] = count[i] == FULL;
+  auto at = [&](int x, int y, int z) -> uint8_t& { return solid[std::size_t(x + G * (y + G * z))]; };
+  auto full = [&](int x0, int x1, int y0, int y1, int z0, int z1) {
+    for (int z = z0; z < z1; ++z)
+      for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x)
+          if (!at(x, y, z)) return false;
+    return true;
+  };
+
+  const glm::vec3 base = glm::vec3(float(cc.x), float(cc.y), float(cc.z)) * float(CHUNK_SIZE) - 0.5f;
+  for (int z = 0; z < G; ++z)
+    for (int y = 0; y < G; ++y)
+      for (int x = 0; x < G; ++x) {
+        if (!at(x, y, z)) continue;
+        int ex = 1, ey = 1, ez = 1;
+        while (x + ex < G && at(x + ex, y, z)) ++ex;
+        while (y + ey < G && full(x, x + ex, y + ey, y + ey + 1, z, z + 1)) ++ey;
+        while (z + ez < G && full(x, x + ex, y, y + ey, z + ez, z + ez + 1)) ++ez;
+        for (int k = z; k < z + ez; ++k)
+          for (int j = y; j < y + ey; ++j)
+            for (int i = x; i < x + ex; ++i) at(i, j, k) = 0;
+        const glm::vec3 lo = base + glm::vec3(float(x), float(y), float(z)) * float(B);
+        out.push_back({lo, lo + glm::vec3(float(ex), float(ey), float(ez)) * float(B)});
+      }
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) { resize(width, height); }
+
+void OcclusionBuffer::resize(int width, int height) {
+  w_ = std::max(1, width);
+  h_ = std::max(1, height);
+  levels_.clear();
+  int w = w_, h = h_;
+  for (;;) {
+    Level L;
+    L.w = w;
+    L.h = h;
+    L.maxZ.assign(std::size_t(w) * std::size_t(h), 1.0f);
+    if (!levels_.empty()) L.minZ.assign(L.maxZ.size(), 1.0f);
+    levels_.push_back(std::move(L));
+    if (w == 1 && h == 1) break;
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+}
+
+void OcclusionBuffer::begin(const glm::mat4& clip) {
+  clip_ = clip;
+  for (Level& L : levels_) {
+    std::fill(L.maxZ.begin(), L.maxZ.end(), 1.0f);
+    std::fill(L.minZ.begin(), L.minZ.end(), 1.0f);
+  }
+}
+
+void OcclusionBuffer::setup(std::span<const Box3> boxes) {
+  tris_.clear();
+  const float W = float(w_), H = float(h_);
+  auto window = [&](const glm::vec4& c) {
+    const float iw = 1.0f / c.w;
+    return glm::vec3((c.x * iw * 0.5f + 0.5f) * W, (c.y * iw * 0.5f + 0.5f) * H,
+                     std::min(1.0f, c.z * iw * 0.5f + 0.5f));
+  };
+  auto emit = [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    if (edge(a, b, c.x, c.y) <= 0.0f) return;   // back-facing or degenerate
+    const float lo = std::min({a.y, b.y, c.y}), hi = std::max({a.y, b.y, c.y});
+    const int y0 = std::max(0, int(std::ceil(lo - 0.5f)));
+    const int y1 = std::min(h_ - 1, int(std::floor(hi - 0.5f)));
+    const float xlo = std::min({a.x, b.x, c.x}), xhi = std::max({a.x, b.x, c.x});
+    if (y0 > y1 || xhi < 0.0f || xlo > W) return;
+    tris_.push_back({{a, b, c}, y0, y1});
+  };
+
+  for (const Box3& b : boxes) {
+    glm::vec4 cl[8];
+    for (int k = 0; k < 8; ++k) cl[k] = clip_ * glm::vec4(corner(b, k), 1.0f);
+    for (const auto& f : FACES) {
+      // Clip the quad against the near plane (z >= -w), then fan it into triangles
+      glm::vec4 poly[5];
+      int n = 0;
+      for (int k = 0; k < 4; ++k) {
+        const glm::vec4& p = cl[f[k]];
+        const glm::vec4& q = cl[f[(k + 1) % 4]];
+        const float dp = p.z + p.w, dq = q.z + q.w;
+        if (dp >= 0.0f) poly[n++] = p;
+        if ((dp >= 0.0f) != (dq >= 0.0f)) poly[n++] = p + (q - p) * (dp / (dp - dq));
+      }
+      if (n < 3) continue;
+      glm::vec3 win[5];
+      bool ok = true;
+      for (int k = 0; k < n && ok; ++k) {
+        ok = poly[k].w > 1e-6f;
+        if (ok) win[k] = window(poly[k]);
+      }
+      if (!ok) continue;
+      for (int k = 1; k + 1 < n; ++k) emit(win[0], win[k], win[k + 1]);
+    }
+  }
+}
+
+void OcclusionBuffer::raster_band(int y0, int y1) {
+  float* depth = levels_[0].maxZ.data();
+  for (const Tri& t : tris_) {
+    const int ty0 = std::max(y0, t.y0), ty1 = std::min(y1, t.y1);
+    if (ty0 > ty1) continue;
+    const glm::vec3 &a = t.v[0], &b = t.v[1], &c = t.v[2];
+    const float area = edge(a, b, c.x, c.y);
+    const int x0 = std::max(0, int(std::ceil(std::min({a.x, b.x, c.x}) - 0.5f)));
+    const int x1 = std::min(w_ - 1, int(std::floor(std::max({a.x, b.x, c.x}) - 0.5f)));
+    for (int y = ty0; y <= ty1; ++y) {
+      const float py = float(y) + 0.5f;
+      float* row = depth + std::size_t(y) * std::size_t(w_);
+      for (int x = x0; x <= x1; ++x) {
+        const float px = float(x) + 0.5f;
+        const float e0 = edge(b, c, px, py), e1 = edge(c, a, px, py), e2 = edge(a, b, px, py);
+        if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) continue;
+        const float z = (e0 * a.z + e1 * b.z + e2 * c.z) / area;
+        if (z < row[x]) row[x] = std::max(z, 0.0f);
+      }
+    }
+  }
+}
+
+void OcclusionBuffer::build_hierarchy() {
+  for (std::size_t l = 1; l < levels_.size(); ++l) {
+    const Level& src = levels_[l - 1];
+    Level& dst = levels_[l];
+    const std::vector<float>& srcMin = l == 1 ? src.maxZ : src.minZ;
+    for (int y = 0; y < dst.h; ++y)
+      for (int x = 0; x < dst.w; ++x) {
+        float lo = 1.0f, hi = 0.0f;
+        for (int dy = 0; dy < 2; ++dy)
+          for (int dx = 0; dx < 2; ++dx) {
+            const int sx = std::min(2 * x + dx, src.w - 1), sy = std::min(2 * y + dy, src.h - 1);
+            const std::size_t i = std::size_t(sy) * std::size_t(src.w) + std::size_t(sx);
+            lo = std::min(lo, srcMin[i]);
+            hi = std::max(hi, src.maxZ[i]);
+          }
+        const std::size_t i = std::size_t(y) * std::size_t(dst.w) + std::size_t(x);
+        dst.minZ[i] = lo;
+        dst.maxZ[i] = hi;
+      }
+  }
+}
+
+void OcclusionBuffer::rasterize(std::span<const Box3> boxes, ThreadPool* pool) {
+  setup(boxes);
+  const int threads = pool ? int(pool->size()) + 1 : 1;
+  const int bands = std::min(h_, threads * BANDS_PER_THREAD);
+  const int rows = (h_ + bands - 1) / bands;
+  parallel_for(pool, std::size_t(bands), [&](std::size_t i) {
+    const int y0 = int(i) * rows;
+    raster_band(y0, std::min(h_, y0 + rows) - 1);
+  });
+  build_hierarchy();
+}
+
+bool OcclusionBuffer::occluded(const Box3& box) const {
+  const Level& top = levels_.back();
+  float x0 = 1e30f, x1 = -1e30f, y0 = 1e30f, y1 = -1e30f, zNear = 1.0f;
+  for (int k = 0; k < 8; ++k) {
+    const glm::vec4 c = clip_ * glm::vec4(corner(box, k), 1.0f);
+    if (c.w <= 1e-6f || c.z < -c.w) return false;   // crosses the near plane
+    const float iw = 1.0f / c.w;
+    const float x = (c.x * iw * 0.5f + 0.5f) * float(w_), y = (c.y * iw * 0.5f + 0.5f) * float(h_);
+    x0 = std::min(x0, x); x1 = std::max(x1, x);
+    y0 = std::min(y0, y); y1 = std::max(y1, y);
+    zNear = std::min(zNear, c.z * iw * 0.5f + 0.5f);
+  }
+  if (levels_.size() > 1 && zNear <= top.minZ[0]) return false;   // in front of every occluder
+  if (x1 < 0.0f || y1 < 0.0f || x0 >= float(w_) || y0 >= float(h_)) return false;
+  const int px0 = std::max(0, int(std::floor(x0))), px1 = std::min(w_ - 1, int(std::floor(x1)));
+  const int py0 = std::max(0, int(std::floor(y0))), py1 = std::min(h_ - 1, int(std::floor(y1)));
+
+  // Start at the coarsest level with a few texels per side; a texel's max depth
+  // bounds every pixel under it, and one that fails is retried at the level below
+  int l = 0;
+  while (l + 1 < int(levels_.size()) && ((px1 >> l) - (px0 >> l) >= 4 || (py1 >> l) - (py0 >> l) >= 4)) ++l;
+  for (int y = py0 >> l; y <= py1 >> l; ++y)
+    for (int x = px0 >> l; x <= px1 >> l; ++x)
+      if (!behind(l, x, y, px0, px1, py0, py1, zNear)) return false;
+  return true;
+}
+
+bool OcclusionBuffer::behind(int l, int x, int y, int px0, int px1, int py0, int py1, float z) const {
+  const Level& L = levels_[std::size_t(l)];
+  if (L.maxZ[std::size_t(y) * std::size_t(L.w) + std::size_t(x)] < z) return true;
+  if (l == 0) return false;
+  // Children of (x, y) that overlap the pixel rectangle
+  const int c = l - 1;
+  for (int cy = std::max(2 * y, py0 >> c); cy <= std::min(2 * y + 1, py1 >> c); ++cy)
+    for (int cx = std::max(2 * x, px0 >> c); cx <= std::min(2 * x + 1, px1 >> c); ++cx)
+      if (!behind(c, cx, cy, px0, px1, py0, py1, z)) return false;
+  return true;
+}
+
+} // namespace vxl
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "chunk.hpp"
+#include "thread_pool.hpp"
+
+/** @file occlusion.hpp
+ *  @brief CPU software occlusion culling: occluder boxes rasterized into a small
+ *         depth buffer with a min/max hierarchy, then box-vs-depth tests.
+ */
+
+namespace vxl {
+
+/// Axis-aligned box in world (or store-local) units.
+struct Box3 {
+  glm::vec3 lo{0.0f}, hi{0.0f};
+};
+
+/// Voxels per sub-brick edge that occluder_boxes tests for being solid.
+constexpr int OCCLUDER_BRICK = 4;
+
+/// Solid interior of chunk cc as boxes: sub-bricks of OCCLUDER_BRICK^3 voxels
+/// all holding axis-aligned cubes, merged greedily (x, then y, then z) into as
+/// few boxes as possible. Appended to `out` in store-local units (voxel k spans
+/// [k - 0.5, k + 0.5]).
+void occluder_boxes(const Chunk& ch, const IVec3& cc, std::vector<Box3>& out);
+
+/** @brief Low-resolution depth buffer of occluders, for testing boxes against.
+ *
+ *  Depth is window z (0 near .. 1 far) of a GL clip matrix; row 0 is the bottom
+ *  of the screen. Occluder boxes are drawn as their front-facing triangles,
+ *  clipped at the near plane, keeping the nearest depth per pixel sample. The
+ *  screen is split into bands rasterized in parallel. A min/max pyramid then
+ *  lets occluded() test a box of any size against a handful of texels.
+ *  Pixel coverage is sampled at pixel centres, so an occluder edge may hide
+ *  up to half a buffer pixel more than it covers.
+ */
+class OcclusionBuffer {
+public:
+  explicit OcclusionBuffer(int width = 256, int height = 128);
+  void resize(int width, int height);
+  int width() const noexcept { return w_; }
+  int height() const noexcept { return h_; }
+
+  /// Clear to far and use `clip` (= P * V) for what follows.
+  void begin(const glm::mat4& clip);
+  /// Draw boxes as occluders, then rebuild the hierarchy. Uses pool's workers
+  /// (and the calling thread) if given.
+  void rasterize(std::span<const Box3> boxes, ThreadPool* pool = nullptr);
+  /// True if every point of the box lies behind occluders drawn since begin().
+  /// Boxes crossing the near plane or leaving the screen are never occluded.
+  bool occluded(const Box3& box) const;
+
+  /// Depth at a pixel of the full-resolution level.
+  float depth(int x, int y) const { return levels_[0].maxZ[std::size_t(y) * std::size_t(w_) + std::size_t(x)]; }
+
+private:
+  struct Level {
+    int w = 0, h = 0;
+    std::vector<float> minZ, maxZ;   ///< level 0 holds depth in maxZ only
+  };
+  /// A clipped, projected occluder triangle: window x, y, z per corner.
+  struct Tri {
+    glm::vec3 v[3];
+    int y0, y1;   ///< pixel rows it may touch
+  };
+
+  int w_ = 0, h_ = 0;
+  glm::mat4 clip_{1.0f};
+  std::vector<Level> levels_;
+  std::vector<Tri> tris_;
+
+  void setup(std::span<const Box3> boxes);
+  void raster_band(int y0, int y1);
+  void build_hierarchy();
+  /// Whether every pixel of texel (x, y) of level l inside [px0, px1] x [py0, py1]
+  /// holds an occluder nearer than depth z.
+  bool behind(int l, int x, int y, int px0, int px1, int py0, int py1, float z) const;
+};
+
+} // namespace vxl
@@ -0,0 +1,135 @@
+#include "orientation.hpp"
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace vxl {
+
+namespace {
+
+struct Tables {
+  std::array<glm::mat3, Orientation::COUNT> mats;
+  std::array<glm::quat, Orientation::COUNT> quats;
+  std::array<std::array<uint8_t, Orientation::COUNT>, Orientation::COUNT> compose;
+  std::array<uint8_t, Orientation::COUNT> inverse;
+  std::array<std::array<int8_t, 9>, Orientation::COUNT> ints;   // column-major, like mats
+
+  Tables() {
+    // Signed permutation matrices with det +1, identity first: column j is ±e_perm[j].
+    const int perms[6][3] = {{0,1,2},{0,2,1},{1,0,2},{1,2,0},{2,0,1},{2,1,0}};
+    const int parity[6] = {+1,-1,-1,+1,+1,-1};
+    int n = 0;
+    for (int p = 0; p < 6; ++p) {
+      for (int s = 0; s < 8; ++s) {
+        int sx = (s & 1) ? -1 : 1, sy = (s & 2) ? -1 : 1, sz = (s & 4) ? -1 : 1;
+        if (parity[p] * sx * sy * sz != 1) continue;
+        glm::mat3 m(0.0f);
+        m[0][perms[p][0]] = float(sx);
+        m[1][perms[p][1]] = float(sy);
+        m[2][perms[p][2]] = float(sz);
+        mats[n] = m;
+        for (int c = 0; c < 3; ++c) for (int r = 0; r < 3; ++r) ints[n][c*3 + r] = int8_t(m[c][r]);
+        quats[n] = glm::normalize(glm::quat_cast(m));
+        ++n;
+      }
+    }
+    for (int a = 0; a < Orientation::COUNT; ++a) {
+      for (int b = 0; b < Orientation::COUNT; ++b) {
+        compose[a][b] = *match(mats[a] * mats[b]);
+        if (compose[a][b] == 0) inverse[a] = uint8_t(b);
+      }
+    }
+  }
+
+  std::optional<uint8_t> match(const glm::mat3& m, float eps = 1e-3f) const {
+    for (int c = 0; c < Orientation::COUNT; ++c) {
+      bool same = true;
+      for (int i = 0; i < 3 && same; ++i)
+        for (int j = 0; j < 3 && same; ++j)
+          same = std::abs(m[i][j] - mats[c][i][j]) <= eps;
+      if (same) return uint8_t(c);
+    }
+    return std::nullopt;
+  }
+};
+
+const Tables& tables() {
+  static const Tables t;
+  return t;
+}
+
+} // namespace
+
+const glm::mat3& orientation_matrix(uint8_t code) { return tables().mats[code]; }
+const glm::quat& orientation_quat(uint8_t code) { return tables().quats[code]; }
+uint8_t orientation_compose(uint8_t a, uint8_t b) { return tables().compose[a][b]; }
+uint8_t orientation_inverse(uint8_t code) { return tables().inverse[code]; }
+
+IVec3 orientation_apply(uint8_t code, const IVec3& v) {
+  const auto& m = tables().ints[code];
+  return {m[0]*v.x + m[3]*v.y + m[6]*v.z,
+          m[1]*v.x + m[4]*v.y + m[7]*v.z,
+          m[2]*v.x + m[5]*v.y + m[8]*v.z};
+}
+
+std::optional<uint8_t> orientation_from_matrix(const glm::mat3& m, float eps) {
+  return tables().match(m, eps);
+}
+
+std::optional<uint8_t> snap_orientation(const glm::quat& q, float eps) {
+  return tables().match(glm::mat3_cast(glm::normalize(q)), eps);
+}
+
+// ----- RotationTable -----
+
+RotationTable::QuatKey RotationTable::key_of(const glm::quat& q) {
+  // q and -q are the same rotation; pick the representative with w >= 0
+  glm::quat c = (q.w < 0.0f) ? -q : q;
+  QuatKey k;
+  float f[4] = {c.x, c.y, c.z, c.w};
+  std::memcpy(k.bits, f, sizeof f);
+  return k;
+}
+
+std::size_t RotationTable::QuatKeyHasher::operator()(const QuatKey& k) const noexcept {
+  std::size_t h = 1469598103934665603ull;
+  for (uint32_t b : k.bits) h ^= b + 0x9e3779b97f4a7c15ull + (h<<6) + (h>>2);
+  return h;
+}
+
+uint32_t RotationTable::intern(const glm::quat& q) {
+  glm::quat n = glm::normalize(q);
+  QuatKey key = key_of(n);
+  auto it = index_.find(key);
+  if (it != index_.end()) return it->second;
+  uint32_t slot;
+  if (!free_.empty()) {
+    slot = free_.back(); free_.pop_back();
+    quats_[slot] = n; mats_[slot] = glm::mat3_cast(n); live_[slot] = true;
+  } else {
+    slot = uint32_t(quats_.size());
+    quats_.push_back(n); mats_.push_back(glm::mat3_cast(n)); live_.push_back(true);
+  }
+  index_.emplace(key, slot);
+  ++version_;
+  return slot;
+}
+
+std::size_t RotationTable::collect(const std::vector<bool>& used) {
+  std::size_t freed = 0;
+  for (std::size_t i = 0; i < quats_.size(); ++i) {
+    if (!live_[i] || (i < used.size() && used[i])) continue;
+    index_.erase(key_of(quats_[i]));
+    live_[i] = false;
+    free_.push_back(uint32_t(i));
+    ++freed;
+  }
+  return freed;
+}
+
+void RotationTable::clear() {
+  quats_.clear(); mats_.clear(); live_.clear(); free_.clear(); index_.clear();
+  ++version_;
+}
+
+} // namespace vxl
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "util.hpp"
+
+/** @file orientation.hpp
+ *  @brief One-byte cube orientations (the 24 axis-aligned rotations) and the
+ *         side table that holds the rare arbitrary ones.
+ */
+
+namespace vxl {
+
+/** @brief Packed orientation code. 0..23 index the axis-aligned rotations
+ *         (0 = identity); FREE means "see the cube's side-table slot".
+ */
+struct Orientation {
+  static constexpr uint8_t COUNT = 24;
+  static constexpr uint8_t FREE  = 0xFF;
+
+  uint8_t code = 0;
+
+  bool axis_aligned() const noexcept { return code < COUNT; }
+  bool operator==(const Orientation&) const = default;
+};
+
+/// Rotation matrix of an axis-aligned code (entries are exactly 0/±1).
+const glm::mat3& orientation_matrix(uint8_t code);
+/// Quaternion of an axis-aligned code.
+const glm::quat& orientation_quat(uint8_t code);
+/// Exact integer rotation of v by an axis-aligned code.
+IVec3 orientation_apply(uint8_t code, const IVec3& v);
+/// Code of a*b (apply b, then a).
+uint8_t orientation_compose(uint8_t a, uint8_t b);
+/// Code of the inverse rotation.
+uint8_t orientation_inverse(uint8_t code);
+/// Axis-aligned code for q if every matrix entry is within eps of 0/±1.
+std::optional<uint8_t> snap_orientation(const glm::quat& q, float eps = 1e-3f);
+/// Axis-aligned code for an exact signed-permutation matrix, if it is one.
+std::optional<uint8_t> orientation_from_matrix(const glm::mat3& m, float eps = 1e-3f);
+
+/** @brief Interning table of arbitrary (non axis-aligned) rotations, with a
+ *         cached matrix per entry so renderers never convert quaternions.
+ */
+class RotationTable {
+public:
+  /// Slot of an identical rotation, or a new one.
+  uint32_t intern(const glm::quat& q);
+  const glm::quat& quat(uint32_t slot) const { return quats_[slot]; }
+  const glm::mat3& matrix(uint32_t slot) const { return mats_[slot]; }
+
+  /// Live entries / allocated slots.
+  std::size_t size() const noexcept { return index_.size(); }
+  std::size_t slots() const noexcept { return quats_.size(); }
+
+  /// Free every slot not flagged in `used`. Returns the number released.
+  std::size_t collect(const std::vector<bool>& used);
+  void clear();
+
+  /// Bumped whenever a slot is (re)filled, for caches of the table (GPU copies).
+  uint64_t version() const noexcept { return version_; }
+
+private:
+  struct QuatKey {
+    uint32_t bits[4];
+    bool operator==(const QuatKey&) const = default;
+  };
+  struct QuatKeyHasher { std::size_t operator()(const QuatKey& k) const noexcept; };
+  static QuatKey key_of(const glm::quat& q);
+
+  std::vector<glm::quat> quats_;
+  std::vector<glm::mat3> mats_;
+  std::vector<bool> live_;
+  std::vector<uint32_t> free_;
+  std::unordered_map<QuatKey, uint32_t, QuatKeyHasher> index_;
+  uint64_t version_ = 1;
+};
+
+} // namespace vxl
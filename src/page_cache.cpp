@@ -0,0 +1,142 @@
+#include "page_cache.hpp"
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <stdexcept>
+
+namespace vxl {
+
+namespace {
+constexpr int MIN_CLASS = 9;   // 512-byte extents at least
+
+uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+uint64_t record_bytes(uint64_t count) { return align8(count * sizeof(uint16_t)) + count * sizeof(Cube); }
+} // namespace
+
+// ----- PageFile -----
+
+PageFile::PageFile(std::string path) : path_(std::move(path)) {
+  io_.open(path_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!io_) throw std::runtime_error("Cannot create page file: " + path_);
+}
+
+PageFile::~PageFile() {
+  io_.close();
+  std::error_code ec;
+  std::filesystem::remove(path_, ec);
+}
+
+uint32_t PageFile::write(const Chunk& c) {
+  idx_.clear(); vox_.clear();
+  c.for_each([&](int i, const Cube& cube){
+    idx_.push_back(uint16_t(i));
+    vox_.push_back(cube);
+    if (cube.mat >= mats_.size()) mats_.resize(cube.mat + 1, false);
+    mats_[cube.mat] = true;
+    if (!cube.rotation.axis_aligned()) {
+      if (cube.freeRot >= rots_.size()) rots_.resize(cube.freeRot + 1, false);
+      rots_[cube.freeRot] = true;
+    }
+  });
+  const uint64_t bytes = record_bytes(idx_.size());
+  const int cls = std::max(MIN_CLASS, int(std::bit_width(std::max<uint64_t>(bytes, 1) - 1)));
+  if (freeExtents_.size() <= std::size_t(cls)) freeExtents_.resize(cls + 1);
+
+  Record r;
+  r.count = uint32_t(idx_.size());
+  r.cls = uint8_t(cls);
+  if (!freeExtents_[cls].empty()) {
+    r.offset = freeExtents_[cls].back();
+    freeExtents_[cls].pop_back();
+  } else {
+    r.offset = end_;
+    end_ += uint64_t(1) << cls;
+  }
+  io_.seekp(std::streamoff(r.offset));
+  io_.write(reinterpret_cast<const char*>(idx_.data()), std::streamsize(idx_.size() * sizeof(uint16_t)));
+  io_.seekp(std::streamoff(r.offset + align8(idx_.size() * sizeof(uint16_t))));
+  io_.write(reinterpret_cast<const char*>(vox_.data()), std::streamsize(vox_.size() * sizeof(Cube)));
+  if (!io_) {
+    io_.clear();
+    freeExtents_[cls].push_back(r.offset);
+    throw std::runtime_error("Page file write failed: " + path_);
+  }
+
+  uint32_t id;
+  if (!freeIds_.empty()) { id = freeIds_.back(); freeIds_.pop_back(); records_[id] = r; }
+  else { id = uint32_t(records_.size()); records_.push_back(r); }
+  ++live_;
+  return id;
+}
+
+void PageFile::release(uint32_t id) {
+  const Record& r = records_[id];
+  freeExtents_[r.cls].push_back(r.offset);
+  freeIds_.push_back(id);
+  if (--live_ == 0) {
+    // Nothing left: start over, including the usage flags
+    records_.clear(); freeIds_.clear(); freeExtents_.clear();
+    mats_.clear(); rots_.clear();
+    end_ = 0;
+  }
+}
+
+void PageFile::load(uint32_t id, Chunk& out) {
+  const Record& r = records_[id];
+  idx_.resize(r.count);
+  vox_.resize(r.count);
+  io_.seekg(std::streamoff(r.offset));
+  io_.read(reinterpret_cast<char*>(idx_.data()), std::streamsize(idx_.size() * sizeof(uint16_t)));
+  io_.seekg(std::streamoff(r.offset + align8(idx_.size() * sizeof(uint16_t))));
+  io_.read(reinterpret_cast<char*>(vox_.data()), std::streamsize(vox_.size() * sizeof(Cube)));
+  if (!io_) {
+    io_.clear();
+    throw std::runtime_error("Page file read failed: " + path_);
+  }
+  out.set_sorted(idx_, vox_);
+}
+
+void PageFile::mark_used(std::vector<bool>& materials, std::vector<bool>& rotations) const {
+  for (std::size_t i = 0; i < std::min(mats_.size(), materials.size()); ++i) if (mats_[i]) materials[i] = true;
+  for (std::size_t i = 0; i < std::min(rots_.size(), rotations.size()); ++i) if (rots_[i]) rotations[i] = true;
+}
+
+// ----- ChunkPager -----
+
+ChunkPager::ChunkPager(std::size_t budgetBytes, std::string pagePath)
+  : budget_(budgetBytes), file_(std::move(pagePath)) {}
+
+std::size_t ChunkPager::resident_bytes(std::span<const ChunkStore* const> stores) {
+  std::size_t total = 0;
+  for (auto* s : stores) s->for_each_resident_use([&](const IVec3&, uint64_t, std::size_t bytes){ total += bytes; });
+  return total;
+}
+
+std::size_t ChunkPager::trim(std::span<const ChunkStore* const> stores) {
+  std::size_t total = resident_bytes(stores);
+  if (total <= budget_) return 0;
+
+  struct Candidate { uint32_t store; IVec3 cc; std::size_t bytes; };
+  std::vector<Candidate> cands;
+  std::vector<KeyIndex> order;
+  for (uint32_t si = 0; si < stores.size(); ++si) {
+    stores[si]->for_each_resident_use([&](const IVec3& cc, uint64_t used, std::size_t bytes){
+      order.push_back({used, uint32_t(cands.size())});
+      cands.push_back({si, cc, bytes});
+    });
+  }
+  radix_sort(order);   // oldest stamp first
+
+  const auto target = std::size_t(double(budget_) * LOW_WATER);
+  std::size_t n = 0;
+  for (auto& o : order) {
+    if (total <= target) break;
+    const Candidate& c = cands[o.index];
+    if (!stores[c.store]->evict(c.cc)) continue;
+    total -= c.bytes;
+    ++n;
+  }
+  return n;
+}
+
+} // namespace vxl
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+#include "chunk.hpp"
+
+/** @file page_cache.hpp
+ *  @brief Out-of-core chunks: a scratch page file and an LRU pager that evicts
+ *         cold chunks under a memory budget (see Universe::enable_paging).
+ */
+
+namespace vxl {
+
+/** @brief Process-private file of evicted chunks. Records are raw Cube arrays
+ *         (valid only in this process), kept in power-of-two size classes whose
+ *         freed extents are reused. The file is deleted on destruction.
+ */
+class PageFile : public IChunkSource {
+public:
+  /// Create (truncate) `path`. Throws std::runtime_error if it cannot be opened.
+  explicit PageFile(std::string path);
+  ~PageFile() override;
+  PageFile(const PageFile&) = delete;
+  PageFile& operator=(const PageFile&) = delete;
+
+  /// Store a copy of c; returns its record id.
+  uint32_t write(const Chunk& c);
+  /// Free a record written earlier.
+  void release(uint32_t id);
+
+  void load(uint32_t id, Chunk& out) override;
+  /// Conservative: everything any record held since the file was last empty.
+  void mark_used(std::vector<bool>& materials, std::vector<bool>& rotations) const override;
+
+  const std::string& path() const noexcept { return path_; }
+  std::size_t records() const noexcept { return live_; }
+  std::size_t file_bytes() const noexcept { return std::size_t(end_); }
+
+private:
+  struct Record {
+    uint64_t offset = 0;
+    uint32_t count = 0;
+    uint8_t cls = 0;        ///< extent is 1 << cls bytes
+  };
+
+  std::string path_;
+  std::fstream io_;
+  std::vector<Record> records_;
+  std::vector<uint32_t> freeIds_;
+  std::vector<std::vector<uint64_t>> freeExtents_;   ///< by size class
+  uint64_t end_ = 0;
+  std::size_t live_ = 0;
+  std::vector<bool> mats_, rots_;
+  std::vector<uint16_t> idx_;   ///< scratch
+  std::vector<Cube> vox_;
+};
+
+/// Pager counters since the last reset.
+struct PageStats {
+  uint64_t hits = 0;        ///< accesses to a resident chunk
+  uint64_t misses = 0;      ///< chunks faulted in from a snapshot or the page file
+  uint64_t evictions = 0;
+  uint64_t writebacks = 0;  ///< evictions that had to write the chunk out
+};
+
+/** @brief Keeps the resident chunks of a set of stores under a byte budget.
+ *
+ *  Stores stamp each chunk with the pager clock whenever it is accessed; trim()
+ *  evicts in stamp order (least recently used first) down to LOW_WATER of the
+ *  budget, so a burst of faults is paid for in one sort. Eviction invalidates
+ *  references into chunks, so trim() only runs at points where none are held.
+ */
+class ChunkPager {
+public:
+  static constexpr double LOW_WATER = 0.75;
+
+  ChunkPager(std::size_t budgetBytes, std::string pagePath);
+
+  std::size_t budget() const noexcept { return budget_; }
+  void set_budget(std::size_t bytes) noexcept { budget_ = bytes; }
+
+  PageFile& file() noexcept { return file_; }
+  const PageFile& file() const noexcept { return file_; }
+  PageStats& stats() noexcept { return stats_; }
+  const PageStats& stats() const noexcept { return stats_; }
+  void reset_stats() noexcept { stats_ = {}; }
+
+  /// Next access stamp.
+  uint64_t tick() noexcept { return ++clock_; }
+
+  /// Resident chunk bytes of the given stores.
+  static std::size_t resident_bytes(std::span<const ChunkStore* const> stores);
+  /// If the stores' resident chunks exceed the budget, evict the least recently
+  /// used ones until they fit LOW_WATER of it. Returns the number evicted.
+  std::size_t trim(std::span<const ChunkStore* const> stores);
+
+private:
+  std::size_t budget_;
+  PageFile file_;
+  PageStats stats_;
+  uint64_t clock_ = 0;
+};
+
+} // namespace vxl
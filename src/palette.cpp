@@ -0,0 +1,86 @@
+#include "palette.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace vxl {
+
+namespace {
+
+/// Bits a component is compared and hashed by: -0 counts as +0, and a NaN equals
+/// a NaN with the same bits, so equality and the hash agree.
+uint32_t key_bits(float f) noexcept {
+  if (f == 0.0f) f = 0.0f;
+  uint32_t u; std::memcpy(&u, &f, sizeof u);
+  return u;
+}
+
+template <class F> void for_each_component(const Material& m, F&& fn) {
+  for (int i=0;i<4;i++) fn(m.colorA[i]);
+  for (int i=0;i<4;i++) fn(m.colorB[i]);
+  for (int i=0;i<3;i++) fn(m.gradDir[i]);
+}
+
+} // namespace
+
+bool operator==(const Material& a, const Material& b) noexcept {
+  if (a.kind != b.kind) return false;
+  uint32_t ka[11], kb[11];
+  int n = 0;
+  for_each_component(a, [&](float f){ ka[n++] = key_bits(f); });
+  n = 0;
+  for_each_component(b, [&](float f){ kb[n++] = key_bits(f); });
+  return std::memcmp(ka, kb, sizeof ka) == 0;
+}
+
+std::size_t MaterialHasher::operator()(const Material& m) const noexcept {
+  std::size_t h = 1469598103934665603ull;
+  auto mix = [&](uint32_t u) { h ^= u + 0x9e3779b97f4a7c15ull + (h<<6) + (h>>2); };
+  mix(uint32_t(m.kind));
+  for_each_component(m, [&](float f){ mix(key_bits(f)); });
+  return h;
+}
+
+MaterialPalette::MaterialPalette() { clear(); }
+
+MaterialId MaterialPalette::intern(const Material& m) {
+  auto it = index_.find(m);
+  if (it != index_.end()) return it->second;
+  MaterialId id;
+  if (!free_.empty()) {
+    id = free_.back(); free_.pop_back();
+    entries_[id] = m; live_[id] = true;
+  } else {
+    if (entries_.size() >= MAX_ENTRIES)
+      throw std::length_error("material palette full (65536 entries); try 'palette gc'");
+    id = MaterialId(entries_.size());
+    entries_.push_back(m); live_.push_back(true);
+  }
+  index_.emplace(m, id);
+  ++version_;
+  return id;
+}
+
+std::size_t MaterialPalette::collect(const std::vector<bool>& used) {
+  std::size_t freed = 0;
+  for (std::size_t i = 1; i < entries_.size(); ++i) {
+    if (!live_[i] || (i < used.size() && used[i])) continue;
+    index_.erase(entries_[i]);
+    entries_[i] = Material{};
+    live_[i] = false;
+    free_.push_back(MaterialId(i));
+    ++freed;
+  }
+  if (freed) ++version_;
+  return freed;
+}
+
+void MaterialPalette::clear() {
+  entries_.assign(1, Material{});
+  live_.assign(1, true);
+  free_.clear();
+  index_.clear();
+  index_.emplace(Material{}, MaterialId(0));
+  ++version_;
+}
+
+} // namespace vxl
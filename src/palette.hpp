@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "cube.hpp"
+
+/** @file palette.hpp
+ *  @brief Deduplicated material table; cubes refer to entries by 16-bit index.
+ */
+
+namespace vxl {
+
+/// Component-wise, with -0 equal to +0 and NaNs equal when their bits are (so
+/// every material, NaN or not, equals itself and interns once).
+bool operator==(const Material& a, const Material& b) noexcept;
+
+struct MaterialHasher {
+  std::size_t operator()(const Material& m) const noexcept;
+};
+
+/** @brief Interning table of materials. Slot 0 always holds the default Material. */
+class MaterialPalette {
+public:
+  static constexpr std::size_t MAX_ENTRIES = 65536;
+
+  MaterialPalette();
+
+  /// Index of an identical entry, or a new one. Throws std::length_error when all slots are live.
+  MaterialId intern(const Material& m);
+  /// Material for an index (freed slots read as the default material).
+  const Material& get(MaterialId id) const { return entries_[id]; }
+
+  /// Live entries / allocated slots (live + free).
+  std::size_t size() const noexcept { return index_.size(); }
+  std::size_t slots() const noexcept { return entries_.size(); }
+
+  /// Free every slot whose flag in `used` is false (slot 0 is kept). Indices of
+  /// surviving entries do not change; freed slots are reused by later intern().
+  /// Returns the number of entries released.
+  std::size_t collect(const std::vector<bool>& used);
+
+  void clear();
+
+  /// Bumped whenever an entry's content changes, for caches of the table (GPU copies).
+  uint64_t version() const noexcept { return version_; }
+
+private:
+  std::vector<Material> entries_;
+  std::vector<bool> live_;
+  std::vector<MaterialId> free_;
+  std::unordered_map<Material, MaterialId, MaterialHasher> index_;
+  uint64_t version_ = 0;
+};
+
+} // namespace vxl
@@ -0,0 +1,124 @@
+#include "program_cache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace vxl {
+
+namespace {
+
+constexpr char MAGIC[4] = {'V', 'X', 'P', 'B'};
+constexpr uint32_t VERSION = 1;
+
+#pragma pack(push, 1)
+struct BinaryHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t size;
+  uint64_t checksum;   ///< fnv1a64 of the data
+};
+#pragma pack(pop)
+
+} // namespace
+
+uint64_t fnv1a64(std::string_view bytes, uint64_t h) {
+  for (unsigned char c : bytes) {
+    h ^= c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+uint64_t program_key(std::span<const std::string_view> sources, std::string_view driver) {
+  // Lengths first, so moving text from one stage to the next changes the key
+  auto length = [](uint64_t h, std::size_t n) {
+    const uint64_t v = n;
+    return fnv1a64(std::string_view(reinterpret_cast<const char*>(&v), sizeof v), h);
+  };
+  uint64_t h = length(fnv1a64(driver), driver.size());
+  for (std::string_view s : sources) h = fnv1a64(s, length(h, s.size()));
+  return h;
+}
+
+std::string ProgramCache::path_of(uint64_t key) const {
+  char name[24];
+  std::snprintf(name, sizeof name, "%016llx.bin", static_cast<unsigned long long>(key));
+  return (std::filesystem::path(dir_) / name).string();
+}
+
+std::optional<ProgramBinary> ProgramCache::load(uint64_t key) const {
+  if (!enabled()) return std::nullopt;
+  std::ifstream f(path_of(key), std::ios::binary);
+  BinaryHeader h{};
+  if (!f.read(reinterpret_cast<char*>(&h), sizeof h)) return std::nullopt;
+  if (std::memcmp(h.magic, MAGIC, sizeof MAGIC) != 0 || h.version != VERSION || h.key != key) return std::nullopt;
+  ProgramBinary b;
+  b.format = h.format;
+  b.data.resize(h.size);
+  if (!f.read(b.data.data(), std::streamsize(h.size))) return std::nullopt;
+  if (fnv1a64(std::string_view(b.data.data(), b.data.size())) != h.checksum) return std::nullopt;
+  return b;
+}
+
+bool ProgramCache::save(uint64_t key, const ProgramBinary& b) const {
+  if (!enabled() || b.data.size() > UINT32_MAX) return false;
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  const std::string path = path_of(key), tmp = path + ".tmp";
+  BinaryHeader h{};
+  std::memcpy(h.magic, MAGIC, sizeof MAGIC);
+  h.version = VERSION;
+  h.key = key;
+  h.format = b.format;
+  h.size = uint32_t(b.data.size());
+  h.checksum = fnv1a64(std::string_view(b.data.data(), b.data.size()));
+  {
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    f.write(reinterpret_cast<const char*>(&h), sizeof h);
+    f.write(b.data.data(), std::streamsize(b.data.size()));
+    if (!f.flush()) {
+      f.close();
+      std::filesystem::remove(tmp, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) std::filesystem::remove(tmp, ec);
+  return !ec;
+}
+
+void ProgramCache::erase(uint64_t key) const {
+  if (!enabled()) return;
+  std::error_code ec;
+  std::filesystem::remove(path_of(key), ec);
+}
+
+FileWatcher::Seen FileWatcher::stat(const std::string& path) {
+  Seen s;
+  std::error_code ec;
+  s.time = std::filesystem::last_write_time(path, ec);
+  if (ec) return {};
+  s.bytes = std::filesystem::file_size(path, ec);
+  if (ec) return {};
+  s.exists = true;
+  return s;
+}
+
+void FileWatcher::watch(const std::string& path) {
+  files_.try_emplace(path, stat(path));
+}
+
+std::vector<std::string> FileWatcher::poll() {
+  std::vector<std::string> changed;
+  for (auto& [path, seen] : files_) {
+    const Seen now = stat(path);
+    if (now == seen) continue;
+    seen = now;
+    changed.push_back(path);
+  }
+  return changed;
+}
+
+} // namespace vxl
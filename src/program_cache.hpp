@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** @file program_cache.hpp
+ *  @brief What the shader cache keeps on disk, without GL: linked program
+ *         binaries keyed by a hash of their sources and the driver, and a
+ *         watcher telling when shader sources change.
+ */
+
+namespace vxl {
+
+/// 64-bit FNV-1a of `bytes`, continuing from `h`.
+uint64_t fnv1a64(std::string_view bytes, uint64_t h = 0xcbf29ce484222325ull);
+
+/// Cache key of a program linked from `sources` (in stage order) by the driver
+/// identified by `driver` (vendor, renderer and version strings). Any change to
+/// either gives another key.
+uint64_t program_key(std::span<const std::string_view> sources, std::string_view driver);
+
+/// A linked program as the driver hands it out (glGetProgramBinary).
+struct ProgramBinary {
+  uint32_t format = 0;      ///< driver-specific binary format enum
+  std::vector<char> data;
+};
+
+/** @brief Directory of program binaries, one file per key.
+ *
+ *  File: "VXPB", uint32 version, uint64 key, uint32 format, uint32 size,
+ *  uint64 FNV-1a of the data, then the data. Files are written to a temporary
+ *  name and renamed into place, so a crash never leaves half a binary under a
+ *  key. Anything unreadable counts as a miss: the cache only saves time.
+ */
+class ProgramCache {
+public:
+  /// Binaries under `dir` (created on the first save); an empty dir disables the cache.
+  explicit ProgramCache(std::string dir = {}) : dir_(std::move(dir)) {}
+
+  bool enabled() const noexcept { return !dir_.empty(); }
+  const std::string& dir() const noexcept { return dir_; }
+  std::string path_of(uint64_t key) const;
+
+  /// The binary stored under key, if there is an intact one.
+  std::optional<ProgramBinary> load(uint64_t key) const;
+  /// Store b under key, replacing what was there. Returns false if it could not
+  /// be written.
+  bool save(uint64_t key, const ProgramBinary& b) const;
+  /// Forget the binary under key (one the driver refused, say).
+  void erase(uint64_t key) const;
+
+private:
+  std::string dir_;
+};
+
+/** @brief Polls files for changes to their modification time or size.
+ *
+ *  Portable and cheap for the few files it is meant for (one stat each per poll).
+ *  A file that disappears or reappears counts as changed.
+ */
+class FileWatcher {
+public:
+  /// Start watching path (from its current state); watching it again does nothing.
+  void watch(const std::string& path);
+  /// Paths that changed since they were watched or last reported.
+  std::vector<std::string> poll();
+  std::size_t size() const noexcept { return files_.size(); }
+
+private:
+  struct Seen {
+    std::filesystem::file_time_type time{};
+    std::uintmax_t bytes = 0;
+    bool exists = false;
+    bool operator==(const Seen&) const = default;
+  };
+  std::unordered_map<std::string, Seen> files_;
+
+  static Seen stat(const std::string& path);
+};
+
+} // namespace vxl
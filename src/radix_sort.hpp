@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/** @file radix_sort.hpp
+ *  @brief LSD radix sort for (64-bit key, 32-bit payload) records.
+ */
+
+namespace vxl {
+
+struct KeyIndex {
+  uint64_t key;
+  uint32_t index;
+};
+
+/// Stable sort by key, 11 bits per pass. Digits on which every key agrees are
+/// skipped, so clustered keys (same high bits) cost only a few passes.
+inline void radix_sort(std::vector<KeyIndex>& a) {
+  constexpr int BITS = 11, PASSES = (64 + BITS - 1) / BITS;
+  constexpr uint64_t MASK = (1u << BITS) - 1;
+  const std::size_t n = a.size();
+  if (n < 2) return;
+  std::vector<std::array<uint32_t, 1u << BITS>> hist(PASSES);
+  bool sorted = true;
+  for (std::size_t i = 0; i < n; ++i) {
+    uint64_t k = a[i].key;
+    for (int d = 0; d < PASSES; ++d) ++hist[d][(k >> (BITS * d)) & MASK];
+    if (i && a[i - 1].key > k) sorted = false;
+  }
+  if (sorted) return;
+  std::vector<KeyIndex> tmp(n);
+  for (int d = 0; d < PASSES; ++d) {
+    auto& h = hist[d];
+    if (h[(a[0].key >> (BITS * d)) & MASK] == n) continue;  // all keys share this digit
+    uint32_t sum = 0;
+    for (auto& c : h) { uint32_t t = c; c = sum; sum += t; }
+    for (std::size_t i = 0; i < n; ++i) tmp[h[(a[i].key >> (BITS * d)) & MASK]++] = a[i];
+    a.swap(tmp);
+  }
+}
+
+} // namespace vxl
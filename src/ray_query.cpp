@@ -0,0 +1,515 @@
+#include "ray_query.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include "morton_map.hpp"
+#include "orientation.hpp"
+#include "world_snapshot.hpp"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VXL_RAY_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace vxl {
+
+namespace {
+
+/// Half the edge of the Morton key range of Universe::in_world.
+constexpr double WORLD_LIMIT = double(1 << 20);
+/// Rays per cast_rays job.
+constexpr std::size_t RAYS_PER_JOB = 512;
+
+/// Ray in the grid space of a store: voxel p fills the cell [p, p + 1).
+struct GridRay {
+  double o[3], d[3];
+  double inv[3];   ///< 1 / d, infinite where d is 0
+  int step[3];     ///< sign of d
+};
+
+GridRay grid_ray(const glm::vec3& o, const glm::vec3& d) {
+  GridRay r{{o.x + 0.5, o.y + 0.5, o.z + 0.5}, {d.x, d.y, d.z}, {}, {}};
+  for (int i = 0; i < 3; ++i) {
+    r.inv[i] = r.d[i] != 0.0 ? 1.0 / r.d[i] : std::numeric_limits<double>::infinity();
+    r.step[i] = r.d[i] > 0.0 ? 1 : r.d[i] < 0.0 ? -1 : 0;
+  }
+  return r;
+}
+
+/// Clip [t0, t1] to where the ray is inside the box [lo, hi); false if empty.
+bool clip(const GridRay& r, const double (&lo)[3], const double (&hi)[3], double& t0, double& t1) {
+  for (int i = 0; i < 3; ++i) {
+    if (r.d[i] == 0.0) {
+      if (r.o[i] < lo[i] || r.o[i] >= hi[i]) return false;
+      continue;
+    }
+    double a = (lo[i] - r.o[i]) * r.inv[i], b = (hi[i] - r.o[i]) * r.inv[i];
+    if (a > b) std::swap(a, b);
+    t0 = std::max(t0, a);
+    t1 = std::min(t1, b);
+  }
+  return t0 <= t1;
+}
+
+/// Where to walk the ray: [0, maxT], inside the world for the world store. False
+/// if that is empty or the ray has no direction.
+bool ray_span(const GridRay& r, float maxT, bool worldBounds, double& t0, double& t1) {
+  if (r.d[0] == 0.0 && r.d[1] == 0.0 && r.d[2] == 0.0) return false;
+  t0 = 0.0;
+  t1 = maxT;
+  if (!worldBounds) return t0 <= t1;
+  constexpr double LO[3] = {-WORLD_LIMIT, -WORLD_LIMIT, -WORLD_LIMIT}, HI[3] = {WORLD_LIMIT, WORLD_LIMIT, WORLD_LIMIT};
+  return clip(r, LO, HI, t0, t1);
+}
+
+/** @brief Amanatides-Woo walk over cells of edge `size`, from t0 to t1.
+ *
+ *  Calls fn(cell, tEnter, tExit, axis) for each cell the ray crosses, in order;
+ *  axis is the one whose face it came in through (-1 for the first cell).
+ *  `lo`/`hi` bound the cells (inclusive), which keeps a start on a cell face in
+ *  the cell the caller expects. Stops when fn returns true, and returns that.
+ */
+template <class Fn>
+bool walk(const GridRay& r, double t0, double t1, double size, const int (&lo)[3], const int (&hi)[3], Fn&& fn) {
+  const int* step = r.step;
+  int cell[3];
+  double tMax[3], tDelta[3];
+  const double perCell = 1.0 / size;
+  for (int i = 0; i < 3; ++i) {
+    const double p = r.o[i] + r.d[i] * t0;
+    cell[i] = std::clamp(int(std::floor(p * perCell)), lo[i], hi[i]);
+    if (step[i] == 0) {
+      tMax[i] = tDelta[i] = std::numeric_limits<double>::infinity();
+    } else {
+      const double edge = (cell[i] + (step[i] > 0 ? 1 : 0)) * size;
+      tMax[i] = (edge - r.o[i]) * r.inv[i];
+      tDelta[i] = size * std::abs(r.inv[i]);
+    }
+  }
+  double t = t0;
+  int axis = -1;
+  for (;;) {
+    const int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+    const double exit = std::min(tMax[a], t1);
+    if (fn(IVec3{cell[0], cell[1], cell[2]}, t, exit, axis)) return true;
+    if (tMax[a] >= t1) return false;
+    cell[a] += step[a];
+    if (cell[a] < lo[a] || cell[a] > hi[a]) return false;
+    t = tMax[a];
+    tMax[a] += tDelta[a];
+    axis = a;
+  }
+}
+
+/** @brief What one query looked up, for the rays after it: chunks by
+ *         coordinate, and the occupancy bits of chunks (one per voxel, and one
+ *         per 8^3 brick that holds any cube).
+ *
+ *  Neighbouring rays cross the same chunks, so most lookups are repeats. Walks
+ *  skip empty bricks and test a voxel with one bit instead of searching a
+ *  sparse chunk. A live store changes chunks in place, so each query starts
+ *  with clear(). One per thread.
+ */
+class QueryCache {
+public:
+  struct Bits {
+    uint64_t bricks = 0;                      ///< bit brick_of(i) for every cube i
+    uint64_t voxels[CHUNK_VOLUME / 64] = {};  ///< bit local_index
+  };
+
+  static int brick_of(int i) { return ((i >> 3) & 3) | ((i >> 6) & 12) | ((i >> 9) & 48); }
+
+  void clear() {
+    byChunk_.clear();
+    for (Found& f : found_) f.store = nullptr;
+  }
+
+  /// Chunk cc of store s, or null.
+  template <class Store> const Chunk* chunk(const Store& s, const IVec3& cc) {
+    const uint32_t h = uint32_t(cc.x) * 73856093u ^ uint32_t(cc.y) * 19349663u ^ uint32_t(cc.z) * 83492791u;
+    Found& f = found_[h % found_.size()];
+    if (f.store != &s || !(f.cc == cc)) f = {&s, cc, lookup(s, cc)};
+    return f.chunk;
+  }
+
+  const Bits& bits(const Chunk& ch) {
+    if (auto it = byChunk_.find(&ch); it != byChunk_.end()) return bits_[it->second];
+    if (byChunk_.size() == MAX_BITS) byChunk_.clear();   // start over rather than track use
+    const std::size_t slot = byChunk_.size();
+    if (slot == bits_.size()) bits_.emplace_back();
+    byChunk_.emplace(&ch, slot);
+    Bits& b = bits_[slot];
+    b.bricks = 0;
+    std::fill(std::begin(b.voxels), std::end(b.voxels), 0);
+    ch.for_each([&](int i, const Cube&) {
+      b.voxels[i >> 6] |= uint64_t(1) << (i & 63);
+      b.bricks |= uint64_t(1) << brick_of(i);
+    });
+    return b;
+  }
+
+private:
+  struct Found {
+    const void* store = nullptr;
+    IVec3 cc{0,0,0};
+    const Chunk* chunk = nullptr;
+  };
+  static constexpr std::size_t MAX_BITS = 256;          ///< 1 MB of bitmaps per thread at most
+  std::vector<Bits> bits_;                               ///< slots, reused after clear()
+  std::unordered_map<const Chunk*, std::size_t> byChunk_;
+  std::vector<Found> found_ = std::vector<Found>(1024);  ///< direct-mapped by coordinate
+
+  static const Chunk* lookup(const ChunkStore& s, const IVec3& cc) { return s.has_chunk(cc) ? s.chunk(cc) : nullptr; }
+  static const Chunk* lookup(const StoreSnapshot& s, const IVec3& cc) { return s.chunk(cc); }
+};
+
+QueryCache& query_cache() {
+  thread_local QueryCache cache;
+  return cache;
+}
+
+/// First cube of chunk ch (at cc) the ray enters over [tIn, tOut]; axisIn is the
+/// axis of the face it entered the chunk by (-1 if it starts inside). Walks the
+/// chunk's 8^3 bricks, and the voxels of those that hold cubes.
+std::optional<RayHit> walk_chunk(const GridRay& r, const Chunk& ch, const IVec3& cc, double tIn, double tOut, int axisIn) {
+  constexpr int BRICK = 8, BRICKS = CHUNK_SIZE / BRICK;
+  const QueryCache::Bits& bits = query_cache().bits(ch);
+  const int lo[3] = {cc.x * BRICKS, cc.y * BRICKS, cc.z * BRICKS};
+  const int hi[3] = {lo[0] + BRICKS - 1, lo[1] + BRICKS - 1, lo[2] + BRICKS - 1};
+  std::optional<RayHit> hit;
+  walk(r, tIn, tOut, double(BRICK), lo, hi, [&](const IVec3& b, double bIn, double bOut, int brickAxis) {
+    if (!((bits.bricks >> ((b.x & 3) | (b.y & 3) << 2 | (b.z & 3) << 4)) & 1)) return false;
+    if (brickAxis < 0) brickAxis = axisIn;   // the chunk's entry face is this brick's too
+    const int vlo[3] = {b.x * BRICK, b.y * BRICK, b.z * BRICK};
+    const int vhi[3] = {vlo[0] + BRICK - 1, vlo[1] + BRICK - 1, vlo[2] + BRICK - 1};
+    return walk(r, bIn, bOut, 1.0, vlo, vhi, [&](const IVec3& p, double t, double, int axis) {
+      const int i = local_index(p);
+      if (!((bits.voxels[i >> 6] >> (i & 63)) & 1)) return false;
+      if (axis < 0) axis = brickAxis;
+      RayHit h;
+      h.voxel = p;
+      if (axis >= 0) (&h.normal.x)[axis] = r.d[axis] > 0.0 ? -1 : 1;
+      h.t = float(t);
+      hit = h;
+      return true;
+    });
+  });
+  return hit;
+}
+
+// Walks start from the coarsest cells a store can tell are empty: chunks of a
+// live store, regions of 8^3 chunks of a snapshot. Misses cross empty space in
+// few steps.
+
+constexpr int top_size(const ChunkStore&) { return CHUNK_SIZE; }
+constexpr int top_size(const StoreSnapshot&) { return CHUNK_SIZE << REGION_SHIFT; }
+bool has_top(const ChunkStore& s, const IVec3& cc) { return query_cache().chunk(s, cc) != nullptr; }
+bool has_top(const StoreSnapshot& s, const IVec3& rc) { return s.has_region(rc); }
+
+/// First cube in top cell c (which has_top) over [tIn, tOut]; axisIn as for walk_chunk.
+std::optional<RayHit> walk_top(const ChunkStore& s, const GridRay& r, const IVec3& cc, double tIn, double tOut, int axisIn) {
+  return walk_chunk(r, *query_cache().chunk(s, cc), cc, tIn, tOut, axisIn);
+}
+
+std::optional<RayHit> walk_top(const StoreSnapshot& s, const GridRay& r, const IVec3& rc, double tIn, double tOut, int axisIn) {
+  constexpr int N = 1 << REGION_SHIFT;
+  const int lo[3] = {rc.x * N, rc.y * N, rc.z * N};
+  const int hi[3] = {lo[0] + N - 1, lo[1] + N - 1, lo[2] + N - 1};
+  std::optional<RayHit> hit;
+  walk(r, tIn, tOut, double(CHUNK_SIZE), lo, hi, [&](const IVec3& cc, double a, double b, int axis) {
+    const Chunk* ch = query_cache().chunk(s, cc);
+    if (!ch) return false;
+    hit = walk_chunk(r, *ch, cc, a, b, axis < 0 ? axisIn : axis);
+    return hit.has_value();
+  });
+  return hit;
+}
+
+/// First cube of store s along r within [0, maxT], in store coordinates.
+template <class Store>
+std::optional<RayHit> cast_store(const Store& s, const GridRay& r, float maxT, bool worldBounds) {
+  double t0, t1;
+  if (!ray_span(r, maxT, worldBounds, t0, t1)) return std::nullopt;
+  constexpr int BIG = std::numeric_limits<int>::max() / 2;
+  const int anyLo[3] = {-BIG, -BIG, -BIG}, anyHi[3] = {BIG, BIG, BIG};
+  std::optional<RayHit> hit;
+  walk(r, t0, t1, double(top_size(s)), anyLo, anyHi, [&](const IVec3& c, double tIn, double tOut, int axisIn) {
+    if (!has_top(s, c)) return false;
+    hit = walk_top(s, r, c, tIn, tOut, axisIn);
+    return hit.has_value();
+  });
+  return hit;
+}
+
+/// Replace best by the first cube of a group (cubes posed by offset and orient)
+/// if that is nearer. Rotations keep t, so the cast runs in group-local space.
+template <class Store>
+void nearer_in_group(const Store& cubes, const IVec3& offset, uint8_t orient, const Ray& ray, std::optional<RayHit>& best) {
+  const glm::mat3& inv = orientation_matrix(orientation_inverse(orient));
+  const glm::vec3 lro = inv * (ray.origin - glm::vec3(offset.x, offset.y, offset.z));
+  auto h = cast_store(cubes, grid_ray(lro, inv * ray.dir), best ? best->t : ray.maxT, false);
+  if (!h || (best && h->t >= best->t)) return;
+  const IVec3 v = orientation_apply(orient, h->voxel);
+  h->voxel = {v.x + offset.x, v.y + offset.y, v.z + offset.z};
+  h->normal = orientation_apply(orient, h->normal);
+  best = h;
+}
+
+const ChunkStore& world_store(const Universe& U) { return U.store(); }
+const StoreSnapshot& world_store(const WorldSnapshot& W) { return *W.world; }
+
+void add_groups(const Universe& U, const Ray& ray, std::optional<RayHit>& best) {
+  U.for_each_group([&](const std::string&, const Group& g) { nearer_in_group(g.cubes, g.offset, g.orient, ray, best); });
+}
+void add_groups(const WorldSnapshot& W, const Ray& ray, std::optional<RayHit>& best) {
+  for (const WorldSnapshot::GroupView& g : W.groups) nearer_in_group(*g.cubes, g.offset, g.orient, ray, best);
+}
+
+template <class World>
+std::optional<RayHit> cast_one(const World& w, const Ray& ray) {
+  std::optional<RayHit> best = cast_store(world_store(w), grid_ray(ray.origin, ray.dir), ray.maxT, true);
+  add_groups(w, ray, best);
+  if (best) best->point = ray.origin + ray.dir * best->t;
+  return best;
+}
+
+#if defined(__AVX__) || defined(VXL_RAY_SSE)
+#if defined(__AVX__)
+constexpr int PACKET = 8;
+using VF = __m256;
+inline VF vset(float x) { return _mm256_set1_ps(x); }
+inline VF vload(const float* p) { return _mm256_loadu_ps(p); }
+inline void vstore(float* p, VF v) { _mm256_storeu_ps(p, v); }
+inline VF vadd(VF a, VF b) { return _mm256_add_ps(a, b); }
+inline VF vmin(VF a, VF b) { return _mm256_min_ps(a, b); }
+inline VF vand(VF a, VF b) { return _mm256_and_ps(a, b); }
+inline VF vor(VF a, VF b) { return _mm256_or_ps(a, b); }
+/// a where m is clear, else 0.
+inline VF vandnot(VF m, VF a) { return _mm256_andnot_ps(m, a); }
+inline VF vle(VF a, VF b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+/// b where m is set, else a.
+inline VF vselect(VF a, VF b, VF m) { return _mm256_blendv_ps(a, b, m); }
+inline int vmask(VF m) { return _mm256_movemask_ps(m); }
+#else
+constexpr int PACKET = 4;
+using VF = __m128;
+inline VF vset(float x) { return _mm_set1_ps(x); }
+inline VF vload(const float* p) { return _mm_loadu_ps(p); }
+inline void vstore(float* p, VF v) { _mm_storeu_ps(p, v); }
+inline VF vadd(VF a, VF b) { return _mm_add_ps(a, b); }
+inline VF vmin(VF a, VF b) { return _mm_min_ps(a, b); }
+inline VF vand(VF a, VF b) { return _mm_and_ps(a, b); }
+inline VF vor(VF a, VF b) { return _mm_or_ps(a, b); }
+inline VF vandnot(VF m, VF a) { return _mm_andnot_ps(m, a); }
+inline VF vle(VF a, VF b) { return _mm_cmple_ps(a, b); }
+inline VF vselect(VF a, VF b, VF m) { return _mm_or_ps(_mm_and_ps(m, b), _mm_andnot_ps(m, a)); }
+inline int vmask(VF m) { return _mm_movemask_ps(m); }
+#endif
+
+/** @brief hits[k] = first cube of the world store s along rays[k], k < n <= PACKET.
+ *
+ *  The top-level walks of the rays (see top_size) advance together, one SIMD
+ *  lane each; cell coordinates are kept relative to the first ray's so they
+ *  stay exact in floats. Per step each lane still looks its cell up (shared with
+ *  lanes in the same cell) and, where it is not empty, walks it in double
+ *  precision over the ray's exact interval in it. Lanes drop out as they hit or
+ *  run out.
+ */
+template <class Store>
+void cast_packet(const Store& s, const Ray* rays, int n, std::optional<RayHit>* hits) {
+  constexpr float INF = std::numeric_limits<float>::infinity();
+  const int size = top_size(s);
+  GridRay g[PACKET];
+  double t0[PACKET], t1[PACKET];
+  float cell[3][PACKET], step[3][PACKET], tMax[3][PACKET], tDelta[3][PACKET], tEnd[PACKET], axisIn[PACKET];
+  IVec3 base{0,0,0};
+  int active = 0;
+  for (int k = 0; k < PACKET; ++k) {
+    // Idle lanes step on x by nothing and never end: they are masked out anyway
+    for (int i = 0; i < 3; ++i) { cell[i][k] = 0.0f; step[i][k] = 0.0f; tMax[i][k] = i ? INF : 0.0f; tDelta[i][k] = 0.0f; }
+    tEnd[k] = INF;
+    axisIn[k] = -1.0f;
+    if (k >= n) continue;
+    hits[k].reset();
+    g[k] = grid_ray(rays[k].origin, rays[k].dir);
+    if (!ray_span(g[k], rays[k].maxT, true, t0[k], t1[k])) continue;
+    int c[3];
+    for (int i = 0; i < 3; ++i) c[i] = int(std::floor((g[k].o[i] + g[k].d[i] * t0[k]) / size));
+    if (!active) base = {c[0], c[1], c[2]};
+    const int b[3] = {base.x, base.y, base.z};
+    for (int i = 0; i < 3; ++i) {
+      const double d = g[k].d[i];
+      cell[i][k] = float(c[i] - b[i]);
+      if (d == 0.0) {
+        tMax[i][k] = INF;
+        continue;
+      }
+      step[i][k] = d > 0.0 ? 1.0f : -1.0f;
+      tMax[i][k] = float(((c[i] + (d > 0.0 ? 1 : 0)) * double(size) - g[k].o[i]) / d);
+      tDelta[i][k] = float(size / std::abs(d));
+    }
+    tEnd[k] = float(t1[k]);
+    active |= 1 << k;
+  }
+
+  VF cx = vload(cell[0]), cy = vload(cell[1]), cz = vload(cell[2]);
+  const VF sx = vload(step[0]), sy = vload(step[1]), sz = vload(step[2]);
+  VF mx = vload(tMax[0]), my = vload(tMax[1]), mz = vload(tMax[2]);
+  const VF dx = vload(tDelta[0]), dy = vload(tDelta[1]), dz = vload(tDelta[2]);
+  const VF end = vload(tEnd);
+  VF axis = vload(axisIn);
+  IVec3 seen[PACKET];
+  bool seenFull[PACKET];
+  int seenMask = 0;   ///< lanes whose seen/seenFull hold their last lookup
+
+  while (active) {
+    const VF next = vmin(mx, vmin(my, mz));
+    float ccx[PACKET], ccy[PACKET], ccz[PACKET], ax[PACKET];
+    vstore(ccx, cx); vstore(ccy, cy); vstore(ccz, cz); vstore(ax, axis);
+    for (int m = active; m; m &= m - 1) {
+      const int k = std::countr_zero(unsigned(m));
+      const IVec3 c{int(ccx[k]) + base.x, int(ccy[k]) + base.y, int(ccz[k]) + base.z};
+      // Coherent lanes mostly stand in the same cells: reuse their lookups
+      int o = seenMask;
+      for (; o; o &= o - 1)
+        if (seen[std::countr_zero(unsigned(o))] == c) break;
+      const bool full = o ? seenFull[std::countr_zero(unsigned(o))] : has_top(s, c);
+      seen[k] = c;
+      seenFull[k] = full;
+      seenMask |= 1 << k;
+      if (!full) continue;
+      const double lo[3] = {double(c.x) * size, double(c.y) * size, double(c.z) * size};
+      const double hi[3] = {lo[0] + size, lo[1] + size, lo[2] + size};
+      double a = t0[k], b = t1[k];
+      if (!clip(g[k], lo, hi, a, b)) continue;
+      if ((hits[k] = walk_top(s, g[k], c, a, b, int(ax[k])))) active &= ~(1 << k);
+    }
+    active &= ~vmask(vle(end, next));
+    // Step each lane across its nearest cell face
+    const VF onX = vand(vle(mx, my), vle(mx, mz));
+    const VF onY = vandnot(onX, vle(my, mz));
+    const VF notZ = vor(onX, onY);
+    cx = vadd(cx, vand(onX, sx)); cy = vadd(cy, vand(onY, sy)); cz = vadd(cz, vandnot(notZ, sz));
+    mx = vadd(mx, vand(onX, dx)); my = vadd(my, vand(onY, dy)); mz = vadd(mz, vandnot(notZ, dz));
+    axis = vselect(vselect(vset(2.0f), vset(1.0f), onY), vset(0.0f), onX);
+  }
+}
+#else
+constexpr int PACKET = 1;
+
+template <class Store>
+void cast_packet(const Store& s, const Ray* rays, int n, std::optional<RayHit>* hits) {
+  for (int k = 0; k < n; ++k) hits[k] = cast_store(s, grid_ray(rays[k].origin, rays[k].dir), rays[k].maxT, true);
+}
+#endif
+
+/// cast_rays over rays [first, first + count).
+template <class World>
+void cast_range(const World& w, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits,
+                std::size_t first, std::size_t count) {
+  query_cache().clear();
+  for (std::size_t i = first; i < first + count; i += PACKET) {
+    const int n = int(std::min<std::size_t>(PACKET, first + count - i));
+    cast_packet(world_store(w), rays.data() + i, n, hits.data() + i);
+    for (int k = 0; k < n; ++k) {
+      std::optional<RayHit>& best = hits[i + k];
+      add_groups(w, rays[i + k], best);
+      if (best) best->point = rays[i + k].origin + rays[i + k].dir * best->t;
+    }
+  }
+}
+
+void check_sizes(std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) {
+  if (hits.size() < rays.size()) throw std::invalid_argument("cast_rays: need a hit slot per ray");
+}
+
+} // namespace
+
+std::optional<RayHit> cast_ray(const Universe& U, const Ray& ray) {
+  query_cache().clear();
+  return cast_one(U, ray);
+}
+
+std::optional<RayHit> cast_ray(const WorldSnapshot& W, const Ray& ray) {
+  query_cache().clear();
+  return cast_one(W, ray);
+}
+
+void cast_rays(const WorldSnapshot& W, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits, ThreadPool* pool) {
+  check_sizes(rays, hits);
+  const std::size_t jobs = (rays.size() + RAYS_PER_JOB - 1) / RAYS_PER_JOB;
+  parallel_for(pool, jobs, [&](std::size_t j) {
+    const std::size_t first = j * RAYS_PER_JOB;
+    cast_range(W, rays, hits, first, std::min(RAYS_PER_JOB, rays.size() - first));
+  });
+}
+
+void cast_rays(const Universe& U, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) {
+  check_sizes(rays, hits);
+  cast_range(U, rays, hits, 0, rays.size());
+}
+
+void cast_rays_scalar(const WorldSnapshot& W, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) {
+  check_sizes(rays, hits);
+  query_cache().clear();
+  for (std::size_t i = 0; i < rays.size(); ++i) hits[i] = cast_one(W, rays[i]);
+}
+
+int ray_packet_width() { return PACKET; }
+
+const char* ray_packet_isa() {
+#if defined(__AVX__)
+  return "AVX";
+#elif defined(VXL_RAY_SSE)
+  return "SSE";
+#else
+  return "scalar";
+#endif
+}
+
+std::vector<Ray> screen_rays(const glm::mat4& viewProj, int width, int height, PixelRect rect, int step) {
+  std::vector<Ray> rays;
+  if (width <= 0 || height <= 0) return rays;
+  step = std::max(step, 1);
+  const int x0 = std::clamp(std::min(rect.x0, rect.x1), 0, width - 1), x1 = std::clamp(std::max(rect.x0, rect.x1), 0, width - 1);
+  const int y0 = std::clamp(std::min(rect.y0, rect.y1), 0, height - 1), y1 = std::clamp(std::max(rect.y0, rect.y1), 0, height - 1);
+  const glm::mat4 inv = glm::inverse(viewProj);
+  auto ray_at = [&](int px, int py) {
+    const float x = 2.0f * (float(px) + 0.5f) / float(width) - 1.0f;
+    const float y = 1.0f - 2.0f * (float(py) + 0.5f) / float(height);
+    glm::vec4 pNear = inv * glm::vec4(x, y, -1, 1); pNear /= pNear.w;
+    glm::vec4 pFar  = inv * glm::vec4(x, y,  1, 1); pFar  /= pFar.w;
+    const glm::vec3 d = glm::vec3(pFar - pNear);
+    Ray r;
+    r.origin = glm::vec3(pNear);
+    r.maxT = glm::length(d);
+    r.dir = d / r.maxT;
+    return r;
+  };
+  const int nx = (x1 - x0) / step + 1, ny = (y1 - y0) / step + 1;
+  rays.reserve(std::size_t(nx) * std::size_t(ny));
+  for (int ty = 0; ty < ny; ty += 2)
+    for (int tx = 0; tx < nx; tx += 4)
+      for (int j = ty; j < std::min(ty + 2, ny); ++j)
+        for (int i = tx; i < std::min(tx + 4, nx); ++i) rays.push_back(ray_at(x0 + i * step, y0 + j * step));
+  return rays;
+}
+
+std::vector<IVec3> visible_in_rect(const ScreenView& view, PixelRect rect, int step, ThreadPool* pool) {
+  std::vector<IVec3> out;
+  if (!view.world) return out;
+  const std::vector<Ray> rays = screen_rays(view.viewProj, view.width, view.height, rect, step);
+  std::vector<std::optional<RayHit>> hits(rays.size());
+  cast_rays(*view.world, rays, hits, pool);
+  MortonSet seen;
+  for (const auto& h : hits)
+    if (h && seen.insert(h->voxel)) out.push_back(h->voxel);
+  return out;
+}
+
+} // namespace vxl
@@ -0,0 +1,94 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "thread_pool.hpp"
+#include "universe.hpp"
+#include "util.hpp"
+
+/** @file ray_query.hpp
+ *  @brief Ray casts against the voxel grid: one ray (picking), or arrays of
+ *         them traced in SIMD packets across worker threads (marquee selection,
+ *         visibility and line-of-sight queries).
+ */
+
+namespace vxl {
+
+struct WorldSnapshot;
+
+/// Default reach of a ray, in units of its direction's length.
+constexpr float RAY_REACH = 65536.0f;
+
+/// Where a ray first enters a cube.
+struct RayHit {
+  IVec3 voxel{0,0,0};      ///< world coordinate of the cube
+  IVec3 normal{0,0,0};     ///< outward unit normal of the face entered; zero if the ray starts inside
+  glm::vec3 point{0.0f};   ///< world point where the ray enters the cube
+  float t = 0.0f;          ///< ray parameter of point
+  /// The empty cell in front of the face hit, for placing a cube against it.
+  IVec3 adjacent() const noexcept { return {voxel.x + normal.x, voxel.y + normal.y, voxel.z + normal.z}; }
+};
+
+/// origin + t * dir for t in [0, maxT].
+struct Ray {
+  glm::vec3 origin{0.0f};
+  glm::vec3 dir{0.0f, 0.0f, -1.0f};
+  float maxT = RAY_REACH;
+};
+
+/** @brief First cube (unit cell centred on its coordinate, rotations ignored)
+ *         the ray enters, groups included.
+ *
+ *  Walks the grid with Amanatides-Woo steps: chunk by chunk, then voxel by voxel
+ *  inside chunks that exist, so the cost follows the distance covered, not the
+ *  scene. Groups are walked in their own frame. A zero direction hits nothing.
+ */
+std::optional<RayHit> cast_ray(const Universe& U, const Ray& ray);
+std::optional<RayHit> cast_ray(const WorldSnapshot& W, const Ray& ray);
+
+/** @brief hits[i] = cast_ray(W, rays[i]) for every ray (hits.size() >= rays.size()).
+ *
+ *  Rays are traced in packets of ray_packet_width() consecutive rays: the
+ *  packet's coarse steps (regions of chunks) run in SIMD lanes, and lanes in the
+ *  same cell share its lookup. Chunk lookups and per-chunk occupancy bits are
+ *  kept for the whole batch, so neighbouring rays from one eye (screen_rays()
+ *  order) cost far less than separate casts. Batches of packets are spread over
+ *  pool's workers and the calling thread; snapshots are immutable, so W may be
+ *  read meanwhile.
+ */
+void cast_rays(const WorldSnapshot& W, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits,
+               ThreadPool* pool = nullptr);
+/// Same packets against the live universe, on the calling thread only: const
+/// access to a ChunkStore may fault chunks in and is not safe to share.
+void cast_rays(const Universe& U, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits);
+/// The same batch walked one ray at a time, without packets; the reference for cast_rays.
+void cast_rays_scalar(const WorldSnapshot& W, std::span<const Ray> rays, std::span<std::optional<RayHit>> hits);
+/// Rays per SIMD packet: 8 (AVX), 4 (SSE) or 1.
+int ray_packet_width();
+/// Instruction set cast_rays was built with: "AVX", "SSE" or "scalar".
+const char* ray_packet_isa();
+
+/// Pixel rectangle, corners included; x to the right, y down, as mouse coordinates.
+struct PixelRect {
+  int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+};
+
+/// Rays through the centres of every `step`-th pixel of `rect` (clipped to the
+/// width x height viewport) for the camera viewProj, from the near plane to the
+/// far plane. Ordered in 4x2-pixel tiles, so packets hold neighbouring rays.
+std::vector<Ray> screen_rays(const glm::mat4& viewProj, int width, int height, PixelRect rect, int step = 1);
+
+/// The world as the user sees it: the snapshot on screen and its camera.
+struct ScreenView {
+  std::shared_ptr<const WorldSnapshot> world;
+  glm::mat4 viewProj{1.0f};
+  int width = 0, height = 0;
+};
+
+/// Cubes of view.world that a ray through some `step`-th pixel of rect hits
+/// first: the cubes visible in the rectangle. Each listed once.
+std::vector<IVec3> visible_in_rect(const ScreenView& view, PixelRect rect, int step = 1, ThreadPool* pool = nullptr);
+
+} // namespace vxl
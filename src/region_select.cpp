@@ -0,0 +1,298 @@
+#include "region_select.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+namespace vxl {
+
+namespace {
+
+using Bits = VoxelMask::Bits;
+
+/// A world chunk to scan, held while workers read it.
+struct Scan {
+  IVec3 cc;
+  std::shared_ptr<const Chunk> chunk;
+  Bits out;
+};
+
+/// Chunks of s within chunk coordinates [lo, hi] that keep(cc), faulted in on
+/// this thread. The region's chunks are probed when there are fewer of them
+/// than chunks in the table, else the table is filtered.
+template <class Keep>
+std::vector<Scan> overlapping(const ChunkStore& s, const IVec3& lo, const IVec3& hi, Keep&& keep) {
+  std::vector<IVec3> coords;
+  const double span = double(hi.x - lo.x + 1) * double(hi.y - lo.y + 1) * double(hi.z - lo.z + 1);
+  if (span <= double(s.chunk_count())) {
+    for (int z = lo.z; z <= hi.z; ++z)
+      for (int y = lo.y; y <= hi.y; ++y)
+        for (int x = lo.x; x <= hi.x; ++x)
+          if (s.has_chunk({x, y, z}) && keep(IVec3{x, y, z})) coords.push_back({x, y, z});
+  } else {
+    s.for_each_chunk_coord([&](const IVec3& cc) {
+      if (cc.x >= lo.x && cc.y >= lo.y && cc.z >= lo.z && cc.x <= hi.x && cc.y <= hi.y && cc.z <= hi.z && keep(cc))
+        coords.push_back(cc);
+    });
+  }
+  std::vector<Scan> scans(coords.size());
+  for (std::size_t i = 0; i < coords.size(); ++i) {
+    scans[i].cc = coords[i];
+    scans[i].chunk = s.share(coords[i]);
+  }
+  return scans;
+}
+
+/// Cubes p of U in the voxel box [lo, hi] (in world) with in(p), scanning the
+/// world chunks that keep(cc) in parallel. Group cubes are tested one by one.
+template <class Keep, class In>
+VoxelMask select_region(const Universe& U, const IVec3& lo, const IVec3& hi, Keep&& keep, In&& in, ThreadPool* pool) {
+  VoxelMask out;
+  if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) return out;
+  auto wanted = [&](const IVec3& p) {
+    return p.x >= lo.x && p.y >= lo.y && p.z >= lo.z && p.x <= hi.x && p.y <= hi.y && p.z <= hi.z && in(p);
+  };
+  std::vector<Scan> scans = overlapping(U.store(), chunk_of(lo), chunk_of(hi), keep);
+  parallel_for(pool, scans.size(), [&](std::size_t k) {
+    Scan& s = scans[k];
+    s.chunk->for_each([&](int i, const Cube&) {
+      if (wanted(voxel_at(s.cc, i))) s.out.words[i >> 6] |= uint64_t(1) << (i & 63);
+    });
+  });
+  for (const Scan& s : scans) out.insert_chunk(s.cc, s.out);
+  U.for_each_group([&](const std::string&, const Group& g) {
+    g.cubes.for_each([&](const IVec3& l, const Cube&) {
+      const IVec3 p = g.to_world(l);
+      if (wanted(p)) out.insert(p);
+    });
+  });
+  return out;
+}
+
+IVec3 clamp_to_world(const IVec3& p) {
+  return {std::clamp(p.x, MORTON_MIN, MORTON_MAX), std::clamp(p.y, MORTON_MIN, MORTON_MAX),
+          std::clamp(p.z, MORTON_MIN, MORTON_MAX)};
+}
+
+int clamp_coord(double v) { return int(std::clamp(v, double(MORTON_MIN), double(MORTON_MAX))); }
+
+// ----- flood fill -----
+// A chunk's cells as 32-bit rows: row y + 32 z, bit x, so a step along x is a
+// shift and a step along y or z is the next row or the next layer.
+
+constexpr int ROWS = CHUNK_SIZE * CHUNK_SIZE;
+using Rows = std::array<uint32_t, ROWS>;
+
+uint32_t row_of(const Bits& b, int r) { return uint32_t(b.words[r >> 1] >> ((r & 1) * 32)); }
+
+void to_bits(const Rows& rows, Bits& b) {
+  for (int w = 0; w < VoxelMask::WORDS; ++w) b.words[w] = uint64_t(rows[2 * w]) | uint64_t(rows[2 * w + 1]) << 32;
+}
+
+/// Cells at most one step from cur (cur included).
+void dilate(const Rows& cur, Connectivity conn, Rows& out) {
+  constexpr int N = CHUNK_SIZE;
+  Rows x;
+  for (int r = 0; r < ROWS; ++r) x[r] = cur[r] | cur[r] << 1 | cur[r] >> 1;
+  // Faces step along one axis from cur; all 26 neighbours are the x, y and z steps chained
+  const Rows& fromY = conn == Connectivity::All ? x : cur;
+  Rows y;
+  for (int r = 0; r < ROWS; ++r) {
+    const int ry = r & (N - 1);
+    y[r] = (ry > 0 ? fromY[r - 1] : 0u) | (ry < N - 1 ? fromY[r + 1] : 0u);
+  }
+  if (conn == Connectivity::All) {
+    for (int r = 0; r < ROWS; ++r) y[r] |= x[r];
+    for (int r = 0; r < ROWS; ++r) out[r] = y[r] | (r >= N ? y[r - N] : 0u) | (r < ROWS - N ? y[r + N] : 0u);
+  } else {
+    for (int r = 0; r < ROWS; ++r) out[r] = x[r] | y[r] | (r >= N ? cur[r - N] : 0u) | (r < ROWS - N ? cur[r + N] : 0u);
+  }
+}
+
+/// Grow cur inside solid until it stops changing.
+void grow(Rows& cur, const Rows& solid, Connectivity conn) {
+  Rows next;
+  for (;;) {
+    dilate(cur, conn, next);
+    bool changed = false;
+    for (int r = 0; r < ROWS; ++r) {
+      next[r] &= solid[r];
+      changed |= next[r] != cur[r];
+    }
+    if (!changed) return;
+    cur = next;
+  }
+}
+
+/// One chunk's share of a fill.
+struct FillChunk {
+  IVec3 cc;
+  std::shared_ptr<const Chunk> chunk;   ///< null if only group cubes are here
+  Rows solid{};                         ///< cells the fill may enter, once ready
+  Rows filled{};
+  Rows pending{};                       ///< cells reached from neighbours since the last wave
+  bool ready = false;
+  bool queued = false;
+};
+
+constexpr IVec3 FACE_STEPS[6] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+
+struct Flood {
+  const Universe& U;
+  Connectivity conn;
+  FloodMatch match;
+  MaterialId mat = 0;
+  VoxelMask groupSolid;   ///< matching group cubes, at world positions
+  MortonMap<std::unique_ptr<FillChunk>> chunks;
+  std::vector<IVec3> steps;
+
+  /// The chunk's state, created (and its world chunk faulted in) on first use; null if nothing is there.
+  FillChunk* at(const IVec3& cc) {
+    if (std::unique_ptr<FillChunk>* f = chunks.find(cc)) return f->get();
+    const bool world = U.store().has_chunk(cc);
+    if (!world && !groupSolid.chunk(cc)) return nullptr;
+    auto f = std::make_unique<FillChunk>();
+    f->cc = cc;
+    if (world) f->chunk = U.store().share(cc);
+    return (chunks[cc] = std::move(f)).get();
+  }
+
+  void make_solid(FillChunk& f) const {
+    Rows occupied{};
+    if (f.chunk) f.chunk->for_each([&](int i, const Cube& c) {
+      const uint32_t bit = 1u << (i & 31);
+      occupied[i >> 5] |= bit;
+      if (match == FloodMatch::AnySolid || c.mat == mat) f.solid[i >> 5] |= bit;
+    });
+    // A world cube hides a group cube at the same place
+    if (const Bits* g = groupSolid.chunk(f.cc))
+      for (int r = 0; r < ROWS; ++r) f.solid[r] |= row_of(*g, r) & ~occupied[r];
+    f.ready = true;
+  }
+
+  /// Take in f's pending cells, grow, and list the cells past its faces that the new cells touch.
+  void run(FillChunk& f, std::vector<IVec3>& spill) const {
+    if (!f.ready) make_solid(f);
+    Rows cur;
+    bool fresh = false;
+    for (int r = 0; r < ROWS; ++r) {
+      const uint32_t add = f.pending[r] & f.solid[r] & ~f.filled[r];
+      fresh |= add != 0;
+      cur[r] = f.filled[r] | add;
+      f.pending[r] = 0;
+    }
+    if (!fresh) return;
+    grow(cur, f.solid, conn);
+    constexpr int LAST = CHUNK_SIZE - 1;
+    for (int r = 0; r < ROWS; ++r) {
+      const int y = r & LAST, z = r >> CHUNK_SHIFT;
+      uint32_t edge = cur[r] & ~f.filled[r];
+      if (y != 0 && y != LAST && z != 0 && z != LAST) edge &= 1u | 1u << LAST;   // inner rows touch x faces only
+      for (; edge; edge &= edge - 1) {
+        const int x = std::countr_zero(edge);
+        const IVec3 p = voxel_at(f.cc, x | r << CHUNK_SHIFT);
+        for (const IVec3& d : steps) {
+          const int nx = x + d.x, ny = y + d.y, nz = z + d.z;
+          if (nx >= 0 && ny >= 0 && nz >= 0 && nx <= LAST && ny <= LAST && nz <= LAST) continue;
+          const IVec3 q{p.x + d.x, p.y + d.y, p.z + d.z};
+          if (Universe::in_world(q)) spill.push_back(q);
+        }
+      }
+      f.filled[r] = cur[r];
+    }
+  }
+};
+
+} // namespace
+
+VoxelMask cubes_in_box(const Universe& U, const IVec3& a, const IVec3& b, ThreadPool* pool) {
+  const IVec3 rlo{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+  const IVec3 rhi{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+  // Clamping a box wholly past one side of the world would leave it the boundary plane
+  if (rhi.x < MORTON_MIN || rhi.y < MORTON_MIN || rhi.z < MORTON_MIN ||
+      rlo.x > MORTON_MAX || rlo.y > MORTON_MAX || rlo.z > MORTON_MAX)
+    return {};
+  const IVec3 lo = clamp_to_world(rlo), hi = clamp_to_world(rhi);
+  return select_region(U, lo, hi, [](const IVec3&) { return true; }, [](const IVec3&) { return true; }, pool);
+}
+
+VoxelMask cubes_in_ellipsoid(const Universe& U, const glm::vec3& centre, const glm::vec3& radii, ThreadPool* pool) {
+  if (!(radii.x > 0.0f && radii.y > 0.0f && radii.z > 0.0f))
+    throw std::invalid_argument("cubes_in_ellipsoid: radii must be positive");
+  const double c[3] = {centre.x, centre.y, centre.z}, inv[3] = {1.0 / radii.x, 1.0 / radii.y, 1.0 / radii.z};
+  const double rad[3] = {radii.x, radii.y, radii.z};
+  /// Scaled squared distance from the centre to the nearest point of the box [lo, hi].
+  auto nearest = [&](const double lo[3], const double hi[3]) {
+    double s = 0.0;
+    for (int i = 0; i < 3; ++i) {
+      const double d = (std::clamp(c[i], lo[i], hi[i]) - c[i]) * inv[i];
+      s += d * d;
+    }
+    return s;
+  };
+  const IVec3 lo{clamp_coord(std::ceil(c[0] - rad[0])), clamp_coord(std::ceil(c[1] - rad[1])), clamp_coord(std::ceil(c[2] - rad[2]))};
+  const IVec3 hi{clamp_coord(std::floor(c[0] + rad[0])), clamp_coord(std::floor(c[1] + rad[1])), clamp_coord(std::floor(c[2] + rad[2]))};
+  auto keep = [&](const IVec3& cc) {
+    const double blo[3] = {double(cc.x) * CHUNK_SIZE, double(cc.y) * CHUNK_SIZE, double(cc.z) * CHUNK_SIZE};
+    const double bhi[3] = {blo[0] + CHUNK_MASK, blo[1] + CHUNK_MASK, blo[2] + CHUNK_MASK};
+    return nearest(blo, bhi) <= 1.0;
+  };
+  auto in = [&](const IVec3& p) {
+    const double q[3] = {double(p.x), double(p.y), double(p.z)};
+    return nearest(q, q) <= 1.0;
+  };
+  return select_region(U, lo, hi, keep, in, pool);
+}
+
+VoxelMask flood_select(const Universe& U, const IVec3& seed, Connectivity conn, FloodMatch match, ThreadPool* pool) {
+  const std::optional<Cube> at = Universe::in_world(seed) ? U.get(seed.x, seed.y, seed.z) : std::nullopt;
+  if (!at) return {};
+  Flood F{U, conn, match, at->mat, {}, {}, {}};
+  U.for_each_group([&](const std::string&, const Group& g) {
+    g.cubes.for_each([&](const IVec3& l, const Cube& c) {
+      const IVec3 p = g.to_world(l);
+      if (Universe::in_world(p) && (match == FloodMatch::AnySolid || c.mat == F.mat)) F.groupSolid.insert(p);
+    });
+  });
+  if (conn == Connectivity::Faces) {
+    F.steps.assign(std::begin(FACE_STEPS), std::end(FACE_STEPS));
+  } else {
+    for (int z = -1; z <= 1; ++z)
+      for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+          if (x || y || z) F.steps.push_back({x, y, z});
+  }
+
+  FillChunk* first = F.at(chunk_of(seed));
+  const int i = local_index(seed);
+  first->pending[i >> 5] |= 1u << (i & 31);
+  std::vector<FillChunk*> wave{first};
+  std::vector<std::vector<IVec3>> spills;
+  while (!wave.empty()) {
+    spills.assign(wave.size(), {});
+    parallel_for(pool, wave.size(), [&](std::size_t k) { F.run(*wave[k], spills[k]); });
+    for (FillChunk* f : wave) f->queued = false;
+    wave.clear();
+    // Cells past a face become the pending cells of the chunk there
+    for (const std::vector<IVec3>& spill : spills) {
+      for (const IVec3& q : spill) {
+        FillChunk* f = F.at(chunk_of(q));
+        if (!f) continue;
+        const int j = local_index(q);
+        f->pending[j >> 5] |= 1u << (j & 31);
+        if (!f->queued) { f->queued = true; wave.push_back(f); }
+      }
+    }
+  }
+
+  VoxelMask out;
+  Bits b;
+  F.chunks.for_each([&](const IVec3& cc, const std::unique_ptr<FillChunk>& f) {
+    to_bits(f->filled, b);
+    out.insert_chunk(cc, b);
+  });
+  return out;
+}
+
+} // namespace vxl
@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "thread_pool.hpp"
+#include "universe.hpp"
+#include "voxel_mask.hpp"
+#include "util.hpp"
+
+/** @file region_select.hpp
+ *  @brief Cubes in a region: a box, an ellipsoid, or the connected component
+ *         around a cube. Only occupied chunks are visited, so the cost follows
+ *         the cubes near the region rather than its volume.
+ */
+
+namespace vxl {
+
+/** @brief Cubes p with min(a, b) <= p <= max(a, b) on every axis.
+ *
+ *  Overlapping chunks are found from the region or from the chunk table,
+ *  whichever is smaller, and scanned on pool's workers (the calling thread
+ *  faults them in first). Group cubes are included at their world positions.
+ */
+VoxelMask cubes_in_box(const Universe& U, const IVec3& a, const IVec3& b, ThreadPool* pool = nullptr);
+
+/// Cubes whose centre p has sum(((p - centre) / radii)^2) <= 1; chunks the
+/// ellipsoid misses are skipped whole. Throws std::invalid_argument unless
+/// every radius is positive.
+VoxelMask cubes_in_ellipsoid(const Universe& U, const glm::vec3& centre, const glm::vec3& radii,
+                             ThreadPool* pool = nullptr);
+
+/// Neighbours a flood fill steps to.
+enum class Connectivity {
+  Faces,   ///< 6: cubes sharing a face
+  All,     ///< 26: sharing a face, an edge or a corner
+};
+
+/// Cubes a flood fill may enter.
+enum class FloodMatch {
+  AnySolid,       ///< every cube
+  SameMaterial,   ///< cubes with the seed's material
+};
+
+/** @brief The cubes connected to the one at seed; empty if there is none.
+ *
+ *  Each chunk grows its part of the component with whole-row bit operations
+ *  until nothing changes, then hands the cells it reached on its faces to
+ *  its neighbours. All chunks with new cells grow in parallel, wave by wave.
+ */
+VoxelMask flood_select(const Universe& U, const IVec3& seed, Connectivity conn, FloodMatch match,
+                       ThreadPool* pool = nullptr);
+
+} // namespace vxl
@@ -1,12 +1,17 @@
 #include "renderer.hpp"
+#include "camera.hpp"
 #include <GL/glew.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
 #include <vector>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <stdexcept>
+#include <cstddef>
+#include <cstdio>
 #include <cstring>
 
 #ifndef DEFAULT_SHADER_DIR
@@ -15,62 +20,78 @@
 
 namespace vxl {
 
-static std::string read_text_file(const std::string& path) {
-  std::ifstream f(path);
-  if (!f) throw std::runtime_error("Cannot read file: " + path);
-  std::stringstream ss; ss << f.rdbuf();
-  return ss.str();
+namespace {
+
+constexpr uint8_t MIN_CLASS = 3;       // blocks of 8 slots at least
+constexpr uint32_t MIN_SLOTS = 1024;
+constexpr uint32_t REPACK_AT = 4096;   // stores past this many slots repack once half are holes
+constexpr int TEXELS = 3;              // RGBA32F texels per table entry
+constexpr float CUBE_REACH = 0.8661f;  // half a unit cube's diagonal: bounds any rotation
+constexpr std::size_t MAX_OCCLUDERS = 512;   // nearest occluder boxes rasterized per frame
+constexpr float MIN_OCCLUDER_PIXELS = 2.0f;  // in occlusion buffer rows
+constexpr int OCCLUSION_WIDTH = 256;
+
+uint8_t size_class(uint32_t count) {
+  return std::max(MIN_CLASS, uint8_t(std::bit_width(std::max<uint32_t>(count, 1) - 1)));
 }
 
-static unsigned int compile_shader(GLenum type, const std::string& src) {
-  GLuint s = glCreateShader(type);
-  const char* c = src.c_str();
-  glShaderSource(s, 1, &c, nullptr);
-  glCompileShader(s);
-  GLint ok=0; glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-  if (!ok) {
-    GLint len=0; glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
-    std::string log(len, '\0'); glGetShaderInfoLog(s, len, nullptr, log.data());
-    throw std::runtime_error("Shader compile failed: " + log);
-  }
-  return s;
+/// Orientation index of c in the rotation table (see Renderer::Instance).
+uint32_t orientation_index(const Cube& c, uint32_t hole) {
+  if (c.rotation.axis_aligned()) return c.rotation.code;
+  // Slots past what 16 bits can address are drawn unrotated
+  return c.freeRot < hole - Orientation::COUNT ? Orientation::COUNT + c.freeRot : 0;
 }
 
-Renderer::Renderer() {}
+} // namespace
+
+Renderer::Renderer(ThreadPool& pool) : pool_(pool) {}
 Renderer::~Renderer() {
-  if (vboInst_) glDeleteBuffers(1,&vboInst_);
+  // Queued rebuilds hold `this`; the shared pool lives on, so let them drain as no-ops
+  closing_.store(true, std::memory_order_relaxed);
+  pool_.wait_idle();
+  for (auto& [serial, B] : stores_) release(B);
+  release(glass_);
+  if (materialTex_) glDeleteTextures(1,&materialTex_);
+  if (rotationTex_) glDeleteTextures(1,&rotationTex_);
+  if (materialBuf_) glDeleteBuffers(1,&materialBuf_);
+  if (rotationBuf_) glDeleteBuffers(1,&rotationBuf_);
   if (vboVerts_) glDeleteBuffers(1,&vboVerts_);
   if (ebo_) glDeleteBuffers(1,&ebo_);
-  if (vao_) glDeleteVertexArrays(1,&vao_);
-  if (prog_) glDeleteProgram(prog_);
+  if (quadEbo_) glDeleteBuffers(1,&quadEbo_);
 }
 
-void Renderer::init_gl() {
+void Renderer::set_meshing(bool on) {
+  if (on == meshing_) return;
+  meshing_ = on;
+  ++epoch_;          // rebuilds in flight were made for the other mode
+  ready_.clear();
+  inflight_.clear();
+  for (auto& [serial, B] : stores_) release(B);
+  stores_.clear();   // rebuilt from scratch next frame
+  ++glassVersion_;
+}
+
+void Renderer::init_gl(const std::string& shaderCacheDir) {
   glewExperimental = GL_TRUE;
   if (glewInit() != GLEW_OK) throw std::runtime_error("GLEW init failed");
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_CULL_FACE);
-  build_program();
+  shaders_ = std::make_unique<ShaderCache>(DEFAULT_SHADER_DIR, shaderCacheDir);
+  build_programs();
+  const ShaderCache::Stats& st = shaders_->stats();
+  char line[160];
+  std::snprintf(line, sizeof line, "Shaders: %zu programs, %zu from the binary cache%s, %.1f ms", st.programs,
+                st.fromCache, shaders_->binaries() ? "" : " (unsupported by the driver or off)", st.ms);
+  shaderMessages_.push_back(line);
   build_cube_mesh();
+  build_tables();
 }
 
 void Renderer::resize(int w, int h) { viewportW_ = w; viewportH_ = h; }
 
-void Renderer::build_program() {
-  std::string vsPath = std::string(DEFAULT_SHADER_DIR) + "/cube.vert";
-  std::string fsPath = std::string(DEFAULT_SHADER_DIR) + "/cube.frag";
-  auto vs = compile_shader(GL_VERTEX_SHADER, read_text_file(vsPath));
-  auto fs = compile_shader(GL_FRAGMENT_SHADER, read_text_file(fsPath));
-  prog_ = glCreateProgram();
-  glAttachShader(prog_, vs); glAttachShader(prog_, fs);
-  glLinkProgram(prog_);
-  GLint ok=0; glGetProgramiv(prog_, GL_LINK_STATUS, &ok);
-  if (!ok) {
-    GLint len=0; glGetProgramiv(prog_, GL_INFO_LOG_LENGTH, &len);
-    std::string log(len, '\0'); glGetProgramInfoLog(prog_, len, nullptr, log.data());
-    throw std::runtime_error("Program link failed: " + log);
-  }
-  glDeleteShader(vs); glDeleteShader(fs);
+void Renderer::build_programs() {
+  prog_ = shaders_->program("cube.vert", "cube.frag");
+  meshProg_ = shaders_->program("mesh.vert", "cube.frag");   // same fragment stage as the instances
 }
 
 void Renderer::build_cube_mesh() {
@@ -95,51 +116,516 @@ void Renderer::build_cube_mesh() {
   add_face({ 1, 0, 0}, { s,-s, s}, { s,-s,-s}, { s, s,-s}, { s, s, s});
   add_face({-1, 0, 0}, {-s,-s, s}, {-s, s, s}, {-s, s,-s}, {-s,-s,-s});
 
-  glGenVertexArrays(1,&vao_);
-  glBindVertexArray(vao_);
-
   glGenBuffers(1,&vboVerts_);
   glBindBuffer(GL_ARRAY_BUFFER, vboVerts_);
   glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(V), verts.data(), GL_STATIC_DRAW);
-  glEnableVertexAttribArray(0); // pos
-  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(V),(void*)0);
-  glEnableVertexAttribArray(1); // normal
-  glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,sizeof(V),(void*)(3*sizeof(float)));
 
   glGenBuffers(1,&ebo_);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size()*sizeof(unsigned int), idx.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-  // Instance buffer: model matrix (4 vec4), colorA (vec4), colorB(vec4), kind(int), gradDir(vec3)
-  glGenBuffers(1,&vboInst_);
-  glBindBuffer(GL_ARRAY_BUFFER, vboInst_);
-  size_t stride = sizeof(float)* (16 + 4 + 4 + 1 + 3);
-  std::size_t offset = 0;
-  for (int i=0;i<4;i++) {
-    glEnableVertexAttribArray(2+i);
-    glVertexAttribPointer(2+i, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset));
-    glVertexAttribDivisor(2+i, 1);
-    offset += sizeof(float)*4;
-  }
-  glEnableVertexAttribArray(6);
-  glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset));
-  glVertexAttribDivisor(6,1);
-  offset += sizeof(float)*4;
-  glEnableVertexAttribArray(7);
-  glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset));
-  glVertexAttribDivisor(7,1);
-  offset += sizeof(float)*4;
-  glEnableVertexAttribArray(8);
-  glVertexAttribIPointer(8, 1, GL_INT, stride, (void*)(offset));
-  glVertexAttribDivisor(8,1);
-  offset += sizeof(int)*1;
-  glEnableVertexAttribArray(9);
-  glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset));
-  glVertexAttribDivisor(9,1);
+void Renderer::build_tables() {
+  auto make = [](unsigned int& buf, unsigned int& tex) {
+    glGenBuffers(1,&buf);
+    glBindBuffer(GL_TEXTURE_BUFFER, buf);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * TEXELS, nullptr, GL_DYNAMIC_DRAW);
+    glGenTextures(1,&tex);
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buf);
+  };
+  make(materialBuf_, materialTex_);
+  make(rotationBuf_, rotationTex_);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderer::upload_tables(const WorldSnapshot& W) {
+  auto upload = [&](unsigned int buf) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buf);
+    const auto bytes = GLsizeiptr(tableStaging_.size() * sizeof(glm::vec4));
+    glBufferData(GL_TEXTURE_BUFFER, bytes, tableStaging_.data(), GL_DYNAMIC_DRAW);
+    stats_.bytesUploaded += std::size_t(bytes);
+  };
+  if (W.materials->version != materialVersion_) {
+    // colorA, colorB, (gradDir, kind) per palette slot
+    tableStaging_.clear();
+    for (const Material& m : W.materials->entries) {
+      tableStaging_.push_back(m.colorA);
+      tableStaging_.push_back(m.colorB);
+      tableStaging_.push_back(glm::vec4(m.gradDir, m.kind == Material::Kind::Solid ? 0.0f : 1.0f));
+    }
+    upload(materialBuf_);
+    materialVersion_ = W.materials->version;
+  }
+  if (W.rotations->version != rotationVersion_) {
+    // Matrix columns of the axis-aligned codes, then of the side-table slots
+    const std::vector<glm::mat3>& rt = W.rotations->matrices;
+    const std::size_t n = std::min<std::size_t>(rt.size(), HOLE - Orientation::COUNT);
+    tableStaging_.clear();
+    auto push = [&](const glm::mat3& R) { for (int c = 0; c < 3; ++c) tableStaging_.push_back(glm::vec4(R[c], 0.0f)); };
+    for (uint8_t code = 0; code < Orientation::COUNT; ++code) push(orientation_matrix(code));
+    for (std::size_t i = 0; i < n; ++i) push(rt[i]);
+    upload(rotationBuf_);
+    rotationVersion_ = W.rotations->version;
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderer::bind_attributes(StoreBuffer& B) const {
+  if (!B.vao) glGenVertexArrays(1,&B.vao);
+  glBindVertexArray(B.vao);
+
+  // Shared cube mesh: pos, normal (see build_cube_mesh)
+  const GLsizei vstride = sizeof(float) * 6;
+  glBindBuffer(GL_ARRAY_BUFFER, vboVerts_);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,vstride,(void*)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,vstride,(void*)(3*sizeof(float)));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+
+  // Instance buffer: position (ivec3), material | orientation << 16 (uint)
+  glBindBuffer(GL_ARRAY_BUFFER, B.vbo);
+  const GLsizei stride = sizeof(Instance);
+  glEnableVertexAttribArray(2);
+  glVertexAttribIPointer(2, 3, GL_INT, stride, (void*)offsetof(Instance, x));
+  glVertexAttribDivisor(2,1);
+  glEnableVertexAttribArray(3);
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(Instance, packed));
+  glVertexAttribDivisor(3,1);
 
   glBindVertexArray(0);
 }
 
+void Renderer::release(StoreBuffer& B) const {
+  if (B.vbo) glDeleteBuffers(1,&B.vbo);
+  if (B.vao) glDeleteVertexArrays(1,&B.vao);
+  B.vbo = B.vao = 0;
+  B.meshes.for_each([](const IVec3&, MeshBlock& m) {
+    glDeleteBuffers(1,&m.vbo);
+    glDeleteVertexArrays(1,&m.vao);
+  });
+  B.meshes.clear();
+  B.lods.for_each([](const IVec3&, LodBlock& l) {
+    for (MeshBlock& m : l.level) {
+      if (m.vbo) glDeleteBuffers(1,&m.vbo);
+      if (m.vao) glDeleteVertexArrays(1,&m.vao);
+    }
+  });
+  B.lods.clear();
+  B.occluders.clear();
+  B.translucent.clear();
+}
+
+void Renderer::reserve_quads(uint32_t quads) {
+  if (quads <= quadCapacity_) return;
+  const uint32_t cap = std::max({uint32_t(4096), quadCapacity_ * 2, quads});
+  std::vector<uint32_t> idx;
+  idx.reserve(std::size_t(cap) * 6);
+  for (uint32_t q = 0; q < cap; ++q) {
+    const uint32_t v = q * 4;
+    idx.insert(idx.end(), {v, v + 1, v + 2, v, v + 2, v + 3});
+  }
+  // Mesh VAOs refer to the buffer by name, so refilling it in place keeps them valid
+  if (!quadEbo_) glGenBuffers(1,&quadEbo_);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEbo_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(uint32_t), idx.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  quadCapacity_ = cap;
+}
+
+void Renderer::reserve_slots(StoreBuffer& B, uint32_t slots) {
+  if (slots <= B.capacity) return;
+  const uint32_t cap = std::max({MIN_SLOTS, B.capacity * 2, slots});
+  GLuint vbo = 0;
+  glGenBuffers(1,&vbo);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+  glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(cap) * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+  if (B.vbo) {
+    // Grow on the GPU side: the old content is copied, not re-uploaded
+    glBindBuffer(GL_COPY_READ_BUFFER, B.vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(B.end) * sizeof(Instance));
+    glDeleteBuffers(1,&B.vbo);
+  }
+  B.vbo = vbo;
+  B.capacity = cap;
+  bind_attributes(B);
+}
+
+uint32_t Renderer::alloc_block(StoreBuffer& B, uint8_t cls) {
+  B.live += uint32_t(1) << cls;
+  if (B.free.size() > cls && !B.free[cls].empty()) {
+    uint32_t first = B.free[cls].back();
+    B.free[cls].pop_back();
+    return first;
+  }
+  uint32_t first = B.end;
+  reserve_slots(B, B.end + (uint32_t(1) << cls));
+  B.end += uint32_t(1) << cls;
+  return first;
+}
+
+void Renderer::free_block(StoreBuffer& B, const Block& b) {
+  // Punch out the slots in use so they draw nothing until the block is reused
+  if (b.count) {
+    staging_.assign(b.count, Instance{0, 0, 0, HOLE << 16});
+    const auto bytes = GLsizeiptr(staging_.size() * sizeof(Instance));
+    glBindBuffer(GL_ARRAY_BUFFER, B.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, GLintptr(b.first) * sizeof(Instance), bytes, staging_.data());
+    stats_.bytesUploaded += std::size_t(bytes);
+  }
+  if (B.free.size() <= b.cls) B.free.resize(b.cls + 1);
+  B.free[b.cls].push_back(b.first);
+  B.live -= uint32_t(1) << b.cls;
+}
+
+void Renderer::repack(StoreBuffer& B) {
+  const uint32_t cap = std::max(MIN_SLOTS, std::bit_ceil(B.live));
+  GLuint vbo = 0;
+  glGenBuffers(1,&vbo);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+  glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(cap) * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, B.vbo);
+  // Whole blocks move, holes and all, so nothing is re-encoded
+  uint32_t end = 0;
+  B.blocks.for_each([&](const IVec3&, Block& b) {
+    const uint32_t slots = uint32_t(1) << b.cls;
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(b.first) * sizeof(Instance),
+                        GLintptr(end) * sizeof(Instance), GLsizeiptr(slots) * sizeof(Instance));
+    b.first = end;
+    end += slots;
+  });
+  glDeleteBuffers(1,&B.vbo);
+  B.vbo = vbo;
+  B.capacity = cap;
+  B.end = B.live = end;
+  B.free.clear();
+  bind_attributes(B);
+}
+
+void Renderer::upload_mesh(StoreBuffer& B, const IVec3& cc, const ChunkMesh& mesh) {
+  MeshBlock* mb = B.meshes.find(cc);
+  if (!mb && mesh.quads() == 0) return;
+  if (!mb) mb = &B.meshes[cc];
+  fill_mesh(*mb, mesh);
+  if (!mb->quads) B.meshes.erase(cc);
+}
+
+void Renderer::upload_lod(StoreBuffer& B, const IVec3& cc, const ChunkMesh (&levels)[LOD_LEVELS - 1]) {
+  LodBlock* l = B.lods.find(cc);
+  if (!l && levels[0].quads() == 0) return;
+  if (!l) l = &B.lods[cc];
+  for (int k = 0; k < LOD_LEVELS - 1; ++k) fill_mesh(l->level[k], levels[k]);
+  if (!l->level[0].quads) B.lods.erase(cc);   // every level of a non-empty chunk has quads
+}
+
+void Renderer::fill_mesh(MeshBlock& mb, const ChunkMesh& mesh) {
+  if (mesh.quads() == 0) {
+    if (mb.vbo) glDeleteBuffers(1,&mb.vbo);
+    if (mb.vao) glDeleteVertexArrays(1,&mb.vao);
+    mb = MeshBlock{};
+    return;
+  }
+  reserve_quads(uint32_t(mesh.quads()));
+  if (!mb.vao) {
+    glGenVertexArrays(1,&mb.vao);
+    glGenBuffers(1,&mb.vbo);
+    glBindVertexArray(mb.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mb.vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 4, GL_UNSIGNED_BYTE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_SHORT, sizeof(MeshVertex), (void*)offsetof(MeshVertex, mat));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEbo_);
+    glBindVertexArray(0);
+  }
+  const auto bytes = GLsizeiptr(mesh.vertices.size() * sizeof(MeshVertex));
+  glBindBuffer(GL_ARRAY_BUFFER, mb.vbo);
+  glBufferData(GL_ARRAY_BUFFER, bytes, mesh.vertices.data(), GL_DYNAMIC_DRAW);
+  mb.quads = uint32_t(mesh.quads());
+  stats_.bytesUploaded += std::size_t(bytes);
+}
+
+void Renderer::upload_instances(StoreBuffer& B, const IVec3& cc, const std::vector<Instance>& instances) {
+  const uint32_t count = uint32_t(instances.size());
+  Block* b = B.blocks.find(cc);
+  if (b && (count == 0 || b->cls != size_class(count))) {
+    free_block(B, *b);
+    B.blocks.erase(cc);
+    b = nullptr;
+  }
+  if (count == 0) return;
+  if (!b) {
+    Block nb;
+    nb.cls = size_class(count);
+    const bool reused = B.free.size() > nb.cls && !B.free[nb.cls].empty();
+    nb.first = alloc_block(B, nb.cls);
+    nb.count = reused ? 0 : (uint32_t(1) << nb.cls);   // fresh GPU storage is undefined: fill all of it
+    b = &(B.blocks[cc] = nb);
+  }
+
+  // Pad with holes over whatever the block held before
+  const Instance* data = instances.data();
+  const uint32_t slots = std::max(count, b->count);
+  if (slots > count) {
+    staging_.assign(instances.begin(), instances.end());
+    staging_.resize(slots, Instance{0, 0, 0, HOLE << 16});
+    data = staging_.data();
+  }
+  const auto bytes = GLsizeiptr(slots) * GLsizeiptr(sizeof(Instance));
+  glBindBuffer(GL_ARRAY_BUFFER, B.vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, GLintptr(b->first) * sizeof(Instance), bytes, data);
+  b->count = count;
+  stats_.bytesUploaded += std::size_t(bytes);
+}
+
+void Renderer::schedule(const std::shared_ptr<const StoreSnapshot>& S, StoreBuffer& B, const IVec3& cc, uint8_t what) {
+  if (!meshing_) what &= REBUILD_INSTANCES;
+  if (!S->has_chunk(cc)) {
+    upload_instances(B, cc, {});
+    upload_mesh(B, cc, ChunkMesh{});
+    upload_lod(B, cc, {});
+    B.occluders.erase(cc);
+    if (B.translucent.erase(cc)) ++glassVersion_;
+    if (const Pending* p = B.pending.find(cc)) {   // whatever is in flight for it is stale now
+      settle(p->version);
+      B.pending.erase(cc);
+    }
+    return;
+  }
+  auto [p, fresh] = B.pending.try_emplace(cc);
+  if (!fresh) settle(p->version);   // the new job shows its changes too
+  p->what |= what;
+  p->job = ++nextJob_;
+  p->version = frameVersion_;
+  ++inflight_[frameVersion_];
+
+  auto out = std::make_shared<ChunkBuild>();
+  out->epoch = epoch_;
+  out->serial = S->serial();
+  out->job = p->job;
+  out->cc = cc;
+  out->what = p->what;
+  const bool meshing = meshing_;
+  // Snapshots never change, so the worker reads the chunk and its neighbours itself
+  jobs_.fetch_add(1, std::memory_order_relaxed);
+  pool_.submit([this, snap = S, out, meshing, mats = materialSnapshot_]() mutable {
+    if (closing_.load(std::memory_order_relaxed)) { jobs_.fetch_sub(1, std::memory_order_relaxed); return; }
+    thread_local MeshInput input;
+    MeshInput* in = &input;
+    if (out->what & REBUILD_MESH) Mesher::gather(*snap, out->cc, *in, mats->translucent);
+    else in->chunk = *snap->chunk(out->cc);
+    snap.reset();
+    auto instance = [&](int i, const Cube& c) {
+      const IVec3 p = voxel_at(out->cc, i);
+      return Instance{p.x, p.y, p.z, uint32_t(c.mat) | orientation_index(c, HOLE) << 16};
+    };
+    // Translucent cubes are drawn sorted, on their own: to the mesh, the coarse
+    // levels and the occluders they are not there
+    thread_local std::vector<uint16_t> glass;
+    glass.clear();
+    in->chunk.for_each([&](int i, const Cube& c) {
+      if (c.mat >= mats->translucent.size() || !mats->translucent[c.mat]) return;
+      glass.push_back(uint16_t(i));
+      out->translucent.push_back(instance(i, c));
+    });
+    in->chunk.erase_sorted(glass);
+    if (out->what & REBUILD_INSTANCES) {
+      // In meshing mode only cubes the mesher leaves out are instanced
+      out->instances.reserve(in->chunk.size());
+      in->chunk.for_each([&](int i, const Cube& c) {
+        if (!(meshing && Mesher::meshable(c))) out->instances.push_back(instance(i, c));
+      });
+      occluder_boxes(in->chunk, out->cc, out->occluders);
+    }
+    thread_local Mesher mesher;
+    if (out->what & REBUILD_MESH) mesher.build(*in, out->mesh);
+    if (out->what & REBUILD_LOD) {
+      thread_local LodLevel levels[LOD_LEVELS - 1];
+      build_lod_chain(in->chunk, mats->colours, levels);
+      for (int k = 0; k < LOD_LEVELS - 1; ++k) mesher.build(levels[k], out->lod[k]);
+    }
+    done_.push(std::make_unique<ChunkBuild>(std::move(*out)));
+    jobs_.fetch_sub(1, std::memory_order_relaxed);
+  });
+}
+
+void Renderer::apply_builds() {
+  done_.drain([&](std::unique_ptr<ChunkBuild>&& r) { ready_.push_back(std::move(r)); });
+  const auto start = std::chrono::steady_clock::now();
+  const std::chrono::duration<double, std::milli> budget(uploadBudgetMs_);
+  while (!ready_.empty()) {
+    std::unique_ptr<ChunkBuild> r = std::move(ready_.front());
+    ready_.pop_front();
+    // Drop results of vanished stores, of the other mode, and of superseded jobs
+    auto it = stores_.find(r->serial);
+    if (r->epoch != epoch_ || it == stores_.end()) continue;
+    StoreBuffer& B = it->second;
+    const Pending* p = B.pending.find(r->cc);
+    if (!p || p->job != r->job) continue;
+    settle(p->version);
+    B.pending.erase(r->cc);
+    if (r->what & REBUILD_INSTANCES) {
+      upload_instances(B, r->cc, r->instances);
+      if (r->occluders.empty()) B.occluders.erase(r->cc);
+      else B.occluders[r->cc] = std::move(r->occluders);
+      if (!r->translucent.empty()) {
+        B.translucent[r->cc] = std::move(r->translucent);
+        ++glassVersion_;
+      } else if (B.translucent.erase(r->cc)) {
+        ++glassVersion_;
+      }
+    }
+    if (r->what & REBUILD_MESH) upload_mesh(B, r->cc, r->mesh);
+    if (r->what & REBUILD_LOD) upload_lod(B, r->cc, r->lod);
+    ++stats_.chunksUpdated;
+    if (std::chrono::steady_clock::now() - start >= budget) break;
+  }
+  stats_.chunksWaiting = ready_.size();
+  stats_.jobsPending = jobs_.load(std::memory_order_relaxed);
+}
+
+void Renderer::settle(uint64_t version) {
+  auto it = inflight_.find(version);
+  if (it != inflight_.end() && --it->second == 0) inflight_.erase(it);
+}
+
+void Renderer::sync_store(const std::shared_ptr<const StoreSnapshot>& S, StoreBuffer& B) {
+  B.seen = true;
+  const uint8_t all = REBUILD_INSTANCES | REBUILD_MESH | REBUILD_LOD;
+  if (!B.vbo) {
+    B.snap = S;
+    reserve_slots(B, uint32_t(std::clamp<std::size_t>(S->size(), 1, UINT32_MAX / 2)));
+    S->for_each_chunk([&](const IVec3& cc, const Chunk&){ schedule(S, B, cc, all); });
+    return;
+  }
+  if (B.snap == S) return;
+  const std::shared_ptr<const StoreSnapshot> before = std::move(B.snap);
+  B.snap = S;
+  if (!meshing_) {
+    S->for_each_change(before.get(), [&](const IVec3& cc){ schedule(S, B, cc, all); });
+  } else {
+    // A chunk's faces depend on its neighbours' border cells: re-mesh those too
+    dirty_.clear();
+    S->for_each_change(before.get(), [&](const IVec3& cc){ dirty_.insert(cc); schedule(S, B, cc, all); });
+    dirty_.for_each([&](const IVec3& cc) {
+      static const IVec3 dirs[6] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+      for (auto& d : dirs) {
+        const IVec3 n{cc.x + d.x, cc.y + d.y, cc.z + d.z};
+        if (!dirty_.contains(n) && S->has_chunk(n) && neighbours_.insert(n)) schedule(S, B, n, REBUILD_MESH);
+      }
+    });
+    neighbours_.clear();
+  }
+
+  // Mostly holes: compact
+  if (B.end > REPACK_AT && B.live * 2 < B.end) repack(B);
+}
+
+void Renderer::cull_occluded(const glm::mat4& V, const glm::mat4& P) {
+  const auto start = std::chrono::steady_clock::now();
+  // Nearest first: they hide the most
+  const std::size_t n = std::min(MAX_OCCLUDERS, occluderCandidates_.size());
+  std::partial_sort(occluderCandidates_.begin(), occluderCandidates_.begin() + std::ptrdiff_t(n), occluderCandidates_.end(),
+                    [](const auto& a, const auto& b) { return a.first < b.first; });
+  occluderBoxes_.clear();
+  for (std::size_t i = 0; i < n; ++i) occluderBoxes_.push_back(occluderCandidates_[i].second);
+  stats_.occluders = n;
+
+  if (n) {
+    const int rows = std::clamp(OCCLUSION_WIDTH * viewportH_ / std::max(1, viewportW_), 16, OCCLUSION_WIDTH);
+    if (occlusionBuf_.height() != rows) occlusionBuf_.resize(OCCLUSION_WIDTH, rows);
+    occlusionBuf_.begin(P * V);
+    occlusionBuf_.rasterize(occluderBoxes_, &pool_);
+    for (std::size_t i = 0; i < boxes_.size(); ++i) {
+      if (!visible_[i]) continue;
+      const Box3 b{{boxes_.lo(0)[i], boxes_.lo(1)[i], boxes_.lo(2)[i]}, {boxes_.hi(0)[i], boxes_.hi(1)[i], boxes_.hi(2)[i]}};
+      if (occlusionBuf_.occluded(b)) {
+        visible_[i] = 0;
+        ++stats_.chunksOccluded;
+      }
+    }
+  }
+  stats_.occlusionMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Renderer::draw_translucent(const std::vector<StoreDraw>& draws, const glm::vec3& eye) {
+  glassChunks_.clear();
+  for (const StoreDraw& d : draws)
+    for (std::size_t i = d.glass; i < d.end; ++i) {
+      if (!visible_[i]) { ++stats_.chunksCulled; continue; }
+      glassChunks_.push_back({boxRefs_[i].translucent, d.M});
+      ++stats_.chunksDrawn;
+    }
+  if (glassChunks_ != glassSorted_) {
+    glassSorted_ = glassChunks_;
+    ++glassVersion_;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  if (sorter_.reusable(glassVersion_, eye)) {
+    stats_.sortReused = true;
+  } else {
+    glassPoints_.clear();
+    glassCubes_.clear();
+    glassOwner_.clear();
+    for (uint32_t k = 0; k < glassSorted_.size(); ++k) {
+      const GlassChunk& g = glassSorted_[k];
+      for (const Instance& c : *g.cubes) {
+        glassPoints_.push_back(glm::vec3(g.M * glm::vec4(float(c.x), float(c.y), float(c.z), 1.0f)));
+        glassCubes_.push_back(c);
+        glassOwner_.push_back(k);
+      }
+    }
+    sorter_.sort(glassPoints_, eye, glassVersion_, &pool_);
+
+    // One buffer, back to front; a new run wherever the owning store changes
+    glassRuns_.clear();
+    staging_.clear();
+    for (uint32_t i : sorter_.order()) {
+      const glm::mat4& M = glassSorted_[glassOwner_[i]].M;
+      if (glassRuns_.empty() || glassRuns_.back().M != M) glassRuns_.push_back({M, uint32_t(staging_.size()), 0});
+      ++glassRuns_.back().count;
+      staging_.push_back(glassCubes_[i]);
+    }
+    if (!staging_.empty()) {
+      glass_.end = 0;   // nothing worth keeping when it grows
+      reserve_slots(glass_, uint32_t(staging_.size()));
+      const auto bytes = GLsizeiptr(staging_.size() * sizeof(Instance));
+      glBindBuffer(GL_ARRAY_BUFFER, glass_.vbo);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, staging_.data());
+      glass_.end = uint32_t(staging_.size());
+      stats_.bytesUploaded += std::size_t(bytes);
+    }
+  }
+  stats_.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if (glassRuns_.empty()) return;
+
+  // Tested against the opaque scene, but translucent cubes do not hide each other
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDepthMask(GL_FALSE);
+  glUseProgram(prog_);
+  const GLint locM = glGetUniformLocation(prog_, "uModel");
+  glBindVertexArray(glass_.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, glass_.vbo);
+  for (const GlassRun& r : glassRuns_) {
+    glUniformMatrix4fv(locM, 1, GL_FALSE, glm::value_ptr(r.M));
+    const std::size_t base = std::size_t(r.first) * sizeof(Instance);
+    glVertexAttribIPointer(2, 3, GL_INT, sizeof(Instance), (void*)(base + offsetof(Instance, x)));
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(Instance), (void*)(base + offsetof(Instance, packed)));
+    glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, GLsizei(r.count));
+    stats_.translucent += r.count;
+    ++stats_.drawCalls;
+  }
+  glBindVertexArray(0);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
+}
+
 void Renderer::draw_grid(const glm::mat4& VP) const {
   glDisable(GL_DEPTH_TEST);
   glBegin(GL_LINES);
@@ -154,8 +640,8 @@ void Renderer::draw_grid(const glm::mat4& VP) const {
   glEnable(GL_DEPTH_TEST);
 }
 
-void Renderer::render(const Universe& U, const Selection& Sel, const glm::mat4& V, const glm::mat4& P,
-                      bool drawGrid) {
+void Renderer::render(const WorldSnapshot& W, const glm::mat4& V, const glm::mat4& P, bool drawGrid) {
+  if (shaders_->poll()) build_programs();   // shader files changed on disk
   glViewport(0,0,viewportW_, viewportH_);
   glClearColor(0.08f,0.09f,0.1f,1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -169,45 +655,205 @@ void Renderer::render(const Universe& U, const Selection& Sel, const glm::mat4&
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   }
 
-  // Prepare instance buffer
-  struct Instance {
-    float model[16];
-    float colorA[4];
-    float colorB[4];
-    int kind;
-    float gradDir[3];
-  };
-  std::vector<Instance> inst;
-  inst.reserve(U.all().size());
-
-  for (auto&& [p, c] : U.all()) {
-    glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(p.x, p.y, p.z)) * glm::mat4_cast(c.rotation);
-    Instance I{};
-    std::memcpy(I.model, glm::value_ptr(M), sizeof(float)*16);
-    std::memcpy(I.colorA, glm::value_ptr(c.mat.colorA), sizeof(float)*4);
-    std::memcpy(I.colorB, glm::value_ptr(c.mat.colorB), sizeof(float)*4);
-    I.kind = (c.mat.kind == Material::Kind::Solid) ? 0 : 1;
-    I.gradDir[0]=c.mat.gradDir.x; I.gradDir[1]=c.mat.gradDir.y; I.gradDir[2]=c.mat.gradDir.z;
-    inst.push_back(I);
+  // Bring the persistent instance buffers and meshes up to date; drop those of vanished stores
+  stats_ = {};
+  for (auto& [serial, B] : stores_) B.seen = false;
+  frameVersion_ = W.version;
+  if (!materialSnapshot_ || W.materials->version != snapshotVersion_) {
+    // Rebuild jobs set translucent cubes apart and average colours into the
+    // coarse levels: give them what they need of it
+    const std::vector<Material>& pal = W.materials->entries;
+    auto snap = std::make_shared<MaterialSnapshot>();
+    snap->colours.resize(pal.size());
+    snap->translucent.resize(pal.size());
+    for (std::size_t i = 0; i < pal.size(); ++i) {
+      const Material& m = pal[i];
+      snap->colours[i] = m.kind == Material::Kind::Solid ? glm::vec3(m.colorA) : 0.5f * glm::vec3(m.colorA + m.colorB);
+      snap->translucent[i] = translucent(m);
+    }
+    materialSnapshot_ = std::move(snap);
+    snapshotVersion_ = W.materials->version;
   }
+  sync_store(W.world, stores_[W.world->serial()]);
+  for (const auto& g : W.groups) sync_store(g.cubes, stores_[g.cubes->serial()]);
+  for (auto it = stores_.begin(); it != stores_.end(); ) {
+    if (it->second.seen) {
+      stats_.bufferBytes += std::size_t(it->second.capacity) * sizeof(Instance);
+      it->second.meshes.for_each([&](const IVec3&, const MeshBlock& m) { stats_.bufferBytes += std::size_t(m.quads) * 4 * sizeof(MeshVertex); });
+      it->second.lods.for_each([&](const IVec3&, const LodBlock& l) {
+        for (const MeshBlock& m : l.level) stats_.bufferBytes += std::size_t(m.quads) * 4 * sizeof(MeshVertex);
+      });
+      ++it;
+    } else {
+      it->second.pending.for_each([&](const IVec3&, const Pending& p) { settle(p.version); });
+      release(it->second);
+      it = stores_.erase(it);
+      ++glassVersion_;
+    }
+  }
+  apply_builds();
+  settled_ = inflight_.empty() ? frameVersion_ : std::min(frameVersion_, inflight_.begin()->first - 1);
+  upload_tables(W);
 
-  glUseProgram(prog_);
-  GLint locV = glGetUniformLocation(prog_, "uView");
-  GLint locP = glGetUniformLocation(prog_, "uProj");
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, materialTex_);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, rotationTex_);
+  glActiveTexture(GL_TEXTURE0);
   glm::mat4 Vcopy = V, Pcopy = P;
-  glUniformMatrix4fv(locV, 1, GL_FALSE, glm::value_ptr(Vcopy));
-  glUniformMatrix4fv(locP, 1, GL_FALSE, glm::value_ptr(Pcopy));
+  for (unsigned int prog : {prog_, meshProg_}) {
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "uMaterials"), 0);
+    glUniform1i(glGetUniformLocation(prog, "uRotations"), 1);
+    glUniformMatrix4fv(glGetUniformLocation(prog, "uView"), 1, GL_FALSE, glm::value_ptr(Vcopy));
+    glUniformMatrix4fv(glGetUniformLocation(prog, "uProj"), 1, GL_FALSE, glm::value_ptr(Pcopy));
+  }
 
   if (wireframe_) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-  glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vboInst_);
-  glBufferData(GL_ARRAY_BUFFER, inst.size()*sizeof(Instance), inst.data(), GL_DYNAMIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+  // Box every instance block, mesh and translucent chunk in world space; groups through their pose
+  std::vector<StoreDraw> draws;
+  boxes_.clear();
+  boxRefs_.clear();
+  occluderCandidates_.clear();
+  const glm::vec3 eye(glm::inverse(V)[3]);
+  const float fovY = 2.0f * std::atan(1.0f / P[1][1]);
+  auto gather = [&](const StoreSnapshot& S, const glm::mat4& M) {
+    StoreBuffer& B = stores_[S.serial()];
+    const glm::mat3 R(M);
+    const glm::vec3 t(M[3]);
+    glm::vec3 lo, hi;
+    auto bounds = [&](const IVec3& cc) {
+      const glm::vec3 l = glm::vec3(float(cc.x), float(cc.y), float(cc.z)) * float(CHUNK_SIZE) - CUBE_REACH;
+      const glm::vec3 h = l + (float(CHUNK_SIZE - 1) + 2.0f * CUBE_REACH);
+      const glm::vec3 a = R * l + t, c = R * h + t;   // R is a signed permutation
+      lo = glm::min(a, c);
+      hi = glm::max(a, c);
+    };
+    auto box = [&](const IVec3& cc) { bounds(cc); boxes_.push(lo, hi); };
+
+    // Level of detail: how large voxels look at the nearest point of the chunk
+    B.lods.for_each([&](const IVec3& cc, LodBlock& l) {
+      if (!lod_) { l.current = 0; return; }
+      bounds(cc);
+      const float d = glm::length(glm::max(lo, glm::min(eye, hi)) - eye);
+      l.current = pick_lod_level(projected_pixels(1.0f, d, fovY, viewportH_), l.current);
+    });
+    auto coarse = [&](const IVec3& cc) { const LodBlock* l = B.lods.find(cc); return l && l->current; };
+
+    // Occluder candidates: solid interiors large enough on screen to hide something
+    if (occlusion_) {
+      const int rows = occlusionBuf_.height();
+      B.occluders.for_each([&](const IVec3&, const std::vector<Box3>& solid) {
+        for (const Box3& o : solid) {
+          const glm::vec3 a = R * o.lo + t, c = R * o.hi + t;
+          const Box3 w{glm::min(a, c), glm::max(a, c)};
+          const glm::vec3 ext = w.hi - w.lo;
+          const float dist = glm::length(glm::max(w.lo, glm::min(eye, w.hi)) - eye);
+          if (projected_pixels(std::max({ext.x, ext.y, ext.z}), dist, fovY, rows) >= MIN_OCCLUDER_PIXELS)
+            occluderCandidates_.push_back({dist, w});
+        }
+      });
+    }
+
+    StoreDraw d{&B, M, boxRefs_.size(), 0, 0, 0};
+    B.blocks.for_each([&](const IVec3& cc, const Block& b) {
+      if (coarse(cc)) return;
+      box(cc);
+      boxRefs_.push_back({b, nullptr, cc});
+    });
+    d.mid = boxRefs_.size();
+    B.meshes.for_each([&](const IVec3& cc, const MeshBlock& m) {
+      if (coarse(cc)) return;
+      box(cc);
+      boxRefs_.push_back({Block{}, &m, cc});
+    });
+    B.lods.for_each([&](const IVec3& cc, const LodBlock& l) {
+      if (!l.current) return;
+      box(cc);
+      boxRefs_.push_back({Block{}, &l.level[l.current - 1], cc, l.current});
+    });
+    d.glass = boxRefs_.size();
+    B.translucent.for_each([&](const IVec3& cc, const std::vector<Instance>& cubes) {
+      box(cc);
+      boxRefs_.push_back({Block{}, nullptr, cc, 0, &cubes});
+    });
+    d.end = boxRefs_.size();
+    draws.push_back(d);
+  };
+  gather(*W.world, glm::mat4(1.0f));
+  for (const auto& g : W.groups) {
+    glm::mat4 M(orientation_matrix(g.orient));
+    M[3] = glm::vec4(float(g.offset.x), float(g.offset.y), float(g.offset.z), 1.0f);
+    gather(*g.cubes, M);
+  }
+  cull_aabbs(Frustum::from_matrix(P * V), boxes_, visible_);
+  if (occlusion_) cull_occluded(V, P);
 
+  // Instanced cubes: the visible blocks of each store, one call per run of adjacent blocks
   // There are 36 indices total
-  GLsizei indexCount = 36;
-  glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)inst.size());
+  const GLsizei indexCount = 36;
+  glUseProgram(prog_);
+  GLint locM = glGetUniformLocation(prog_, "uModel");
+  for (const StoreDraw& d : draws) {
+    runs_.clear();
+    for (std::size_t i = d.begin; i < d.mid; ++i) {
+      if (!visible_[i]) { ++stats_.chunksCulled; continue; }
+      runs_.push_back(boxRefs_[i].block);
+      stats_.instances += boxRefs_[i].block.count;
+      ++stats_.chunksDrawn;
+    }
+    if (runs_.empty()) continue;
+    std::sort(runs_.begin(), runs_.end(), [](const Block& a, const Block& b) { return a.first < b.first; });
+    glUniformMatrix4fv(locM, 1, GL_FALSE, glm::value_ptr(d.M));
+    glBindVertexArray(d.B->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, d.B->vbo);
+    for (std::size_t k = 0; k < runs_.size(); ++k) {
+      const uint32_t first = runs_[k].first;
+      uint32_t last = first + runs_[k].count;
+      // Holes in between (and at the end of blocks) draw nothing
+      while (k + 1 < runs_.size() && runs_[k + 1].first == runs_[k].first + (uint32_t(1) << runs_[k].cls)) {
+        ++k;
+        last = runs_[k].first + runs_[k].count;
+      }
+      // GL 3.3 has no base instance: point the instance attributes at the run instead
+      const std::size_t base = std::size_t(first) * sizeof(Instance);
+      glVertexAttribIPointer(2, 3, GL_INT, sizeof(Instance), (void*)(base + offsetof(Instance, x)));
+      glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(Instance), (void*)(base + offsetof(Instance, packed)));
+      glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)(last - first));
+      ++stats_.drawCalls;
+    }
+  }
+
+  // Meshed chunks: one call per visible mesh, full detail or a coarse level
+  glUseProgram(meshProg_);
+  locM = glGetUniformLocation(meshProg_, "uModel");
+  const GLint locOrigin = glGetUniformLocation(meshProg_, "uOrigin");
+  const GLint locCell = glGetUniformLocation(meshProg_, "uCell");
+  int cellLevel = 0;
+  glUniform1f(locCell, 1.0f);
+  for (const StoreDraw& d : draws) {
+    bool posed = false;
+    for (std::size_t i = d.mid; i < d.glass; ++i) {
+      if (!visible_[i]) { ++stats_.chunksCulled; continue; }
+      const BoxRef& r = boxRefs_[i];
+      if (!posed) { glUniformMatrix4fv(locM, 1, GL_FALSE, glm::value_ptr(d.M)); posed = true; }
+      glUniform3f(locOrigin, float(r.cc.x * CHUNK_SIZE), float(r.cc.y * CHUNK_SIZE), float(r.cc.z * CHUNK_SIZE));
+      if (r.level != cellLevel) {
+        cellLevel = r.level;
+        glUniform1f(locCell, float(1 << cellLevel));
+      }
+      stats_.lodChunks += r.level != 0;
+      glBindVertexArray(r.mesh->vao);
+      glDrawElements(GL_TRIANGLES, GLsizei(r.mesh->quads) * 6, GL_UNSIGNED_INT, 0);
+      stats_.meshQuads += r.mesh->quads;
+      ++stats_.chunksDrawn;
+      ++stats_.drawCalls;
+    }
+  }
+  glBindVertexArray(0);
+
+  draw_translucent(draws, eye);
 
   if (wireframe_) glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
@@ -1,7 +1,21 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <glm/glm.hpp>
-#include "universe.hpp"
-#include "selection.hpp"
+#include "world_snapshot.hpp"
+#include "depth_sort.hpp"
+#include "frustum.hpp"
+#include "mesher.hpp"
+#include "occlusion.hpp"
+#include "shader_cache.hpp"
+#include "thread_pool.hpp"
 
 /** @file renderer.hpp
  *  @brief OpenGL renderer: cubes (instanced), grid, selection outlines, wireframe toggle.
@@ -9,30 +23,283 @@
 
 namespace vxl {
 
+/// What the last render() did.
+struct RenderStats {
+  std::size_t instances = 0;       ///< cubes drawn
+  std::size_t chunksDrawn = 0;     ///< chunk instance blocks, meshes and translucent sets in view
+  std::size_t chunksCulled = 0;    ///< those skipped as outside it or occluded
+  std::size_t chunksOccluded = 0;  ///< of those, the ones hidden behind occluders
+  std::size_t occluders = 0;       ///< occluder boxes rasterized
+  double occlusionMs = 0.0;        ///< CPU time of occlusion culling
+  std::size_t drawCalls = 0;
+  std::size_t meshQuads = 0;       ///< greedy quads drawn (meshing mode)
+  std::size_t lodChunks = 0;       ///< chunks drawn at a coarser level of detail
+  std::size_t translucent = 0;     ///< translucent cubes drawn, back to front
+  bool sortReused = false;         ///< their order was kept from an earlier frame
+  double sortMs = 0.0;             ///< CPU time of ordering and uploading them
+  std::size_t chunksUpdated = 0;   ///< chunk rebuilds uploaded
+  std::size_t chunksWaiting = 0;   ///< rebuilds finished but left for later frames (upload budget)
+  std::size_t jobsPending = 0;     ///< rebuilds queued or running on the workers
+  std::size_t bytesUploaded = 0;   ///< instance data and tables sent to the GPU
+  std::size_t bufferBytes = 0;     ///< GPU instance and mesh storage, holes included
+};
+
 class Renderer {
 public:
-  Renderer();
+  /// Rebuilds, occlusion rasterizing and depth sorting run on `pool`, which must
+  /// outlive the renderer (the app shares it with the simulation).
+  explicit Renderer(ThreadPool& pool);
+  /// Rebuilds not started yet are skipped; waits for the pool to go idle.
   ~Renderer();
 
-  void init_gl();                    ///< Create GL resources; call after GL context ready
+  /// Create GL resources; call after GL context ready. Program binaries are
+  /// cached under shaderCacheDir (not at all if empty); see ShaderCache.
+  void init_gl(const std::string& shaderCacheDir = {});
   void resize(int w, int h);
   void set_wireframe(bool on) { wireframe_ = on; }
+  /// Draw axis-aligned cubes as per-chunk meshes of their exposed faces (see Mesher)
+  /// instead of one instance each; cubes with a free rotation stay instanced.
+  /// Switching rebuilds all GPU data on the next frame.
+  void set_meshing(bool on);
+  bool meshing() const noexcept { return meshing_; }
+  /// In meshing mode, draw chunks whose voxels look smaller than a pixel from a
+  /// coarser level of their mip chain (see lod.hpp). On by default.
+  void set_lod(bool on) { lod_ = on; }
+  bool lod() const noexcept { return lod_; }
+  /// Skip chunks hidden behind the solid interiors of nearer chunks, tested on
+  /// the CPU (see OcclusionBuffer) before anything is submitted. On by default.
+  void set_occlusion(bool on) { occlusion_ = on; }
+  bool occlusion() const noexcept { return occlusion_; }
+
+  /// Milliseconds per frame spent uploading finished chunk rebuilds (default 4);
+  /// at least one is uploaded per frame, the rest wait for the next.
+  void set_upload_budget(double ms) { uploadBudgetMs_ = ms; }
+  double upload_budget() const noexcept { return uploadBudgetMs_; }
+
+  /// How far the camera may move before translucent cubes are sorted again
+  /// (default 0.1 units); see DepthSorter.
+  void set_sort_reuse_distance(float d) { sorter_.set_reuse_distance(d); }
+  float sort_reuse_distance() const noexcept { return sorter_.reuse_distance(); }
 
-  /// Draw a frame.
-  void render(const Universe& U, const Selection& Sel, const glm::mat4& V, const glm::mat4& P,
-              bool drawGrid);
+  /// Draw a frame of W. Chunks that differ from the snapshot drawn before
+  /// (StoreSnapshot::for_each_change) are rebuilt on worker threads, which read
+  /// them from W; until a rebuild is uploaded the chunk is drawn as it was.
+  /// Everything else is drawn from data already on the GPU. Chunks whose bounds
+  /// lie outside the frustum of P*V are not drawn. Cubes of translucent
+  /// materials are drawn last, blended, farthest from the eye first.
+  void render(const WorldSnapshot& W, const glm::mat4& V, const glm::mat4& P, bool drawGrid);
+  const RenderStats& stats() const noexcept { return stats_; }
+  /// Shader build summary, reloads and compile errors since the last call.
+  std::vector<std::string> take_shader_messages() {
+    std::vector<std::string> out = std::move(shaderMessages_);
+    if (shaders_) for (std::string& m : shaders_->take_messages()) out.push_back(std::move(m));
+    return out;
+  }
+  /// Newest WorldSnapshot::version whose every change the last frame showed:
+  /// rebuilds of it and of the snapshots before it are all uploaded.
+  uint64_t settled_version() const noexcept { return settled_; }
 
 private:
+  /** @brief Per-cube vertex attributes (see cube.vert): the store-local position,
+   *         then material id | orientation index << 16. Orientation indices 0..23
+   *         are the axis-aligned codes, 24 + slot the free rotations; HOLE marks an
+   *         unused slot, which draws nothing.
+   */
+  struct Instance {
+    int32_t x, y, z;
+    uint32_t packed;
+  };
+  static constexpr uint32_t HOLE = 0xFFFF;
+
+  /// What a rebuild job produces.
+  enum : uint8_t { REBUILD_INSTANCES = 1, REBUILD_MESH = 2, REBUILD_LOD = 4 };
+  /// The newest rebuild job of a chunk; older ones' results are dropped.
+  struct Pending {
+    uint64_t job = 0;
+    uint64_t version = 0;   ///< WorldSnapshot::version it was scheduled for
+    uint8_t what = 0;
+  };
+  /// A chunk's range of instance slots: 2^cls slots from `first`, `count` of them used.
+  struct Block {
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint8_t cls = 0;
+  };
+  /// A chunk's greedy mesh: its own vertex buffer, indexed by the shared quad index buffer.
+  struct MeshBlock {
+    unsigned int vao = 0, vbo = 0;
+    uint32_t quads = 0;
+  };
+  /// Meshes of a chunk's coarse levels, and the level it was last drawn at.
+  struct LodBlock {
+    MeshBlock level[LOD_LEVELS - 1];   ///< level L at L - 1
+    uint8_t current = 0;
+  };
+  /** @brief Instances of one ChunkStore, kept in a persistent GL buffer.
+   *
+   *  Each chunk owns a block; a changed chunk is rewritten in place with
+   *  glBufferSubData, moving to another block only when its size class changes.
+   *  Unused slots hold HOLE instances, so the whole buffer is drawn
+   *  with one call. Group stores hold local coordinates; the pose is a uniform.
+   */
+  struct StoreBuffer {
+    unsigned int vao = 0, vbo = 0;
+    uint32_t capacity = 0;                      ///< slots allocated on the GPU
+    uint32_t end = 0;                           ///< slots handed out (draw count)
+    uint32_t live = 0;                          ///< slots in blocks owned by chunks
+    MortonMap<Block> blocks;                    ///< by chunk coordinate
+    MortonMap<MeshBlock> meshes;                ///< by chunk coordinate (meshing mode)
+    MortonMap<LodBlock> lods;                   ///< by chunk coordinate (meshing mode)
+    MortonMap<Pending> pending;                 ///< rebuilds in flight, by chunk coordinate
+    MortonMap<std::vector<Box3>> occluders;     ///< solid interiors (occluder_boxes), store-local
+    MortonMap<std::vector<Instance>> translucent;   ///< translucent cubes, kept on the CPU for sorting
+    std::vector<std::vector<uint32_t>> free;    ///< first slot of released blocks, by class
+    std::shared_ptr<const StoreSnapshot> snap;  ///< the store as scheduled for so far
+    bool seen = false;
+  };
+
+  /// A finished rebuild, handed from a worker to the GL thread.
+  struct ChunkBuild {
+    uint64_t epoch = 0, serial = 0, job = 0;   ///< set_meshing epoch, ChunkStore::serial(), Pending::job
+    IVec3 cc{0,0,0};
+    uint8_t what = 0;
+    std::vector<Instance> instances;           ///< the chunk's instanced cubes
+    std::vector<Instance> translucent;         ///< and its translucent ones
+    std::vector<Box3> occluders;
+    ChunkMesh mesh;
+    ChunkMesh lod[LOD_LEVELS - 1];
+  };
+
   // GL resources
-  unsigned int prog_ = 0;
-  unsigned int vao_ = 0, vboVerts_ = 0, vboInst_ = 0, ebo_ = 0;
+  std::unique_ptr<ShaderCache> shaders_;   ///< owns prog_ and meshProg_
+  std::vector<std::string> shaderMessages_;
+  unsigned int prog_ = 0, meshProg_ = 0;
+  unsigned int vboVerts_ = 0, ebo_ = 0;
+  unsigned int quadEbo_ = 0;          ///< 0,1,2, 0,2,3 per quad, shared by all meshes
+  uint32_t quadCapacity_ = 0;         ///< quads quadEbo_ can index
   int viewportW_ = 1, viewportH_ = 1;
+  // Texture buffers the vertex shader decodes instances with
+  unsigned int materialBuf_ = 0, materialTex_ = 0;   ///< 3 texels per palette slot
+  unsigned int rotationBuf_ = 0, rotationTex_ = 0;   ///< 3 texels (columns) per orientation index
+  uint64_t materialVersion_ = 0, rotationVersion_ = 0;   ///< of the tables uploaded (0: none)
 
   bool wireframe_ = false;
+  bool meshing_ = true;
+  bool lod_ = true;
+  bool occlusion_ = true;
+  /// What rebuild jobs need of the palette: a copy, made when it changes.
+  struct MaterialSnapshot {
+    std::vector<glm::vec3> colours;     ///< per palette slot, averaged into coarse levels
+    std::vector<uint8_t> translucent;   ///< per palette slot
+  };
+  std::shared_ptr<const MaterialSnapshot> materialSnapshot_;
+  uint64_t snapshotVersion_ = 0;                       ///< palette version it was taken at
+  uint64_t epoch_ = 0;                                 ///< bumped by set_meshing
+  MortonSet dirty_, neighbours_;                       ///< sync_store scratch
+  // Snapshot versions: the one drawn, rebuilds outstanding per version, the settled one
+  uint64_t frameVersion_ = 0;
+  std::map<uint64_t, std::size_t> inflight_;
+  uint64_t settled_ = 0;
+  std::unordered_map<uint64_t, StoreBuffer> stores_;   ///< by ChunkStore::serial()
+  RenderStats stats_;
+  std::vector<Instance> staging_;                      ///< one block, padded with holes
+  // Background rebuilds: jobs go to pool_, results come back through done_ and
+  // wait in ready_ until the upload budget lets them through
+  double uploadBudgetMs_ = 4.0;
+  uint64_t nextJob_ = 0;
+  CompletionQueue<std::unique_ptr<ChunkBuild>> done_;
+  std::deque<std::unique_ptr<ChunkBuild>> ready_;
+  ThreadPool& pool_;
+  std::atomic<std::size_t> jobs_{0};                   ///< rebuilds submitted, not finished
+  std::atomic<bool> closing_{false};                   ///< set by ~Renderer: jobs still queued do nothing
+  std::vector<glm::vec4> tableStaging_;
+  // Per-frame culling scratch: world boxes of all blocks, their verdicts, visible runs
+  struct BoxRef {
+    Block block;                      ///< instance block, if mesh and translucent are null
+    const MeshBlock* mesh = nullptr;
+    IVec3 cc{0,0,0};
+    uint8_t level = 0;                ///< of mesh
+    const std::vector<Instance>* translucent = nullptr;
+  };
+  /// A store's pose and its boxes in boxRefs_: instance blocks in [begin, mid),
+  /// meshes in [mid, glass), translucent cubes in [glass, end).
+  struct StoreDraw {
+    const StoreBuffer* B = nullptr;
+    glm::mat4 M{1.0f};
+    std::size_t begin = 0, mid = 0, glass = 0, end = 0;
+  };
+  AabbBatch boxes_;
+  std::vector<BoxRef> boxRefs_;
+  std::vector<uint8_t> visible_;
+  std::vector<Block> runs_;
+  // Per-frame occlusion scratch: candidate occluders (world box, distance), the chosen ones
+  OcclusionBuffer occlusionBuf_;
+  std::vector<std::pair<float, Box3>> occluderCandidates_;
+  std::vector<Box3> occluderBoxes_;
+  // Translucent cubes: the visible chunks' cubes in one buffer, back to front;
+  // runs of one store are drawn with its pose. Kept while the chunks in view
+  // stay the same and the sorter says the order holds.
+  struct GlassChunk {
+    const std::vector<Instance>* cubes = nullptr;
+    glm::mat4 M{1.0f};
+    bool operator==(const GlassChunk&) const = default;
+  };
+  struct GlassRun {
+    glm::mat4 M{1.0f};
+    uint32_t first = 0, count = 0;
+  };
+  StoreBuffer glass_;                    ///< only vao, vbo, capacity and end are used
+  std::vector<GlassChunk> glassChunks_, glassSorted_;   ///< in view now / at the last sort
+  std::vector<GlassRun> glassRuns_;
+  uint64_t glassVersion_ = 0;            ///< bumped when translucent cubes or the chunks in view change
+  DepthSorter sorter_;
+  std::vector<glm::vec3> glassPoints_;   ///< world centres, for sorter_
+  std::vector<Instance> glassCubes_;     ///< in the order of glassPoints_
+  std::vector<uint32_t> glassOwner_;     ///< index into glassSorted_, per cube
 
-  void build_program();
+  /// (Re)fetch the programs from shaders_.
+  void build_programs();
   void build_cube_mesh();
   void draw_grid(const glm::mat4& VP) const;
+  void build_tables();
+  /// Re-upload the material / rotation tables whose version changed.
+  void upload_tables(const WorldSnapshot& W);
+
+  /// Schedule rebuilds for store snapshot S: every chunk if B is new, else those
+  /// that changed since B.snap.
+  void sync_store(const std::shared_ptr<const StoreSnapshot>& S, StoreBuffer& B);
+  /// Queue a job rebuilding `what` of chunk cc of S (REBUILD_*), on top of
+  /// whatever a job still in flight for cc was asked to rebuild. The job reads
+  /// the chunk from S. A chunk that no longer exists is dropped at once.
+  void schedule(const std::shared_ptr<const StoreSnapshot>& S, StoreBuffer& B, const IVec3& cc, uint8_t what);
+  /// A rebuild scheduled for snapshot `version` is uploaded, superseded or moot.
+  void settle(uint64_t version);
+  /// Upload finished rebuilds, oldest first, until the frame's budget is spent.
+  void apply_builds();
+  /// Write chunk cc's instances into its block (released if there are none).
+  void upload_instances(StoreBuffer& B, const IVec3& cc, const std::vector<Instance>& instances);
+  /// Replace chunk cc's mesh (dropped if it has no quads).
+  void upload_mesh(StoreBuffer& B, const IVec3& cc, const ChunkMesh& mesh);
+  /// Replace chunk cc's coarse level meshes (dropped if the chunk is empty).
+  void upload_lod(StoreBuffer& B, const IVec3& cc, const ChunkMesh (&levels)[LOD_LEVELS - 1]);
+  /// Upload `mesh` into mb, creating its buffers; deletes them if mesh is empty.
+  void fill_mesh(MeshBlock& mb, const ChunkMesh& mesh);
+  /// Lay B's blocks out again from slot 0, copying them on the GPU.
+  void repack(StoreBuffer& B);
+  /// Rasterize the nearest occluders in view and clear visible_ for the boxes
+  /// (boxes_) they hide.
+  void cull_occluded(const glm::mat4& V, const glm::mat4& P);
+  /// Blend the translucent cubes of visible chunks over the frame, farthest
+  /// first, sorting them again unless the last order still holds.
+  void draw_translucent(const std::vector<StoreDraw>& draws, const glm::vec3& eye);
+  void reserve_quads(uint32_t quads);
+  uint32_t alloc_block(StoreBuffer& B, uint8_t cls);
+  void free_block(StoreBuffer& B, const Block& b);
+  /// Make the GL buffer hold at least `slots` instances, keeping its content.
+  void reserve_slots(StoreBuffer& B, uint32_t slots);
+  /// Vertex array for B: the shared cube mesh plus B's instance attributes.
+  void bind_attributes(StoreBuffer& B) const;
+  void release(StoreBuffer& B) const;
 };
 
 } // namespace vxl
@@ -5,65 +5,90 @@
 
 namespace vxl {
 
-void Selection::clear() { set_.clear(); }
-void Selection::add(const IVec3& p) { set_.insert(p); }
+void Selection::clear() {
+  if (set_.empty()) return;
+  set_.clear();
+  ++version_;
+}
+void Selection::add(const IVec3& p) { if (Universe::in_world(p) && set_.insert(p)) ++version_; }
 void Selection::toggle(const IVec3& p) {
-  if (set_.count(p)) set_.erase(p); else set_.insert(p);
+  if (!Universe::in_world(p)) return;
+  if (!set_.erase(p)) set_.insert(p);
+  ++version_;
 }
-bool Selection::contains(const IVec3& p) const { return set_.count(p) != 0; }
-std::vector<IVec3> Selection::items() const { return std::vector<IVec3>(set_.begin(), set_.end()); }
+bool Selection::contains(const IVec3& p) const { return Universe::in_world(p) && set_.contains(p); }
 
-static bool ray_aabb(const glm::vec3& ro, const glm::vec3& rd,
-                     const glm::vec3& minB, const glm::vec3& maxB, float& tOut) {
-  // Slab method
-  float tmin = -std::numeric_limits<float>::infinity();
-  float tmax =  std::numeric_limits<float>::infinity();
-  for (int i=0;i<3;i++) {
-    float invD = 1.0f / rd[i];
-    float t0 = (minB[i] - ro[i]) * invD;
-    float t1 = (maxB[i] - ro[i]) * invD;
-    if (invD < 0.0f) std::swap(t0,t1);
-    tmin = std::max(tmin, t0);
-    tmax = std::min(tmax, t1);
-    if (tmax < tmin) return false;
-  }
-  tOut = tmin;
-  return tOut >= 0.0f;
+// Each op leaves the size unchanged only if it leaves the set unchanged (a
+// subset added, a superset intersected, a disjoint set removed).
+void Selection::unite(const VoxelMask& m) {
+  const std::size_t n = set_.size();
+  set_ |= m;
+  if (set_.size() != n) ++version_;
+}
+void Selection::intersect(const VoxelMask& m) {
+  const std::size_t n = set_.size();
+  set_ &= m;
+  if (set_.size() != n) ++version_;
+}
+void Selection::subtract(const VoxelMask& m) {
+  const std::size_t n = set_.size();
+  set_ -= m;
+  if (set_.size() != n) ++version_;
+}
+
+std::optional<RayHit> Selection::raycast(const Universe& U, const glm::vec3& ro, const glm::vec3& rd, float maxT) {
+  return cast_ray(U, Ray{ro, rd, maxT});
 }
 
 std::optional<IVec3> Selection::pick_cube(const Universe& U,
                                           const glm::vec3& ro,
                                           const glm::vec3& rd) {
-  float bestT = std::numeric_limits<float>::infinity();
-  std::optional<IVec3> best{};
-  for (auto&& [p, c] : U.all()) {
-    glm::vec3 minB{p.x - 0.5f, p.y - 0.5f, p.z - 0.5f};
-    glm::vec3 maxB{p.x + 0.5f, p.y + 0.5f, p.z + 0.5f};
-    float t;
-    if (ray_aabb(ro, rd, minB, maxB, t)) {
-      if (t < bestT) { bestT = t; best = p; }
-    }
-  }
-  return best;
+  auto hit = raycast(U, ro, rd);
+  if (!hit) return std::nullopt;
+  return hit->voxel;
 }
 
-void Selection::move(Universe& U, const IVec3& d) {
-  if (set_.empty()) return;
-  // Copy, then move to avoid collisions
-  std::vector<std::pair<IVec3, Cube>> temp;
-  temp.reserve(set_.size());
-  for (auto& p : set_) {
-    auto c = U.get(p.x,p.y,p.z);
-    if (c) temp.push_back({p, *c});
-  }
-  for (auto& [p,c] : temp) U.erase(p.x,p.y,p.z);
-  std::unordered_set<IVec3, IVec3Hash> newset;
-  for (auto& [p,c] : temp) {
-    IVec3 np{p.x + d.x, p.y + d.y, p.z + d.z};
-    U.place(np.x,np.y,np.z, c);
-    newset.insert(np);
+bool Selection::transform(Universe& U, const VoxelTransform& T, ThreadPool* pool) {
+  if (set_.empty() || T.identity()) return true;
+  const auto from = items();
+  VoxelMask newset;
+  for (const IVec3& p : from) {
+    const IVec3 q = T.apply(p);
+    if (!Universe::in_world(q)) return false;
+    newset.insert(q);
   }
-  set_.swap(newset);
+  std::vector<IVec3> src, dst;
+  std::vector<Cube> cubes;
+  src.reserve(from.size()); cubes.reserve(from.size());
+  U.visit_many(from, [&](const IVec3& p, const Cube& c) { src.push_back(p); cubes.push_back(c); });
+
+  // Destinations and turned codes per block; free rotations go through the side table after
+  const uint8_t turn = T.cube_turn();
+  const glm::quat turnQ = orientation_quat(turn);
+  constexpr std::size_t BLOCK = 4096;
+  dst.resize(src.size());
+  parallel_for(pool, (src.size() + BLOCK - 1) / BLOCK, [&](std::size_t b) {
+    for (std::size_t i = b * BLOCK, e = std::min(src.size(), i + BLOCK); i < e; ++i) {
+      dst[i] = T.apply(src[i]);
+      Cube& c = cubes[i];
+      if (turn != 0 && c.rotation.axis_aligned()) c.rotation.code = orientation_compose(turn, c.rotation.code);
+    }
+  });
+  // intern_rotation, not set_rotation: a sweep now would free slots taken by earlier cubes
+  if (turn != 0)
+    for (Cube& c : cubes)
+      if (!c.rotation.axis_aligned()) c.freeRot = U.intern_rotation(turnQ * U.rotation(c));
+
+  // All reads are done, so overlapping sources and destinations are safe
+  U.erase_many(src);
+  U.place_many(dst, cubes);
+  std::swap(set_, newset);
+  ++version_;
+  return true;
+}
+
+bool Selection::move(Universe& U, const IVec3& d, ThreadPool* pool) {
+  return transform(U, VoxelTransform::translation(d), pool);
 }
 
 void Selection::rotate(Universe& U, char axis, float degrees) {
@@ -72,12 +97,13 @@ void Selection::rotate(Universe& U, char axis, float degrees) {
   float rad = glm::radians(degrees);
   glm::vec3 ax = (axis=='x') ? glm::vec3(1,0,0) : (axis=='y') ? glm::vec3(0,1,0) : glm::vec3(0,0,1);
   glm::quat rq = glm::angleAxis(rad, glm::normalize(ax));
-  for (auto& p : set_) {
-    auto c = U.get(p.x,p.y,p.z);
-    if (!c) continue;
-    c->rotation = rq * c->rotation;
-    U.place(p.x,p.y,p.z, *c);
-  }
+  auto rcode = snap_orientation(rq);
+  set_.for_each_slice(EDIT_SLICE, [&](std::span<const IVec3> slice) {
+    U.update_many(slice, [&](const IVec3&, Cube& c){
+      if (rcode && c.rotation.axis_aligned()) c.rotation.code = orientation_compose(*rcode, c.rotation.code);
+      else U.set_rotation(c, rq * U.rotation(c));  // snaps back to a code when it lands on one
+    });
+  });
 }
 
 } // namespace vxl
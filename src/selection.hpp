@@ -1,9 +1,12 @@
 #pragma once
 #include <glm/glm.hpp>
-#include <unordered_set>
 #include <vector>
 #include "util.hpp"
 #include "universe.hpp"
+#include "voxel_mask.hpp"
+#include "ray_query.hpp"
+#include "thread_pool.hpp"
+#include "voxel_transform.hpp"
 
 /** @file selection.hpp
  *  @brief Selection manager with ray casting and basic manipulation.
@@ -17,22 +20,60 @@ public:
   void add(const IVec3& p);
   void toggle(const IVec3& p);
   bool contains(const IVec3& p) const;
-  std::vector<IVec3> items() const;
+  bool empty() const noexcept { return set_.empty(); }
+  std::size_t size() const noexcept { return set_.size(); }
+  /// Every selected coordinate; prefer for_each() or set().for_each_slice() for large selections.
+  std::vector<IVec3> items() const { return set_.items(); }
+  /// fn(const IVec3&) per selected coordinate, without allocating.
+  template <class Fn> void for_each(Fn&& fn) const { set_.for_each(fn); }
+  /// Bumped whenever the set of selected coordinates changes.
+  uint64_t version() const noexcept { return version_; }
+  /// Selected coordinates; copies share chunk masks, so snapshots take one cheaply.
+  const VoxelMask& set() const noexcept { return set_; }
 
-  /// Ray-cast to nearest cube center-aligned AABB (size 1), returns coordinate if hit.
+  // Set algebra, a 64-bit word at a time.
+  void unite(const VoxelMask& m);
+  void intersect(const VoxelMask& m);
+  void subtract(const VoxelMask& m);
+
+  /// Coordinates per call when edits walk a selection with set().for_each_slice().
+  static constexpr std::size_t EDIT_SLICE = 1 << 16;
+
+  /// Default reach of raycast(), in units of the ray direction's length.
+  static constexpr float PICK_DISTANCE = RAY_REACH;
+
+  /// First cube the ray rayOrigin + t * rayDir enters for t in [0, maxT]
+  /// (cast_ray: a grid walk, so the cost follows the distance covered).
+  static std::optional<RayHit> raycast(const Universe& U, const glm::vec3& rayOrigin, const glm::vec3& rayDir,
+                                       float maxT = PICK_DISTANCE);
+  /// Coordinate of raycast()'s cube.
   static std::optional<IVec3> pick_cube(const Universe& U,
                                         const glm::vec3& rayOrigin,
                                         const glm::vec3& rayDir);
 
-  /// Move all selected cubes by integer delta (preserves materials).
-  void move(Universe& U, const IVec3& d);
+  /** @brief Carry the selected cubes, and the selection, through T: positions
+   *         move and each cube's orientation turns with them.
+   *
+   *  Every cube is read before any is written, so sources and destinations may
+   *  overlap. Destinations and turned orientations are computed on the pool;
+   *  the writes are one erase_many and one place_many, so history and journals
+   *  see them in order. Cubes land ungrouped. Only the cube seen at each
+   *  coordinate moves: a group cube shadowed by an ungrouped one stays, and
+   *  shows once the ungrouped cube has left. Returns false, changing nothing,
+   *  if any selected coordinate would leave in_world().
+   */
+  bool transform(Universe& U, const VoxelTransform& T, ThreadPool* pool = nullptr);
+
+  /// Move all selected cubes by integer delta (preserves materials); transform()
+  /// with a translation.
+  bool move(Universe& U, const IVec3& d, ThreadPool* pool = nullptr);
 
-  /// Rotate selection around its centroid by degrees on axis (x/y/z).
+  /// Spin each selected cube in place by degrees on axis (x/y/z); positions stay.
   void rotate(Universe& U, char axis, float degrees);
 
 private:
-  struct IVec3Hash { std::size_t operator()(const IVec3& k) const noexcept { return IVec3Hasher{}(k); } };
-  std::unordered_set<IVec3, IVec3Hash> set_;
+  VoxelMask set_;
+  uint64_t version_ = 0;
 };
 
 } // namespace vxl
@@ -0,0 +1,155 @@
+#include "shader_cache.hpp"
+#include <GL/glew.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace vxl {
+
+namespace {
+
+constexpr std::chrono::milliseconds POLL_INTERVAL{250};
+
+std::string read_text_file(const std::string& path) {
+  std::ifstream f(path);
+  if (!f) throw std::runtime_error("Cannot read file: " + path);
+  std::stringstream ss; ss << f.rdbuf();
+  return ss.str();
+}
+
+std::string gl_string(GLenum name) {
+  const GLubyte* s = glGetString(name);
+  return s ? reinterpret_cast<const char*>(s) : "";
+}
+
+GLuint compile_shader(GLenum type, const std::string& src, const std::string& name) {
+  GLuint s = glCreateShader(type);
+  const char* c = src.c_str();
+  glShaderSource(s, 1, &c, nullptr);
+  glCompileShader(s);
+  GLint ok=0; glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    GLint len=0; glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
+    std::string log(len, '\0'); glGetShaderInfoLog(s, len, nullptr, log.data());
+    glDeleteShader(s);
+    throw std::runtime_error("Shader compile failed (" + name + "): " + log);
+  }
+  return s;
+}
+
+/// Throws, deleting prog, if it did not link.
+void check_link(GLuint prog, const std::string& name) {
+  GLint ok=0; glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+  if (ok) return;
+  GLint len=0; glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &len);
+  std::string log(std::max(len, 1), '\0'); glGetProgramInfoLog(prog, len, nullptr, log.data());
+  glDeleteProgram(prog);
+  throw std::runtime_error("Program link failed (" + name + "): " + log);
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(std::string shaderDir, std::string cacheDir)
+    : shaderDir_(std::move(shaderDir)), cache_(std::move(cacheDir)) {
+  driver_ = gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" + gl_string(GL_VERSION) + "\n" +
+            gl_string(GL_SHADING_LANGUAGE_VERSION);
+  if (cache_.enabled() && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binaries_ = formats > 0;
+  }
+}
+
+ShaderCache::~ShaderCache() {
+  for (const Entry& e : entries_) glDeleteProgram(e.id);
+}
+
+unsigned int ShaderCache::program(const std::string& vert, const std::string& frag) {
+  for (const Entry& e : entries_)
+    if (e.vert == vert && e.frag == frag) return e.id;
+  const unsigned int id = build(vert, frag);
+  entries_.push_back({vert, frag, id});
+  watcher_.watch(path(vert));
+  watcher_.watch(path(frag));
+  return id;
+}
+
+unsigned int ShaderCache::build(const std::string& vert, const std::string& frag) {
+  const auto start = std::chrono::steady_clock::now();
+  const std::string name = vert + " + " + frag;
+  const std::string vs = read_text_file(path(vert)), fs = read_text_file(path(frag));
+  const std::string_view sources[] = {vs, fs};
+  const uint64_t key = program_key(sources, driver_);
+  auto done = [&](GLuint prog, bool cached) {
+    ++stats_.programs;
+    stats_.fromCache += cached;
+    stats_.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return prog;
+  };
+
+  if (binaries_) {
+    if (auto bin = cache_.load(key)) {
+      GLuint prog = glCreateProgram();
+      glProgramBinary(prog, GLenum(bin->format), bin->data.data(), GLsizei(bin->data.size()));
+      GLint ok = 0; glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+      if (ok) return done(prog, true);
+      // Made by another driver build: compile, and cache what this one makes
+      glDeleteProgram(prog);
+      cache_.erase(key);
+    }
+  }
+
+  GLuint v = compile_shader(GL_VERTEX_SHADER, vs, vert), f = 0;
+  try {
+    f = compile_shader(GL_FRAGMENT_SHADER, fs, frag);
+  } catch (...) {
+    glDeleteShader(v);
+    throw;
+  }
+  GLuint prog = glCreateProgram();
+  if (binaries_) glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glAttachShader(prog, v); glAttachShader(prog, f);
+  glLinkProgram(prog);
+  glDeleteShader(v); glDeleteShader(f);   // freed with the program
+  check_link(prog, name);
+
+  if (binaries_) {
+    GLint len = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len > 0) {
+      ProgramBinary bin;
+      bin.data.resize(std::size_t(len));
+      GLenum format = 0;
+      glGetProgramBinary(prog, len, nullptr, &format, bin.data.data());
+      bin.format = format;
+      if (!cache_.save(key, bin)) messages_.push_back("Cannot write shader cache in " + cache_.dir());
+    }
+  }
+  return done(prog, false);
+}
+
+bool ShaderCache::poll() {
+  const auto now = std::chrono::steady_clock::now();
+  if (now < nextPoll_) return false;
+  nextPoll_ = now + POLL_INTERVAL;
+  const std::vector<std::string> changed = watcher_.poll();
+  if (changed.empty()) return false;
+  auto touched = [&](const std::string& file) { return std::find(changed.begin(), changed.end(), path(file)) != changed.end(); };
+  bool replaced = false;
+  for (Entry& e : entries_) {
+    if (!touched(e.vert) && !touched(e.frag)) continue;
+    try {
+      const unsigned int id = build(e.vert, e.frag);
+      glDeleteProgram(e.id);
+      e.id = id;
+      replaced = true;
+      messages_.push_back("Reloaded shaders " + e.vert + " + " + e.frag);
+    } catch (std::exception& ex) {
+      messages_.push_back(ex.what());
+    }
+  }
+  return replaced;
+}
+
+} // namespace vxl
@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include "program_cache.hpp"
+
+/** @file shader_cache.hpp
+ *  @brief GL shader programs built from the files in a shader directory, loaded
+ *         from cached program binaries when possible, and rebuilt when their
+ *         sources change on disk.
+ */
+
+namespace vxl {
+
+/** @brief Owns the renderer's GL programs.
+ *
+ *  A program is looked up in the ProgramCache under program_key() of its
+ *  sources and the driver strings, and handed to glProgramBinary. If there is
+ *  no binary, the driver has no binary formats, or it rejects the binary (after
+ *  a driver update, say), the sources are compiled and linked as usual and the
+ *  result is cached for the next start. Needs a current GL context throughout.
+ */
+class ShaderCache {
+public:
+  /// What building the programs cost, since construction.
+  struct Stats {
+    std::size_t programs = 0;    ///< builds, reloads included
+    std::size_t fromCache = 0;   ///< of those, loaded from a cached binary
+    double ms = 0.0;             ///< time spent building them
+  };
+
+  /// Sources from `shaderDir`; binaries under `cacheDir` (none if empty).
+  ShaderCache(std::string shaderDir, std::string cacheDir);
+  ~ShaderCache();
+  ShaderCache(const ShaderCache&) = delete;
+  ShaderCache& operator=(const ShaderCache&) = delete;
+
+  /// The program linking shader files `vert` and `frag`, built on the first
+  /// request. Throws std::runtime_error if it does not compile or link.
+  unsigned int program(const std::string& vert, const std::string& frag);
+  /// Rebuild the programs whose source files changed (checked at most every
+  /// 250 ms). One that no longer compiles keeps its old program, and the error
+  /// goes to the messages. Returns true if a program object was replaced:
+  /// request it again.
+  bool poll();
+  /// Reloads and compile errors since the last call, for the console.
+  std::vector<std::string> take_messages() { return std::move(messages_); }
+
+  /// Whether the driver can save and load program binaries.
+  bool binaries() const noexcept { return binaries_; }
+  const Stats& stats() const noexcept { return stats_; }
+
+private:
+  struct Entry {
+    std::string vert, frag;
+    unsigned int id = 0;
+  };
+  std::string shaderDir_;
+  ProgramCache cache_;
+  std::string driver_;          ///< vendor, renderer and version strings
+  bool binaries_ = false;
+  std::vector<Entry> entries_;
+  FileWatcher watcher_;
+  std::chrono::steady_clock::time_point nextPoll_{};
+  std::vector<std::string> messages_;
+  Stats stats_;
+
+  std::string path(const std::string& file) const { return shaderDir_ + "/" + file; }
+  /// A new program for vert + frag, from the cache or compiled; throws on failure.
+  unsigned int build(const std::string& vert, const std::string& frag);
+};
+
+} // namespace vxl
@@ -0,0 +1,94 @@
+#include "simulation.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace vxl {
+
+Simulation::Simulation(ThreadPool& pool, const std::string& session, int baseEdgePixels)
+  : U_(baseEdgePixels), pool_(pool) {
+  register_builtin_commands(Cmds_);
+  if (!session.empty()) open_session(session);
+  Hist_.clear();
+  publish(nullptr);
+  thread_ = std::thread([this] { loop(); });
+}
+
+Simulation::~Simulation() {
+  stop_.store(true, std::memory_order_release);
+  wake_.release();
+  thread_.join();
+}
+
+void Simulation::open_session(const std::string& base) {
+  bool recovered = false;
+  U_.remove_journal(&Hist_);   // recovery is not an undoable edit
+  try {
+    Log_ = std::make_unique<EditLog>(U_, base + ".wal", base + ".vxs");
+    const auto& r = Log_->recovered();
+    recovered = r.snapshot || r.transactions > 0;
+    if (recovered) {
+      print("Recovered session " + base + ": " + std::to_string(U_.size()) + " cubes, " +
+            std::to_string(r.transactions) + " logged transactions" + (r.tornTail ? " (torn tail dropped)" : ""));
+    }
+  } catch (std::exception& e) {
+    print(std::string("Edit log disabled: ") + e.what());
+  }
+  U_.add_journal(&Hist_);
+
+  // Seed: a few cubes
+  if (!recovered) for (int z=0; z<3; ++z) U_.place(z,0,0);
+}
+
+void Simulation::post(Edit edit) {
+  posted_.fetch_add(1, std::memory_order_relaxed);
+  inbox_.push({std::move(edit), Clock::now()});
+  wake_.release();
+}
+
+void Simulation::wait_idle() {
+  std::unique_lock lock(idleMu_);
+  idle_.wait(lock, [&] { return done_.load(std::memory_order_acquire) >= posted_.load(std::memory_order_acquire); });
+}
+
+void Simulation::loop() {
+  Context ctx{U_, Sel_, Hist_, Log_.get(), Cmds_, [this](const std::string& s) { print(s); }, pool_};
+  for (;;) {
+    wake_.acquire();
+    // Everything posted by now is one batch, shown by one snapshot
+    bool any = false;
+    Clock::time_point oldest{};
+    const std::size_t n = inbox_.drain([&](Posted&& p) {
+      if (!any || p.at < oldest) oldest = p.at;
+      any = true;
+      try {
+        p.edit(ctx);
+      } catch (std::exception& e) {
+        print(std::string("Error: ") + e.what());
+      }
+    });
+    if (n) {
+      publish(&oldest);
+      U_.page_out();
+      if (Log_) Log_->publish();
+      {
+        std::lock_guard lock(idleMu_);
+        done_.fetch_add(n, std::memory_order_release);
+      }
+      idle_.notify_all();
+    }
+    if (stop_.load(std::memory_order_acquire) && inbox_.empty()) break;
+  }
+}
+
+void Simulation::publish(const Clock::time_point* oldest) {
+  if (oldest) unread_.push_back({builder_.next_version(), *oldest});
+  std::shared_ptr<const WorldSnapshot> snap = builder_.build(U_, Sel_, unread_);
+  // If the reader took the snapshot this one displaces, it has seen every stamp
+  // but this one's
+  if (!latest_.publish(std::move(snap)))
+    unread_.erase(std::remove_if(unread_.begin(), unread_.end(), [&](const EditStamp& e) {
+      return e.version < builder_.last()->version;
+    }), unread_.end());
+}
+
+} // namespace vxl
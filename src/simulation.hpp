@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+#include "commands.hpp"
+#include "thread_pool.hpp"
+#include "world_snapshot.hpp"
+
+/** @file simulation.hpp
+ *  @brief The editing side of the app on its own thread: owns the Universe and
+ *         Selection, runs the edits other threads post, and publishes a
+ *         WorldSnapshot after each batch of them.
+ */
+
+namespace vxl {
+
+/** @brief Owns the world and edits it on a thread of its own.
+ *
+ *  Other threads never touch the Universe: they post() edits, which run in the
+ *  order posted, and read the newest WorldSnapshot. After each batch of edits
+ *  the simulation publishes a snapshot (through a TripleBuffer, so neither side
+ *  waits for the other), then pages out chunks and hands the implicit
+ *  transaction to the edit log, as the main loop used to between frames.
+ *  One thread reads snapshots (update(), snapshot(), drain_messages()).
+ */
+class Simulation {
+public:
+  using Clock = WorldSnapshot::Clock;
+
+  /// What an edit works with; only valid during the edit.
+  struct Context {
+    Universe& U;
+    Selection& Sel;
+    History& history;
+    EditLog* log;                                    ///< null if the session log is off
+    CommandRegistry& commands;
+    std::function<void(const std::string&)> print;   ///< to the reader (drain_messages)
+    ThreadPool& pool;                                ///< workers for queries over snapshots
+  };
+  using Edit = std::function<void(Context&)>;
+
+  /// Open (or recover) the session with files `session` + .vxs / .wal, seeding a
+  /// new one with a few cubes; with an empty name, start empty without a log.
+  /// Publishes the first snapshot before returning. `pool` runs edits' parallel
+  /// work (Context::pool) and must outlive the simulation; the app shares one
+  /// with the renderer, so the two split the cores instead of oversubscribing them.
+  explicit Simulation(ThreadPool& pool, const std::string& session = {}, int baseEdgePixels = 64);
+  /// Runs the edits posted so far, then stops the thread.
+  ~Simulation();
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  /// Any thread: run `edit` on the simulation thread after those posted before
+  /// it. Exceptions it throws are printed.
+  void post(Edit edit);
+  /// Any thread: block until every edit posted so far has run and a snapshot
+  /// showing them is published.
+  void wait_idle();
+  /// Edits posted and not finished.
+  std::size_t pending() const noexcept {
+    return posted_.load(std::memory_order_relaxed) - done_.load(std::memory_order_relaxed);
+  }
+
+  /// Reader: move to the newest snapshot; returns whether there was a new one.
+  bool update() { return latest_.update(); }
+  /// Reader: the snapshot update() last moved to; null before the first update().
+  const std::shared_ptr<const WorldSnapshot>& snapshot() const noexcept { return latest_.front(); }
+  /// Reader: fn(std::string&&) for each line edits printed since the last call.
+  template <class Fn> std::size_t drain_messages(Fn&& fn) { return messages_.drain(std::forward<Fn>(fn)); }
+
+private:
+  struct Posted {
+    Edit edit;
+    Clock::time_point at;
+  };
+
+  Universe U_;
+  History Hist_{U_};
+  std::unique_ptr<EditLog> Log_;
+  Selection Sel_;
+  CommandRegistry Cmds_;
+  SnapshotBuilder builder_;
+  std::vector<EditStamp> unread_;   ///< of published snapshots the reader may not have taken
+  TripleBuffer<std::shared_ptr<const WorldSnapshot>> latest_;
+  CompletionQueue<Posted> inbox_;
+  CompletionQueue<std::string> messages_;
+  std::counting_semaphore<> wake_{0};   ///< released once per post (and to stop)
+  std::atomic<std::size_t> posted_{0}, done_{0};
+  std::atomic<bool> stop_{false};
+  std::mutex idleMu_;
+  std::condition_variable idle_;
+  ThreadPool& pool_;
+  std::thread thread_;   ///< last: started once everything else exists
+
+  void open_session(const std::string& base);
+  void print(const std::string& s) { messages_.push(s); }
+  void loop();
+  /// Snapshot the world and hand it to the reader; `oldest` is the post time of
+  /// the oldest edit it is the first to show, if any.
+  void publish(const Clock::time_point* oldest);
+};
+
+} // namespace vxl
@@ -0,0 +1,320 @@
+#include "snapshot.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace vxl {
+
+static_assert(std::endian::native == std::endian::little, "snapshot files are little-endian");
+static_assert(sizeof(SnapHeader) == 80 && sizeof(SnapMaterial) == 48 && sizeof(SnapGroup) == 24);
+static_assert(sizeof(SnapChunk) == 32 && sizeof(SnapVoxel) == 8);
+
+namespace {
+
+constexpr uint64_t BITMAP_WORDS = CHUNK_VOLUME / 64;
+
+uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+/// Payload bytes of a chunk with `count` voxels in the given encoding.
+uint64_t payload_bytes(uint32_t encoding, uint64_t count) {
+  uint64_t head = (encoding == SnapChunk::BITMAP) ? BITMAP_WORDS * 8 : align8(count * 2);
+  return head + count * sizeof(SnapVoxel);
+}
+
+template <class T> T read_at(const std::byte* base, uint64_t offset) {
+  T v;
+  std::memcpy(&v, base + offset, sizeof(T));
+  return v;
+}
+
+class Writer {
+public:
+  explicit Writer(const std::string& path) : out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_) throw std::runtime_error("Cannot write file: " + path);
+  }
+  void write(const void* p, std::size_t n) {
+    out_.write(static_cast<const char*>(p), std::streamsize(n));
+    pos_ += n;
+  }
+  template <class T> void put(const T& v) { write(&v, sizeof(T)); }
+  void pad8() {
+    static const char zeros[8] = {};
+    write(zeros, align8(pos_) - pos_);
+  }
+  uint64_t pos() const { return pos_; }
+  std::ofstream& stream() { return out_; }
+
+private:
+  std::ofstream out_;
+  uint64_t pos_ = 0;
+};
+
+/// Decodes chunk payloads out of a mapped snapshot on demand.
+class SnapshotSource : public IChunkSource {
+public:
+  SnapshotSource(std::string path, std::unique_ptr<MappedFile> file, uint64_t directoryOffset,
+                 std::vector<MaterialId> mats, std::vector<uint32_t> rots)
+    : path_(std::move(path)), file_(std::move(file)), dir_(directoryOffset), mats_(std::move(mats)),
+      rots_(std::move(rots)) {}
+
+  /// True if this source maps the file at `path`.
+  bool maps(const std::string& path) const {
+    std::error_code ec;
+    return std::filesystem::equivalent(path_, path, ec);
+  }
+
+  void load(uint32_t id, Chunk& out) override {
+    const std::byte* base = file_->data();
+    auto e = read_at<SnapChunk>(base, dir_ + uint64_t(id) * sizeof(SnapChunk));
+    uint64_t at = e.offset;
+    std::vector<uint16_t> idx(e.count);
+    if (e.encoding == SnapChunk::BITMAP) {
+      std::size_t k = 0;
+      for (uint64_t w = 0; w < BITMAP_WORDS; ++w, at += 8) {
+        for (uint64_t bits = read_at<uint64_t>(base, at); bits; bits &= bits - 1) {
+          if (k == idx.size()) throw std::runtime_error("snapshot: corrupt chunk bitmap");
+          idx[k++] = uint16_t(w * 64 + std::countr_zero(bits));
+        }
+      }
+      if (k != idx.size()) throw std::runtime_error("snapshot: corrupt chunk bitmap");
+    } else {
+      std::memcpy(idx.data(), base + at, idx.size() * sizeof(uint16_t));
+      at += align8(idx.size() * sizeof(uint16_t));
+      for (std::size_t k = 0; k < idx.size(); ++k)
+        if (idx[k] >= CHUNK_VOLUME || (k && idx[k] <= idx[k - 1])) throw std::runtime_error("snapshot: corrupt chunk index");
+    }
+    std::vector<Cube> cubes(e.count);
+    for (std::size_t k = 0; k < cubes.size(); ++k, at += sizeof(SnapVoxel)) {
+      auto v = read_at<SnapVoxel>(base, at);
+      bool free = v.rotation == Orientation::FREE;
+      if (v.mat >= mats_.size() || (!free && v.rotation >= Orientation::COUNT) || (free && v.freeRot >= rots_.size()))
+        throw std::runtime_error("snapshot: corrupt voxel");
+      cubes[k].mat = mats_[v.mat];
+      cubes[k].rotation.code = v.rotation;
+      cubes[k].freeRot = free ? rots_[v.freeRot] : 0;
+    }
+    out.set_sorted(idx, cubes);
+  }
+
+  void mark_used(std::vector<bool>& materials, std::vector<bool>& rotations) const override {
+    for (MaterialId m : mats_) materials[m] = true;
+    for (uint32_t r : rots_) rotations[r] = true;
+  }
+
+private:
+  std::string path_;
+  std::unique_ptr<MappedFile> file_;
+  uint64_t dir_;
+  std::vector<MaterialId> mats_;   ///< file palette index -> universe palette id
+  std::vector<uint32_t> rots_;     ///< file rotation index -> universe side-table slot
+};
+
+} // namespace
+
+void Snapshot::save(const Universe& U, const std::string& path) {
+  // Stores in file order: ungrouped first, then groups by name
+  std::vector<const std::pair<const std::string, Group>*> groups;
+  for (auto& kv : U.groups_) groups.push_back(&kv);
+  std::sort(groups.begin(), groups.end(), [](auto* a, auto* b){ return a->first < b->first; });
+  std::vector<const ChunkStore*> stores{&U.cubes_};
+  for (auto* g : groups) stores.push_back(&g->second.cubes);
+
+  // Keep only the palette / rotation slots in use (sources and the page file
+  // answer for chunks that are not resident, so nothing is loaded for this)
+  std::vector<bool> usedMat(U.palette_.slots(), false), usedRot(U.rotations_.slots(), false);
+  U.mark_used(usedMat, usedRot);
+  usedMat[0] = true;
+  std::vector<uint16_t> matRemap(usedMat.size(), 0);
+  std::vector<uint32_t> rotRemap(usedRot.size(), 0);
+  uint32_t materialCount = 0, rotationCount = 0;
+  for (std::size_t i = 0; i < usedMat.size(); ++i) if (usedMat[i]) matRemap[i] = uint16_t(materialCount++);
+  for (std::size_t i = 0; i < usedRot.size(); ++i) if (usedRot[i]) rotRemap[i] = rotationCount++;
+
+  const std::string tmp = path + ".tmp";
+  SnapHeader h{};
+  std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof h.magic);
+  h.version = SNAPSHOT_VERSION;
+  h.headerSize = sizeof(SnapHeader);
+  h.baseEdgePixels = U.base_edge_pixels();
+  h.materialCount = materialCount;
+  h.rotationCount = rotationCount;
+  h.groupCount = uint32_t(groups.size());
+  {
+    Writer w(tmp);
+    w.put(h);   // rewritten with the offsets at the end
+
+    h.materialOffset = w.pos();
+    for (std::size_t i = 0; i < usedMat.size(); ++i) {
+      if (!usedMat[i]) continue;
+      const Material& m = U.palette_.get(MaterialId(i));
+      SnapMaterial sm{};
+      sm.kind = uint32_t(m.kind);
+      for (int k = 0; k < 4; ++k) { sm.colorA[k] = m.colorA[k]; sm.colorB[k] = m.colorB[k]; }
+      for (int k = 0; k < 3; ++k) sm.gradDir[k] = m.gradDir[k];
+      w.put(sm);
+    }
+
+    h.rotationOffset = w.pos();
+    for (std::size_t i = 0; i < usedRot.size(); ++i) {
+      if (!usedRot[i]) continue;
+      const glm::quat& q = U.rotations_.quat(uint32_t(i));
+      float f[4] = {q.x, q.y, q.z, q.w};
+      w.write(f, sizeof f);
+    }
+
+    h.groupOffset = w.pos();
+    for (auto* g : groups) {
+      SnapGroup sg{};
+      sg.offset[0] = g->second.offset.x; sg.offset[1] = g->second.offset.y; sg.offset[2] = g->second.offset.z;
+      sg.orient = g->second.orient;
+      sg.nameLength = uint32_t(g->first.size());
+      w.put(sg);
+      w.write(g->first.data(), g->first.size());
+      w.pad8();
+    }
+
+    // Payloads in Morton order per store, so nearby chunks are nearby on disk
+    std::vector<SnapChunk> dir;
+    std::vector<uint16_t> idx;
+    std::vector<SnapVoxel> vox;
+    for (uint32_t si = 0; si < stores.size(); ++si) {
+      // Chunks read from the file being replaced are moved off it as they are
+      // written: Windows cannot replace a file that is still mapped
+      auto* src = dynamic_cast<const SnapshotSource*>(stores[si]->source());
+      const bool detach = src && src->maps(path);
+      std::vector<KeyIndex> order;
+      std::vector<IVec3> coords;
+      stores[si]->for_each_chunk_coord([&](const IVec3& cc){
+        order.push_back({morton_encode(cc), uint32_t(coords.size())});
+        coords.push_back(cc);
+      });
+      radix_sort(order);
+      for (auto& o : order) {
+        const IVec3& cc = coords[o.index];
+        const Chunk& ch = *stores[si]->chunk(cc);
+        idx.clear(); vox.clear();
+        ch.for_each([&](int i, const Cube& c){
+          idx.push_back(uint16_t(i));
+          bool free = !c.rotation.axis_aligned();
+          vox.push_back({matRemap[c.mat], c.rotation.code, 0, free ? rotRemap[c.freeRot] : 0});
+        });
+        SnapChunk e{};
+        e.cx = cc.x; e.cy = cc.y; e.cz = cc.z;
+        e.store = si;
+        e.count = uint32_t(idx.size());
+        e.encoding = (ch.size() > Chunk::DENSE_AT) ? SnapChunk::BITMAP : SnapChunk::SPARSE;
+        e.offset = w.pos();
+        if (e.encoding == SnapChunk::BITMAP) {
+          uint64_t occ[BITMAP_WORDS] = {};
+          for (uint16_t i : idx) occ[i >> 6] |= uint64_t(1) << (i & 63);
+          w.write(occ, sizeof occ);
+        } else {
+          w.write(idx.data(), idx.size() * sizeof(uint16_t));
+          w.pad8();
+        }
+        w.write(vox.data(), vox.size() * sizeof(SnapVoxel));
+        dir.push_back(e);
+        h.voxelCount += e.count;
+        if (detach) stores[si]->release_source(cc);
+        U.page_out();   // a paged universe streams through memory instead of loading whole
+      }
+    }
+
+    h.directoryOffset = w.pos();
+    h.chunkCount = dir.size();
+    w.write(dir.data(), dir.size() * sizeof(SnapChunk));
+    w.stream().seekp(0);
+    w.stream().write(reinterpret_cast<const char*>(&h), sizeof h);
+    w.stream().flush();
+    if (!w.stream()) throw std::runtime_error("Write failed: " + tmp);
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) throw std::runtime_error("Cannot replace " + path + ": " + ec.message());
+}
+
+void Snapshot::load(Universe& U, const std::string& path) {
+  auto file = std::make_unique<MappedFile>(path);
+  const std::byte* base = file->data();
+  const uint64_t size = file->size();
+  auto bad = [&](const char* what) { return std::runtime_error(path + ": " + what); };
+  auto fits = [&](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+
+  if (size < sizeof(SnapHeader)) throw bad("not a voxel snapshot");
+  auto h = read_at<SnapHeader>(base, 0);
+  if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof h.magic) != 0) throw bad("not a voxel snapshot");
+  if (h.version != SNAPSHOT_VERSION) throw bad(("unsupported snapshot version " + std::to_string(h.version)).c_str());
+  if (h.headerSize < sizeof(SnapHeader)) throw bad("truncated header");
+  if (h.materialCount == 0 || h.materialCount > MaterialPalette::MAX_ENTRIES ||
+      !fits(h.materialOffset, uint64_t(h.materialCount) * sizeof(SnapMaterial)) ||
+      !fits(h.rotationOffset, uint64_t(h.rotationCount) * 16) ||
+      h.chunkCount >= ~uint32_t(0) || !fits(h.directoryOffset, h.chunkCount * sizeof(SnapChunk)))
+    throw bad("corrupt section table");
+
+  // Parse and validate everything small before touching U
+  std::vector<Material> materials(h.materialCount);
+  for (uint32_t i = 0; i < h.materialCount; ++i) {
+    auto sm = read_at<SnapMaterial>(base, h.materialOffset + uint64_t(i) * sizeof(SnapMaterial));
+    Material& m = materials[i];
+    m.kind = sm.kind ? Material::Kind::Gradient : Material::Kind::Solid;
+    m.colorA = {sm.colorA[0], sm.colorA[1], sm.colorA[2], sm.colorA[3]};
+    m.colorB = {sm.colorB[0], sm.colorB[1], sm.colorB[2], sm.colorB[3]};
+    m.gradDir = {sm.gradDir[0], sm.gradDir[1], sm.gradDir[2]};
+  }
+  std::vector<glm::quat> rotations(h.rotationCount);
+  for (uint32_t i = 0; i < h.rotationCount; ++i) {
+    float f[4];
+    std::memcpy(f, base + h.rotationOffset + uint64_t(i) * 16, sizeof f);
+    rotations[i] = glm::quat(f[3], f[0], f[1], f[2]);
+  }
+  std::vector<std::pair<std::string, GroupPose>> groups;
+  uint64_t at = h.groupOffset;
+  for (uint32_t i = 0; i < h.groupCount; ++i) {
+    if (!fits(at, sizeof(SnapGroup))) throw bad("corrupt group table");
+    auto sg = read_at<SnapGroup>(base, at);
+    at += sizeof(SnapGroup);
+    if (!fits(at, sg.nameLength) || sg.orient >= Orientation::COUNT) throw bad("corrupt group table");
+    GroupPose pose{{sg.offset[0], sg.offset[1], sg.offset[2]}, uint8_t(sg.orient)};
+    groups.emplace_back(std::string(reinterpret_cast<const char*>(base + at), sg.nameLength), pose);
+    at = align8(at + sg.nameLength);
+  }
+  // Chunk coordinates are checked as such: scaling a corrupt one up could overflow
+  auto chunk_in_range = [](int c) { return c >= (MORTON_MIN >> CHUNK_SHIFT) && c <= (MORTON_MAX >> CHUNK_SHIFT); };
+  for (uint64_t i = 0; i < h.chunkCount; ++i) {
+    auto e = read_at<SnapChunk>(base, h.directoryOffset + i * sizeof(SnapChunk));
+    if (e.store > groups.size() || e.count == 0 || e.count > uint32_t(CHUNK_VOLUME) ||
+        e.encoding > SnapChunk::BITMAP || !fits(e.offset, payload_bytes(e.encoding, e.count)) ||
+        !chunk_in_range(e.cx) || !chunk_in_range(e.cy) || !chunk_in_range(e.cz))
+      throw bad("corrupt chunk directory");
+  }
+
+  // Install: tables now, chunks as lazy directory entries
+  U.clear();
+  U.set_base_edge_pixels(h.baseEdgePixels);
+  std::vector<MaterialId> mats(materials.size());
+  for (std::size_t i = 0; i < materials.size(); ++i) mats[i] = U.palette_.intern(materials[i]);
+  std::vector<uint32_t> rots(rotations.size());
+  for (std::size_t i = 0; i < rotations.size(); ++i) rots[i] = U.rotations_.intern(rotations[i]);
+
+  std::vector<ChunkStore*> stores{&U.cubes_};
+  for (auto& [name, pose] : groups) {
+    Group& g = U.groups_[name];
+    g.offset = pose.offset;
+    g.orient = pose.orient;
+    g.cubes.set_pager(U.pager_.get());
+    stores.push_back(&g.cubes);
+  }
+  for (uint64_t i = 0; i < h.chunkCount; ++i) {
+    auto e = read_at<SnapChunk>(base, h.directoryOffset + i * sizeof(SnapChunk));
+    stores[e.store]->add_lazy({e.cx, e.cy, e.cz}, uint32_t(i), int(e.count));
+  }
+  auto source = std::make_shared<SnapshotSource>(path, std::move(file), h.directoryOffset, std::move(mats), std::move(rots));
+  for (auto* s : stores) if (s->chunk_count()) s->set_source(source);
+}
+
+} // namespace vxl
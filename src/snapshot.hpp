@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "universe.hpp"
+
+/** @file snapshot.hpp
+ *  @brief Versioned binary save/load of a whole Universe.
+ *
+ *  Layout (little-endian, sections 8-byte aligned):
+ *    SnapHeader
+ *    SnapMaterial[materialCount]        compacted palette, entry 0 = default
+ *    float[4][rotationCount]            compacted free rotations (x,y,z,w)
+ *    group table                        SnapGroup + name bytes, per group
+ *    chunk payloads                     see SnapChunk::encoding
+ *    SnapChunk[chunkCount]              chunk directory
+ *  The directory is read on load; payloads are only decoded when a chunk is
+ *  first touched, straight out of the mapped file.
+ */
+
+namespace vxl {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'V','X','L','S','N','A','P','\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;       ///< sizeof(SnapHeader) of the writer
+  int32_t baseEdgePixels;
+  uint32_t materialCount;
+  uint32_t rotationCount;
+  uint32_t groupCount;
+  uint64_t chunkCount;
+  uint64_t voxelCount;
+  uint64_t materialOffset;
+  uint64_t rotationOffset;
+  uint64_t groupOffset;
+  uint64_t directoryOffset;
+};
+
+struct SnapMaterial {
+  uint32_t kind;             ///< Material::Kind
+  float colorA[4];
+  float colorB[4];
+  float gradDir[3];
+};
+
+/// Followed by nameLength bytes, padded to 8.
+struct SnapGroup {
+  int32_t offset[3];
+  uint32_t orient;
+  uint32_t nameLength;
+  uint32_t reserved;
+};
+
+struct SnapChunk {
+  enum : uint32_t {
+    SPARSE = 0,              ///< uint16 local index[count] (padded to 8), SnapVoxel[count]
+    BITMAP = 1,              ///< uint64 occupancy[CHUNK_VOLUME/64], SnapVoxel[count]
+  };
+  int32_t cx, cy, cz;
+  uint32_t store;            ///< 0 = ungrouped, g+1 = group g of the group table
+  uint32_t count;
+  uint32_t encoding;
+  uint64_t offset;           ///< payload position in the file
+};
+
+/// One voxel, in ascending local index order within its chunk.
+struct SnapVoxel {
+  uint16_t mat;              ///< index into the file's palette
+  uint8_t rotation;          ///< Orientation code
+  uint8_t reserved;
+  uint32_t freeRot;          ///< index into the file's rotations when rotation is FREE
+};
+
+/** @brief Save / load entry points (friends of Universe). */
+struct Snapshot {
+  /// Write U to `path` (via a temporary file renamed into place). Loads any chunks
+  /// still in a previous snapshot or the page file; a paged universe is trimmed
+  /// back to its budget as it goes. Chunks still read from `path` itself are moved
+  /// off it (paged ones to the page file), so the mapping is gone before the
+  /// rename. Throws std::runtime_error on I/O failure.
+  static void save(const Universe& U, const std::string& path);
+  /// Replace U's content with the snapshot at `path`. Only the header, palette,
+  /// rotations, group table and chunk directory are read; chunks stay in the
+  /// mapped file until first touched. Throws std::runtime_error on a bad file.
+  static void load(Universe& U, const std::string& path);
+};
+
+} // namespace vxl
@@ -0,0 +1,99 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace vxl {
+
+namespace {
+
+/// The pool the calling thread works for (null for other threads), and its index there.
+thread_local const ThreadPool* tl_pool = nullptr;
+thread_local unsigned tl_worker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0) threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  for (unsigned i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+  threads_.reserve(threads);
+  for (unsigned i = 0; i < threads; ++i) threads_.emplace_back([this, i] { worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lk(sleepMu_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& t : threads_) t.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  const unsigned w = tl_pool == this ? tl_worker
+                                     : next_.fetch_add(1, std::memory_order_relaxed) % unsigned(queues_.size());
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  {
+    // Counted under sleepMu_, and before the job is visible, so a worker about
+    // to sleep cannot miss it and the count never drops below zero
+    std::lock_guard<std::mutex> lk(sleepMu_);
+    queued_.fetch_add(1, std::memory_order_relaxed);
+  }
+  {
+    std::lock_guard<std::mutex> lk(queues_[w]->mu);
+    queues_[w]->jobs.push_back(std::move(job));
+  }
+  wake_.notify_one();
+}
+
+void ThreadPool::wait_idle() {
+  std::unique_lock<std::mutex> lk(sleepMu_);
+  idle_.wait(lk, [&] { return pending_.load(std::memory_order_acquire) == 0; });
+}
+
+bool ThreadPool::take(unsigned self, std::function<void()>& job) {
+  {
+    Queue& q = *queues_[self];
+    std::lock_guard<std::mutex> lk(q.mu);
+    if (!q.jobs.empty()) {
+      job = std::move(q.jobs.back());
+      q.jobs.pop_back();
+      return true;
+    }
+  }
+  const unsigned n = unsigned(queues_.size());
+  for (unsigned k = 1; k < n; ++k) {
+    Queue& q = *queues_[(self + k) % n];
+    std::lock_guard<std::mutex> lk(q.mu);
+    if (!q.jobs.empty()) {
+      job = std::move(q.jobs.front());
+      q.jobs.pop_front();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::worker_loop(unsigned self) {
+  tl_pool = this;
+  tl_worker = self;
+  std::function<void()> job;
+  for (;;) {
+    {
+      // Checked before every job, so a pool being destroyed drops its backlog
+      std::unique_lock<std::mutex> lk(sleepMu_);
+      wake_.wait(lk, [&] { return stop_ || queued_.load(std::memory_order_relaxed) > 0; });
+      if (stop_) return;
+    }
+    if (take(self, job)) {
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      job();
+      job = nullptr;
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lk(sleepMu_);
+        idle_.notify_all();
+      }
+    }
+  }
+}
+
+} // namespace vxl
@@ -0,0 +1,193 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** @file thread_pool.hpp
+ *  @brief Work-stealing thread pool, and lock-free hand-offs between threads: a
+ *         queue for results, a triple buffer for the newest version of a value.
+ */
+
+namespace vxl {
+
+/** @brief Fixed set of worker threads, each with its own job deque.
+ *
+ *  submit() deals jobs out round-robin (a job submitted from inside a job goes
+ *  to the submitting worker's own deque). A worker takes its newest job first
+ *  and, when its deque is empty, steals the oldest job of another, so uneven
+ *  jobs even out without a shared queue everyone contends on. Jobs must not
+ *  throw.
+ */
+class ThreadPool {
+public:
+  /// `threads` workers; 0 sizes the pool to the machine, leaving a core for the
+  /// calling thread (at least one worker).
+  explicit ThreadPool(unsigned threads = 0);
+  /// Stops the workers once their current jobs finish; jobs not started by then
+  /// are dropped, not run.
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void submit(std::function<void()> job);
+  /// Block until every job submitted so far has finished.
+  void wait_idle();
+
+  unsigned size() const noexcept { return unsigned(threads_.size()); }
+  /// Jobs submitted and not finished yet.
+  std::size_t pending() const noexcept { return pending_.load(std::memory_order_relaxed); }
+  /// Jobs a worker took from another worker's deque, since construction.
+  uint64_t steals() const noexcept { return steals_.load(std::memory_order_relaxed); }
+
+private:
+  struct Queue {
+    std::mutex mu;
+    std::deque<std::function<void()>> jobs;
+  };
+  std::vector<std::unique_ptr<Queue>> queues_;   ///< one per worker
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> pending_{0};          ///< submitted, not finished
+  std::atomic<std::size_t> queued_{0};           ///< submitted, not started
+  std::atomic<unsigned> next_{0};                ///< round-robin cursor
+  std::atomic<uint64_t> steals_{0};
+  std::mutex sleepMu_;
+  std::condition_variable wake_, idle_;
+  bool stop_ = false;                            ///< guarded by sleepMu_
+
+  void worker_loop(unsigned self);
+  /// Own newest job, else another worker's oldest.
+  bool take(unsigned self, std::function<void()>& job);
+};
+
+/** @brief Run fn(i) for every i in [0, n) on the pool's workers and the calling
+ *         thread; returns when all calls are done. The caller claims indices
+ *         too, so this finishes even when every worker is busy with other jobs
+ *         (it never waits for a job it did not start). With no pool, or n < 2,
+ *         runs inline. fn must not throw.
+ */
+template <class Fn>
+void parallel_for(ThreadPool* pool, std::size_t n, Fn&& fn) {
+  if (!pool || n < 2) {
+    for (std::size_t i = 0; i < n; ++i) fn(i);
+    return;
+  }
+  struct State {
+    std::atomic<std::size_t> next{0}, done{0};
+    std::size_t n = 0;
+    const std::function<void(std::size_t)>* fn = nullptr;   ///< only read after claiming an index
+  };
+  const std::function<void(std::size_t)> body = [&fn](std::size_t i) { fn(i); };
+  auto st = std::make_shared<State>();
+  st->n = n;
+  st->fn = &body;
+  auto work = [](State& s) {
+    for (std::size_t i; (i = s.next.fetch_add(1, std::memory_order_relaxed)) < s.n; ) {
+      (*s.fn)(i);
+      s.done.fetch_add(1, std::memory_order_release);
+    }
+  };
+  const std::size_t helpers = std::min<std::size_t>(pool->size(), n - 1);
+  for (std::size_t h = 0; h < helpers; ++h) pool->submit([st, work] { work(*st); });
+  work(*st);
+  // What is left is running on workers right now
+  while (st->done.load(std::memory_order_acquire) < n) std::this_thread::yield();
+}
+
+/** @brief Unbounded multi-producer, single-consumer queue without locks.
+ *
+ *  Producers push onto an atomic list head with compare-and-swap; the consumer
+ *  detaches the whole list with one exchange, so no node is ever touched by
+ *  both sides at once (and there is no ABA).
+ */
+template <class T>
+class CompletionQueue {
+public:
+  CompletionQueue() = default;
+  ~CompletionQueue() { drain([](T&&) {}); }
+  CompletionQueue(const CompletionQueue&) = delete;
+  CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+  /// Any thread.
+  void push(T value) {
+    Node* n = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+    while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {}
+  }
+
+  /// Consumer thread only: call fn(T&&) on everything pushed so far, oldest
+  /// first per producer. Returns how many items there were.
+  template <class Fn>
+  std::size_t drain(Fn&& fn) {
+    Node* n = head_.exchange(nullptr, std::memory_order_acquire);
+    Node* fifo = nullptr;
+    while (n) { Node* next = n->next; n->next = fifo; fifo = n; n = next; }
+    std::size_t count = 0;
+    while (fifo) {
+      Node* next = fifo->next;
+      fn(std::move(fifo->value));
+      delete fifo;
+      fifo = next;
+      ++count;
+    }
+    return count;
+  }
+
+  bool empty() const noexcept { return head_.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+  struct Node {
+    T value;
+    Node* next;
+  };
+  std::atomic<Node*> head_{nullptr};
+};
+
+/** @brief Hands the newest of a stream of values from one writer thread to one
+ *         reader thread, without locks and without either side waiting.
+ *
+ *  Three slots: the writer fills its own, then swaps it with the shared middle
+ *  one; the reader swaps its own with the middle one when that holds something
+ *  new. Each slot belongs to one side at a time, so the reader can keep using
+ *  front() while the writer publishes, and values the reader never got to are
+ *  overwritten (and destroyed) on the writer's thread.
+ */
+template <class T>
+class TripleBuffer {
+public:
+  /// Writer: make `value` the newest. Returns true if the value it replaces was
+  /// never read, false if the reader took every earlier one it could see.
+  bool publish(T value) {
+    slots_[back_] = std::move(value);
+    const uint8_t old = state_.exchange(uint8_t(back_ | FRESH), std::memory_order_acq_rel);
+    back_ = old & INDEX;
+    return old & FRESH;
+  }
+
+  /// Reader: move to the newest value, if there is one not read yet; returns
+  /// whether front() changed.
+  bool update() {
+    if (!(state_.load(std::memory_order_acquire) & FRESH)) return false;
+    const uint8_t old = state_.exchange(front_, std::memory_order_acq_rel);
+    front_ = old & INDEX;
+    return true;
+  }
+  /// Reader: the value update() last moved to (default-constructed before that).
+  const T& front() const noexcept { return slots_[front_]; }
+
+private:
+  static constexpr uint8_t INDEX = 3, FRESH = 4;
+  T slots_[3]{};
+  uint8_t back_ = 0;                 ///< the writer's slot
+  uint8_t front_ = 1;                ///< the reader's slot
+  std::atomic<uint8_t> state_{2};    ///< the middle slot, | FRESH while unread
+};
+
+} // namespace vxl
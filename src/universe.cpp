@@ -1,62 +1,338 @@
 #include "universe.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <stdexcept>
 
 namespace vxl {
 
 Universe::Universe(int baseEdgePixels) : baseEdgePixels_(std::max(1, baseEdgePixels)) {}
 
 void Universe::place(int x,int y,int z, const Cube& c) {
-  cubes_[IVec3{x,y,z}] = c;
+  IVec3 p{x,y,z};
+  if (!in_world(p)) throw std::out_of_range("coordinate outside the universe (each axis in [-2^20, 2^20))");
+  if (!journals_.empty()) note_voxel(UNGROUPED, p, cubes_.find(p), &c);
+  cubes_.place(p, c);
 }
 
 bool Universe::erase(int x,int y,int z) {
-  return cubes_.erase(IVec3{x,y,z}) > 0;
+  IVec3 p{x,y,z};
+  if (!in_world(p)) return false;
+  if (const Cube* c = cubes_.find(p)) {
+    if (!journals_.empty()) note_voxel(UNGROUPED, p, c, nullptr);
+    return cubes_.erase(p);
+  }
+  for (auto& [name, g] : groups_) {
+    IVec3 l = g.to_local(p);
+    const Cube* c = in_morton_range(l) ? g.cubes.find(l) : nullptr;
+    if (!c) continue;
+    if (!journals_.empty()) note_voxel(name, l, c, nullptr);
+    return g.cubes.erase(l);
+  }
+  return false;
+}
+
+void Universe::place_many(std::span<const IVec3> coords, std::span<const Cube> cubes) {
+  if (cubes.size() != 1 && cubes.size() != coords.size())
+    throw std::invalid_argument("place_many: need one cube or one per coordinate");
+  for (auto& p : coords)
+    if (!in_world(p)) throw std::out_of_range("coordinate outside the universe (each axis in [-2^20, 2^20))");
+  store_place_many(UNGROUPED, cubes_, coords, cubes);
+}
+
+std::size_t Universe::erase_many(std::span<const IVec3> coords) {
+  if (groups_.empty()) return store_erase_many(UNGROUPED, cubes_, coords);
+  std::vector<uint8_t> hit(coords.size(), 0);
+  std::size_t n = store_erase_many(UNGROUPED, cubes_, coords, &hit);
+  for (auto& [name, g] : groups_) {
+    n += group_pass(g, coords, hit, [&](std::span<const IVec3> local, std::vector<uint8_t>* h) {
+      return store_erase_many(name, g.cubes, local, h);
+    });
+  }
+  return n;
 }
 
 std::optional<Cube> Universe::get(int x,int y,int z) const {
-  auto it = cubes_.find(IVec3{x,y,z});
-  if (it == cubes_.end()) return std::nullopt;
-  return it->second;
+  IVec3 p{x,y,z};
+  if (!in_world(p)) return std::nullopt;
+  if (const Cube* c = cubes_.find(p)) return *c;
+  for (auto& [name, g] : groups_) {
+    IVec3 l = g.to_local(p);
+    if (!in_morton_range(l)) continue;
+    if (const Cube* c = g.cubes.find(l)) return to_world_frame(g, *c);
+  }
+  return std::nullopt;
+}
+
+std::size_t Universe::size() const noexcept {
+  std::size_t n = cubes_.size();
+  for (auto& [name, g] : groups_) n += g.cubes.size();
+  return n;
+}
+
+std::size_t Universe::chunk_count() const noexcept {
+  std::size_t n = cubes_.chunk_count();
+  for (auto& [name, g] : groups_) n += g.cubes.chunk_count();
+  return n;
+}
+
+std::size_t Universe::resident_chunk_count() const noexcept {
+  std::size_t n = cubes_.resident_count();
+  for (auto& [name, g] : groups_) n += g.cubes.resident_count();
+  return n;
+}
+
+void Universe::clear() {
+  cubes_.clear();
+  for (auto& [name, g] : groups_) g.cubes.clear();
+  groups_.clear();
+  palette_.clear();
+  rotations_.clear();
+  rotationGcAt_ = 1024;
+}
+
+std::vector<const ChunkStore*> Universe::all_stores() const {
+  std::vector<const ChunkStore*> stores{&cubes_};
+  for (auto& [name, g] : groups_) stores.push_back(&g.cubes);
+  return stores;
+}
+
+void Universe::enable_paging(std::size_t budgetBytes, const std::string& pagePath) {
+  if (pager_) { pager_->set_budget(budgetBytes); return; }
+  pager_ = std::make_unique<ChunkPager>(budgetBytes, pagePath);
+  cubes_.set_pager(pager_.get());
+  for (auto& [name, g] : groups_) g.cubes.set_pager(pager_.get());
+}
+
+void Universe::disable_paging() {
+  if (!pager_) return;
+  cubes_.set_pager(nullptr);
+  for (auto& [name, g] : groups_) g.cubes.set_pager(nullptr);
+  pager_.reset();
+}
+
+std::size_t Universe::page_out() const {
+  if (!pager_) return 0;
+  auto stores = all_stores();
+  return pager_->trim(stores);
+}
+
+void Universe::mark_used(std::vector<bool>& materials, std::vector<bool>& rotations) const {
+  auto mark = [&](const Cube& c){
+    materials[c.mat] = true;
+    if (!c.rotation.axis_aligned()) rotations[c.freeRot] = true;
+  };
+  auto scan = [&](const ChunkStore& s){
+    // Chunks still in a source are covered by the source, without loading them
+    s.for_each_resident_chunk([&](const IVec3&, const Chunk& ch){ ch.for_each([&](int, const Cube& c){ mark(c); }); });
+    if (s.source()) s.source()->mark_used(materials, rotations);
+  };
+  if (pager_) pager_->file().mark_used(materials, rotations);
+  scan(cubes_);
+  for (auto& [name, g] : groups_) scan(g.cubes);
+  for (auto* j : journals_) j->for_each_held(mark);
+}
+
+std::size_t Universe::gc_materials() {
+  std::vector<bool> used(palette_.slots(), false), rots(rotations_.slots(), false);
+  mark_used(used, rots);
+  return palette_.collect(used);
+}
+
+glm::quat Universe::rotation(const Cube& c) const {
+  return c.rotation.axis_aligned() ? orientation_quat(c.rotation.code) : rotations_.quat(c.freeRot);
+}
+
+void Universe::set_rotation(Cube& c, const glm::quat& q) {
+  if (auto code = snap_orientation(q)) {
+    c.rotation.code = *code;
+    c.freeRot = 0;
+    return;
+  }
+  // Continuous edits (R + mouse) intern a new rotation every frame; sweep the
+  // side table whenever it has doubled since the last sweep.
+  if (rotations_.slots() >= rotationGcAt_) {
+    gc_rotations();
+    rotationGcAt_ = std::max<std::size_t>(1024, 2 * rotations_.size());
+  }
+  c.rotation.code = Orientation::FREE;
+  c.freeRot = rotations_.intern(q);
+}
+
+std::size_t Universe::gc_rotations() {
+  std::vector<bool> mats(palette_.slots(), false), used(rotations_.slots(), false);
+  mark_used(mats, used);
+  return rotations_.collect(used);
+}
+
+Cube Universe::to_world_frame(const Group& g, Cube c) const {
+  if (g.orient == 0) return c;
+  if (c.rotation.axis_aligned()) c.rotation.code = orientation_compose(g.orient, c.rotation.code);
+  else c.freeRot = rotations_.intern(orientation_quat(g.orient) * rotations_.quat(c.freeRot));
+  return c;
+}
+
+Cube Universe::to_group_frame(const Group& g, Cube c) const {
+  if (g.orient == 0) return c;
+  uint8_t inv = orientation_inverse(g.orient);
+  if (c.rotation.axis_aligned()) c.rotation.code = orientation_compose(inv, c.rotation.code);
+  else c.freeRot = rotations_.intern(orientation_quat(inv) * rotations_.quat(c.freeRot));
+  return c;
 }
 
 void Universe::group_create(const std::string& name, const std::vector<IVec3>& members) {
-  groups_[name] = members;
+  group_bake(name);
+  std::vector<IVec3> src;
+  std::vector<Cube> cubes;
+  src.reserve(members.size());
+  cubes.reserve(members.size());
+  visit_many(members, [&](const IVec3& p, const Cube& c){ src.push_back(p); cubes.push_back(c); });
+  erase_many(src);
+
+  GroupPose pose;
+  if (!src.empty()) {
+    // Anchor at the rounded centroid so group_rotate turns the group in place
+    double sx = 0, sy = 0, sz = 0;
+    for (auto& p : src) { sx += p.x; sy += p.y; sz += p.z; }
+    double n = double(src.size());
+    pose.offset = {int(std::floor(sx / n + 0.5)), int(std::floor(sy / n + 0.5)), int(std::floor(sz / n + 0.5))};
+    for (auto& p : src) p = {p.x - pose.offset.x, p.y - pose.offset.y, p.z - pose.offset.z};
+  }
+  apply_group(name, &pose);
+  if (!src.empty()) store_place_many(name, groups_.at(name).cubes, src, cubes);
 }
 
 bool Universe::group_exists(const std::string& name) const {
   return groups_.find(name) != groups_.end();
 }
 
-std::vector<IVec3> Universe::group_members(const std::string& name) const {
+const Group* Universe::group(const std::string& name) const {
   auto it = groups_.find(name);
-  return (it == groups_.end()) ? std::vector<IVec3>{} : it->second;
+  return (it == groups_.end()) ? nullptr : &it->second;
+}
+
+std::vector<IVec3> Universe::group_members(const std::string& name) const {
+  std::vector<IVec3> out;
+  if (const Group* g = group(name)) {
+    out.reserve(g->cubes.size());
+    g->cubes.for_each([&](const IVec3& l, const Cube&){ out.push_back(g->to_world(l)); });
+  }
+  return out;
 }
 
 bool Universe::group_erase(const std::string& name) {
-  return groups_.erase(name) > 0;
+  return group_bake(name);
 }
 
 bool Universe::group_move(const std::string& name, const IVec3& d) {
   auto it = groups_.find(name);
   if (it == groups_.end()) return false;
-  std::vector<IVec3> newMembers;
-  newMembers.reserve(it->second.size());
-
-  // Copy then move to avoid collisions
-  std::vector<std::pair<IVec3, Cube>> temp;
-  for (auto& p : it->second) {
-    if (auto c = get(p.x,p.y,p.z)) {
-      temp.emplace_back(p, *c);
+  const IVec3& o = it->second.offset;
+  GroupPose pose{{o.x + d.x, o.y + d.y, o.z + d.z}, it->second.orient};
+  apply_group(name, &pose);
+  return true;
+}
+
+bool Universe::group_rotate(const std::string& name, uint8_t code) {
+  auto it = groups_.find(name);
+  if (it == groups_.end()) return false;
+  GroupPose pose{it->second.offset, orientation_compose(code, it->second.orient)};
+  apply_group(name, &pose);
+  return true;
+}
+
+bool Universe::group_bake(const std::string& name) {
+  auto it = groups_.find(name);
+  if (it == groups_.end()) return false;
+  const Group& g = it->second;
+  std::vector<IVec3> dst;
+  std::vector<Cube> cubes;
+  dst.reserve(g.cubes.size());
+  cubes.reserve(g.cubes.size());
+  g.cubes.for_each([&](const IVec3& l, const Cube& c){
+    dst.push_back(g.to_world(l));
+    cubes.push_back(to_world_frame(g, c));
+  });
+  place_many(dst, cubes);   // validates every coordinate before writing
+  apply_group(name, nullptr);
+  return true;
+}
+
+// ----- journals -----
+
+void Universe::add_journal(IEditJournal* j) {
+  if (std::find(journals_.begin(), journals_.end(), j) == journals_.end()) journals_.push_back(j);
+}
+
+void Universe::remove_journal(IEditJournal* j) {
+  journals_.erase(std::remove(journals_.begin(), journals_.end(), j), journals_.end());
+}
+
+void Universe::note_voxel(const std::string& group, const IVec3& p, const Cube* before, const Cube* after) {
+  for (auto* j : journals_) j->on_voxel(group, p, before, after);
+}
+
+void Universe::note_group(const std::string& name, const GroupPose* before, const GroupPose* after) {
+  for (auto* j : journals_) j->on_group(name, before, after);
+}
+
+std::size_t Universe::store_place_many(const std::string& name, ChunkStore& s,
+                                       std::span<const IVec3> coords, std::span<const Cube> cubes) {
+  if (journals_.empty()) return s.place_many(coords, cubes);
+  return s.place_many(coords, cubes, [&](const IVec3& p, const Cube* before, const Cube* after){
+    note_voxel(name, p, before, after);
+  });
+}
+
+std::size_t Universe::store_erase_many(const std::string& name, ChunkStore& s,
+                                       std::span<const IVec3> coords, std::vector<uint8_t>* hit) {
+  if (journals_.empty()) return s.erase_many(coords, hit);
+  return s.erase_many(coords, hit, [&](const IVec3& p, const Cube* before, const Cube*){
+    note_voxel(name, p, before, nullptr);
+  });
+}
+
+ChunkStore& Universe::store_named(const std::string& group) {
+  if (group.empty()) return cubes_;
+  auto it = groups_.find(group);
+  if (it == groups_.end()) throw std::invalid_argument("no such group: " + group);
+  return it->second.cubes;
+}
+
+void Universe::apply_place(const std::string& group, std::span<const IVec3> coords, std::span<const Cube> cubes) {
+  if (cubes.size() != 1 && cubes.size() != coords.size())
+    throw std::invalid_argument("apply_place: need one cube or one per coordinate");
+  store_place_many(group, store_named(group), coords, cubes);
+}
+
+void Universe::apply_erase(const std::string& group, std::span<const IVec3> coords) {
+  store_erase_many(group, store_named(group), coords);
+}
+
+void Universe::apply_group(const std::string& name, const GroupPose* pose) {
+  auto it = groups_.find(name);
+  if (!pose) {
+    if (it == groups_.end()) return;
+    Group& g = it->second;
+    if (!journals_.empty()) {
+      g.cubes.for_each([&](const IVec3& l, const Cube& c){ note_voxel(name, l, &c, nullptr); });
+      GroupPose before = g.pose();
+      note_group(name, &before, nullptr);
     }
+    g.cubes.clear();   // releases its page file records
+    groups_.erase(it);
+    return;
   }
-  for (auto& [p,c] : temp) erase(p.x,p.y,p.z);
-  for (auto& [p,c] : temp) {
-    IVec3 np{p.x + d.x, p.y + d.y, p.z + d.z};
-    place(np.x,np.y,np.z, c);
-    newMembers.push_back(np);
+  if (it == groups_.end()) {
+    note_group(name, nullptr, pose);
+    it = groups_.emplace(name, Group{}).first;
+    it->second.cubes.set_pager(pager_.get());
+  } else {
+    GroupPose before = it->second.pose();
+    note_group(name, &before, pose);
   }
-  it->second.swap(newMembers);
-  return true;
+  it->second.offset = pose->offset;
+  it->second.orient = pose->orient;
 }
 
 } // namespace vxl
@@ -1,41 +1,76 @@
 #pragma once
 #include <glm/glm.hpp>
-#include <glm/gtc/quaternion.hpp>
+#include <functional>
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include <optional>
+#include <span>
 #include "util.hpp"
+#include "cube.hpp"
+#include "chunk.hpp"
+#include "page_cache.hpp"
+#include "palette.hpp"
 
 /** @file universe.hpp
  *  @brief Sparse, unbounded voxel universe. All cubes have same base geometry.
+ *         Voxels live in 32^3 chunks (see chunk.hpp).
  */
 
 namespace vxl {
 
-/** @brief Material coloration model for a cube. */
-struct Material {
-  enum class Kind { Solid, Gradient } kind = Kind::Solid;
-  glm::vec4 colorA{0.8f,0.8f,0.8f,1.0f};
-  glm::vec4 colorB{0.2f,0.2f,0.2f,1.0f};
-  glm::vec3 gradDir{0,1,0}; ///< unit direction in local cube space
+/// Placement of a group in the world (see Group).
+struct GroupPose {
+  IVec3 offset{0,0,0};
+  uint8_t orient = 0;
+  bool operator==(const GroupPose&) const = default;
 };
 
-/** @brief Optional hook to allow embedding custom renderables per-cube. */
-struct IEmbeddedRenderable {
-  virtual ~IEmbeddedRenderable() = default;
-  /// Called with model matrix that maps cube-local coordinates to world.
-  virtual void draw(const glm::mat4& cubeModel) = 0;
+/** @brief Named set of cubes kept in its own frame. Local voxel l appears in the
+ *         world at orientation_apply(orient, l) + offset, so moving or turning a
+ *         group rewrites two fields instead of every member.
+ */
+struct Group {
+  ChunkStore cubes;        ///< group-local coordinates; rotations relative to the group
+  IVec3 offset{0,0,0};     ///< world position of the local origin (the anchor)
+  uint8_t orient = 0;      ///< axis-aligned Orientation code about the anchor
+
+  GroupPose pose() const { return {offset, orient}; }
+  IVec3 to_world(const IVec3& l) const {
+    IVec3 r = orientation_apply(orient, l);
+    return {r.x + offset.x, r.y + offset.y, r.z + offset.z};
+  }
+  IVec3 to_local(const IVec3& w) const {
+    return orientation_apply(orientation_inverse(orient), {w.x - offset.x, w.y - offset.y, w.z - offset.z});
+  }
 };
 
-/** @brief One cube at an integer coordinate. */
-struct Cube {
-  Material mat{};
-  glm::quat rotation{1,0,0,0};  ///< local rotation
-  IEmbeddedRenderable* embedded{nullptr}; ///< user-owned object (not managed)
+/** @brief Observer of every storage change made to a Universe, in order.
+ *
+ *  Changes are reported per store: `group` names it ("" for ungrouped cubes),
+ *  coordinates are store-local and cubes are in store frame, so feeding them
+ *  back through Universe::apply_* reproduces the state exactly. A change is
+ *  reported just before it is applied.
+ */
+class IEditJournal {
+public:
+  virtual ~IEditJournal() = default;
+  /// Voxel p of store `group` goes from *before to *after (nullptr = empty).
+  virtual void on_voxel(const std::string& group, const IVec3& p, const Cube* before, const Cube* after) = 0;
+  /// Group is created (before == nullptr), dropped (after == nullptr) or re-posed.
+  /// Groups are always empty when created or dropped.
+  virtual void on_group(const std::string& name, const GroupPose* before, const GroupPose* after) = 0;
+  /// Cubes the journal still holds, so palette / rotation GC keeps their slots.
+  virtual void for_each_held(const std::function<void(const Cube&)>& fn) const { (void)fn; }
 };
 
-/** @brief Universe parameters and sparse content. */
+/** @brief Universe parameters and sparse content.
+ *
+ *  Cubes are either ungrouped (world storage) or owned by a Group. Lookups,
+ *  edits and the batch forms see both, in world coordinates and with group
+ *  orientations folded into the returned cubes; an ungrouped cube shadows a
+ *  group cube at the same position. place/place_many always write ungrouped.
+ */
 class Universe {
 public:
   /// Construct with desired on-screen pixels for cube edge at default zoom.
@@ -44,27 +79,208 @@ public:
   int base_edge_pixels() const noexcept { return baseEdgePixels_; }
   void set_base_edge_pixels(int px) noexcept { baseEdgePixels_ = std::max(1, px); }
 
-  /// Place or replace a cube.
+  // Batch forms: coordinates are sorted by Morton code and each chunk is looked up
+  // once per run, so large edits avoid per-voxel hashing and Cube copies.
+
+  /// coords[i] gets cubes[i] (or cubes[0] if only one cube is given). Throws
+  /// std::out_of_range before changing anything if a coordinate is outside in_world().
+  void place_many(std::span<const IVec3> coords, std::span<const Cube> cubes);
+  /// Remove cubes where present. Returns the number removed.
+  std::size_t erase_many(std::span<const IVec3> coords);
+  /// fn(const IVec3& p, Cube& c) in place on every existing cube among coords;
+  /// fn must not place or erase. Returns the number of cubes visited.
+  template <class Fn> std::size_t update_many(std::span<const IVec3> coords, Fn&& fn) {
+    const bool rec = !journals_.empty();
+    auto world = [&](const IVec3& p, Cube& c) {
+      if (!rec) { fn(p, c); return; }
+      Cube before = c;
+      fn(p, c);
+      note_voxel(UNGROUPED, p, &before, &c);
+    };
+    if (groups_.empty()) return cubes_.update_many(coords, world);
+    std::vector<uint8_t> hit(coords.size(), 0);
+    std::size_t n = cubes_.update_many(coords, world, &hit);
+    for (auto& [name, g] : groups_) {
+      n += group_pass(g, coords, hit, [&](std::span<const IVec3> local, std::vector<uint8_t>* h) {
+        return g.cubes.update_many(local, [&](const IVec3& l, Cube& c) {
+          Cube stored = c, before = to_world_frame(g, c), w = before;
+          fn(g.to_world(l), w);
+          // Untouched rotations keep their group-frame value (no float round trip)
+          if (w.rotation == before.rotation && w.freeRot == before.freeRot) {
+            w.rotation = c.rotation; w.freeRot = c.freeRot; c = w;
+          } else {
+            c = to_group_frame(g, w);
+          }
+          if (rec) note_voxel(name, l, &stored, &c);
+        }, h);
+      });
+    }
+    return n;
+  }
+  /// fn(const IVec3& p, const Cube& c) on every existing cube among coords.
+  template <class Fn> std::size_t visit_many(std::span<const IVec3> coords, Fn&& fn) const {
+    if (groups_.empty()) return cubes_.visit_many(coords, fn);
+    std::vector<uint8_t> hit(coords.size(), 0);
+    std::size_t n = cubes_.visit_many(coords, fn, &hit);
+    for (auto& [name, g] : groups_) {
+      n += group_pass(g, coords, hit, [&](std::span<const IVec3> local, std::vector<uint8_t>* h) {
+        return g.cubes.visit_many(local, [&](const IVec3& l, const Cube& c) {
+          fn(g.to_world(l), to_world_frame(g, c));
+        }, h);
+      });
+    }
+    return n;
+  }
+
+  /// Coordinates a cube can occupy: each axis in [-2^20, 2^20) (Morton-keyed storage).
+  static bool in_world(const IVec3& p) noexcept { return in_morton_range(p); }
+
+  /// Place or replace a cube. Throws std::out_of_range outside in_world().
   void place(int x,int y,int z, const Cube& c = Cube{});
   /// Remove cube if present. Returns true if erased.
   bool erase(int x,int y,int z);
   /// Get cube if present.
   std::optional<Cube> get(int x,int y,int z) const;
+  /// Drop every cube, group, material and free rotation. Journals are not told.
+  void clear();
+
+  // Materials
+  MaterialPalette& materials() noexcept { return palette_; }
+  const MaterialPalette& materials() const noexcept { return palette_; }
+  const Material& material(MaterialId id) const { return palette_.get(id); }
+  /// Release palette entries no cube references. Returns the number freed.
+  std::size_t gc_materials();
+
+  // Orientations
+  /// Full local rotation of a cube.
+  glm::quat rotation(const Cube& c) const;
+  /// Local rotation matrix, read from lookup tables (no quaternion math).
+  const glm::mat3& rotation_matrix(const Cube& c) const {
+    return c.rotation.axis_aligned() ? orientation_matrix(c.rotation.code) : rotations_.matrix(c.freeRot);
+  }
+  /// Store q in c: snapped to an axis-aligned code when within tolerance, otherwise
+  /// interned in the side table. May collect unreferenced side-table slots first,
+  /// so call it with cubes that are still (or not yet) placed, not while detached.
+  void set_rotation(Cube& c, const glm::quat& q);
+  const RotationTable& free_rotations() const noexcept { return rotations_; }
+  /// Side-table slot for q as is: no snapping and no sweep, so loaders can build
+  /// FREE cubes before placing them.
+  uint32_t intern_rotation(const glm::quat& q) { return rotations_.intern(q); }
+  /// Release side-table rotations no cube references. Returns the number freed.
+  std::size_t gc_rotations();
 
-  /// Bulk access
-  const std::unordered_map<IVec3, Cube, IVec3Hasher>& all() const { return cubes_; }
+  /// Number of cubes / allocated chunks, grouped ones included.
+  std::size_t size() const noexcept;
+  std::size_t chunk_count() const noexcept;
+  /// Chunks in memory; the rest are still in a snapshot (see Snapshot::load) or paged out.
+  std::size_t resident_chunk_count() const noexcept;
+
+  // Paging
+  /// Keep roughly `budgetBytes` of chunks in memory: page_out() evicts the least
+  /// recently used ones, writing changed chunks to a scratch page file at `pagePath`
+  /// (unchanged ones just fall back to their snapshot / page file copy). Evicted
+  /// chunks fault back in on access. If paging is already on, only the budget changes.
+  void enable_paging(std::size_t budgetBytes, const std::string& pagePath);
+  /// Bring every paged-out chunk back into memory and stop paging.
+  void disable_paging();
+  const ChunkPager* pager() const noexcept { return pager_.get(); }
+  void reset_page_stats() noexcept { if (pager_) pager_->reset_stats(); }
+  /// Evict down to the budget if over it; returns the chunks evicted. References to
+  /// cubes or chunks obtained earlier may dangle afterwards, so call it between
+  /// operations (the app does once per frame). Const: content does not change.
+  std::size_t page_out() const;
+
+  /// Bulk access to ungrouped cubes, chunk by chunk: fn(const IVec3& chunkCoord, const Chunk&).
+  template <class Fn> void for_each_chunk(Fn&& fn) const { cubes_.for_each_chunk(fn); }
+  /// Bulk access to ungrouped cubes, voxel by voxel (chunk order): fn(const IVec3& p, const Cube&).
+  template <class Fn> void for_each(Fn&& fn) const { cubes_.for_each(fn); }
+  const ChunkStore& store() const { return cubes_; }
 
   // Groups
+  /// Move the cubes at `members` (ungrouped or from other groups) into a new group
+  /// anchored at their rounded centroid. An existing group of that name is baked first.
   void group_create(const std::string& name, const std::vector<IVec3>& members);
   bool group_exists(const std::string& name) const;
+  const Group* group(const std::string& name) const;
+  /// World coordinates of the group's cubes.
   std::vector<IVec3> group_members(const std::string& name) const;
+  /// Dissolve the grouping; the cubes stay where they are (same as group_bake).
   bool group_erase(const std::string& name);
+  /// Translate a group in O(1). Cubes pushed outside in_world() are unreachable until
+  /// moved back, and group_bake refuses to flatten them.
   bool group_move(const std::string& name, const IVec3& d);
+  /// Turn a group about its anchor by an axis-aligned Orientation code, in O(1).
+  bool group_rotate(const std::string& name, uint8_t code);
+  /// Write the group's cubes into the world at their transformed positions and drop
+  /// the group. Throws std::out_of_range (changing nothing) if any would land outside.
+  bool group_bake(const std::string& name);
+  /// fn(const std::string& name, const Group&) in unspecified order.
+  template <class Fn> void for_each_group(Fn&& fn) const {
+    for (auto& [name, g] : groups_) fn(name, g);
+  }
+
+  // Journals
+  /// Report every subsequent change to j (not owned; remove it before destroying it).
+  void add_journal(IEditJournal* j);
+  void remove_journal(IEditJournal* j);
+
+  // Store-level edits for replaying journals: coordinates are local to `group`
+  // ("" = ungrouped), cubes are in its frame, and no in_world() check is made.
+  // They are reported to journals like any other edit.
+  void apply_place(const std::string& group, std::span<const IVec3> coords, std::span<const Cube> cubes);
+  void apply_erase(const std::string& group, std::span<const IVec3> coords);
+  /// Create or re-pose a group (pose != nullptr), or drop it with its cubes.
+  void apply_group(const std::string& name, const GroupPose* pose);
 
 private:
+  friend struct Snapshot;
+
   int baseEdgePixels_;
-  std::unordered_map<IVec3, Cube, IVec3Hasher> cubes_;
-  std::unordered_map<std::string, std::vector<IVec3>> groups_;
+  std::unique_ptr<ChunkPager> pager_;   ///< before the stores: they release page records on clear
+  ChunkStore cubes_;
+  MaterialPalette palette_;
+  mutable RotationTable rotations_;   ///< const lookups may intern group-composed rotations
+  std::size_t rotationGcAt_ = 1024;
+  std::unordered_map<std::string, Group> groups_;
+  std::vector<IEditJournal*> journals_;
+
+  static inline const std::string UNGROUPED{};   ///< journal name of the world store
+
+  /// Flag material / rotation slots in use by any store, chunk source or journal.
+  void mark_used(std::vector<bool>& materials, std::vector<bool>& rotations) const;
+  void note_voxel(const std::string& group, const IVec3& p, const Cube* before, const Cube* after);
+  void note_group(const std::string& name, const GroupPose* before, const GroupPose* after);
+  /// ChunkStore batch edits that report to journals first.
+  std::size_t store_place_many(const std::string& name, ChunkStore& s,
+                               std::span<const IVec3> coords, std::span<const Cube> cubes);
+  std::size_t store_erase_many(const std::string& name, ChunkStore& s,
+                               std::span<const IVec3> coords, std::vector<uint8_t>* hit = nullptr);
+  ChunkStore& store_named(const std::string& group);
+  /// The world store and every group store.
+  std::vector<const ChunkStore*> all_stores() const;
+
+  /// Cube as seen in the world / stored in g (rotation composed with g's orientation).
+  Cube to_world_frame(const Group& g, Cube c) const;
+  Cube to_group_frame(const Group& g, Cube c) const;
+
+  /// Run pass(localCoords, localHit) on g for the coords not hit yet and fold its hits back.
+  template <class Pass>
+  static std::size_t group_pass(const Group& g, std::span<const IVec3> coords,
+                                std::vector<uint8_t>& hit, Pass&& pass) {
+    if (g.cubes.size() == 0) return 0;
+    std::vector<IVec3> local;
+    std::vector<uint32_t> back;
+    for (std::size_t i = 0; i < coords.size(); ++i) {
+      if (hit[i]) continue;
+      local.push_back(g.to_local(coords[i]));
+      back.push_back(uint32_t(i));
+    }
+    if (local.empty()) return 0;
+    std::vector<uint8_t> localHit(local.size(), 0);
+    std::size_t n = pass(std::span<const IVec3>(local), &localHit);
+    for (std::size_t k = 0; k < back.size(); ++k) if (localHit[k]) hit[back[k]] = 1;
+    return n;
+  }
 };
 
 } // namespace vxl
@@ -0,0 +1,146 @@
+#include "voxel_mask.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace vxl {
+
+VoxelMask::Bits& VoxelMask::writable(std::shared_ptr<Bits>& b) {
+  if (b.use_count() > 1) {
+    b = std::make_shared<Bits>(*b);
+  } else {
+    // The last other owner (a snapshot) may have let go on another thread: see its reads first
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return *b;
+}
+
+bool VoxelMask::insert(const IVec3& p) {
+  auto [slot, fresh] = chunks_.try_emplace(chunk_of(p));
+  if (fresh) *slot = std::make_shared<Bits>();
+  const int i = local_index(p);
+  const uint64_t bit = uint64_t(1) << (i & 63);
+  if ((*slot)->words[i >> 6] & bit) return false;
+  Bits& b = writable(*slot);
+  b.words[i >> 6] |= bit;
+  ++b.count;
+  ++size_;
+  return true;
+}
+
+bool VoxelMask::erase(const IVec3& p) {
+  const IVec3 cc = chunk_of(p);
+  std::shared_ptr<Bits>* slot = chunks_.find(cc);
+  const int i = local_index(p);
+  const uint64_t bit = uint64_t(1) << (i & 63);
+  if (!slot || !((*slot)->words[i >> 6] & bit)) return false;
+  Bits& b = writable(*slot);
+  b.words[i >> 6] &= ~bit;
+  --size_;
+  if (--b.count == 0) chunks_.erase(cc);
+  return true;
+}
+
+bool VoxelMask::contains(const IVec3& p) const {
+  const Bits* b = chunk(chunk_of(p));
+  const int i = local_index(p);
+  return b && (b->words[i >> 6] >> (i & 63) & 1);
+}
+
+void VoxelMask::insert_chunk(const IVec3& cc, const Bits& bits) {
+  if (std::all_of(bits.words, bits.words + WORDS, [](uint64_t w) { return w == 0; })) return;
+  auto [slot, fresh] = chunks_.try_emplace(cc);
+  if (fresh) *slot = std::make_shared<Bits>();
+  Bits& b = writable(*slot);
+  size_ -= std::size_t(b.count);
+  b.count = 0;
+  for (int w = 0; w < WORDS; ++w) {
+    b.words[w] |= bits.words[w];
+    b.count += std::popcount(b.words[w]);
+  }
+  size_ += std::size_t(b.count);
+}
+
+VoxelMask& VoxelMask::operator|=(const VoxelMask& o) {
+  if (this == &o) return *this;
+  o.chunks_.for_each([&](const IVec3& cc, const std::shared_ptr<Bits>& ob) {
+    auto [slot, fresh] = chunks_.try_emplace(cc);
+    if (fresh) {   // share it; the first change to either side copies it
+      *slot = ob;
+      size_ += std::size_t(ob->count);
+      return;
+    }
+    if (*slot == ob) return;
+    Bits& b = writable(*slot);
+    size_ -= std::size_t(b.count);
+    b.count = 0;
+    for (int w = 0; w < WORDS; ++w) {
+      b.words[w] |= ob->words[w];
+      b.count += std::popcount(b.words[w]);
+    }
+    size_ += std::size_t(b.count);
+  });
+  return *this;
+}
+
+VoxelMask& VoxelMask::operator&=(const VoxelMask& o) {
+  if (this == &o) return *this;
+  std::vector<IVec3> emptied;
+  chunks_.for_each([&](const IVec3& cc, std::shared_ptr<Bits>& slot) {
+    const std::shared_ptr<Bits>* ob = o.chunks_.find(cc);
+    if (ob && *ob == slot) return;
+    size_ -= std::size_t(slot->count);
+    if (!ob) { emptied.push_back(cc); return; }
+    Bits& b = writable(slot);
+    b.count = 0;
+    for (int w = 0; w < WORDS; ++w) {
+      b.words[w] &= (*ob)->words[w];
+      b.count += std::popcount(b.words[w]);
+    }
+    size_ += std::size_t(b.count);
+    if (b.count == 0) emptied.push_back(cc);
+  });
+  for (const IVec3& cc : emptied) chunks_.erase(cc);
+  return *this;
+}
+
+VoxelMask& VoxelMask::operator-=(const VoxelMask& o) {
+  if (this == &o) { clear(); return *this; }
+  std::vector<IVec3> emptied;
+  chunks_.for_each([&](const IVec3& cc, std::shared_ptr<Bits>& slot) {
+    const std::shared_ptr<Bits>* ob = o.chunks_.find(cc);
+    if (!ob) return;
+    size_ -= std::size_t(slot->count);
+    if (*ob == slot) { emptied.push_back(cc); return; }
+    Bits& b = writable(slot);
+    b.count = 0;
+    for (int w = 0; w < WORDS; ++w) {
+      b.words[w] &= ~(*ob)->words[w];
+      b.count += std::popcount(b.words[w]);
+    }
+    size_ += std::size_t(b.count);
+    if (b.count == 0) emptied.push_back(cc);
+  });
+  for (const IVec3& cc : emptied) chunks_.erase(cc);
+  return *this;
+}
+
+bool operator==(const VoxelMask& a, const VoxelMask& b) {
+  if (a.size_ != b.size_ || a.chunks_.size() != b.chunks_.size()) return false;
+  bool same = true;
+  a.chunks_.for_each([&](const IVec3& cc, const std::shared_ptr<VoxelMask::Bits>& ab) {
+    if (!same) return;
+    const VoxelMask::Bits* bb = b.chunk(cc);
+    same = bb && (bb == ab.get() || std::equal(ab->words, ab->words + VoxelMask::WORDS, bb->words));
+  });
+  return same;
+}
+
+std::vector<IVec3> VoxelMask::items() const {
+  std::vector<IVec3> out;
+  out.reserve(size_);
+  for_each([&](const IVec3& p) { out.push_back(p); });
+  return out;
+}
+
+} // namespace vxl
@@ -0,0 +1,102 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+#include "chunk.hpp"
+#include "morton_map.hpp"
+#include "util.hpp"
+
+/** @file voxel_mask.hpp
+ *  @brief Set of voxel coordinates held as one occupancy bitmask per 32^3 chunk.
+ */
+
+namespace vxl {
+
+/** @brief Coordinate set backed by per-chunk bitmasks (4 KiB per touched chunk).
+ *
+ *  A chunk's bits are laid out by local_index(), so a set of a million
+ *  neighbouring voxels costs about 128 KiB rather than tens of bytes per entry,
+ *  and union / intersection / difference run a 64-bit word at a time. Copies
+ *  share chunk masks; a mask is copied before its next change only while
+ *  another VoxelMask still holds it, so handing a copy to a snapshot costs one
+ *  pointer per chunk. Coordinates must satisfy in_morton_range().
+ */
+class VoxelMask {
+public:
+  static constexpr int WORDS = CHUNK_VOLUME / 64;
+
+  /// One chunk's bits: local index i is bit i & 63 of words[i >> 6].
+  struct Bits {
+    uint64_t words[WORDS] = {};
+    int count = 0;   ///< bits set
+  };
+
+  bool empty() const noexcept { return size_ == 0; }
+  std::size_t size() const noexcept { return size_; }
+  /// Chunks holding at least one coordinate.
+  std::size_t chunk_count() const noexcept { return chunks_.size(); }
+  void clear() { chunks_.clear(); size_ = 0; }
+
+  /// Returns true if p was not present.
+  bool insert(const IVec3& p);
+  /// Returns true if p was present.
+  bool erase(const IVec3& p);
+  bool contains(const IVec3& p) const;
+  /// Add the coordinates of chunk cc set in bits.words (bits.count is ignored).
+  void insert_chunk(const IVec3& cc, const Bits& bits);
+
+  VoxelMask& operator|=(const VoxelMask& o);
+  VoxelMask& operator&=(const VoxelMask& o);
+  /// Remove every coordinate of o.
+  VoxelMask& operator-=(const VoxelMask& o);
+  friend bool operator==(const VoxelMask& a, const VoxelMask& b);
+
+  /// Bits of chunk cc, or null if it holds none.
+  const Bits* chunk(const IVec3& cc) const {
+    const std::shared_ptr<Bits>* b = chunks_.find(cc);
+    return b ? b->get() : nullptr;
+  }
+  /// fn(const IVec3& chunkCoord, const Bits&) per non-empty chunk, in unspecified order.
+  template <class Fn> void for_each_chunk(Fn&& fn) const {
+    chunks_.for_each([&](const IVec3& cc, const std::shared_ptr<Bits>& b) { fn(cc, *b); });
+  }
+  /// fn(const IVec3&) per coordinate, chunk by chunk, ascending local index within a chunk.
+  template <class Fn> void for_each(Fn&& fn) const {
+    for_each_chunk([&](const IVec3& cc, const Bits& b) {
+      for (int w = 0; w < WORDS; ++w)
+        for (uint64_t m = b.words[w]; m; m &= m - 1) fn(voxel_at(cc, w * 64 + std::countr_zero(m)));
+    });
+  }
+  /// fn(std::span<const IVec3>) over all coordinates in slices of at most n,
+  /// in for_each() order, for the batch edit APIs without listing every
+  /// coordinate at once. The span is reused between calls.
+  template <class Fn> void for_each_slice(std::size_t n, Fn&& fn) const {
+    std::vector<IVec3> buf;
+    buf.reserve(std::min(n, size_));
+    for_each([&](const IVec3& p) {
+      buf.push_back(p);
+      if (buf.size() < n) return;
+      fn(std::span<const IVec3>(buf));
+      buf.clear();
+    });
+    if (!buf.empty()) fn(std::span<const IVec3>(buf));
+  }
+  /// Every coordinate, in for_each() order.
+  std::vector<IVec3> items() const;
+
+  /// Heap bytes held, counting shared chunk masks in full.
+  std::size_t memory_bytes() const noexcept { return chunks_.memory_bytes() + chunks_.size() * sizeof(Bits); }
+
+private:
+  MortonMap<std::shared_ptr<Bits>> chunks_;   ///< by chunk coordinate; never holds an empty mask
+  std::size_t size_ = 0;
+
+  /// b, first copied if another VoxelMask shares it.
+  static Bits& writable(std::shared_ptr<Bits>& b);
+};
+
+} // namespace vxl
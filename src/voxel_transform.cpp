@@ -0,0 +1,96 @@
+#include "voxel_transform.hpp"
+#include "orientation.hpp"
+#include <cmath>
+#include <stdexcept>
+
+namespace vxl {
+
+namespace {
+
+int& at(IVec3& v, int i) { return i == 0 ? v.x : i == 1 ? v.y : v.z; }
+int at(const IVec3& v, int i) { return i == 0 ? v.x : i == 1 ? v.y : v.z; }
+
+} // namespace
+
+VoxelTransform VoxelTransform::then(const VoxelTransform& next) const noexcept {
+  VoxelTransform r;
+  for (int i = 0; i < 3; ++i) {
+    const int j = next.axis[i];
+    r.axis[i] = axis[j];
+    r.sign[i] = int8_t(next.sign[i] * sign[j]);
+    at(r.t, i) = next.sign[i] * at(t, j) + at(next.t, i);
+  }
+  return r;
+}
+
+VoxelTransform VoxelTransform::inverse() const noexcept {
+  VoxelTransform r;
+  for (int i = 0; i < 3; ++i) {
+    const int a = axis[i];
+    r.axis[a] = int8_t(i);
+    r.sign[a] = sign[i];
+    at(r.t, a) = -sign[i] * at(t, i);
+  }
+  return r;
+}
+
+int VoxelTransform::det() const noexcept {
+  int inversions = (axis[0] > axis[1]) + (axis[0] > axis[2]) + (axis[1] > axis[2]);
+  return (inversions % 2 ? -1 : 1) * sign[0] * sign[1] * sign[2];
+}
+
+bool VoxelTransform::identity() const noexcept { return *this == VoxelTransform{}; }
+
+uint8_t VoxelTransform::cube_turn() const {
+  glm::mat3 m(0.0f);
+  const int d = det();
+  for (int i = 0; i < 3; ++i) m[axis[i]][i] = float(sign[i] * d);
+  return *orientation_from_matrix(m);
+}
+
+VoxelTransform VoxelTransform::translation(const IVec3& d) {
+  VoxelTransform r;
+  r.t = d;
+  return r;
+}
+
+VoxelTransform VoxelTransform::turn(int axis, int quarters, const IVec3& pivot2) {
+  if (axis < 0 || axis > 2) throw std::invalid_argument("VoxelTransform::turn: axis must be 0, 1 or 2");
+  // One right-handed quarter turn: (x, -z, y), (z, y, -x) or (-y, x, z)
+  static constexpr int8_t AXES[3][3] = {{0, 2, 1}, {2, 1, 0}, {1, 0, 2}};
+  static constexpr int8_t SIGNS[3][3] = {{1, -1, 1}, {1, 1, -1}, {-1, 1, 1}};
+  VoxelTransform quarter;
+  for (int i = 0; i < 3; ++i) { quarter.axis[i] = AXES[axis][i]; quarter.sign[i] = SIGNS[axis][i]; }
+  VoxelTransform r;
+  for (int q = ((quarters % 4) + 4) % 4; q > 0; --q) r = r.then(quarter);
+  // p -> R (p - c) + c, so t = c - R c, computed doubled
+  const IVec3 rc = r.apply(pivot2);
+  const IVec3 t2{pivot2.x - rc.x, pivot2.y - rc.y, pivot2.z - rc.z};
+  if (t2.x % 2 || t2.y % 2 || t2.z % 2)
+    throw std::invalid_argument("VoxelTransform::turn: the pivot would put cubes between cells");
+  r.t = {t2.x / 2, t2.y / 2, t2.z / 2};
+  return r;
+}
+
+VoxelTransform VoxelTransform::mirror(int axis, int plane2) {
+  if (axis < 0 || axis > 2) throw std::invalid_argument("VoxelTransform::mirror: axis must be 0, 1 or 2");
+  VoxelTransform r;
+  r.sign[axis] = -1;
+  at(r.t, axis) = plane2;
+  return r;
+}
+
+IVec3 doubled_centroid(const VoxelMask& m) {
+  double s[3] = {0.0, 0.0, 0.0};
+  m.for_each([&](const IVec3& p) { s[0] += p.x; s[1] += p.y; s[2] += p.z; });
+  const double k = 2.0 / double(m.size());
+  return {int(std::llround(s[0] * k)), int(std::llround(s[1] * k)), int(std::llround(s[2] * k))};
+}
+
+IVec3 turnable_pivot(int axis, IVec3 pivot2) {
+  const int a = (axis + 1) % 3, b = (axis + 2) % 3;
+  if ((at(pivot2, a) - at(pivot2, b)) % 2) at(pivot2, b) += 1;
+  return pivot2;
+}
+
+} // namespace vxl
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include "util.hpp"
+#include "voxel_mask.hpp"
+
+/** @file voxel_transform.hpp
+ *  @brief Exact integer maps of the grid onto itself: 90-degree turns, mirrors
+ *         and translations, and their compositions.
+ */
+
+namespace vxl {
+
+/** @brief p -> R p + t, where R permutes the axes and flips some of them.
+ *
+ *  Row i of R holds sign[i] in column axis[i], so component i of R p is
+ *  sign[i] * p[axis[i]]. Each of the 48 such maps is a turn (det R = +1) or
+ *  a turn combined with a mirror (det R = -1).
+ */
+struct VoxelTransform {
+  int8_t axis[3] = {0, 1, 2};
+  int8_t sign[3] = {1, 1, 1};
+  IVec3 t{0,0,0};
+
+  IVec3 apply(const IVec3& p) const noexcept {
+    const int v[3] = {p.x, p.y, p.z};
+    return {sign[0] * v[axis[0]] + t.x, sign[1] * v[axis[1]] + t.y, sign[2] * v[axis[2]] + t.z};
+  }
+  /// This map, then `next`.
+  VoxelTransform then(const VoxelTransform& next) const noexcept;
+  VoxelTransform inverse() const noexcept;
+  /// det R: -1 if the map mirrors.
+  int det() const noexcept;
+  bool identity() const noexcept;
+  /// Orientation code a cube turns by: R, or -R for a mirror. A cube looks the
+  /// same reflected through its centre, so turning it by -R matches R.
+  uint8_t cube_turn() const;
+
+  bool operator==(const VoxelTransform&) const = default;
+
+  static VoxelTransform translation(const IVec3& d);
+  /** @brief `quarters` right-handed quarter turns about the axis (0 = x, 1 = y,
+   *         2 = z) through the point pivot2 / 2.
+   *
+   *  Pivots are given doubled so they can sit on cube centres (even) or on
+   *  cube faces and corners (odd). For an odd number of quarters both
+   *  coordinates across the axis must share a parity, or cubes would land
+   *  between cells: std::invalid_argument otherwise, or for a bad axis.
+   */
+  static VoxelTransform turn(int axis, int quarters, const IVec3& pivot2);
+  /// Reflection across the plane {p : p[axis] = plane2 / 2}.
+  static VoxelTransform mirror(int axis, int plane2);
+};
+
+/// Twice the mean of m's coordinates, rounded: a pivot (see VoxelTransform::turn)
+/// at the centroid to the nearest half cube. m must not be empty.
+IVec3 doubled_centroid(const VoxelMask& m);
+
+/// pivot2 nudged by half a cube where needed so a turn about `axis` is valid.
+IVec3 turnable_pivot(int axis, IVec3 pivot2);
+
+} // namespace vxl
@@ -0,0 +1,94 @@
+#include "world_snapshot.hpp"
+
+namespace vxl {
+
+std::shared_ptr<const StoreSnapshot> StoreSnapshot::update(const ChunkStore& S, const std::shared_ptr<const StoreSnapshot>& prev) {
+  const StoreSnapshot* base = prev && prev->serial_ == S.serial() ? prev.get() : nullptr;
+  // Chunks to look at again, by region
+  MortonMap<std::vector<IVec3>> touched;
+  if (base) {
+    S.take_dirty([&](const IVec3& cc) { touched[region_of(cc)].push_back(cc); });
+    if (touched.empty()) return prev;
+  } else {
+    S.take_dirty([](const IVec3&) {});
+    S.for_each_chunk_coord([&](const IVec3& cc) { touched[region_of(cc)].push_back(cc); });
+  }
+
+  auto out = std::make_shared<StoreSnapshot>();
+  out->serial_ = S.serial();
+  out->size_ = S.size();
+  if (base) {
+    out->regions_ = base->regions_;
+    out->chunks_ = base->chunks_;
+  }
+  touched.for_each([&](const IVec3& rc, const std::vector<IVec3>& ccs) {
+    const std::shared_ptr<const ChunkTable>* old = out->regions_.find(rc);
+    auto table = old ? std::make_shared<ChunkTable>(**old) : std::make_shared<ChunkTable>();
+    for (const IVec3& cc : ccs) {
+      if (std::shared_ptr<const Chunk> ch = S.has_chunk(cc) ? S.share(cc) : nullptr) {
+        auto [slot, fresh] = table->try_emplace(cc);
+        *slot = std::move(ch);
+        out->chunks_ += fresh;
+      } else if (table->erase(cc)) {
+        --out->chunks_;
+      }
+    }
+    if (table->empty()) out->regions_.erase(rc);
+    else out->regions_[rc] = std::move(table);
+  });
+  return out;
+}
+
+const Chunk* StoreSnapshot::chunk(const IVec3& cc) const {
+  const std::shared_ptr<const ChunkTable>* t = regions_.find(region_of(cc));
+  if (!t) return nullptr;
+  const std::shared_ptr<const Chunk>* ch = (*t)->find(cc);
+  return ch ? ch->get() : nullptr;
+}
+
+std::shared_ptr<const WorldSnapshot> SnapshotBuilder::build(const Universe& U, const Selection& Sel,
+                                                            std::vector<EditStamp> edits) {
+  auto out = std::make_shared<WorldSnapshot>();
+  const WorldSnapshot* prev = last_.get();
+  out->version = next_version();
+  out->world = StoreSnapshot::update(U.store(), prev ? prev->world : nullptr);
+  U.for_each_group([&](const std::string& name, const Group& g) {
+    std::shared_ptr<const StoreSnapshot> before;
+    if (prev)
+      for (const auto& v : prev->groups)
+        if (v.cubes->serial() == g.cubes.serial()) { before = v.cubes; break; }
+    out->groups.push_back({name, StoreSnapshot::update(g.cubes, before), g.offset, g.orient});
+  });
+
+  const MaterialPalette& pal = U.materials();
+  if (prev && prev->materials->version == pal.version()) {
+    out->materials = prev->materials;
+  } else {
+    auto t = std::make_shared<MaterialTable>();
+    t->version = pal.version();
+    t->entries.reserve(pal.slots());
+    for (std::size_t i = 0; i < pal.slots(); ++i) t->entries.push_back(pal.get(MaterialId(i)));
+    out->materials = std::move(t);
+  }
+  const RotationTable& rt = U.free_rotations();
+  if (prev && prev->rotations->version == rt.version()) {
+    out->rotations = prev->rotations;
+  } else {
+    auto t = std::make_shared<RotationMatrices>();
+    t->version = rt.version();
+    t->matrices.reserve(rt.slots());
+    for (std::size_t i = 0; i < rt.slots(); ++i) t->matrices.push_back(rt.matrix(uint32_t(i)));
+    out->rotations = std::move(t);
+  }
+  if (prev && prev->selectionVersion == Sel.version()) out->selection = prev->selection;
+  else out->selection = std::make_shared<const VoxelMask>(Sel.set());
+  out->selectionVersion = Sel.version();
+
+  out->cubes = U.size();
+  out->baseEdgePixels = U.base_edge_pixels();
+  out->edits = std::move(edits);
+  last_ = out;
+  return out;
+}
+
+} // namespace vxl
@@ -0,0 +1,150 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "universe.hpp"
+#include "selection.hpp"
+
+/** @file world_snapshot.hpp
+ *  @brief Immutable, versioned views of a Universe and its Selection that other
+ *         threads can read while the originals go on changing. Each view shares
+ *         everything that did not change with the one before it.
+ */
+
+namespace vxl {
+
+/// log2 of the chunks per region edge. A new view of a store copies its region
+/// table and the chunk tables of the regions that changed, nothing else.
+constexpr int REGION_SHIFT = 3;
+
+/** @brief Immutable view of one ChunkStore, safe to read from any thread.
+ *
+ *  Holds the store's own chunks (ChunkStore::share): the store copies a chunk
+ *  before changing it while a view still has it, so views never see a change
+ *  and cost no copies of chunks that stay the same. Chunks are filed by region
+ *  of 8^3 chunk coordinates; a view made after some chunks changed shares the
+ *  tables of all other regions with the view it was made from, and
+ *  for_each_change() finds the differences by comparing pointers.
+ */
+class StoreSnapshot {
+public:
+  /// View of S: `prev` (an earlier view of S, or null) updated with the chunks
+  /// S reports through ChunkStore::take_dirty, which this consumes. Returns prev
+  /// itself if nothing changed. With no prev, every chunk of S is faulted in.
+  static std::shared_ptr<const StoreSnapshot> update(const ChunkStore& S, const std::shared_ptr<const StoreSnapshot>& prev);
+
+  /// The store's ChunkStore::serial().
+  uint64_t serial() const noexcept { return serial_; }
+  /// Cubes / chunks in the view.
+  std::size_t size() const noexcept { return size_; }
+  std::size_t chunk_count() const noexcept { return chunks_; }
+
+  const Chunk* chunk(const IVec3& cc) const;
+  bool has_chunk(const IVec3& cc) const { return chunk(cc) != nullptr; }
+  /// Whether the view has any chunk in region rc (chunk coordinates >> REGION_SHIFT).
+  bool has_region(const IVec3& rc) const { return regions_.contains(rc); }
+  /// fn(const IVec3& chunkCoord, const Chunk&) in unspecified order.
+  template <class Fn> void for_each_chunk(Fn&& fn) const {
+    regions_.for_each([&](const IVec3&, const std::shared_ptr<const ChunkTable>& t) {
+      t->for_each([&](const IVec3& cc, const std::shared_ptr<const Chunk>& ch) { fn(cc, *ch); });
+    });
+  }
+  /// fn(const IVec3& chunkCoord) for every chunk added, removed or changed since
+  /// `older`, an earlier view of the same store (every chunk if null). Regions
+  /// both views share are skipped unvisited.
+  template <class Fn> void for_each_change(const StoreSnapshot* older, Fn&& fn) const {
+    regions_.for_each([&](const IVec3& rc, const std::shared_ptr<const ChunkTable>& t) {
+      const std::shared_ptr<const ChunkTable>* o = older ? older->regions_.find(rc) : nullptr;
+      if (o && *o == t) return;
+      t->for_each([&](const IVec3& cc, const std::shared_ptr<const Chunk>& ch) {
+        const std::shared_ptr<const Chunk>* was = o ? (*o)->find(cc) : nullptr;
+        if (!was || *was != ch) fn(cc);
+      });
+      if (o) (*o)->for_each([&](const IVec3& cc, const std::shared_ptr<const Chunk>&) { if (!t->contains(cc)) fn(cc); });
+    });
+    if (!older) return;
+    older->regions_.for_each([&](const IVec3& rc, const std::shared_ptr<const ChunkTable>& o) {
+      if (!regions_.contains(rc)) o->for_each([&](const IVec3& cc, const std::shared_ptr<const Chunk>&) { fn(cc); });
+    });
+  }
+
+private:
+  using ChunkTable = MortonMap<std::shared_ptr<const Chunk>>;
+  MortonMap<std::shared_ptr<const ChunkTable>> regions_;   ///< by region coordinate
+  uint64_t serial_ = 0;
+  std::size_t size_ = 0, chunks_ = 0;
+
+  static IVec3 region_of(const IVec3& cc) { return {cc.x >> REGION_SHIFT, cc.y >> REGION_SHIFT, cc.z >> REGION_SHIFT}; }
+};
+
+/// Palette entries (MaterialPalette::get of every slot) as of one version.
+struct MaterialTable {
+  uint64_t version = 0;
+  std::vector<Material> entries;
+};
+
+/// Side-table rotation matrices (RotationTable::matrix of every slot) as of one version.
+struct RotationMatrices {
+  uint64_t version = 0;
+  std::vector<glm::mat3> matrices;
+};
+
+/// When the edits first shown by one snapshot were posted (the oldest of them).
+struct EditStamp {
+  uint64_t version = 0;                        ///< WorldSnapshot::version
+  std::chrono::steady_clock::time_point at{};
+};
+
+/** @brief The world at one moment, as published to other threads.
+ *
+ *  Parts that did not change since the previous snapshot are the same objects
+ *  (same pointers) as in it.
+ */
+struct WorldSnapshot {
+  using Clock = std::chrono::steady_clock;
+
+  /// A group's cubes and pose (see Group).
+  struct GroupView {
+    std::string name;
+    std::shared_ptr<const StoreSnapshot> cubes;
+    IVec3 offset{0,0,0};
+    uint8_t orient = 0;
+  };
+
+  uint64_t version = 0;                               ///< 1 for the first snapshot of a builder, then counting up
+  std::shared_ptr<const StoreSnapshot> world;         ///< ungrouped cubes
+  std::vector<GroupView> groups;
+  std::shared_ptr<const MaterialTable> materials;
+  std::shared_ptr<const RotationMatrices> rotations;
+  std::shared_ptr<const VoxelMask> selection;         ///< shares the selection's chunk masks
+  uint64_t selectionVersion = 0;                      ///< Selection::version() it was copied at
+  std::size_t cubes = 0;                              ///< Universe::size()
+  int baseEdgePixels = 64;
+  /// Snapshots that may not have reached the reader, this one included, with
+  /// when the oldest edit each was the first to show was posted. Oldest first;
+  /// a reader that skipped some finds them here (see Simulation).
+  std::vector<EditStamp> edits;
+};
+
+/** @brief Makes the WorldSnapshots of one Universe and Selection, each from the
+ *         one before. Lives on (and is called from) the thread editing them.
+ */
+class SnapshotBuilder {
+public:
+  /// Snapshot of U and Sel as they are now. Consumes the stores' dirty chunks
+  /// (see StoreSnapshot::update), so it must be their only consumer.
+  std::shared_ptr<const WorldSnapshot> build(const Universe& U, const Selection& Sel,
+                                             std::vector<EditStamp> edits = {});
+  /// The version the next build() gives its snapshot.
+  uint64_t next_version() const noexcept { return last_ ? last_->version + 1 : 1; }
+  /// The snapshot build() returned last, or null.
+  const std::shared_ptr<const WorldSnapshot>& last() const noexcept { return last_; }
+
+private:
+  std::shared_ptr<const WorldSnapshot> last_;
+};
+
+} // namespace vxl
@@ -24,7 +24,24 @@ TEST_CASE("Commands basic") {
   REQUIRE(R.run_line("fill solid #00ff00ff", ctx));
   auto c = U.get(0,0,0);
   REQUIRE(c.has_value());
-  REQUIRE(c->mat.colorA.y == Approx(1.0f));
+  REQUIRE(U.material(c->mat).colorA.y == Approx(1.0f));
   REQUIRE(R.run_line("move 0 1 0", ctx));
   REQUIRE(U.get(0,1,0).has_value());
 }
+
+TEST_CASE("Commands share palette entries") {
+  Universe U;
+  Selection S;
+  CommandRegistry R;
+  register_builtin_commands(R);
+  CommandContext ctx{ U, S, [](const std::string&){}, [](){}, [](){} };
+
+  for (int x = 0; x < 10; ++x)
+    REQUIRE(R.run_line("place " + std::to_string(x) + " 0 0 color=#ff0000ff", ctx));
+  REQUIRE(U.materials().size() == 2);  // default + red
+  REQUIRE(R.run_line("select box 0 0 0 9 0 0", ctx));
+  REQUIRE(R.run_line("fill gradient #000000ff #ffffffff dir=x", ctx));
+  REQUIRE(U.get(0,0,0)->mat == U.get(9,0,0)->mat);
+  REQUIRE(R.run_line("palette gc", ctx));
+  REQUIRE(U.materials().size() == 2);  // red was dropped
+}
@@ -0,0 +1,57 @@
+#include <catch2/catch_test_macros.hpp>
+#include "depth_sort.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace vxl;
+
+TEST_CASE("Parallel radix sort is stable and matches a serial sort") {
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<uint32_t> key(0, 5000);   // plenty of ties
+  std::vector<DepthKey> a(200000);
+  for (std::size_t i = 0; i < a.size(); ++i) a[i] = {key(rng) << 4, uint32_t(i)};   // low digit all zero
+  std::vector<DepthKey> want = a;
+  std::stable_sort(want.begin(), want.end(), [](const DepthKey& x, const DepthKey& y) { return x.key < y.key; });
+
+  ThreadPool pool(3);
+  std::vector<DepthKey> scratch;
+  for (ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}) {
+    std::vector<DepthKey> got = a;
+    radix_sort(got, DEPTH_KEY_BITS, scratch, p);
+    bool same = true;
+    for (std::size_t i = 0; i < got.size(); ++i) same &= got[i].key == want[i].key && got[i].index == want[i].index;
+    REQUIRE(same);
+  }
+}
+
+TEST_CASE("Depth sorter orders back to front and reuses the order for small moves") {
+  std::vector<glm::vec3> pts = {{0, 0, -5}, {0, 0, -50}, {3, 0, 1}, {0, 0, -20}, {0, 40, 0}};
+  DepthSorter S;
+  REQUIRE_FALSE(S.reusable(1, glm::vec3(0.0f)));
+  S.sort(pts, glm::vec3(0.0f), 1);
+  REQUIRE(S.order() == std::vector<uint32_t>{1, 4, 3, 0, 2});
+
+  // Turning the camera changes nothing; moving it a little keeps the order
+  REQUIRE(S.reusable(1, glm::vec3(0.05f, 0, 0)));
+  REQUIRE_FALSE(S.reusable(1, glm::vec3(0, 0, -30)));   // walked past two of them
+  REQUIRE_FALSE(S.reusable(2, glm::vec3(0.0f)));        // different points
+  S.sort(pts, glm::vec3(0, 0, -30), 2);
+  REQUIRE(S.order() == std::vector<uint32_t>{4, 2, 0, 1, 3});
+  S.invalidate();
+  REQUIRE_FALSE(S.reusable(2, glm::vec3(0, 0, -30)));
+
+  // Many points on the pool: distances never increase along the order
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+  pts.resize(100000);
+  for (auto& p : pts) p = {pos(rng), pos(rng), pos(rng)};
+  ThreadPool pool(2);
+  const glm::vec3 eye(10, -20, 30);
+  S.sort(pts, eye, 3, &pool);
+  REQUIRE(S.order().size() == pts.size());
+  const float step = 400.0f / float(1u << DEPTH_KEY_BITS);   // quantization, over the farthest distance
+  bool ordered = true;
+  for (std::size_t i = 1; i < pts.size(); ++i)
+    ordered &= glm::length(pts[S.order()[i]] - eye) <= glm::length(pts[S.order()[i - 1]] - eye) + step;
+  REQUIRE(ordered);
+}
@@ -0,0 +1,163 @@
+#include <catch2/catch_test_macros.hpp>
+#include "edit_log.hpp"
+#include "commands.hpp"
+#include "snapshot.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <filesystem>
+#include <fstream>
+
+using namespace vxl;
+
+namespace {
+
+struct Session {
+  std::string base;
+  explicit Session(const char* name) : base((std::filesystem::temp_directory_path() / name).string()) { remove(); }
+  ~Session() { remove(); }
+  std::string log() const { return base + ".wal"; }
+  std::string snap() const { return base + ".vxs"; }
+  void remove() const {
+    std::error_code ec;
+    std::filesystem::remove(log(), ec);
+    std::filesystem::remove(snap(), ec);
+  }
+};
+
+/// Every cube of A, seen through get(), matches B (materials and rotations by value).
+bool same_scene(const Universe& A, const Universe& B) {
+  if (A.size() != B.size()) return false;
+  bool same = true;
+  auto check = [&](const IVec3& p){
+    auto a = A.get(p.x, p.y, p.z), b = B.get(p.x, p.y, p.z);
+    if (!a || !b || !(A.material(a->mat) == B.material(b->mat)) || A.rotation_matrix(*a) != B.rotation_matrix(*b)) same = false;
+  };
+  A.store().for_each([&](const IVec3& p, const Cube&){ check(p); });
+  A.for_each_group([&](const std::string& name, const Group&){
+    if (!B.group(name) || !(B.group(name)->pose() == A.group(name)->pose())) same = false;
+    for (auto& p : A.group_members(name)) check(p);
+  });
+  return same;
+}
+
+void edit_scene(Universe& U, EditLog& L) {
+  Material red; red.colorA = {1,0,0,1};
+  Cube a; a.mat = U.materials().intern(red);
+  std::vector<IVec3> block;
+  for (int z = 0; z < 20; ++z) for (int y = 0; y < 20; ++y) for (int x = 0; x < 20; ++x) block.push_back({x,y,z});
+  L.begin();
+  U.place_many(block, std::span<const Cube>(&a, 1));
+  L.commit();
+
+  L.begin();
+  Material grad; grad.kind = Material::Kind::Gradient; grad.colorB = {0,0,1,1};
+  MaterialId g = U.materials().intern(grad);
+  U.update_many(block, [&](const IVec3& p, Cube& c){ if (p.x < 5) c.mat = g; });
+  Cube b = a;
+  U.set_rotation(b, glm::angleAxis(glm::radians(20.0f), glm::vec3(1,0,0)));
+  U.place(-30, 4, 9, b);
+  U.erase(1, 1, 1);
+  L.commit();
+
+  L.begin();
+  U.group_create("lid", {{0,19,0}, {1,19,0}, {2,19,0}});
+  U.group_rotate("lid", 5);
+  U.group_move("lid", {0, 10, 0});
+  U.group_create(std::string(70000, 'n'), {{5,0,0}});   // longer than a 16-bit length
+  L.commit();
+
+  U.place(100, 100, 100, a);   // implicit transaction
+  L.publish();
+}
+
+} // namespace
+
+TEST_CASE("Edit log replays a session and cuts off a torn tail") {
+  Session S("vxl_test_session_a");
+  Universe U;
+  {
+    EditLog L(U, S.log(), S.snap());
+    REQUIRE(L.recovered().transactions == 0);
+    edit_scene(U, L);
+    L.flush();
+    REQUIRE(L.commits() == 4);
+    REQUIRE(L.syncs() >= 1);
+    REQUIRE(L.syncs() <= L.commits());
+    REQUIRE(L.error().empty());
+  }
+
+  Universe R;
+  {
+    EditLog L(R, S.log(), S.snap());
+    REQUIRE(L.recovered().transactions == 4);
+    REQUIRE_FALSE(L.recovered().tornTail);
+    REQUIRE(same_scene(U, R));
+    R.erase(100, 100, 100);   // appended after the replayed frames
+  }
+  U.erase(100, 100, 100);
+
+  // A crash mid-write leaves half a frame: it is dropped, the rest survives
+  {
+    std::ofstream f(S.log(), std::ios::binary | std::ios::app);
+    const char junk[] = {40, 0, 0, 0, 1, 2, 3, 4, 5};
+    f.write(junk, sizeof junk);
+  }
+  Universe T;
+  {
+    EditLog L(T, S.log(), S.snap());
+    REQUIRE(L.recovered().tornTail);
+    REQUIRE(L.recovered().transactions == 5);
+    REQUIRE(same_scene(U, T));
+    T.place(7, 7, 70);
+  }
+  U.place(7, 7, 70);
+  Universe V;
+  EditLog L(V, S.log(), S.snap());
+  REQUIRE_FALSE(L.recovered().tornTail);
+  REQUIRE(same_scene(U, V));
+}
+
+TEST_CASE("Checkpoint snapshots the session and restarts the log") {
+  Session S("vxl_test_session_b");
+  Universe U;
+  {
+    EditLog L(U, S.log(), S.snap());
+    edit_scene(U, L);
+    L.checkpoint();
+    REQUIRE(std::filesystem::exists(S.snap()));
+    REQUIRE(L.bytes() == 16);
+    Material blue; blue.colorA = {0,0,1,1};
+    Cube c; c.mat = U.materials().intern(blue);
+    U.place(-5, -5, -5, c);
+    U.group_move("lid", {1, 0, 0});
+  }
+  Universe R;
+  EditLog L(R, S.log(), S.snap());
+  REQUIRE(L.recovered().snapshot);
+  REQUIRE(L.recovered().transactions == 1);
+  REQUIRE(same_scene(U, R));
+}
+
+TEST_CASE("Commands are logged, and load is replayed from its snapshot") {
+  Session S("vxl_test_session_c");
+  auto other = (std::filesystem::temp_directory_path() / "vxl_test_session_other.vxs").string();
+  Universe Src;
+  Src.place(9, 9, 9);
+  Snapshot::save(Src, other);
+
+  Universe U; Selection Sel;
+  {
+    EditLog L(U, S.log(), S.snap());
+    CommandRegistry R; register_builtin_commands(R);
+    CommandContext ctx{U, Sel, [](const std::string&){}, []{}, []{}, nullptr, &L};
+    R.run_line("place 1 2 3 color=#ff0000ff", ctx);
+    R.run_line("load " + other, ctx);
+    R.run_line("place 4 5 6", ctx);
+  }
+  Universe R;
+  EditLog L(R, S.log(), S.snap());
+  REQUIRE(R.size() == 2);
+  REQUIRE(R.get(9, 9, 9));
+  REQUIRE(R.get(4, 5, 6));
+  REQUIRE_FALSE(R.get(1, 2, 3));
+  std::filesystem::remove(other);
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch_test_macros.hpp>
+#include "frustum.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+using namespace vxl;
+
+namespace {
+
+/// Camera at the origin looking down -z, 90 degree field of view, depth 1..100.
+Frustum looking_down_z() {
+  glm::mat4 P = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f);
+  glm::mat4 V = glm::lookAt(glm::vec3(0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+  return Frustum::from_matrix(P * V);
+}
+
+} // namespace
+
+TEST_CASE("Frustum culling keeps boxes in view and drops the rest") {
+  const Frustum F = looking_down_z();
+  AabbBatch B;
+  B.push({-1, -1, -11}, {1, 1, -9});        // straight ahead
+  B.push({-1, -1, 9}, {1, 1, 11});          // behind
+  B.push({-40, -1, -11}, {-30, 1, -9});     // far left of a 90 degree cone at depth 10
+  B.push({8, -1, -11}, {12, 1, -9});        // straddles the right plane
+  B.push({-1, -1, -150}, {1, 1, -120});     // beyond the far plane
+  B.push({-1, -1, -0.9f}, {1, 1, -0.5f});   // in front of the near plane
+  B.push({-500, -500, -99}, {500, 500, 1}); // encloses the whole frustum
+
+  std::vector<uint8_t> vis;
+  REQUIRE(cull_aabbs(F, B, vis) == 3);
+  REQUIRE(vis == std::vector<uint8_t>{1, 0, 0, 1, 0, 0, 1});
+  REQUIRE(cull_aabbs_scalar(F, B, vis) == 3);
+  REQUIRE(vis == std::vector<uint8_t>{1, 0, 0, 1, 0, 0, 1});
+}
+
+TEST_CASE("Batched culling agrees with the scalar reference") {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> pos(-200.0f, 200.0f), ext(0.5f, 32.0f);
+  glm::mat4 P = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.05f, 300.0f);
+  glm::mat4 V = glm::lookAt(glm::vec3(30, 40, 50), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+  const Frustum F = Frustum::from_matrix(P * V);
+
+  for (std::size_t n : {0u, 1u, 3u, 8u, 13u, 1000u}) {
+    AabbBatch B;
+    for (std::size_t i = 0; i < n; ++i) {
+      glm::vec3 lo(pos(rng), pos(rng), pos(rng));
+      B.push(lo, lo + glm::vec3(ext(rng), ext(rng), ext(rng)));
+    }
+    std::vector<uint8_t> simd, scalar;
+    REQUIRE(cull_aabbs(F, B, simd) == cull_aabbs_scalar(F, B, scalar));
+    REQUIRE(simd == scalar);
+  }
+}
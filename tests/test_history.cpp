@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+#include "history.hpp"
+#include "commands.hpp"
+#include <sstream>
+
+using namespace vxl;
+
+static std::vector<IVec3> block(int n) {
+  std::vector<IVec3> pts;
+  for (int z = 0; z < n; ++z) for (int y = 0; y < n; ++y) for (int x = 0; x < n; ++x) pts.push_back({x,y,z});
+  return pts;
+}
+
+TEST_CASE("History undoes and redoes batch edits") {
+  Universe U;
+  History H(U);
+  auto pts = block(40);
+  Cube a; a.mat = 1;
+
+  H.begin("place");
+  U.place_many(pts, std::span<const Cube>(&a, 1));
+  H.commit();
+  H.begin("fill");
+  U.update_many(pts, [](const IVec3& p, Cube& c){ c.mat = uint16_t(2 + (p.x & 1)); });
+  U.erase(0,0,0);
+  H.commit();
+  REQUIRE(H.undo_depth() == 2);
+
+  REQUIRE(H.undo());
+  REQUIRE(U.size() == pts.size());
+  REQUIRE(U.get(0,0,0)->mat == 1);
+  REQUIRE(U.get(39,39,39)->mat == 1);
+  REQUIRE(H.redo_depth() == 1);
+
+  REQUIRE(H.redo());
+  REQUIRE_FALSE(U.get(0,0,0).has_value());
+  REQUIRE(U.get(1,0,0)->mat == 3);
+  REQUIRE(U.get(2,0,0)->mat == 2);
+
+  REQUIRE(H.undo());
+  REQUIRE(H.undo());
+  REQUIRE(U.size() == 0);
+  REQUIRE_FALSE(H.undo());
+
+  // A new edit after undo discards the redo stack
+  H.begin("one");
+  U.place(5,5,5, a);
+  H.commit();
+  REQUIRE(H.redo_depth() == 0);
+  REQUIRE_FALSE(H.redo());
+}
+
+TEST_CASE("History covers group transforms") {
+  Universe U;
+  History H(U);
+  U.place(0,0,0); U.place(1,0,0); U.place(3,3,3);
+  H.clear();
+
+  H.begin(); U.group_create("g", {{0,0,0}, {1,0,0}}); H.commit();
+  H.begin(); U.group_move("g", {0,4,0}); H.commit();
+  H.begin(); U.group_bake("g"); H.commit();
+  REQUIRE(U.get(0,4,0).has_value());
+  REQUIRE_FALSE(U.group_exists("g"));
+
+  REQUIRE(H.undo());                       // un-bake
+  REQUIRE(U.group_exists("g"));
+  REQUIRE(U.store().size() == 1);
+  REQUIRE(U.get(1,4,0).has_value());
+  REQUIRE(H.undo());                       // un-move
+  REQUIRE(U.get(1,0,0).has_value());
+  REQUIRE_FALSE(U.get(1,4,0).has_value());
+  REQUIRE(H.undo());                       // un-create
+  REQUIRE_FALSE(U.group_exists("g"));
+  REQUIRE(U.store().size() == 3);
+
+  REQUIRE(H.redo());
+  REQUIRE(H.redo());
+  REQUIRE(U.group("g")->offset.y == 4);
+}
+
+TEST_CASE("History budget drops the oldest entries") {
+  Universe U;
+  History H(U);
+  for (int i = 0; i < 8; ++i) {
+    H.begin();
+    U.place(i, 0, 0);
+    H.commit();
+  }
+  REQUIRE(H.undo_depth() == 8);
+  std::size_t per = H.bytes() / 8;
+  H.set_budget(3 * per);
+  REQUIRE(H.undo_depth() == 3);
+  REQUIRE(H.bytes() <= H.budget());
+  while (H.undo()) {}
+  REQUIRE(U.size() == 5);                  // the five oldest edits can no longer be undone
+  REQUIRE(U.get(4,0,0).has_value());
+  REQUIRE_FALSE(U.get(5,0,0).has_value());
+}
+
+TEST_CASE("Commands record one undo entry per line") {
+  Universe U;
+  Selection S;
+  History H(U);
+  std::ostringstream out;
+  CommandRegistry R;
+  register_builtin_commands(R);
+  CommandContext ctx{U, S, [&](const std::string& s){ out << s << "\n"; }, [](){}, [](){}, &H};
+
+  REQUIRE(R.run_line("place 0 0 0 color=#ff0000ff", ctx));
+  REQUIRE(R.run_line("select box 0 0 0 0 0 0", ctx));
+  REQUIRE(R.run_line("fill solid #00ff00ff", ctx));
+  REQUIRE(H.undo_depth() == 2);            // select changes no voxels
+  REQUIRE(R.run_line("undo", ctx));
+  REQUIRE(U.material(U.get(0,0,0)->mat).colorA.x == 1.0f);
+  REQUIRE(R.run_line("redo", ctx));
+  REQUIRE(U.material(U.get(0,0,0)->mat).colorA.y == 1.0f);
+  REQUIRE(R.run_line("undo 5", ctx));
+  REQUIRE(U.size() == 0);
+
+  // Palette GC keeps materials the journal still refers to
+  U.gc_materials();
+  REQUIRE(R.run_line("redo 2", ctx));
+  REQUIRE(U.material(U.get(0,0,0)->mat).colorA.y == 1.0f);
+}
@@ -0,0 +1,66 @@
+#include <catch2/catch_test_macros.hpp>
+#include "lod.hpp"
+#include "mesher.hpp"
+#include "universe.hpp"
+#include <cmath>
+
+using namespace vxl;
+
+TEST_CASE("LOD chain keeps any occupied cell and averages colours") {
+  Universe U;
+  Material red; red.colorA = {1,0,0,1};
+  Material blue; blue.colorA = {0,0,1,1};
+  Cube r; r.mat = U.materials().intern(red);
+  Cube b; b.mat = U.materials().intern(blue);
+  U.place(0, 0, 0, r);
+  U.place(1, 0, 0, b);
+  U.place(31, 31, 31, r);
+  std::vector<glm::vec3> colours(U.materials().slots());
+  for (std::size_t i = 0; i < colours.size(); ++i) colours[i] = glm::vec3(U.materials().get(MaterialId(i)).colorA);
+
+  LodLevel levels[LOD_LEVELS - 1];
+  build_lod_chain(*U.store().chunk({0,0,0}), colours, levels);
+  for (int k = 0; k < LOD_LEVELS - 1; ++k) {
+    const LodLevel& L = levels[k];
+    REQUIRE(L.level == k + 1);
+    REQUIRE(L.edge == CHUNK_SIZE >> (k + 1));
+    std::size_t solid = 0;
+    for (uint8_t s : L.solid) solid += s;
+    REQUIRE(solid == 2);   // one cell at each corner, however coarse
+    REQUIRE(L.solid[0] == 1);
+    REQUIRE(L.solid.back() == 1);
+    const glm::vec3 mix = unpack_rgb565(L.color[0]);   // half red, half blue
+    REQUIRE(std::abs(mix.x - 0.5f) < 0.05f);
+    REQUIRE(mix.y == 0.0f);
+    REQUIRE(std::abs(mix.z - 0.5f) < 0.05f);
+    REQUIRE(L.color.back() == pack_rgb565({1, 0, 0}));
+  }
+
+  // A coarse level meshes like a full one, in cells: a solid chunk is six quads
+  std::vector<IVec3> all;
+  for (int z = 0; z < 32; ++z) for (int y = 0; y < 32; ++y) for (int x = 0; x < 32; ++x) all.push_back({x,y,z});
+  U.place_many(all, std::span<const Cube>(&r, 1));
+  build_lod_chain(*U.store().chunk({0,0,0}), colours, levels);
+  Mesher M;
+  ChunkMesh m;
+  M.build(levels[0], m);
+  REQUIRE(m.quads() == 6);
+  REQUIRE(m.faces == 6 * 16 * 16);
+  for (const MeshVertex& v : m.vertices) REQUIRE(v.mat == pack_rgb565({1, 0, 0}));
+}
+
+TEST_CASE("LOD level follows projected voxel size with hysteresis") {
+  REQUIRE(pick_lod_level(4.0f, 0) == 0);
+  REQUIRE(pick_lod_level(1.0f, 0) == 0);
+  REQUIRE(pick_lod_level(0.4f, 0) == 1);      // a 2x cell spans 0.8 pixels
+  REQUIRE(pick_lod_level(0.01f, 0) == LOD_LEVELS - 1);
+
+  // Just past a boundary: stay until a quarter level beyond it
+  REQUIRE(pick_lod_level(0.49f, 0) == 0);
+  REQUIRE(pick_lod_level(0.49f, 1) == 1);
+  REQUIRE(pick_lod_level(0.51f, 1) == 1);
+  REQUIRE(pick_lod_level(0.9f, 1) == 0);
+  // Far jumps land at once, one level short of a boundary they barely cross
+  REQUIRE(pick_lod_level(0.24f, 0) == 1);
+  REQUIRE(pick_lod_level(0.2f, 0) == 2);
+}
@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+#include "mesher.hpp"
+#include "universe.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+
+using namespace vxl;
+
+namespace {
+
+ChunkMesh mesh(const Universe& U, const IVec3& cc) {
+  Mesher M;
+  ChunkMesh out;
+  M.build(U.store(), cc, out);
+  return out;
+}
+
+/// Exposed faces of axis-aligned cubes in chunk cc, counted voxel by voxel.
+std::size_t exposed_faces(const Universe& U, const IVec3& cc) {
+  static const IVec3 dirs[6] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+  std::size_t n = 0;
+  U.store().chunk(cc)->for_each([&](int i, const Cube& c) {
+    if (!Mesher::meshable(c)) return;
+    const IVec3 p = voxel_at(cc, i);
+    for (auto& d : dirs) {
+      auto nb = U.get(p.x + d.x, p.y + d.y, p.z + d.z);
+      if (!nb || !Mesher::meshable(*nb)) ++n;
+    }
+  });
+  return n;
+}
+
+} // namespace
+
+TEST_CASE("Mesher merges the faces of a solid block into six quads") {
+  Universe U;
+  REQUIRE(mesh(U, {0,0,0}).quads() == 0);
+  U.place(3, 4, 5);
+  REQUIRE(mesh(U, {0,0,0}).quads() == 6);
+
+  std::vector<IVec3> block;
+  for (int z = 0; z < 10; ++z) for (int y = 0; y < 10; ++y) for (int x = 0; x < 10; ++x) block.push_back({x,y,z});
+  Cube c;
+  U.place_many(block, std::span<const Cube>(&c, 1));
+  auto m = mesh(U, {0,0,0});
+  REQUIRE(m.quads() == 6);
+  REQUIRE(m.faces == 600);
+
+  // Quads are wound counter-clockwise seen from outside: (c1-c0) x (c3-c0) is the face normal
+  for (std::size_t q = 0; q < m.quads(); ++q) {
+    const MeshVertex* v = &m.vertices[q * 4];
+    glm::vec3 p0(v[0].x, v[0].y, v[0].z), p1(v[1].x, v[1].y, v[1].z), p3(v[3].x, v[3].y, v[3].z);
+    glm::vec3 n = glm::cross(p1 - p0, p3 - p0);
+    const int axis = v[0].face / 2;
+    const float sign = v[0].face % 2 == 0 ? 1.0f : -1.0f;
+    REQUIRE(n[axis] * sign > 0.0f);
+    REQUIRE(n[(axis + 1) % 3] == 0.0f);
+    REQUIRE(n[(axis + 2) % 3] == 0.0f);
+  }
+
+  // Axis-aligned turns do not split quads; another material does
+  Cube turned; turned.rotation.code = 5;
+  U.place(9, 9, 9, turned);
+  REQUIRE(mesh(U, {0,0,0}).quads() == 6);
+  Material red; red.colorA = {1,0,0,1};
+  Cube r; r.mat = U.materials().intern(red);
+  U.place(9, 9, 9, r);
+  REQUIRE(mesh(U, {0,0,0}).quads() > 6);
+  REQUIRE(mesh(U, {0,0,0}).faces == 600);
+}
+
+TEST_CASE("Mesher hides faces across chunk borders and around free rotations") {
+  Universe U;
+  std::vector<IVec3> row;
+  for (int x = 0; x < 64; ++x) row.push_back({x, 0, 0});
+  Cube c;
+  U.place_many(row, std::span<const Cube>(&c, 1));
+  auto left = mesh(U, {0,0,0});
+  REQUIRE(left.quads() == 5);   // four long sides and the -x end; +x touches chunk 1
+  REQUIRE(left.faces == 4 * 32 + 1);
+
+  // A free-rotated cube is not meshed and does not hide its neighbour's face
+  Cube tilted;
+  U.set_rotation(tilted, glm::angleAxis(glm::radians(30.0f), glm::vec3(0, 1, 0)));
+  U.place(31, 1, 0, tilted);
+  auto m = mesh(U, {0,0,0});
+  REQUIRE(m.faces == 4 * 32 + 1);
+  REQUIRE(exposed_faces(U, {0,0,0}) == m.faces);
+
+  // A neighbouring cube of a material flagged translucent hides nothing either
+  Material glass; glass.colorA = {0.5f, 0.7f, 1.0f, 0.4f};
+  Cube g; g.mat = U.materials().intern(glass);
+  U.place(31, 0, 1, g);
+  std::vector<uint8_t> translucent(U.materials().slots());
+  for (std::size_t i = 0; i < translucent.size(); ++i) translucent[i] = vxl::translucent(U.materials().get(MaterialId(i)));
+  REQUIRE(translucent[g.mat] == 1);
+  MeshInput in;
+  Mesher::gather(U.store(), {1,0,0}, in);
+  const std::size_t at = 0 + 32 * 1;   // chunk 1's -x border: u = y, v = z of the cell at x = 31
+  REQUIRE(in.border[1][at] == 1);
+  Mesher::gather(U.store(), {1,0,0}, in, translucent);
+  REQUIRE(in.border[1][at] == 0);
+  REQUIRE(in.border[1][0] == 1);      // (31, 0, 0) is opaque
+}
+
+TEST_CASE("Mesher covers exactly the exposed faces of a random scene") {
+  Universe U;
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> pos(-8, 40), mat(0, 2);
+  Material mats[3];
+  mats[1].colorA = {1,0,0,1};
+  mats[2].colorA = {0,1,0,1};
+  for (int i = 0; i < 20000; ++i) {
+    Cube c; c.mat = U.materials().intern(mats[mat(rng)]);
+    if (i % 50 == 0) U.set_rotation(c, glm::angleAxis(0.3f, glm::vec3(1, 0, 0)));
+    U.place(pos(rng), pos(rng), pos(rng), c);
+  }
+  std::size_t quads = 0, faces = 0;
+  U.store().for_each_chunk([&](const IVec3& cc, const Chunk&) {
+    auto m = mesh(U, cc);
+    REQUIRE(m.faces == exposed_faces(U, cc));
+    quads += m.quads();
+    faces += m.faces;
+  });
+  REQUIRE(quads < faces);
+}
@@ -0,0 +1,48 @@
+#include <catch2/catch_test_macros.hpp>
+#include "morton_map.hpp"
+#include <random>
+#include <unordered_map>
+
+using namespace vxl;
+
+TEST_CASE("Morton codes round-trip and preserve locality") {
+  for (IVec3 p : {IVec3{0,0,0}, IVec3{-1,-1,-1}, IVec3{MORTON_MIN,MORTON_MAX,7}, IVec3{12345,-54321,999}})
+    REQUIRE(morton_decode(morton_encode(p)) == p);
+  REQUIRE(morton_encode({1,0,0}) - morton_encode({0,0,0}) == 1);
+  REQUIRE(morton_encode({0,1,0}) - morton_encode({0,0,0}) == 2);
+  REQUIRE(morton_encode({0,0,1}) - morton_encode({0,0,0}) == 4);
+  REQUIRE_FALSE(in_morton_range({MORTON_MAX + 1, 0, 0}));
+}
+
+TEST_CASE("MortonMap matches unordered_map under random insert/erase") {
+  MortonMap<int> m;
+  std::unordered_map<IVec3, int, IVec3Hasher> ref;
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> d(-40, 40);
+  for (int i = 0; i < 20000; ++i) {
+    IVec3 p{d(rng), d(rng), d(rng)};
+    if (rng() % 3 == 0) {
+      REQUIRE(m.erase(p) == (ref.erase(p) > 0));
+    } else {
+      m[p] = i; ref[p] = i;
+    }
+  }
+  REQUIRE(m.size() == ref.size());
+  for (auto& [p, v] : ref) {
+    REQUIRE(m.find(p) != nullptr);
+    REQUIRE(*m.find(p) == v);
+  }
+  std::size_t visited = 0;
+  m.for_each([&](const IVec3& p, int v){ REQUIRE(ref.at(p) == v); ++visited; });
+  REQUIRE(visited == ref.size());
+}
+
+TEST_CASE("MortonSet insert/contains/erase") {
+  MortonSet s;
+  REQUIRE(s.insert({1,2,3}));
+  REQUIRE_FALSE(s.insert({1,2,3}));
+  REQUIRE(s.contains({1,2,3}));
+  REQUIRE_FALSE(s.contains({3,2,1}));
+  REQUIRE(s.erase({1,2,3}));
+  REQUIRE(s.empty());
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+#include "occlusion.hpp"
+#include "universe.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <chrono>
+#include <random>
+
+using namespace vxl;
+
+namespace {
+
+float volume(const std::vector<Box3>& boxes) {
+  float v = 0.0f;
+  for (const Box3& b : boxes) v += (b.hi.x - b.lo.x) * (b.hi.y - b.lo.y) * (b.hi.z - b.lo.z);
+  return v;
+}
+
+glm::mat4 looking_down_minus_z() {
+  return glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 1000.0f) *
+         glm::lookAt(glm::vec3(0.0f), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+}
+
+} // namespace
+
+TEST_CASE("Occluder boxes cover the solid sub-bricks of a chunk") {
+  Universe U;
+  std::vector<IVec3> half;
+  for (int z = 0; z < 32; ++z) for (int y = 0; y < 32; ++y) for (int x = 0; x < 16; ++x) half.push_back({x + 32, y, z});
+  Cube c;
+  U.place_many(half, std::span<const Cube>(&c, 1));
+  std::vector<Box3> boxes;
+  occluder_boxes(*U.store().chunk({1,0,0}), {1,0,0}, boxes);
+  REQUIRE(boxes.size() == 1);
+  REQUIRE(boxes[0].lo == glm::vec3(31.5f, -0.5f, -0.5f));
+  REQUIRE(boxes[0].hi == glm::vec3(47.5f, 31.5f, 31.5f));
+
+  // A tilted cube or a missing one leaves its sub-brick out
+  Cube tilted;
+  U.set_rotation(tilted, glm::angleAxis(0.4f, glm::vec3(0, 1, 0)));
+  U.place(40, 9, 9, tilted);
+  U.erase(33, 30, 30);
+  boxes.clear();
+  occluder_boxes(*U.store().chunk({1,0,0}), {1,0,0}, boxes);
+  REQUIRE(boxes.size() > 1);
+  REQUIRE(volume(boxes) == float(16 * 32 * 32 - 2 * 64));
+
+  boxes.clear();
+  U.place(0, 0, 0);
+  occluder_boxes(*U.store().chunk({0,0,0}), {0,0,0}, boxes);
+  REQUIRE(boxes.empty());
+}
+
+TEST_CASE("Occlusion buffer hides boxes behind a wall and nothing else") {
+  OcclusionBuffer ob(128, 64);
+  ob.begin(looking_down_minus_z());
+  REQUIRE_FALSE(ob.occluded({{-5, -5, -40}, {5, 5, -30}}));   // nothing drawn yet
+
+  const Box3 wall{{-50, -5, -21}, {50, 5, -20}};
+  ob.rasterize(std::span<const Box3>(&wall, 1));
+  REQUIRE(ob.depth(64, 32) < 1.0f);
+  REQUIRE(ob.depth(0, 0) == 1.0f);   // above the wall's top edge
+  REQUIRE(ob.occluded({{-5, -5, -40}, {5, 5, -30}}));
+  REQUIRE_FALSE(ob.occluded({{-5, -5, -15}, {5, 5, -10}}));    // in front
+  REQUIRE_FALSE(ob.occluded({{-5, -5, -22}, {5, 9, -21.5f}}));  // sticks out above
+  REQUIRE_FALSE(ob.occluded({{-5, 8, -40}, {5, 12, -30}}));    // beside it
+  REQUIRE_FALSE(ob.occluded({{-1, -1, -1}, {1, 1, 1}}));       // around the eye
+  REQUIRE(ob.occluded({{-2, -2, -900}, {2, 2, -800}}));        // far behind
+
+  // A wall crossing the near plane is clipped, not dropped
+  ob.begin(looking_down_minus_z());
+  const Box3 side{{1, -50, -100}, {2, 50, 5}};
+  ob.rasterize(std::span<const Box3>(&side, 1));
+  REQUIRE(ob.depth(20, 32) == 1.0f);
+  REQUIRE(ob.depth(80, 32) < 1.0f);
+}
+
+TEST_CASE("Banded parallel rasterization matches the serial one") {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> pos(-60.0f, 60.0f), depth(-200.0f, 2.0f), size(1.0f, 20.0f);
+  std::vector<Box3> boxes;
+  for (int i = 0; i < 300; ++i) {
+    glm::vec3 lo(pos(rng), pos(rng) * 0.5f, depth(rng));
+    boxes.push_back({lo, lo + glm::vec3(size(rng), size(rng), size(rng))});
+  }
+  OcclusionBuffer serial(160, 90), parallel(160, 90);
+  serial.begin(looking_down_minus_z());
+  serial.rasterize(boxes);
+  ThreadPool pool(3);
+  parallel.begin(looking_down_minus_z());
+  parallel.rasterize(boxes, &pool);
+  bool same = true;
+  for (int y = 0; y < 90; ++y)
+    for (int x = 0; x < 160; ++x) same &= serial.depth(x, y) == parallel.depth(x, y);
+  REQUIRE(same);
+
+  // parallel_for finishes on the calling thread while every worker is busy
+  std::atomic<bool> release{false};
+  for (unsigned i = 0; i < pool.size(); ++i) pool.submit([&] { while (!release) std::this_thread::yield(); });
+  std::atomic<int> sum{0};
+  parallel_for(&pool, 100, [&](std::size_t i) { sum += int(i); });
+  REQUIRE(sum == 4950);
+  release = true;
+  pool.wait_idle();
+}
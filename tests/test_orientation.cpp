@@ -0,0 +1,47 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <glm/gtc/constants.hpp>
+#include "selection.hpp"
+
+using namespace vxl;
+using Catch::Approx;
+
+TEST_CASE("Axis-aligned orientation tables form a group") {
+  REQUIRE(orientation_matrix(0) == glm::mat3(1.0f));
+  for (uint8_t a = 0; a < Orientation::COUNT; ++a) {
+    REQUIRE(orientation_compose(a, orientation_inverse(a)) == 0);
+    REQUIRE(snap_orientation(orientation_quat(a)) == a);
+    for (uint8_t b = 0; b < Orientation::COUNT; ++b) {
+      glm::mat3 m = orientation_matrix(a) * orientation_matrix(b);
+      REQUIRE(orientation_from_matrix(m) == orientation_compose(a, b));
+    }
+  }
+  glm::quat q90 = glm::angleAxis(glm::half_pi<float>(), glm::vec3(0,1,0));
+  REQUIRE(snap_orientation(q90).has_value());
+  REQUIRE_FALSE(snap_orientation(glm::angleAxis(glm::radians(15.0f), glm::vec3(0,1,0))).has_value());
+}
+
+TEST_CASE("Selection rotate snaps to codes and uses the side table otherwise") {
+  Universe U;
+  Selection S;
+  U.place(0,0,0);
+  S.add({0,0,0});
+
+  S.rotate(U, 'y', 90.0f);
+  auto c = U.get(0,0,0);
+  REQUIRE(c->rotation.axis_aligned());
+  REQUIRE(c->rotation.code != 0);
+
+  S.rotate(U, 'y', 30.0f);
+  c = U.get(0,0,0);
+  REQUIRE_FALSE(c->rotation.axis_aligned());
+  REQUIRE(U.free_rotations().size() == 1);
+
+  for (int i = 0; i < 8; ++i) S.rotate(U, 'y', 30.0f);  // 90 + 270 = full turn
+  c = U.get(0,0,0);
+  REQUIRE(c->rotation.axis_aligned());
+  REQUIRE(c->rotation.code == 0);
+  U.gc_rotations();
+  REQUIRE(U.free_rotations().size() == 0);
+  REQUIRE(U.rotation_matrix(*c)[0][0] == Approx(1.0f));
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch_test_macros.hpp>
+#include "program_cache.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace vxl;
+
+namespace {
+
+std::filesystem::path scratch_dir(const char* name) {
+  auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+} // namespace
+
+TEST_CASE("Program keys follow the sources and the driver") {
+  const std::string_view a[] = {"void main(){}", "out vec4 c; void main(){ c = vec4(1); }"};
+  const std::string_view b[] = {"void main(){}", "out vec4 c; void main(){ c = vec4(0); }"};
+  const std::string_view shifted[] = {"void main(){}out vec4 c;", " void main(){ c = vec4(1); }"};
+  const uint64_t k = program_key(a, "Vendor\nGPU\n3.3");
+  REQUIRE(program_key(a, "Vendor\nGPU\n3.3") == k);
+  REQUIRE(program_key(b, "Vendor\nGPU\n3.3") != k);
+  REQUIRE(program_key(shifted, "Vendor\nGPU\n3.3") != k);
+  REQUIRE(program_key(a, "Vendor\nGPU\n3.3 (new driver)") != k);
+  REQUIRE(fnv1a64("") == 0xcbf29ce484222325ull);
+  REQUIRE(fnv1a64("a") == 0xaf63dc4c8601ec8cull);
+}
+
+TEST_CASE("Program cache stores binaries and treats damaged ones as misses") {
+  const auto dir = scratch_dir("voxel_lab_test_program_cache");
+  ProgramCache cache(dir.string());
+  REQUIRE(cache.enabled());
+  REQUIRE_FALSE(cache.load(42));
+
+  ProgramBinary bin;
+  bin.format = 0x8741;
+  bin.data = {'b', 'l', 'o', 'b', '\0', '\x7f'};
+  REQUIRE(cache.save(42, bin));   // creates the directory
+  auto back = cache.load(42);
+  REQUIRE(back);
+  REQUIRE(back->format == bin.format);
+  REQUIRE(back->data == bin.data);
+  REQUIRE_FALSE(cache.load(43));
+
+  // Another key's file under this key's name
+  std::filesystem::copy_file(cache.path_of(42), cache.path_of(7));
+  REQUIRE_FALSE(cache.load(7));
+
+  // A flipped byte, then a truncated file
+  {
+    std::fstream f(cache.path_of(42), std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(-1, std::ios::end);
+    f.put('\x00');
+  }
+  REQUIRE_FALSE(cache.load(42));
+  std::filesystem::resize_file(cache.path_of(42), 10);
+  REQUIRE_FALSE(cache.load(42));
+
+  REQUIRE(cache.save(42, bin));
+  REQUIRE(cache.load(42));
+  cache.erase(42);
+  REQUIRE_FALSE(cache.load(42));
+
+  // No directory: disabled, nothing written
+  ProgramCache off;
+  REQUIRE_FALSE(off.enabled());
+  REQUIRE_FALSE(off.save(1, bin));
+  REQUIRE_FALSE(off.load(1));
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("File watcher reports each change once") {
+  const auto dir = scratch_dir("voxel_lab_test_file_watcher");
+  std::filesystem::create_directories(dir);
+  const std::string a = (dir / "a.vert").string(), b = (dir / "b.frag").string();
+  std::ofstream(a) << "one";
+  FileWatcher w;
+  w.watch(a);
+  w.watch(b);   // not there yet
+  w.watch(a);
+  REQUIRE(w.size() == 2);
+  REQUIRE(w.poll().empty());
+
+  // Same size, later time (set explicitly: file system clocks can be coarse)
+  std::ofstream(a) << "two";
+  std::filesystem::last_write_time(a, std::filesystem::last_write_time(a) + std::chrono::seconds(2));
+  REQUIRE(w.poll() == std::vector<std::string>{a});
+  REQUIRE(w.poll().empty());
+
+  std::ofstream(b) << "appears";
+  REQUIRE(w.poll() == std::vector<std::string>{b});
+  std::filesystem::remove(b);
+  REQUIRE(w.poll() == std::vector<std::string>{b});
+  REQUIRE(w.poll().empty());
+  std::filesystem::remove_all(dir);
+}
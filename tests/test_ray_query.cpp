@@ -0,0 +1,156 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "ray_query.hpp"
+#include "commands.hpp"
+#include "world_snapshot.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
+
+using namespace vxl;
+using Catch::Approx;
+
+namespace {
+
+bool same(const std::optional<RayHit>& a, const std::optional<RayHit>& b) {
+  if (a.has_value() != b.has_value()) return false;
+  return !a || (a->voxel == b->voxel && a->normal == b->normal && a->t == Approx(b->t).margin(1e-3));
+}
+
+/// A 41x41 wall at z = 0 in front of an identical one at z = -5, seen from z = 30.
+ScreenView wall_view(Universe& U, SnapshotBuilder& B) {
+  std::vector<IVec3> wall;
+  for (int y = -20; y <= 20; ++y)
+    for (int x = -20; x <= 20; ++x) { wall.push_back({x, y, 0}); wall.push_back({x, y, -5}); }
+  Cube c;
+  U.place_many(wall, std::span<const Cube>(&c, 1));
+  ScreenView v;
+  v.world = B.build(U, Selection());
+  v.width = 200;
+  v.height = 100;
+  v.viewProj = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 500.0f) *
+               glm::lookAt(glm::vec3(0, 0, 30), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+  return v;
+}
+
+} // namespace
+
+TEST_CASE("Batched ray casts match one cast per ray") {
+  std::mt19937 rng(22);
+  std::uniform_int_distribution<int> coord(-90, 90);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  Universe U;
+  for (int i = 0; i < 6000; ++i) U.place(coord(rng), coord(rng) / 6, coord(rng));
+  U.place(200, 0, 0); U.place(201, 0, 0); U.place(202, 1, 0);
+  U.group_create("g", {{200,0,0}, {201,0,0}, {202,1,0}});
+  REQUIRE(U.group_rotate("g", *snap_orientation(glm::angleAxis(glm::radians(90.0f), glm::vec3(0,0,1)))));
+  SnapshotBuilder B;
+  auto W = B.build(U, Selection());
+
+  // Bundles of rays from one eye, as screens make them, plus scattered ones
+  std::vector<Ray> rays;
+  for (int b = 0; b < 60; ++b) {
+    const glm::vec3 eye(unit(rng) * 120.0f, unit(rng) * 40.0f, unit(rng) * 120.0f);
+    const glm::vec3 aim = b % 6 ? glm::vec3(unit(rng) * 60.0f, 0.0f, unit(rng) * 60.0f) : glm::vec3(201, 0, 0);
+    for (int i = 0; i < 37; ++i) {
+      Ray r;
+      r.origin = eye;
+      r.dir = glm::normalize(aim - eye + 3.0f * glm::vec3(unit(rng), unit(rng), unit(rng)));
+      if (i % 9 == 0) r.dir.y = 0.0f;   // grid-aligned directions, and one with no direction at all
+      if (i == 36) r.dir = glm::vec3(0.0f);
+      if (i % 11 == 0) r.maxT = 40.0f;
+      rays.push_back(r);
+    }
+  }
+
+  std::vector<std::optional<RayHit>> ref(rays.size()), packed(rays.size()), pooled(rays.size()), live(rays.size());
+  cast_rays_scalar(*W, rays, ref);
+  cast_rays(*W, rays, packed);
+  ThreadPool pool(3);
+  cast_rays(*W, rays, pooled, &pool);
+  cast_rays(U, rays, live);
+  std::size_t hits = 0, groupHits = 0;
+  for (std::size_t i = 0; i < rays.size(); ++i) {
+    INFO("ray " << i);
+    REQUIRE(same(ref[i], packed[i]));
+    REQUIRE(same(ref[i], pooled[i]));
+    REQUIRE(same(ref[i], live[i]));
+    REQUIRE(same(ref[i], cast_ray(U, rays[i])));
+    if (!ref[i]) continue;
+    ++hits;
+    groupHits += ref[i]->voxel.x >= 190;
+    REQUIRE(packed[i]->point.x == Approx(ref[i]->point.x).margin(1e-3));
+  }
+  REQUIRE(hits > rays.size() / 3);
+  REQUIRE(groupHits > 0);
+
+  std::vector<std::optional<RayHit>> tooFew(1);
+  REQUIRE_THROWS_AS(cast_rays(*W, rays, tooFew), std::invalid_argument);
+}
+
+TEST_CASE("Screen rays cover the rectangle in tiles") {
+  const glm::mat4 VP = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f) *
+                       glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+  // Corners in either order, clipped to the viewport
+  auto rays = screen_rays(VP, 200, 100, {9, 5, -3, -2}, 1);
+  REQUIRE(rays.size() == 10 * 6);
+  REQUIRE(screen_rays(VP, 200, 100, {0, 0, 199, 99}, 4).size() == 50 * 25);
+  REQUIRE(screen_rays(VP, 0, 100, {0, 0, 10, 10}).empty());
+
+  // The first packet is pixels 0..3 of rows 0 and 1
+  const auto below = screen_rays(VP, 200, 100, {0, 1, 0, 1}, 1);
+  REQUIRE(rays[1].dir.x > rays[0].dir.x);
+  REQUIRE(rays[4].dir.x == Approx(below[0].dir.x));
+  REQUIRE(rays[4].dir.y < rays[0].dir.y);   // next row down
+
+  // Rays run from the near plane to the far plane
+  const auto centre = screen_rays(VP, 200, 100, {100, 50, 100, 50});
+  REQUIRE(centre[0].origin.z == Approx(9.9f).margin(1e-3));
+  REQUIRE(glm::length(centre[0].dir) == Approx(1.0f));
+  REQUIRE(centre[0].maxT == Approx(99.9f).margin(0.05));
+}
+
+TEST_CASE("Visible cubes in a rectangle are the front ones") {
+  Universe U;
+  SnapshotBuilder B;
+  const ScreenView v = wall_view(U, B);
+  ThreadPool pool(2);
+  auto seen = visible_in_rect(v, {0, 0, 199, 99}, 1, &pool);
+  REQUIRE(seen.size() > 100);
+  for (const IVec3& p : seen) REQUIRE(p.z == 0);
+  std::sort(seen.begin(), seen.end(), [](const IVec3& a, const IVec3& b) { return std::tie(a.x, a.y) < std::tie(b.x, b.y); });
+  REQUIRE(std::adjacent_find(seen.begin(), seen.end()) == seen.end());   // each once
+
+  // A small rectangle around the centre sees only the middle of the wall
+  auto middle = visible_in_rect(v, {95, 45, 104, 54}, 1, &pool);
+  REQUIRE_FALSE(middle.empty());
+  for (const IVec3& p : middle) REQUIRE((std::abs(p.x) <= 2 && std::abs(p.y) <= 2));
+  REQUIRE(visible_in_rect(ScreenView{}, {0, 0, 10, 10}).empty());
+}
+
+TEST_CASE("select visible picks through the view the line was typed in") {
+  Universe U;
+  SnapshotBuilder B;
+  const ScreenView v = wall_view(U, B);
+  Selection S;
+  std::vector<std::string> out;
+  CommandRegistry R;
+  register_builtin_commands(R);
+  CommandContext ctx{U, S, [&](const std::string& s){ out.push_back(s); }, []{}, []{}};
+  REQUIRE(R.run_line("select visible 0 0 199 99", ctx));
+  REQUIRE(out.back() == "select visible needs a view.");
+  REQUIRE(S.empty());
+
+  ThreadPool pool(2);
+  ctx.view = &v;
+  ctx.pool = &pool;
+  U.erase(0, 0, 0);   // gone since the frame was drawn
+  REQUIRE(R.run_line("select visible 95 45 104 54 2", ctx));
+  REQUIRE_FALSE(S.empty());
+  REQUIRE_FALSE(S.contains({0, 0, 0}));
+  for (const IVec3& p : S.items()) REQUIRE(p.z == 0);
+  REQUIRE(out.back() == "Selected " + std::to_string(S.size()) + " visible cubes.");
+}
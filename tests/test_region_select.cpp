@@ -0,0 +1,167 @@
+#include <catch2/catch_test_macros.hpp>
+#include "region_select.hpp"
+#include "commands.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <deque>
+#include <random>
+#include <unordered_set>
+
+using namespace vxl;
+
+namespace {
+
+using RefSet = std::unordered_set<IVec3, IVec3Hasher>;
+
+bool matches(const VoxelMask& m, const RefSet& ref) {
+  if (m.size() != ref.size()) return false;
+  bool ok = true;
+  m.for_each([&](const IVec3& p) { ok = ok && ref.contains(p); });
+  return ok;
+}
+
+/// Every cube of U, world and group alike, through its public lookups.
+std::vector<IVec3> all_cubes(const Universe& U) {
+  std::vector<IVec3> out;
+  U.for_each([&](const IVec3& p, const Cube&) { out.push_back(p); });
+  U.for_each_group([&](const std::string& name, const Group&) {
+    for (const IVec3& p : U.group_members(name)) out.push_back(p);
+  });
+  return out;
+}
+
+/// Blobs of two materials across chunk borders and negative coordinates, and a turned group.
+Universe make_scene(uint32_t seed) {
+  Universe U;
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> d(-40, 40), h(-3, 3);
+  Cube red, blue;
+  red.mat = U.materials().intern(Material{});
+  Material b;
+  b.colorA = {0, 0, 1, 1};
+  blue.mat = U.materials().intern(b);
+  for (int i = 0; i < 30000; ++i) U.place(d(rng), h(rng), d(rng), i % 3 ? red : blue);
+  for (int x = 60; x < 70; ++x) U.place(x, 0, 0, blue);
+  U.group_create("g", {{63,0,0}, {64,0,0}, {65,0,0}});
+  REQUIRE(U.group_rotate("g", *snap_orientation(glm::angleAxis(glm::radians(90.0f), glm::vec3(0,1,0)))));
+  return U;
+}
+
+RefSet flood_reference(const Universe& U, const IVec3& seed, bool all, bool same) {
+  RefSet seen;
+  auto start = U.get(seed.x, seed.y, seed.z);
+  if (!start) return seen;
+  std::deque<IVec3> todo{seed};
+  seen.insert(seed);
+  while (!todo.empty()) {
+    const IVec3 p = todo.front();
+    todo.pop_front();
+    for (int dz = -1; dz <= 1; ++dz)
+      for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx) {
+          if (std::abs(dx) + std::abs(dy) + std::abs(dz) != 1 && !(all && (dx || dy || dz))) continue;
+          const IVec3 q{p.x + dx, p.y + dy, p.z + dz};
+          auto c = U.get(q.x, q.y, q.z);
+          if (!c || (same && c->mat != start->mat) || !seen.insert(q).second) continue;
+          todo.push_back(q);
+        }
+  }
+  return seen;
+}
+
+} // namespace
+
+TEST_CASE("Box and ellipsoid selections match a scan of every cube") {
+  Universe U = make_scene(24);
+  const auto cubes = all_cubes(U);
+  ThreadPool pool(3);
+
+  const IVec3 boxes[][2] = {{{-20, -3, -40}, {33, 4, 7}}, {{40, -1, 31}, {-31, 0, -33}}, {{62, -2, -5}, {66, 2, 5}},
+                            {{-1000, -1000, -1000}, {1000, 1000, 1000}}, {{200, 0, 0}, {300, 10, 10}}};
+  for (const auto& b : boxes) {
+    RefSet ref;
+    for (const IVec3& p : cubes)
+      if (p.x >= std::min(b[0].x, b[1].x) && p.x <= std::max(b[0].x, b[1].x) && p.y >= std::min(b[0].y, b[1].y) &&
+          p.y <= std::max(b[0].y, b[1].y) && p.z >= std::min(b[0].z, b[1].z) && p.z <= std::max(b[0].z, b[1].z))
+        ref.insert(p);
+    REQUIRE(matches(cubes_in_box(U, b[0], b[1]), ref));
+    REQUIRE(matches(cubes_in_box(U, b[0], b[1], &pool), ref));
+  }
+  REQUIRE(cubes_in_box(U, {MORTON_MIN - 5, 0, 0}, {MORTON_MAX + 5, 0, 0}).size() > 0);
+  U.place(MORTON_MAX, 0, 0);
+  U.place(0, MORTON_MIN, 0);
+  REQUIRE(cubes_in_box(U, {2000000, 0, 0}, {3000000, 0, 0}).empty());   // past the world, not clamped onto its edge
+  REQUIRE(cubes_in_box(U, {0, -3000000, 0}, {0, -2000000, 0}).empty());
+  REQUIRE(cubes_in_box(U, {MORTON_MAX, 0, 0}, {3000000, 0, 0}).size() == 1);
+
+  const struct { glm::vec3 c, r; } shapes[] = {
+    {{0.0f, 0.0f, 0.0f}, {20.0f, 20.0f, 20.0f}}, {{-10.5f, 2.0f, 7.25f}, {30.0f, 1.5f, 9.0f}},
+    {{64.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}}, {{0.0f, 0.0f, 0.0f}, {0.4f, 0.4f, 0.4f}},
+  };
+  for (const auto& s : shapes) {
+    RefSet ref;
+    for (const IVec3& p : cubes) {
+      const glm::vec3 d = (glm::vec3(p.x, p.y, p.z) - s.c) / s.r;
+      if (double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z <= 1.0) ref.insert(p);
+    }
+    REQUIRE(matches(cubes_in_ellipsoid(U, s.c, s.r, &pool), ref));
+  }
+  REQUIRE_THROWS_AS(cubes_in_ellipsoid(U, {0, 0, 0}, {1, 0, 1}), std::invalid_argument);
+}
+
+TEST_CASE("Flood fills match a breadth-first search") {
+  Universe U = make_scene(5);
+  ThreadPool pool(2);
+  std::mt19937 rng(9);
+  const auto cubes = all_cubes(U);
+  std::size_t biggest = 0;
+  for (int k = 0; k < 12; ++k) {
+    const IVec3 seed = k == 0 ? IVec3{60, 0, 0} : cubes[rng() % cubes.size()];
+    for (bool all : {false, true})
+      for (bool same : {false, true}) {
+        INFO("seed " << seed.x << " " << seed.y << " " << seed.z << " all " << all << " same " << same);
+        const RefSet ref = flood_reference(U, seed, all, same);
+        const auto got = flood_select(U, seed, all ? Connectivity::All : Connectivity::Faces,
+                                      same ? FloodMatch::SameMaterial : FloodMatch::AnySolid, k % 2 ? &pool : nullptr);
+        REQUIRE(matches(got, ref));
+        biggest = std::max(biggest, ref.size());
+      }
+  }
+  REQUIRE(biggest > 1000);   // some fills cross many chunks
+
+  // Turning the group out of the row at x 60..69 cut the row in three
+  REQUIRE(flood_select(U, {60, 0, 0}, Connectivity::All, FloodMatch::AnySolid).size() == 3);
+  const auto group = flood_select(U, {64, 0, 0}, Connectivity::Faces, FloodMatch::AnySolid);
+  REQUIRE(group.size() == 3);
+  REQUIRE(group.contains({64, 0, 1}));
+  REQUIRE(flood_select(U, {500, 0, 0}, Connectivity::All, FloodMatch::AnySolid).empty());
+}
+
+TEST_CASE("Region select commands replace the selection") {
+  Universe U;
+  Selection S;
+  std::vector<std::string> out;
+  CommandRegistry R;
+  register_builtin_commands(R);
+  ThreadPool pool(2);
+  CommandContext ctx{U, S, [&](const std::string& s){ out.push_back(s); }, []{}, []{}};
+  ctx.pool = &pool;
+  for (int x = 0; x < 10; ++x) U.place(x, 0, 0);
+  U.place(20, 0, 0);
+
+  REQUIRE(R.run_line("select box 9 0 0 -1000000 0 0", ctx));
+  REQUIRE(S.size() == 10);
+  REQUIRE(out.back() == "Selected 10 cubes.");
+  REQUIRE(R.run_line("select sphere 20 0 0 2.5", ctx));
+  REQUIRE(S.items() == std::vector<IVec3>{{20, 0, 0}});
+  REQUIRE(R.run_line("select ellipsoid 0 0 0 3 1 1", ctx));
+  REQUIRE(S.size() == 4);
+  REQUIRE(R.run_line("select sphere 0 0 0 0", ctx));
+  REQUIRE(out.back() == "Radii must be positive.");
+  REQUIRE(R.run_line("select flood 4 0 0 26 same", ctx));
+  REQUIRE(S.size() == 10);
+  REQUIRE_FALSE(S.contains({20, 0, 0}));
+  REQUIRE(R.run_line("select flood 15 0 0", ctx));
+  REQUIRE(out.back() == "No cube at the seed.");
+  REQUIRE(R.run_line("select flood 4 0 0 8", ctx));
+  REQUIRE(out.back() == "Unknown flood option: 8");
+}
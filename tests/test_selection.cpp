@@ -0,0 +1,169 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "selection.hpp"
+#include "universe.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace vxl;
+using Catch::Approx;
+
+namespace {
+
+/// Entry t of the unit cube around p, or infinity: the slab test picking used to run per cube.
+float slab_t(const IVec3& p, const glm::vec3& ro, const glm::vec3& rd) {
+  float t0 = 0.0f, t1 = std::numeric_limits<float>::infinity();
+  const float o[3] = {ro.x, ro.y, ro.z}, d[3] = {rd.x, rd.y, rd.z};
+  const int c[3] = {p.x, p.y, p.z};
+  for (int i = 0; i < 3; ++i) {
+    const float lo = c[i] - 0.5f, hi = c[i] + 0.5f;
+    if (d[i] == 0.0f) {
+      if (o[i] < lo || o[i] > hi) return std::numeric_limits<float>::infinity();
+      continue;
+    }
+    float a = (lo - o[i]) / d[i], b = (hi - o[i]) / d[i];
+    if (a > b) std::swap(a, b);
+    t0 = std::max(t0, a);
+    t1 = std::min(t1, b);
+  }
+  return t0 <= t1 ? t0 : std::numeric_limits<float>::infinity();
+}
+
+} // namespace
+
+TEST_CASE("Ray casts agree with a slab test against every cube") {
+  std::mt19937 rng(21);
+  std::uniform_int_distribution<int> coord(-70, 70);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  Universe U;
+  std::vector<IVec3> placed;
+  for (int i = 0; i < 3000; ++i) {
+    placed.push_back({coord(rng), coord(rng) / 4, coord(rng)});
+    U.place(placed.back().x, placed.back().y, placed.back().z);
+  }
+
+  int hits = 0;
+  for (int r = 0; r < 500; ++r) {
+    const glm::vec3 ro(unit(rng) * 90.0f, unit(rng) * 30.0f, unit(rng) * 90.0f);
+    glm::vec3 rd(unit(rng), unit(rng), unit(rng));
+    if (r % 2 == 0) {   // half aimed near a cube, so most of those hit something
+      const IVec3& p = placed[std::size_t(r) % placed.size()];
+      rd = glm::vec3(p.x, p.y, p.z) + 0.4f * glm::vec3(unit(rng), unit(rng), unit(rng)) - ro;
+    }
+    if (r % 5 == 0) rd.y = 0.0f;   // rays along the grid planes
+    if (r % 7 == 0) rd.x = 0.0f;
+    if (glm::length(rd) < 1e-3f) continue;
+    float bestT = std::numeric_limits<float>::infinity();
+    U.for_each([&](const IVec3& p, const Cube&) { bestT = std::min(bestT, slab_t(p, ro, rd)); });
+
+    auto hit = Selection::raycast(U, ro, rd);
+    REQUIRE(hit.has_value() == std::isfinite(bestT));
+    if (!hit) continue;
+    ++hits;
+    REQUIRE(hit->t == Approx(bestT).margin(1e-4));
+    // The hit cube is one the brute force finds at that distance
+    REQUIRE(slab_t(hit->voxel, ro, rd) == Approx(bestT).margin(1e-4));
+    REQUIRE(U.get(hit->voxel.x, hit->voxel.y, hit->voxel.z).has_value());
+  }
+  REQUIRE(hits > 100);
+}
+
+TEST_CASE("Ray hits report the face entered and the point on it") {
+  Universe U;
+  U.place(3, 0, 0);
+
+  auto hit = Selection::raycast(U, {-10.0f, 0.2f, -0.1f}, {1.0f, 0.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{3,0,0});
+  REQUIRE(hit->normal == IVec3{-1,0,0});
+  REQUIRE(hit->adjacent() == IVec3{2,0,0});
+  REQUIRE(hit->t == Approx(12.5f));
+  REQUIRE(hit->point.x == Approx(2.5f));
+  REQUIRE(hit->point.y == Approx(0.2f));
+
+  hit = Selection::raycast(U, {3.0f, 9.0f, 0.0f}, {0.0f, -2.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->normal == IVec3{0,1,0});
+  REQUIRE(hit->t == Approx(4.25f));        // t counts in direction lengths
+  REQUIRE(hit->point.y == Approx(0.5f));
+
+  // Starting inside a cube hits it at once, with no face
+  hit = Selection::raycast(U, {3.1f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{3,0,0});
+  REQUIRE(hit->normal == IVec3{0,0,0});
+  REQUIRE(hit->t == 0.0f);
+
+  // Behind the origin, or past the reach: nothing
+  REQUIRE_FALSE(Selection::raycast(U, {5.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}));
+  REQUIRE_FALSE(Selection::raycast(U, {-10.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, 12.0f));
+  REQUIRE(Selection::raycast(U, {-10.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, 13.0f));
+}
+
+TEST_CASE("Ray casts cross chunk borders and negative coordinates") {
+  Universe U;
+  U.place(-33, 0, 0);     // chunk -2
+  U.place(31, 31, 31);    // last voxel of chunk 0
+  U.place(0, 64, 0);
+
+  // Through the empty chunk -1 into chunk -2, and entering a chunk on the face of its first voxel
+  auto hit = Selection::raycast(U, {40.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{-33,0,0});
+  REQUIRE(hit->normal == IVec3{1,0,0});
+
+  // Starting exactly on a chunk face
+  hit = Selection::raycast(U, {31.5f, 31.0f, 31.0f}, {-1.0f, 0.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{31,31,31});
+  REQUIRE(hit->t == Approx(0.0f));
+
+  // Diagonally through chunk corners
+  hit = Selection::raycast(U, {-20.0f, -20.0f, -20.0f}, {1.0f, 1.0f, 1.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{31,31,31});
+
+  hit = Selection::raycast(U, {0.0f, -1000.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{0,64,0});
+  REQUIRE(hit->normal == IVec3{0,-1,0});
+
+  // From outside the world
+  U.place(1048575, 0, 0);
+  hit = Selection::raycast(U, {1048600.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{1048575,0,0});
+}
+
+TEST_CASE("Ray casts see turned groups and keep the nearest hit") {
+  Universe U;
+  U.place(0,0,0); U.place(1,0,0); U.place(2,0,0); U.place(0,0,-6);
+  U.group_create("g", {{0,0,0}, {1,0,0}, {2,0,0}});
+  REQUIRE(U.group_rotate("g", *snap_orientation(glm::angleAxis(glm::radians(90.0f), glm::vec3(0,1,0)))));
+  // The row runs along z through (1,0,-1) .. (1,0,1)
+  REQUIRE(U.get(1,0,1).has_value());
+
+  auto hit = Selection::raycast(U, {1.0f, 0.0f, 10.0f}, {0.0f, 0.0f, -1.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{1,0,1});
+  REQUIRE(hit->normal == IVec3{0,0,1});     // turned back into world space
+  REQUIRE(hit->point.z == Approx(1.5f));
+
+  // From the side the group's normal is along x
+  hit = Selection::raycast(U, {-5.0f, 0.0f, -1.0f}, {1.0f, 0.0f, 0.0f});
+  REQUIRE(hit);
+  REQUIRE(hit->voxel == IVec3{1,0,-1});
+  REQUIRE(hit->normal == IVec3{-1,0,0});
+
+  // A world cube in front of the group wins
+  U.place(1, 0, 4);
+  hit = Selection::raycast(U, {1.0f, 0.0f, 10.0f}, {0.0f, 0.0f, -1.0f});
+  REQUIRE(hit->voxel == IVec3{1,0,4});
+  // The group in front of a world cube wins
+  hit = Selection::raycast(U, {1.0f, 0.0f, -10.0f}, {0.0f, 0.0f, 1.0f});
+  REQUIRE(hit->voxel == IVec3{1,0,-1});
+  REQUIRE(Selection::pick_cube(U, {1.0f, 0.0f, -10.0f}, {0.0f, 0.0f, 1.0f}) == IVec3{1,0,-1});
+}
@@ -0,0 +1,128 @@
+#include <catch2/catch_test_macros.hpp>
+#include "snapshot.hpp"
+#include "commands.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+
+using namespace vxl;
+
+static std::string temp_path(const char* name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST_CASE("Snapshot round-trips cubes, materials, rotations and groups; chunks load lazily") {
+  Universe U;
+  U.set_base_edge_pixels(12);
+  Material red; red.colorA = {1,0,0,1};
+  Material grad; grad.kind = Material::Kind::Gradient; grad.colorB = {0,0,1,1}; grad.gradDir = {1,0,0};
+  Cube a; a.mat = U.materials().intern(red);
+  Cube b; b.mat = U.materials().intern(grad);
+  U.set_rotation(b, glm::angleAxis(glm::radians(30.0f), glm::vec3(0,1,0)));
+  U.materials().intern(Material{});   // unused entries are not saved
+  Material unused; unused.colorA = {0,1,0,1}; U.materials().intern(unused);
+
+  // One dense chunk, a scattering of sparse ones, a free rotation, a group
+  std::vector<IVec3> dense;
+  for (int z = 0; z < 32; ++z) for (int y = 0; y < 32; ++y) for (int x = 0; x < 16; ++x) dense.push_back({x,y,z});
+  U.place_many(dense, std::span<const Cube>(&a, 1));
+  for (int i = 0; i < 20; ++i) U.place(i * 100, -i * 70, i * 3, a);
+  U.place(-5, 7, 900, b);
+  Cube g; g.mat = a.mat; g.rotation.code = 5;
+  for (int x = 0; x < 3; ++x) U.place(200 + x, 0, 0, g);
+  U.group_create("arm", {{200,0,0}, {201,0,0}, {202,0,0}});
+  U.group_rotate("arm", 9);
+  U.group_move("arm", {-40, 3, 1});
+
+  auto path = temp_path("vxl_test_snapshot.vxs");
+  Snapshot::save(U, path);
+
+  Universe L;
+  Snapshot::load(L, path);
+  REQUIRE(L.size() == U.size());
+  REQUIRE(L.chunk_count() == U.chunk_count());
+  REQUIRE(L.resident_chunk_count() == 0);
+  REQUIRE(L.base_edge_pixels() == 12);
+  REQUIRE(L.materials().size() == 3);
+  REQUIRE(L.group("arm"));
+  REQUIRE(L.group("arm")->pose() == U.group("arm")->pose());
+
+  // Touching one voxel brings in just its chunk
+  auto c = L.get(3, 4, 5);
+  REQUIRE(c);
+  REQUIRE(L.material(c->mat).colorA == red.colorA);
+  REQUIRE(L.resident_chunk_count() == 1);
+
+  U.store().for_each([&](const IVec3& p, const Cube& want){
+    auto got = L.get(p.x, p.y, p.z);
+    REQUIRE(got);
+    REQUIRE(L.material(got->mat) == U.material(want.mat));
+    REQUIRE(L.rotation_matrix(*got) == U.rotation_matrix(want));
+  });
+  auto members = L.group_members("arm"), expect = U.group_members("arm");
+  auto byXyz = [](const IVec3& a, const IVec3& b){ return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+  std::sort(members.begin(), members.end(), byXyz);
+  std::sort(expect.begin(), expect.end(), byXyz);
+  REQUIRE(members == expect);
+  for (auto& p : members) REQUIRE(L.rotation_matrix(*L.get(p.x, p.y, p.z)) == U.rotation_matrix(*U.get(p.x, p.y, p.z)));
+
+  // Re-saving over the mapped file works, and the copy matches
+  Snapshot::save(L, path);
+  Universe R;
+  Snapshot::load(R, path);
+  REQUIRE(R.size() == U.size());
+  REQUIRE(R.get(-5, 7, 900));
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot load rejects missing and corrupt files and leaves the scene alone") {
+  Universe U;
+  Cube c; U.place(1,2,3, c);
+  REQUIRE_THROWS(Snapshot::load(U, temp_path("vxl_no_such_snapshot.vxs")));
+
+  auto path = temp_path("vxl_bad_snapshot.vxs");
+  { std::ofstream f(path, std::ios::binary); f << "not a snapshot at all, just some text padding it out to size"; }
+  REQUIRE_THROWS(Snapshot::load(U, path));
+
+  // Chunk coordinate far outside the world (would overflow if scaled to voxels)
+  Snapshot::save(U, path);
+  {
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    SnapHeader h{};
+    f.read(reinterpret_cast<char*>(&h), sizeof h);
+    const int32_t cx = 1 << 28;
+    f.seekp(std::streamoff(h.directoryOffset + offsetof(SnapChunk, cx)));
+    f.write(reinterpret_cast<const char*>(&cx), sizeof cx);
+  }
+  REQUIRE_THROWS(Snapshot::load(U, path));
+
+  // Valid header, truncated body
+  Snapshot::save(U, path);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 16);
+  REQUIRE_THROWS(Snapshot::load(U, path));
+  REQUIRE(U.size() == 1);
+  std::remove(path.c_str());
+}
+
+TEST_CASE("save/load commands clear selection and history") {
+  Universe U; Selection S; History H(U);
+  CommandRegistry R; register_builtin_commands(R);
+  std::vector<std::string> out;
+  CommandContext ctx{U, S, [&](const std::string& s){ out.push_back(s); }, []{}, []{}, &H};
+  auto path = temp_path("vxl_cmd_snapshot.vxs");
+
+  R.run_line("place 1 1 1", ctx);
+  REQUIRE(R.run_line("save " + path, ctx));
+  R.run_line("place 2 2 2", ctx);
+  R.run_line("select 2 2 2", ctx);
+  REQUIRE(R.run_line("load " + path, ctx));
+  REQUIRE(U.size() == 1);
+  REQUIRE(S.items().empty());
+  REQUIRE(H.undo_depth() == 0);
+  REQUIRE_FALSE(R.run_line("load " + path + ".missing", ctx));
+  std::remove(path.c_str());
+}
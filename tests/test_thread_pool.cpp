@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+#include "thread_pool.hpp"
+#include "mesher.hpp"
+#include "universe.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace vxl;
+
+TEST_CASE("Thread pool runs every job and idle workers steal") {
+  ThreadPool pool(4);
+  REQUIRE(pool.size() == 4);
+  std::atomic<int> sum{0};
+  for (int i = 1; i <= 1000; ++i) pool.submit([&sum, i] { sum += i; });
+  pool.wait_idle();
+  REQUIRE(sum == 500500);
+  REQUIRE(pool.pending() == 0);
+
+  // One job fans out on its own worker's deque; the others can only get work by stealing
+  std::atomic<int> ran{0};
+  pool.submit([&] {
+    for (int i = 0; i < 64; ++i)
+      pool.submit([&ran] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); ++ran; });
+  });
+  pool.wait_idle();
+  REQUIRE(ran == 64);
+  REQUIRE(pool.steals() > 0);
+
+  REQUIRE(ThreadPool().size() >= 1);
+}
+
+TEST_CASE("Destroying a thread pool drops the jobs it has not started") {
+  std::atomic<bool> started{false}, release{false};
+  std::atomic<int> ran{0};
+  std::thread releaser;
+  {
+    ThreadPool pool(1);
+    pool.submit([&] { started = true; while (!release) std::this_thread::yield(); });
+    while (!started) std::this_thread::yield();
+    for (int i = 0; i < 200; ++i) pool.submit([&ran] { ++ran; });
+    // Let the running job finish once the destructor below has begun
+    releaser = std::thread([&] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); release = true; });
+  }
+  releaser.join();
+  REQUIRE(ran == 0);
+}
+
+TEST_CASE("Completion queue hands back everything pushed from many threads") {
+  CompletionQueue<std::unique_ptr<int>> q;
+  REQUIRE(q.empty());
+  std::vector<int> seen;
+  std::vector<int> last(4, -1);
+  bool ordered = true;
+  auto consume = [&](std::unique_ptr<int>&& v) {
+    // Producer t pushes t * 10000 + k for rising k: each producer's items arrive in order
+    const int t = *v / 10000, k = *v % 10000;
+    ordered &= k > last[t];
+    last[t] = k;
+    seen.push_back(*v);
+  };
+  {
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t)
+      producers.emplace_back([&q, t] { for (int k = 0; k < 5000; ++k) q.push(std::make_unique<int>(t * 10000 + k)); });
+    while (seen.size() < 20000) q.drain(consume);
+    for (auto& p : producers) p.join();
+  }
+  REQUIRE(q.drain(consume) == 0);
+  REQUIRE(ordered);
+  std::sort(seen.begin(), seen.end());
+  REQUIRE(std::adjacent_find(seen.begin(), seen.end()) == seen.end());
+
+  q.push(std::make_unique<int>(1));   // freed by the destructor
+}
+
+TEST_CASE("Meshing a gathered copy matches meshing the store, after the store moves on") {
+  Universe U;
+  std::vector<IVec3> block;
+  for (int z = 0; z < 40; ++z) for (int y = 0; y < 8; ++y) for (int x = 0; x < 40; ++x) block.push_back({x,y,z});
+  Cube c;
+  U.place_many(block, std::span<const Cube>(&c, 1));
+  Mesher M;
+  ChunkMesh direct;
+  M.build(U.store(), {0,0,0}, direct);
+
+  MeshInput in;
+  REQUIRE(Mesher::gather(U.store(), {0,0,0}, in));
+  REQUIRE_FALSE(Mesher::gather(U.store(), {5,5,5}, in));
+  U.erase(3, 3, 3);
+  U.place(35, 3, 3);
+
+  ThreadPool pool(2);
+  ChunkMesh copy;
+  pool.submit([&] { Mesher worker; worker.build(in, copy); });
+  pool.wait_idle();
+  REQUIRE(copy.faces == direct.faces);
+  REQUIRE(copy.quads() == direct.quads());
+}
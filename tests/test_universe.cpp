@@ -1,6 +1,8 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_approx.hpp>
 #include "universe.hpp"
+#include "selection.hpp"
+#include <limits>
 
 using namespace vxl;
 using Catch::Approx;
@@ -8,11 +10,12 @@ using Catch::Approx;
 TEST_CASE("Universe place/erase/get works") {
   Universe U;
   REQUIRE_FALSE(U.get(0,0,0).has_value());
-  Cube c; c.mat.colorA = {1,0,0,1};
+  Material m; m.colorA = {1,0,0,1};
+  Cube c; c.mat = U.materials().intern(m);
   U.place(0,0,0, c);
   auto g = U.get(0,0,0);
   REQUIRE(g.has_value());
-  REQUIRE(g->mat.colorA.x == Approx(1.0f));
+  REQUIRE(U.material(g->mat).colorA.x == Approx(1.0f));
   REQUIRE(U.erase(0,0,0));
   REQUIRE_FALSE(U.get(0,0,0).has_value());
 }
@@ -27,3 +30,172 @@ TEST_CASE("Groups create/move") {
   REQUIRE(U.get(0,1,0).has_value());
   REQUIRE(U.get(1,1,0).has_value());
 }
+
+TEST_CASE("Group transforms are O(1) and bake flattens them") {
+  Universe U;
+  Cube c; c.mat = 5;
+  U.place(0,0,0, c); U.place(1,0,0, c); U.place(2,0,0, c); U.place(9,9,9);
+  U.group_create("g", {{0,0,0}, {1,0,0}, {2,0,0}});
+  REQUIRE(U.store().size() == 1);          // members left the world storage
+  REQUIRE(U.size() == 4);
+  REQUIRE(U.group("g")->offset == IVec3{1,0,0});
+
+  REQUIRE(U.group_move("g", {0,5,0}));
+  REQUIRE(U.store().size() == 1);          // nothing rewritten
+  REQUIRE(U.get(0,5,0)->mat == 5);
+  REQUIRE_FALSE(U.get(0,0,0).has_value());
+
+  // Quarter turn about y around the anchor (1,5,0): the row now runs along z
+  REQUIRE(U.group_rotate("g", *snap_orientation(glm::angleAxis(glm::radians(90.0f), glm::vec3(0,1,0)))));
+  REQUIRE(U.get(1,5,-1).has_value());
+  REQUIRE(U.get(1,5,1).has_value());
+  REQUIRE_FALSE(U.get(0,5,0).has_value());
+  REQUIRE_FALSE(U.get(1,5,1)->rotation.code == 0);   // cube orientation follows the group
+
+  // Edits through world coordinates reach grouped cubes
+  std::vector<IVec3> probe = {{1,5,1}, {9,9,9}};
+  REQUIRE(U.update_many(probe, [](const IVec3&, Cube& cube){ cube.mat = 7; }) == 2);
+  REQUIRE(U.get(1,5,1)->mat == 7);
+  REQUIRE(U.erase(1,5,-1));
+  REQUIRE(U.group_members("g").size() == 2);
+
+  auto hit = Selection::pick_cube(U, {1.0f, 5.0f, 10.0f}, {0.0f, 0.0f, -1.0f});
+  REQUIRE(hit.has_value());
+  REQUIRE(*hit == IVec3{1,5,1});
+
+  REQUIRE(U.group_bake("g"));
+  REQUIRE_FALSE(U.group_exists("g"));
+  REQUIRE(U.store().size() == 3);
+  REQUIRE(U.get(1,5,1)->mat == 7);
+  REQUIRE(U.get(1,5,0)->mat == 5);
+}
+
+TEST_CASE("Chunked storage handles negative coords and chunk borders") {
+  Universe U;
+  U.place(-1,-1,-1); U.place(0,0,0); U.place(31,0,0); U.place(32,0,0); U.place(-33,5,7);
+  REQUIRE(U.size() == 5);
+  REQUIRE(U.chunk_count() == 4);
+  REQUIRE(U.get(-1,-1,-1).has_value());
+  REQUIRE(U.get(-33,5,7).has_value());
+  REQUIRE_FALSE(U.get(-32,5,7).has_value());
+  REQUIRE(chunk_of({-1,0,31}) == IVec3{-1,0,0});
+  REQUIRE(voxel_at(chunk_of({-33,5,7}), local_index({-33,5,7})) == IVec3{-33,5,7});
+
+  size_t visited = 0;
+  U.for_each([&](const IVec3& p, const Cube&){ REQUIRE(U.get(p.x,p.y,p.z).has_value()); ++visited; });
+  REQUIRE(visited == 5);
+
+  REQUIRE(U.erase(32,0,0));
+  REQUIRE(U.chunk_count() == 3); // empty chunks are released
+}
+
+TEST_CASE("Chunk switches between sparse and dense storage") {
+  Chunk ch;
+  Cube c; c.mat = 7;
+  for (int i = 0; i <= Chunk::DENSE_AT; ++i) REQUIRE(ch.set(i * 3 % CHUNK_VOLUME, c));
+  REQUIRE(ch.dense());
+  REQUIRE(ch.find(3) != nullptr);
+  REQUIRE(ch.find(3)->mat == 7);
+  REQUIRE(ch.find(4) == nullptr);
+
+  int prev = -1; bool ordered = true;
+  ch.for_each([&](int i, const Cube&){ ordered = ordered && i > prev; prev = i; });
+  REQUIRE(ordered);
+
+  for (int i = 0; i <= Chunk::DENSE_AT; ++i) ch.erase(i * 3 % CHUNK_VOLUME);
+  REQUIRE(ch.empty());
+  REQUIRE_FALSE(ch.dense());
+}
+
+TEST_CASE("Material palette deduplicates and collects unused entries") {
+  Universe U;
+  Material red; red.colorA = {1,0,0,1};
+  Material blue; blue.colorA = {0,0,1,1};
+  MaterialId r = U.materials().intern(red);
+  const uint64_t v = U.materials().version();
+  REQUIRE(U.materials().intern(red) == r);
+  REQUIRE(U.materials().intern(Material{}) == 0);
+  REQUIRE(U.materials().version() == v);    // lookups leave cached copies valid
+  MaterialId b = U.materials().intern(blue);
+  REQUIRE(b != r);
+  REQUIRE(U.materials().size() == 3);
+
+  Cube c; c.mat = b;
+  U.place(0,0,0, c);
+  const uint64_t before = U.materials().version();
+  REQUIRE(U.gc_materials() == 1);           // red is unreferenced
+  REQUIRE(U.materials().version() != before);
+  REQUIRE(U.materials().size() == 2);
+  REQUIRE(U.material(b).colorA.z == Approx(1.0f));
+  REQUIRE(U.materials().intern(red) == r);  // freed slot is reused
+
+  // -0 and +0 are one material; a NaN component interns once, not per call
+  Material neg = red; neg.colorA.y = -0.0f;
+  REQUIRE(U.materials().intern(neg) == r);
+  Material nan = red; nan.colorB.x = std::numeric_limits<float>::quiet_NaN();
+  const MaterialId n = U.materials().intern(nan);
+  REQUIRE(U.materials().intern(nan) == n);
+}
+
+TEST_CASE("Batch place/update/erase") {
+  Universe U;
+  std::vector<IVec3> pts;
+  for (int z = -20; z < 20; ++z) for (int y = 0; y < 40; ++y) for (int x = 40; x > 0; --x) pts.push_back({x,y,z});
+  Cube c; c.mat = 3;
+  U.place_many(pts, std::span<const Cube>(&c, 1));
+  REQUIRE(U.size() == pts.size());
+  REQUIRE(U.get(1,0,-20)->mat == 3);
+
+  std::vector<IVec3> probe = {{1,0,0}, {1,0,0}, {500,0,0}, {2,2,2}};
+  REQUIRE(U.update_many(probe, [](const IVec3&, Cube& cube){ cube.mat = 9; }) == 3);
+  REQUIRE(U.get(1,0,0)->mat == 9);
+  REQUIRE(U.get(2,2,2)->mat == 9);
+  REQUIRE(U.get(3,3,3)->mat == 3);
+
+  std::vector<IVec3> bad = {{0,0,0}, {MORTON_MAX + 1, 0, 0}};
+  REQUIRE_THROWS_AS(U.place_many(bad, std::span<const Cube>(&c, 1)), std::out_of_range);
+  REQUIRE_FALSE(U.get(0,0,0).has_value());
+
+  REQUIRE(U.erase_many(pts) == pts.size());
+  REQUIRE(U.size() == 0);
+  REQUIRE(U.chunk_count() == 0);
+}
+
+TEST_CASE("Chunk stores report each changed chunk once") {
+  auto drain = [](const ChunkStore& s) {
+    std::vector<IVec3> out;
+    s.take_dirty([&](const IVec3& cc){ out.push_back(cc); });
+    return out;
+  };
+  Universe U;
+  std::vector<IVec3> pts;
+  for (int x = -40; x < 40; ++x) pts.push_back({x, 0, 0});
+  Cube c;
+  U.place_many(pts, std::span<const Cube>(&c, 1));
+  U.place(1, 1, 1);
+  REQUIRE(drain(U.store()).size() == 4);   // chunks x = -2 .. 1
+  REQUIRE(drain(U.store()).empty());
+
+  // Reads and paging are not changes; a removed chunk is
+  U.get(5, 0, 0);
+  REQUIRE(drain(U.store()).empty());
+  std::vector<IVec3> far;
+  for (int x = -40; x < -32; ++x) far.push_back({x, 0, 0});
+  U.erase_many(far);
+  auto d = drain(U.store());
+  REQUIRE(d.size() == 1);
+  REQUIRE(d[0] == IVec3{-2, 0, 0});
+  REQUIRE_FALSE(U.store().chunk(d[0]));
+
+  // Group stores track their own chunks under their own serial
+  U.group_create("g", {{0, 0, 0}});
+  const Group* g = U.group("g");
+  REQUIRE(g->cubes.serial() != U.store().serial());
+  REQUIRE(drain(g->cubes).size() == 1);
+  REQUIRE(drain(U.store()).size() == 1);
+  U.group_move("g", {0, 50, 0});   // poses are not chunk changes
+  REQUIRE(drain(g->cubes).empty());
+
+  U.clear();
+  REQUIRE(drain(U.store()).size() == 3);
+}
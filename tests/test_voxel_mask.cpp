@@ -0,0 +1,177 @@
+#include <catch2/catch_test_macros.hpp>
+#include "voxel_mask.hpp"
+#include "selection.hpp"
+#include "commands.hpp"
+#include "world_snapshot.hpp"
+#include <random>
+#include <unordered_set>
+
+using namespace vxl;
+
+namespace {
+
+using RefSet = std::unordered_set<IVec3, IVec3Hasher>;
+
+bool matches(const VoxelMask& m, const RefSet& ref) {
+  if (m.size() != ref.size() || m.empty() != ref.empty()) return false;
+  std::size_t n = 0;
+  bool ok = true;
+  m.for_each([&](const IVec3& p) { ok = ok && ref.contains(p); ++n; });
+  return ok && n == ref.size();
+}
+
+/// Random coordinates around a few chunk corners, negatives included.
+std::pair<VoxelMask, RefSet> random_mask(std::mt19937& rng, int n) {
+  std::uniform_int_distribution<int> d(-40, 40);
+  VoxelMask m;
+  RefSet ref;
+  for (int i = 0; i < n; ++i) {
+    const IVec3 p{d(rng), d(rng) / 4, d(rng)};
+    REQUIRE(m.insert(p) == ref.insert(p).second);
+  }
+  return {std::move(m), std::move(ref)};
+}
+
+} // namespace
+
+TEST_CASE("VoxelMask matches a hash set under random insert/erase") {
+  std::mt19937 rng(23);
+  std::uniform_int_distribution<int> d(-70, 70);
+  VoxelMask m;
+  RefSet ref;
+  for (int i = 0; i < 30000; ++i) {
+    const IVec3 p{d(rng), d(rng), d(rng) / 8};
+    if (rng() % 3 == 0) REQUIRE(m.erase(p) == (ref.erase(p) > 0));
+    else REQUIRE(m.insert(p) == ref.insert(p).second);
+  }
+  REQUIRE(matches(m, ref));
+  for (int i = 0; i < 2000; ++i) {
+    const IVec3 p{d(rng), d(rng), d(rng) / 8};
+    REQUIRE(m.contains(p) == ref.contains(p));
+  }
+  REQUIRE(m.contains({MORTON_MIN, MORTON_MAX, 0}) == false);
+  REQUIRE(m.insert({MORTON_MIN, MORTON_MAX, 0}));
+  REQUIRE(m.contains({MORTON_MIN, MORTON_MAX, 0}));
+
+  // Emptied chunks are dropped
+  m.clear();
+  REQUIRE(m.insert({5, 5, 5}));
+  REQUIRE(m.erase({5, 5, 5}));
+  REQUIRE(m.empty());
+  REQUIRE(m.chunk_count() == 0);
+}
+
+TEST_CASE("VoxelMask set algebra matches the element-wise result") {
+  std::mt19937 rng(7);
+  auto [a, refA] = random_mask(rng, 4000);
+  auto [b, refB] = random_mask(rng, 4000);
+
+  RefSet uni = refA, inter, diff;
+  uni.insert(refB.begin(), refB.end());
+  for (const IVec3& p : refA) (refB.contains(p) ? inter : diff).insert(p);
+
+  VoxelMask u = a;
+  u |= b;
+  REQUIRE(matches(u, uni));
+  VoxelMask i = a;
+  i &= b;
+  REQUIRE(matches(i, inter));
+  VoxelMask s = a;
+  s -= b;
+  REQUIRE(matches(s, diff));
+  REQUIRE(matches(a, refA));   // the copies did not write through
+
+  VoxelMask self = a;
+  self |= self;
+  self &= self;
+  REQUIRE(self == a);
+  self -= self;
+  REQUIRE(self.empty());
+  i -= a;
+  REQUIRE(i.empty());
+  REQUIRE(i.chunk_count() == 0);
+}
+
+TEST_CASE("VoxelMask copies share chunks until one of them changes") {
+  VoxelMask a;
+  for (int x = 0; x < 32; ++x)
+    for (int y = 0; y < 32; ++y) a.insert({x, y, 3});
+  a.insert({100, 0, 0});
+  VoxelMask b = a;
+  REQUIRE(b.chunk({0, 0, 0}) == a.chunk({0, 0, 0}));
+  REQUIRE(b.insert({0, 0, 4}));
+  REQUIRE(b.chunk({0, 0, 0}) != a.chunk({0, 0, 0}));
+  REQUIRE(b.chunk({3, 0, 0}) == a.chunk({3, 0, 0}));
+  REQUIRE_FALSE(a.contains({0, 0, 4}));
+  REQUIRE(a.size() == 32 * 32 + 1);
+  REQUIRE(b.size() == a.size() + 1);
+  REQUIRE_FALSE(a == b);
+  REQUIRE(b.erase({0, 0, 4}));
+  REQUIRE(a == b);
+
+  // Slices cover everything once, in order, and no slice is larger than asked
+  std::vector<IVec3> sliced;
+  std::size_t calls = 0;
+  a.for_each_slice(100, [&](std::span<const IVec3> s) {
+    REQUIRE(s.size() <= 100);
+    sliced.insert(sliced.end(), s.begin(), s.end());
+    ++calls;
+  });
+  REQUIRE(sliced == a.items());
+  REQUIRE(calls == 11);
+  REQUIRE(a.memory_bytes() >= 2 * sizeof(VoxelMask::Bits));
+}
+
+TEST_CASE("Selection set operations bump the version only on change") {
+  Selection S;
+  VoxelMask m;
+  m.insert({1, 0, 0});
+  m.insert({2, 0, 0});
+  S.unite(m);
+  REQUIRE(S.size() == 2);
+  const uint64_t v = S.version();
+  S.unite(m);
+  S.intersect(m);
+  REQUIRE(S.version() == v);
+  VoxelMask one;
+  one.insert({2, 0, 0});
+  S.subtract(one);
+  REQUIRE(S.version() == v + 1);
+  REQUIRE(S.items() == std::vector<IVec3>{{1, 0, 0}});
+  S.intersect(one);
+  REQUIRE(S.empty());
+
+  // A snapshot keeps the selection it was built with
+  Universe U;
+  SnapshotBuilder B;
+  S.unite(m);
+  auto w = B.build(U, S);
+  S.add({3, 0, 0});
+  REQUIRE(w->selection->size() == 2);
+  REQUIRE_FALSE(w->selection->contains({3, 0, 0}));
+}
+
+TEST_CASE("Selection-wide commands walk large selections in slices") {
+  Universe U;
+  Selection S;
+  std::vector<IVec3> cells;
+  for (int z = 0; z < 48; ++z)
+    for (int y = 0; y < 48; ++y)
+      for (int x = 0; x < 40; ++x) cells.push_back({x, y, z});
+  Cube c;
+  U.place_many(cells, std::span<const Cube>(&c, 1));
+  for (const IVec3& p : cells) S.add(p);
+  REQUIRE(S.size() > Selection::EDIT_SLICE);
+
+  std::vector<std::string> out;
+  CommandRegistry R;
+  register_builtin_commands(R);
+  CommandContext ctx{U, S, [&](const std::string& s){ out.push_back(s); }, []{}, []{}};
+  REQUIRE(R.run_line("fill solid #FF0000FF", ctx));
+  std::size_t red = 0;
+  U.for_each([&](const IVec3&, const Cube& k) { red += U.material(k.mat).colorA == glm::vec4(1, 0, 0, 1); });
+  REQUIRE(red == cells.size());
+  REQUIRE(R.run_line("erase selection", ctx));
+  REQUIRE(U.size() == 0);
+  REQUIRE(S.empty());
+}
@@ -0,0 +1,191 @@
+#include <catch2/catch_test_macros.hpp>
+#include "voxel_transform.hpp"
+#include "selection.hpp"
+#include "commands.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <map>
+#include <random>
+
+using namespace vxl;
+
+namespace {
+
+const glm::vec3 AXES[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+Cube coloured(Universe& U, float r) {
+  Material m;
+  m.colorA = {r, 0, 0, 1};
+  Cube c;
+  c.mat = U.materials().intern(m);
+  return c;
+}
+
+/// Position -> (material, full rotation) of every ungrouped cube.
+std::map<std::tuple<int, int, int>, std::pair<MaterialId, glm::quat>> contents(const Universe& U) {
+  std::map<std::tuple<int, int, int>, std::pair<MaterialId, glm::quat>> out;
+  U.for_each([&](const IVec3& p, const Cube& c) { out[{p.x, p.y, p.z}] = {c.mat, U.rotation(c)}; });
+  return out;
+}
+
+bool same_rotation(const glm::quat& a, const glm::quat& b) {
+  return std::abs(std::abs(glm::dot(a, b)) - 1.0f) < 1e-4f;
+}
+
+} // namespace
+
+TEST_CASE("Quarter turns match snapped rotations and compose") {
+  std::mt19937 rng(25);
+  std::uniform_int_distribution<int> d(-50, 50);
+  for (int a = 0; a < 3; ++a)
+    for (int q = -5; q <= 5; ++q) {
+      const VoxelTransform T = VoxelTransform::turn(a, q, {0, 0, 0});
+      const uint8_t code = *snap_orientation(glm::angleAxis(glm::radians(90.0f * float(q)), AXES[a]));
+      REQUIRE(T.det() == 1);
+      REQUIRE(T.cube_turn() == code);
+      for (int k = 0; k < 20; ++k) {
+        const IVec3 p{d(rng), d(rng), d(rng)};
+        REQUIRE(T.apply(p) == orientation_apply(code, p));
+      }
+    }
+
+  // Four quarters about any pivot, and any map followed by its inverse, are the identity
+  const VoxelTransform T = VoxelTransform::turn(1, 1, {3, 8, -7});
+  REQUIRE(T.then(T).then(T).then(T).identity());
+  const VoxelTransform M = T.then(VoxelTransform::mirror(0, 5)).then(VoxelTransform::translation({4, -2, 9}));
+  REQUIRE(M.det() == -1);
+  REQUIRE(M.then(M.inverse()).identity());
+  REQUIRE(M.inverse().then(M).identity());
+  for (int k = 0; k < 50; ++k) {
+    const IVec3 p{d(rng), d(rng), d(rng)};
+    const IVec3 step = VoxelTransform::translation({4, -2, 9}).apply(VoxelTransform::mirror(0, 5).apply(T.apply(p)));
+    REQUIRE(M.apply(p) == step);
+  }
+
+  // A pivot on a cube edge works, one off the grid does not
+  REQUIRE(VoxelTransform::turn(2, 1, {6, 10, 0}).apply({3, 5, 9}) == IVec3{3, 5, 9});
+  REQUIRE(VoxelTransform::turn(2, 1, {1, 1, 0}).apply({0, 0, 0}) == IVec3{1, 0, 0});
+  REQUIRE_THROWS_AS(VoxelTransform::turn(2, 1, {1, 0, 0}), std::invalid_argument);
+  REQUIRE_NOTHROW(VoxelTransform::turn(2, 2, {1, 0, 0}));
+  REQUIRE_THROWS_AS(VoxelTransform::turn(3, 1, {0, 0, 0}), std::invalid_argument);
+  REQUIRE(VoxelTransform::mirror(1, 3).apply({2, 5, 7}) == IVec3{2, -2, 7});
+  REQUIRE(VoxelTransform::turn(0, 1, turnable_pivot(0, {4, 1, 2})).det() == 1);
+}
+
+TEST_CASE("Selections turn, mirror and move through overlapping cells") {
+  Universe U;
+  Selection S;
+  ThreadPool pool(2);
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> d(-20, 20);
+  const uint8_t quarterY = *snap_orientation(glm::angleAxis(glm::radians(90.0f), AXES[1]));
+  const glm::quat free = glm::angleAxis(glm::radians(30.0f), glm::normalize(glm::vec3(1, 2, 3)));
+  for (int i = 0; i < 6000; ++i) {
+    const IVec3 p{d(rng), d(rng), d(rng)};
+    Cube c = coloured(U, float(i % 7) / 7.0f);
+    if (i % 5 == 1) c.rotation.code = quarterY;
+    if (i % 5 == 2) U.set_rotation(c, free);
+    U.place(p.x, p.y, p.z, c);
+    S.add(p);
+  }
+  S.add({100, 0, 0});   // an empty selected cell travels with the rest
+  const auto before = contents(U);
+
+  SECTION("turn") {
+    const VoxelTransform T = VoxelTransform::turn(1, 1, turnable_pivot(1, doubled_centroid(S.set())));
+    const glm::quat q = orientation_quat(T.cube_turn());
+    REQUIRE(S.transform(U, T, &pool));
+    const auto after = contents(U);
+    REQUIRE(after.size() == before.size());
+    for (const auto& [k, v] : before) {
+      const IVec3 p = T.apply({std::get<0>(k), std::get<1>(k), std::get<2>(k)});
+      const auto it = after.find({p.x, p.y, p.z});
+      REQUIRE(it != after.end());
+      REQUIRE(it->second.first == v.first);
+      REQUIRE(same_rotation(it->second.second, q * v.second));
+    }
+    REQUIRE(S.contains(T.apply({100, 0, 0})));
+    REQUIRE(S.size() == before.size() + 1);
+    // Three more quarters bring back every cube as it was
+    for (int k = 0; k < 3; ++k) REQUIRE(S.transform(U, T));
+    const auto back = contents(U);
+    REQUIRE(back.size() == before.size());
+    for (const auto& [k, v] : before) {
+      REQUIRE(back.at(k).first == v.first);
+      REQUIRE(same_rotation(back.at(k).second, v.second));
+    }
+  }
+  SECTION("mirror") {
+    const VoxelTransform T = VoxelTransform::mirror(2, 3);
+    REQUIRE(T.cube_turn() == *snap_orientation(glm::angleAxis(glm::radians(180.0f), AXES[2])));
+    REQUIRE(S.transform(U, T, &pool));
+    REQUIRE(contents(U).size() == before.size());
+    REQUIRE(S.transform(U, T));
+    const auto back = contents(U);
+    for (const auto& [k, v] : before) REQUIRE(back.at(k).first == v.first);
+  }
+  SECTION("move") {
+    REQUIRE(S.move(U, {1, 0, 0}, &pool));   // shifts onto itself
+    const auto after = contents(U);
+    REQUIRE(after.size() == before.size());
+    for (const auto& [k, v] : before) {
+      const auto& w = after.at({std::get<0>(k) + 1, std::get<1>(k), std::get<2>(k)});
+      REQUIRE(w.first == v.first);
+      REQUIRE(same_rotation(w.second, v.second));
+    }
+    // Leaving the world refuses the whole edit
+    REQUIRE_FALSE(S.move(U, {MORTON_MAX, 0, 0}));
+    REQUIRE(contents(U) == after);
+    REQUIRE(S.contains({101, 0, 0}));
+  }
+}
+
+TEST_CASE("Transforms move the cube seen at each coordinate") {
+  Universe U;
+  Selection S;
+  Cube red = coloured(U, 1.0f), blue = coloured(U, 0.5f);
+  U.place(0, 0, 0, blue);
+  U.group_create("g", {{0, 0, 0}});
+  U.place(0, 0, 0, red);   // shadows the group cube
+  S.add({0, 0, 0});
+  REQUIRE(S.move(U, {0, 5, 0}));
+  REQUIRE(U.get(0, 5, 0)->mat == red.mat);
+  REQUIRE(U.get(0, 0, 0)->mat == blue.mat);   // the group cube stays, no longer hidden
+  REQUIRE(U.group_members("g").size() == 1);
+}
+
+TEST_CASE("Turn, mirror and move commands edit the selection") {
+  Universe U;
+  Selection S;
+  std::vector<std::string> out;
+  CommandRegistry R;
+  register_builtin_commands(R);
+  CommandContext ctx{U, S, [&](const std::string& s){ out.push_back(s); }, []{}, []{}};
+  for (int x = 0; x < 4; ++x) { U.place(x, 0, 0); S.add({x, 0, 0}); }
+
+  REQUIRE(R.run_line("turn z 2", ctx));   // a half turn about the exact centre keeps the row in place
+  REQUIRE(U.get(0, 0, 0));
+  REQUIRE(U.get(3, 0, 0));
+  REQUIRE(U.size() == 4);
+  REQUIRE(R.run_line("turn z -2", ctx));
+  REQUIRE(U.get(0, 0, 0));
+  REQUIRE(U.get(3, 0, 0));
+  REQUIRE(R.run_line("turn z", ctx));   // about the centre (1.5, 0, 0), moved to (1.5, 0.5, 0)
+  REQUIRE(U.get(2, -1, 0));
+  REQUIRE(U.get(2, 2, 0));
+  REQUIRE_FALSE(U.get(0, 0, 0));
+  REQUIRE(R.run_line("turn z -1 about 1.5 0.5 0", ctx));
+  REQUIRE(U.get(0, 0, 0));
+  REQUIRE(U.get(3, 0, 0));
+  REQUIRE(R.run_line("turn z 1 about 0.5 0 0", ctx));
+  REQUIRE(out.back() == "That pivot would put cubes between cells.");
+  REQUIRE(R.run_line("mirror x at -0.5", ctx));
+  REQUIRE(U.get(-4, 0, 0));
+  REQUIRE(U.get(-1, 0, 0));
+  REQUIRE_FALSE(U.get(0, 0, 0));
+  REQUIRE(R.run_line("mirror x", ctx));
+  REQUIRE(U.get(-4, 0, 0));
+  REQUIRE(R.run_line("move 0 2000000 0", ctx));
+  REQUIRE(out.back() == "That would move cubes out of the world.");
+  REQUIRE(R.run_line("turn w", ctx));
+  REQUIRE(out.back() == "Usage: turn x|y|z [quarters] [about px py pz]");
+}
@@ -0,0 +1,189 @@
+#include <catch2/catch_test_macros.hpp>
+#include "world_snapshot.hpp"
+#include "simulation.hpp"
+#include "mesher.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace vxl;
+
+namespace {
+
+std::vector<IVec3> changes(const StoreSnapshot& now, const StoreSnapshot* before) {
+  std::vector<IVec3> out;
+  now.for_each_change(before, [&](const IVec3& cc) { out.push_back(cc); });
+  std::sort(out.begin(), out.end(), [](const IVec3& a, const IVec3& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+  });
+  return out;
+}
+
+} // namespace
+
+TEST_CASE("Store snapshots share unchanged chunks and never see later edits") {
+  ChunkStore S;
+  const Cube red{};
+  for (int x = 0; x < 4 * CHUNK_SIZE; x += CHUNK_SIZE) S.place({x, 0, 0}, red);
+  S.place({9 * CHUNK_SIZE, 0, 0}, red);   // another region
+  auto a = StoreSnapshot::update(S, nullptr);
+  REQUIRE(a->serial() == S.serial());
+  REQUIRE(a->size() == 5);
+  REQUIRE(a->chunk_count() == 5);
+  REQUIRE(changes(*a, nullptr).size() == 5);
+
+  // Nothing changed: the same snapshot
+  REQUIRE(StoreSnapshot::update(S, a) == a);
+
+  // Edit one chunk: the store copies it, the old snapshot keeps what it had
+  const Chunk* before = a->chunk({1, 0, 0});
+  S.place({CHUNK_SIZE + 1, 0, 0}, red);
+  REQUIRE(a->chunk({1, 0, 0}) == before);
+  REQUIRE(before->size() == 1);
+  auto b = StoreSnapshot::update(S, a);
+  REQUIRE(b->size() == 6);
+  REQUIRE(b->chunk({1, 0, 0})->size() == 2);
+  REQUIRE(b->chunk({0, 0, 0}) == a->chunk({0, 0, 0}));
+  REQUIRE(changes(*b, a.get()) == std::vector<IVec3>{{1, 0, 0}});
+
+  // Remove a chunk, add one in a new region
+  S.erase({9 * CHUNK_SIZE, 0, 0});
+  S.place({0, 0, 20 * CHUNK_SIZE}, red);
+  auto c = StoreSnapshot::update(S, b);
+  REQUIRE(c->chunk_count() == 5);
+  REQUIRE_FALSE(c->has_chunk({9, 0, 0}));
+  REQUIRE(changes(*c, b.get()) == std::vector<IVec3>{{0, 0, 20}, {9, 0, 0}});
+  REQUIRE(b->has_chunk({9, 0, 0}));
+
+  // Once no snapshot holds a chunk, edits go in place (no copy)
+  a.reset();
+  b.reset();
+  c.reset();
+  const Chunk* own = S.chunk({0, 0, 0});
+  S.place({1, 0, 0}, red);
+  REQUIRE(S.chunk({0, 0, 0}) == own);
+
+  // A snapshot of another store starts over
+  ChunkStore T;
+  T.place({0, 0, 0}, red);
+  auto d = StoreSnapshot::update(S, nullptr);
+  REQUIRE(StoreSnapshot::update(T, d)->serial() == T.serial());
+}
+
+TEST_CASE("Meshing a snapshot matches meshing the store") {
+  ChunkStore S;
+  for (int x = 0; x < 40; ++x) S.place({x, 3, 3}, Cube{});
+  auto snap = StoreSnapshot::update(S, nullptr);
+  MeshInput fromStore, fromSnap;
+  REQUIRE(Mesher::gather(S, {0, 0, 0}, fromStore));
+  REQUIRE(Mesher::gather(*snap, {0, 0, 0}, fromSnap));
+  REQUIRE(fromSnap.chunk.size() == fromStore.chunk.size());
+  for (int f = 0; f < 6; ++f) REQUIRE(fromSnap.border[f] == fromStore.border[f]);
+  REQUIRE_FALSE(Mesher::gather(*snap, {5, 5, 5}, fromSnap));
+}
+
+TEST_CASE("World snapshots reuse the parts that did not change") {
+  Universe U;
+  Selection Sel;
+  SnapshotBuilder B;
+  U.place(0, 0, 0);
+  auto a = B.build(U, Sel);
+  REQUIRE(a->version == 1);
+  REQUIRE(a->cubes == 1);
+  REQUIRE(a->selection->size() == 0);
+
+  Sel.add({0, 0, 0});
+  auto b = B.build(U, Sel);
+  REQUIRE(b->version == 2);
+  REQUIRE(b->world == a->world);
+  REQUIRE(b->materials == a->materials);
+  REQUIRE(b->rotations == a->rotations);
+  REQUIRE(b->selection->contains({0, 0, 0}));
+  REQUIRE(a->selection->size() == 0);
+
+  U.place(40, 0, 0);
+  auto c = B.build(U, Sel);
+  REQUIRE(c->world != b->world);
+  REQUIRE(c->selection == b->selection);
+  REQUIRE(c->cubes == 2);
+  REQUIRE(B.last() == c);
+}
+
+TEST_CASE("Triple buffer hands the reader the newest value") {
+  TripleBuffer<int> buf;
+  REQUIRE_FALSE(buf.update());
+  REQUIRE_FALSE(buf.publish(1));
+  REQUIRE(buf.publish(2));   // 1 was never read
+  REQUIRE(buf.update());
+  REQUIRE(buf.front() == 2);
+  REQUIRE_FALSE(buf.update());
+  REQUIRE_FALSE(buf.publish(3));
+
+  // A writer and a reader at full speed: the reader only ever sees values grow
+  TripleBuffer<std::vector<int>> big;
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 1; i <= 20000; ++i) big.publish(std::vector<int>(64, i));
+    done = true;
+  });
+  int last = 0;
+  bool ok = true;
+  for (;;) {
+    const bool finished = done;
+    if (!big.update()) {
+      if (finished) break;
+      continue;
+    }
+    const auto& v = big.front();
+    ok = ok && v.front() > last && std::all_of(v.begin(), v.end(), [&](int x) { return x == v.front(); });
+    last = v.front();
+  }
+  writer.join();
+  REQUIRE(ok);
+  REQUIRE(last == 20000);
+}
+
+TEST_CASE("Simulation runs posted edits in order and publishes snapshots") {
+  ThreadPool pool(2);
+  Simulation sim(pool);
+  REQUIRE(sim.update());
+  const uint64_t first = sim.snapshot()->version;
+  REQUIRE(sim.snapshot()->cubes == 0);
+
+  for (int x = 0; x < 100; ++x) sim.post([x](Simulation::Context& c) { c.U.place(x, 0, 0); });
+  sim.post([](Simulation::Context& c) { c.Sel.add({5, 0, 0}); });
+  sim.post([](Simulation::Context& c) {
+    CommandContext ctx{c.U, c.Sel, c.print, []{}, []{}, &c.history, c.log};
+    c.commands.run_line("nosuchcommand", ctx);
+  });
+  sim.post([](Simulation::Context&) { throw std::runtime_error("boom"); });
+  sim.wait_idle();
+  REQUIRE(sim.pending() == 0);
+
+  REQUIRE(sim.update());
+  auto w = sim.snapshot();
+  REQUIRE(w->version > first);
+  REQUIRE(w->cubes == 100);
+  REQUIRE(w->world->size() == 100);
+  REQUIRE(w->selection->contains({5, 0, 0}));
+  // Every snapshot with edits is stamped, in this one or one the reader took
+  REQUIRE_FALSE(w->edits.empty());
+  REQUIRE(w->edits.back().version == w->version);
+
+  std::vector<std::string> lines;
+  sim.drain_messages([&](std::string&& s) { lines.push_back(std::move(s)); });
+  REQUIRE(std::any_of(lines.begin(), lines.end(), [](const std::string& s) { return s.find("boom") != std::string::npos; }));
+
+  // The reader keeps its snapshot while edits go on
+  const auto held = w->world->chunk({0, 0, 0})->size();
+  sim.post([](Simulation::Context& c) { c.U.erase(0, 0, 0); });
+  sim.wait_idle();
+  REQUIRE(w->world->chunk({0, 0, 0})->size() == held);
+  REQUIRE(sim.update());
+  REQUIRE(sim.snapshot()->cubes == 99u);
+}